@@ -0,0 +1,28 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Block.h"
+#include "Road.h"
+#include "BlockDivisionResult.generated.h"
+
+// Output buffer of a division task of one top-level block
+// Tasks are run in parallel and never touch shared state - results are merged in order of top-level blocks afterwards
+USTRUCT()
+struct FBlockDivisionResult
+{
+	GENERATED_BODY()
+
+	// Random stream of the top-level block. Its seed depends only on the generation seed and the index of the block,
+	// so the division result doesn't depend on the order in which tasks are executed
+	FRandomStream RandomStream;
+
+	// Inner roads made by cuts
+	TArray<FRoad> Roads;
+	// Blocks which can't be divided further
+	TArray<FBlock> ResBlocks;
+
+	// DEBUG
+	TArray<FBlock> BlocksNotDivided;
+	TArray<FBlock> BlocksNotAttempted;
+	int32 AmountOfSuccessfulCuts = 0;
+};
\ No newline at end of file
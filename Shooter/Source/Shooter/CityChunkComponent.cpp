@@ -0,0 +1,203 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CityChunkComponent.h"
+#include "AI/NavigationSystemBase.h"
+#include "AI/NavigationSystemHelpers.h"
+#include "PhysicsEngine/BodySetup.h"
+
+// Thickness of the walkable slabs under roads and sidewalks
+static const float WalkableSlabThickness = 20.f;
+
+// Same kind of cells next to each other along X, merged into one box
+struct FChunkSpan
+{
+	int32 MinX;
+	int32 MaxX;
+	// 0 - walkable slab, > 0 - building of this height
+	int32 Height;
+	// Box of previous rows this span continues
+	int32 BoxIndex;
+
+	bool IsSameShape(const FChunkSpan& Other) const
+	{
+		return MinX == Other.MinX && MaxX == Other.MaxX && Height == Other.Height;
+	}
+};
+
+UCityChunkComponent::UCityChunkComponent() :
+ChunkBodySetup(nullptr),
+ChunkHash(0),
+bBuilt(false)
+{
+	PrimaryComponentTick.bCanEverTick = false;
+
+	SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	SetCanEverAffectNavigation(true);
+	bHasCustomNavigableGeometry = EHasCustomNavigableGeometry::EvenIfNotCollision;
+}
+
+uint32 UCityChunkComponent::GetChunkHash(const FWorldColumnRuns& Columns, FIntPoint ChunkMin, FIntPoint ChunkMax)
+{
+	uint32 Hash = GetTypeHash(ChunkMin);
+	for(int32 y = ChunkMin.Y; y < ChunkMax.Y; y++)
+	{
+		for(int32 x = ChunkMin.X; x < ChunkMax.X; x++)
+		{
+			for(const FWorldColumnRun& Run : Columns.GetColumn(x, y))
+			{
+				Hash = HashCombine(Hash, HashCombine(GetTypeHash(Run.Type), GetTypeHash(Run.Count)));
+			}
+			// Separates columns, so runs can't move from one to another unnoticed
+			Hash = HashCombine(Hash, GetTypeHash(-1));
+		}
+	}
+	return Hash;
+}
+
+bool UCityChunkComponent::Build(const FWorldColumnRuns& Columns, FIntPoint ChunkMin, FIntPoint ChunkMax, const FCityGridSpace& GridSpace)
+{
+	const uint32 NewHash = GetChunkHash(Columns, ChunkMin, ChunkMax);
+	if(bBuilt && NewHash == ChunkHash)
+	{
+		return false;
+	}
+	ChunkHash = NewHash;
+	bBuilt = true;
+
+	Boxes.Reset();
+	TArray<FChunkSpan> PrevSpans;
+	TArray<FChunkSpan> RowSpans;
+	for(int32 y = ChunkMin.Y; y < ChunkMax.Y; y++)
+	{
+		RowSpans.Reset();
+		for(int32 x = ChunkMin.X; x < ChunkMax.X; x++)
+		{
+			// Building - up to the top of its last building run, Air above it is not an obstacle
+			const int32 Height = Columns.GetBuildingHeight(x, y);
+			if(Height == 0 && !Columns.IsStreet(x, y))
+			{
+				continue;
+			}
+
+			if(RowSpans.Num() > 0 && RowSpans.Last().MaxX == x && RowSpans.Last().Height == Height)
+			{
+				RowSpans.Last().MaxX = x + 1;
+			}
+			else
+			{
+				RowSpans.Add({ x, x + 1, Height, INDEX_NONE });
+			}
+		}
+
+		// A span of the same shape as a span of the previous row extends its box along Y
+		for(FChunkSpan& Span : RowSpans)
+		{
+			const FChunkSpan* Prev = PrevSpans.FindByPredicate([&Span](const FChunkSpan& Other) { return Span.IsSameShape(Other); });
+			if(Prev)
+			{
+				Span.BoxIndex = Prev->BoxIndex;
+				Boxes[Span.BoxIndex].Max.Y = GridSpace.CellsToLocation(FVector(0.f, y + 1, 0.f)).Y;
+			}
+			else
+			{
+				// Cells of the span, the same space the tiles of these cells are spawned in
+				FBox Box(GridSpace.CellsToLocation(FVector(Span.MinX, y, 0.f)), GridSpace.CellsToLocation(FVector(Span.MaxX, y + 1, Span.Height)));
+				if(Span.Height == 0)
+				{
+					Box.Min.Z -= WalkableSlabThickness;
+				}
+				Span.BoxIndex = Boxes.Add(Box);
+			}
+		}
+		Swap(PrevSpans, RowSpans);
+	}
+
+	// Triangles of the boxes. Faces are wound the way navigation export expects: clockwise seen from outside
+	NavVertices.Reset(Boxes.Num() * 8);
+	NavIndices.Reset(Boxes.Num() * 36);
+	for(const FBox& Box : Boxes)
+	{
+		const int32 Base = NavVertices.Num();
+		for(int32 Corner = 0; Corner < 8; Corner++)
+		{
+			NavVertices.Add(FVector(
+				Corner & 1 ? Box.Max.X : Box.Min.X,
+				Corner & 2 ? Box.Max.Y : Box.Min.Y,
+				Corner & 4 ? Box.Max.Z : Box.Min.Z));
+		}
+
+		// Corners of each face in order around its outward normal
+		static const int32 Faces[6][4] = {
+			{ 4, 6, 7, 5 }, // Top
+			{ 0, 1, 3, 2 }, // Bottom
+			{ 0, 4, 5, 1 }, // -Y
+			{ 2, 3, 7, 6 }, // +Y
+			{ 0, 2, 6, 4 }, // -X
+			{ 1, 5, 7, 3 }  // +X
+		};
+		for(const int32* Face : Faces)
+		{
+			NavIndices.Append({ Base + Face[0], Base + Face[1], Base + Face[2] });
+			NavIndices.Append({ Base + Face[0], Base + Face[2], Base + Face[3] });
+		}
+	}
+
+	UpdateBodySetup();
+	UpdateBounds();
+	if(IsRegistered())
+	{
+		RecreatePhysicsState();
+		// Dirties navmesh tiles under the old and the new bounds of this chunk only
+		FNavigationSystem::UpdateComponentData(*this);
+	}
+	return true;
+}
+
+void UCityChunkComponent::UpdateBodySetup()
+{
+	if(!ChunkBodySetup)
+	{
+		ChunkBodySetup = NewObject<UBodySetup>(this, NAME_None, RF_Transient);
+		ChunkBodySetup->CollisionTraceFlag = CTF_UseSimpleAsComplex;
+		ChunkBodySetup->bNeverNeedsCookedCollisionData = true;
+	}
+
+	ChunkBodySetup->AggGeom.BoxElems.Reset(Boxes.Num());
+	for(const FBox& Box : Boxes)
+	{
+		const FVector Size = Box.GetSize();
+		FKBoxElem& Elem = ChunkBodySetup->AggGeom.BoxElems.Add_GetRef(FKBoxElem(Size.X, Size.Y, Size.Z));
+		Elem.Center = Box.GetCenter();
+	}
+	ChunkBodySetup->InvalidatePhysicsData();
+}
+
+UBodySetup* UCityChunkComponent::GetBodySetup()
+{
+	return ChunkBodySetup;
+}
+
+bool UCityChunkComponent::DoCustomNavigableGeometryExport(FNavigableGeometryExport& GeomExport) const
+{
+	if(NavIndices.Num() > 0)
+	{
+		GeomExport.ExportCustomMesh(NavVertices.GetData(), NavVertices.Num(), NavIndices.GetData(), NavIndices.Num(), GetComponentTransform());
+	}
+	// Nothing else to export
+	return false;
+}
+
+FBoxSphereBounds UCityChunkComponent::CalcBounds(const FTransform& LocalToWorld) const
+{
+	FBox LocalBox(ForceInit);
+	for(const FBox& Box : Boxes)
+	{
+		LocalBox += Box;
+	}
+	if(!LocalBox.IsValid)
+	{
+		return FBoxSphereBounds(LocalToWorld.GetLocation(), FVector::ZeroVector, 0.f);
+	}
+	return FBoxSphereBounds(LocalBox.TransformBy(LocalToWorld));
+}
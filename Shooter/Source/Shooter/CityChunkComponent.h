@@ -0,0 +1,56 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/PrimitiveComponent.h"
+#include "WorldColumnRuns.h"
+#include "CityGridSpace.h"
+#include "CityChunkComponent.generated.h"
+
+/**
+ * Simplified geometry of a square chunk of the city, made from the grid instead of the tile meshes:
+ * flat slabs over roads and sidewalks (walkable) and solid boxes over buildings (obstacles)
+ * Exported into the navigation octree as custom geometry, so navmesh tiles of a chunk are rebuilt
+ * only when the chunk itself changes
+ * The same boxes are the collision of the chunk: one simple body instead of a mesh body per tile
+ */
+UCLASS()
+class SHOOTER_API UCityChunkComponent : public UPrimitiveComponent
+{
+	GENERATED_BODY()
+
+public:
+	UCityChunkComponent();
+
+	// Rebuilds boxes of cells [ChunkMin; ChunkMax) of Columns. GridSpace is local to the owner of the component
+	// Returns false if the chunk is the same as on the last build (nothing to rebuild)
+	bool Build(const FWorldColumnRuns& Columns, FIntPoint ChunkMin, FIntPoint ChunkMax, const FCityGridSpace& GridSpace);
+
+	virtual bool DoCustomNavigableGeometryExport(FNavigableGeometryExport& GeomExport) const override;
+	virtual FBoxSphereBounds CalcBounds(const FTransform& LocalToWorld) const override;
+	virtual UBodySetup* GetBodySetup() override;
+
+	FORCEINLINE const TArray<FBox>& GetBoxes() const { return Boxes; }
+
+private:
+	// Hash of the types and heights of the chunk columns (variants don't change the geometry)
+	static uint32 GetChunkHash(const FWorldColumnRuns& Columns, FIntPoint ChunkMin, FIntPoint ChunkMax);
+
+	// Merged boxes of the chunk in local space
+	TArray<FBox> Boxes;
+
+	// Triangles of Boxes for the navigation export
+	TArray<FVector> NavVertices;
+	TArray<int32> NavIndices;
+
+	// Box elements of Boxes
+	UPROPERTY(Transient)
+	UBodySetup* ChunkBodySetup;
+
+	// Fills ChunkBodySetup with Boxes
+	void UpdateBodySetup();
+
+	uint32 ChunkHash;
+	bool bBuilt;
+};
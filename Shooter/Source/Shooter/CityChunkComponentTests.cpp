@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+// Automation tests of UCityChunkComponent
+// Run in the editor: Session Frontend > Automation > Shooter.City.Chunks, or "Automation RunTests Shooter.City.Chunks"
+
+
+#include "CityChunkComponent.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	const FVector ChunkTestCellSize(500.f, 500.f, 300.f);
+
+	// 3 x 3 columns: a building of Height in the middle, streets around it
+	void MakeChunkTestColumns(FWorldColumnRuns& Columns, int32 Height)
+	{
+		Columns.Reset(FIntPoint(3, 3));
+		for(int32 y = 0; y < 3; y++)
+		{
+			for(int32 x = 0; x < 3; x++)
+			{
+				const bool bBuilding = x == 1 && y == 1;
+				Columns.Append(x, y, bBuilding ? ETileType::ETT_Building : ETileType::ETT_Road, 0, bBuilding ? Height : 1);
+			}
+		}
+		Columns.Finish();
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCityChunkBoxesMatchTilesTest, "Shooter.City.Chunks.BoxesMatchTiles",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FCityChunkBoxesMatchTilesTest::RunTest(const FString& Parameters)
+{
+	const int32 Height = 3;
+	FWorldColumnRuns Columns;
+	MakeChunkTestColumns(Columns, Height);
+
+	// Not at the origin, so a mix-up of local and world space shows up too
+	const FCityGridSpace GridSpace(FVector(1000.f, -2000.f, 50.f), ChunkTestCellSize);
+	UCityChunkComponent* Chunk = NewObject<UCityChunkComponent>(GetTransientPackage());
+	Chunk->Build(Columns, FIntPoint(0, 0), FIntPoint(3, 3), GridSpace);
+
+	const FBox* BuildingBox = Chunk->GetBoxes().FindByPredicate([&GridSpace](const FBox& Box) { return Box.Max.Z > GridSpace.Origin.Z; });
+	if(!TestNotNull(TEXT("Chunk has a box of the building"), BuildingBox))
+	{
+		return false;
+	}
+
+	// Tile meshes are modelled from their pivot along +X, -Y and +Z
+	const FBox MeshBox(FVector(0.f, -ChunkTestCellSize.Y, 0.f), FVector(ChunkTestCellSize.X, 0.f, ChunkTestCellSize.Z));
+	for(int32 Rotation = 0; Rotation < 4; Rotation++)
+	{
+		FBox TilesBox(ForceInit);
+		for(int32 z = 0; z < Height; z++)
+		{
+			TilesBox += MeshBox.TransformBy(GridSpace.GetTileTransform(1, 1, z, (ETileRotation)Rotation));
+		}
+		TestTrue(FString::Printf(TEXT("Box of the building %s matches its tiles %s turned by %d"),
+			*BuildingBox->ToString(), *TilesBox.ToString(), Rotation), BuildingBox->Min.Equals(TilesBox.Min, 0.1f) && BuildingBox->Max.Equals(TilesBox.Max, 0.1f));
+	}
+
+	// Grid space agrees with itself: the middle of the cell goes back to the cell
+	const FVector Middle = GridSpace.GetCellBox(1, 1, 2).GetCenter();
+	TestEqual(TEXT("Cell of the middle of cell (1, 1, 2)"), GridSpace.GetCell(Middle), FIntVector(1, 1, 2));
+	TestEqual(TEXT("Column of the middle of cell (1, 1, 2)"), GridSpace.GetColumn(Middle.X, Middle.Y), FIntPoint(1, 1));
+
+	// Street slabs and the building together cover the footprint
+	FBox AllBoxes(ForceInit);
+	for(const FBox& Box : Chunk->GetBoxes())
+	{
+		AllBoxes += Box;
+	}
+	const FBox Footprint(GridSpace.CellsToLocation(FVector(0.f, 0.f, 0.f)), GridSpace.CellsToLocation(FVector(3.f, 3.f, 0.f)));
+	TestTrue(TEXT("Boxes cover the footprint along X"), FMath::IsNearlyEqual(AllBoxes.Min.X, Footprint.Min.X) && FMath::IsNearlyEqual(AllBoxes.Max.X, Footprint.Max.X));
+	TestTrue(TEXT("Boxes cover the footprint along Y"), FMath::IsNearlyEqual(AllBoxes.Min.Y, Footprint.Min.Y) && FMath::IsNearlyEqual(AllBoxes.Max.Y, Footprint.Max.Y));
+	return true;
+}
+
+#endif
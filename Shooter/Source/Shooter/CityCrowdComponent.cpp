@@ -0,0 +1,453 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CityCrowdComponent.h"
+#include "GenerationLogs.h"
+#include "Async/ParallelFor.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Kismet/GameplayStatics.h"
+
+// Agents stepped by one task of ParallelFor
+static const int32 AgentsPerBatch = 256;
+// Agents checked for avoidance, so a crowded cell doesn't make the step quadratic
+static const int32 MaxNeighbours = 32;
+// Promoted actors go back to the crowd a bit farther than they were promoted, so they don't flicker on the border
+static const float DemotionRadiusMultiplier = 1.2f;
+// An instance is sent to the render thread again when its agent moved or turned farther than this since it was drawn
+static const float MinDrawnMove = 1.f;
+static const float MinDrawnTurn = 2.f;
+
+// xorshift32 - each agent has its own state, so agents can pick targets on worker threads
+static FORCEINLINE uint32 NextRandom(uint32& State)
+{
+	State ^= State << 13;
+	State ^= State >> 17;
+	State ^= State << 5;
+	return State;
+}
+
+UCityCrowdComponent::UCityCrowdComponent() :
+NumAgents(10000),
+AgentSpeed(140.f),
+AgentRadius(40.f),
+SeparationWeight(1.f),
+PedestrianMesh(nullptr),
+PromotionRadius(1500.f),
+MaxPromotedAgents(32),
+LastStepMs(0.f),
+Instances(nullptr),
+Footprint(FIntPoint::ZeroValue)
+{
+	PrimaryComponentTick.bCanEverTick = true;
+}
+
+void UCityCrowdComponent::Populate(const FWorldColumnRuns& Columns, const FCityGridSpace& InGridSpace, int32 Seed)
+{
+	Clear();
+	if(!PedestrianMesh && !PromotedPedestrianClass)
+	{
+		UE_LOG(LogGeneration, Warning, TEXT("UCityCrowdComponent::Populate - no PedestrianMesh and no PromotedPedestrianClass, the crowd is not spawned"));
+		return;
+	}
+
+	Footprint = Columns.GetFootprint();
+	GridSpace = InGridSpace;
+
+	TArray<FIntPoint> SidewalkCells;
+	WalkableCells.Init(false, Footprint.X * Footprint.Y);
+	for(int32 y = 0; y < Footprint.Y; y++)
+	{
+		for(int32 x = 0; x < Footprint.X; x++)
+		{
+			const TArrayView<const FWorldColumnRun> Column = Columns.GetColumn(x, y);
+			if(Column.Num() > 0
+				&& Column[0].Type >= ETileType::ETT_Sidewalks_Borderline && Column[0].Type <= ETileType::ETT_Sidewalks_Corner
+				&& Columns.GetBuildingHeight(x, y) == 0)
+			{
+				WalkableCells[y * Footprint.X + x] = true;
+				SidewalkCells.Add(FIntPoint(x, y));
+			}
+		}
+	}
+	if(SidewalkCells.Num() == 0)
+	{
+		UE_LOG(LogGeneration, Warning, TEXT("UCityCrowdComponent::Populate - the city has no free sidewalks"));
+		return;
+	}
+
+	PositionsX.SetNumUninitialized(NumAgents);
+	PositionsY.SetNumUninitialized(NumAgents);
+	VelocitiesX.SetNumZeroed(NumAgents);
+	VelocitiesY.SetNumZeroed(NumAgents);
+	TargetsX.SetNumUninitialized(NumAgents);
+	TargetsY.SetNumUninitialized(NumAgents);
+	RandomStates.SetNumUninitialized(NumAgents);
+	Promoted.Init(false, NumAgents);
+	NextPositionsX.SetNumUninitialized(NumAgents);
+	NextPositionsY.SetNumUninitialized(NumAgents);
+
+	FRandomStream SeedStream(Seed);
+	for(int32 Agent = 0; Agent < NumAgents; Agent++)
+	{
+		const FIntPoint Cell = SidewalkCells[SeedStream.RandHelper(SidewalkCells.Num())];
+		const FVector Location = GridSpace.CellsToLocation(FVector(Cell.X + SeedStream.FRand(), Cell.Y + SeedStream.FRand(), 0.f));
+		PositionsX[Agent] = Location.X;
+		PositionsY[Agent] = Location.Y;
+		// xorshift state can't be 0
+		RandomStates[Agent] = SeedStream.GetUnsignedInt() | 1u;
+		PickTarget(Agent, Cell.X, Cell.Y);
+	}
+
+	if(PedestrianMesh)
+	{
+		if(!Instances)
+		{
+			Instances = NewObject<UInstancedStaticMeshComponent>(GetOwner(), TEXT("CrowdInstances"));
+			Instances->SetupAttachment(GetOwner()->GetRootComponent());
+			Instances->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+			Instances->SetCanEverAffectNavigation(false);
+			Instances->RegisterComponent();
+		}
+		Instances->SetStaticMesh(PedestrianMesh);
+
+		DrawnX.SetNumUninitialized(NumAgents);
+		DrawnY.SetNumUninitialized(NumAgents);
+		DrawnYaw.SetNumUninitialized(NumAgents);
+		DrawnHidden.SetNumUninitialized(NumAgents);
+		TArray<FTransform> InstanceTransforms;
+		InstanceTransforms.SetNumUninitialized(NumAgents);
+		for(int32 Agent = 0; Agent < NumAgents; Agent++)
+		{
+			InstanceTransforms[Agent] = MakeDrawnTransform(Agent);
+		}
+		Instances->AddInstances(InstanceTransforms, false);
+	}
+
+	UE_LOG(LogGeneration, Display, TEXT("UCityCrowdComponent::Populate - %d agents on %d sidewalk cells"), NumAgents, SidewalkCells.Num());
+}
+
+void UCityCrowdComponent::Clear()
+{
+	for(AActor* Actor : PromotedActors)
+	{
+		if(IsValid(Actor))
+		{
+			Actor->Destroy();
+		}
+	}
+	PromotedActors.Reset();
+	PromotedAgents.Reset();
+
+	if(Instances)
+	{
+		Instances->ClearInstances();
+	}
+
+	PositionsX.Reset();
+	PositionsY.Reset();
+	VelocitiesX.Reset();
+	VelocitiesY.Reset();
+	TargetsX.Reset();
+	TargetsY.Reset();
+	RandomStates.Reset();
+	Promoted.Reset();
+	NextPositionsX.Reset();
+	NextPositionsY.Reset();
+	DrawnX.Reset();
+	DrawnY.Reset();
+	DrawnYaw.Reset();
+	DrawnHidden.Reset();
+}
+
+void UCityCrowdComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	Clear();
+	Super::EndPlay(EndPlayReason);
+}
+
+void UCityCrowdComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if(GetNumAgents() == 0 || DeltaTime <= 0.f)
+		return;
+
+	const double StartTime = FPlatformTime::Seconds();
+	StepAgents(DeltaTime);
+	LastStepMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	UpdatePromotion();
+
+	if(Instances && Instances->GetInstanceCount() == GetNumAgents())
+	{
+		UpdateInstances();
+	}
+}
+
+bool UCityCrowdComponent::IsWalkable(int32 x, int32 y) const
+{
+	return x >= 0 && y >= 0 && x < Footprint.X && y < Footprint.Y && WalkableCells[y * Footprint.X + x];
+}
+
+void UCityCrowdComponent::PickTarget(int32 Agent, int32 x, int32 y)
+{
+	static const FIntPoint Neighbours[4] = { FIntPoint(0, -1), FIntPoint(1, 0), FIntPoint(0, 1), FIntPoint(-1, 0) };
+
+	FIntPoint Target(x, y);
+	const uint32 FirstDirection = NextRandom(RandomStates[Agent]);
+	for(uint32 Try = 0; Try < 4; Try++)
+	{
+		const FIntPoint Next = FIntPoint(x, y) + Neighbours[(FirstDirection + Try) & 3];
+		if(IsWalkable(Next.X, Next.Y))
+		{
+			Target = Next;
+			break;
+		}
+	}
+
+	// Somewhere in the middle of the cell, so agents don't walk in lines
+	const float JitterX = (NextRandom(RandomStates[Agent]) & 0xFFFF) / 65535.f * 0.6f + 0.2f;
+	const float JitterY = (NextRandom(RandomStates[Agent]) & 0xFFFF) / 65535.f * 0.6f + 0.2f;
+	const FVector TargetLocation = GridSpace.CellsToLocation(FVector(Target.X + JitterX, Target.Y + JitterY, 0.f));
+	TargetsX[Agent] = TargetLocation.X;
+	TargetsY[Agent] = TargetLocation.Y;
+}
+
+void UCityCrowdComponent::BucketAgents()
+{
+	const int32 NumCells = Footprint.X * Footprint.Y;
+	CellStarts.Init(0, NumCells + 1);
+	SortedAgents.SetNumUninitialized(GetNumAgents());
+
+	// Counting sort by cell: count, prefix sum, place
+	for(int32 Agent = 0; Agent < GetNumAgents(); Agent++)
+	{
+		if(!Promoted[Agent])
+		{
+			const FIntPoint Column = GridSpace.GetColumn(PositionsX[Agent], PositionsY[Agent]);
+			const int32 Cell = Column.Y * Footprint.X + Column.X;
+			CellStarts[FMath::Clamp(Cell, 0, NumCells - 1) + 1]++;
+		}
+	}
+	for(int32 Cell = 0; Cell < NumCells; Cell++)
+	{
+		CellStarts[Cell + 1] += CellStarts[Cell];
+	}
+	TArray<int32> CellFill(CellStarts.GetData(), NumCells);
+	for(int32 Agent = 0; Agent < GetNumAgents(); Agent++)
+	{
+		if(!Promoted[Agent])
+		{
+			const FIntPoint Column = GridSpace.GetColumn(PositionsX[Agent], PositionsY[Agent]);
+			const int32 Cell = Column.Y * Footprint.X + Column.X;
+			SortedAgents[CellFill[FMath::Clamp(Cell, 0, NumCells - 1)]++] = Agent;
+		}
+	}
+}
+
+void UCityCrowdComponent::StepAgents(float DeltaTime)
+{
+	BucketAgents();
+
+	const int32 NumBatches = FMath::DivideAndRoundUp(GetNumAgents(), AgentsPerBatch);
+	ParallelFor(NumBatches, [this, DeltaTime](int32 Batch)
+	{
+		const float AvoidanceDistance = AgentRadius * 2.f;
+		const int32 LastAgent = FMath::Min((Batch + 1) * AgentsPerBatch, GetNumAgents());
+		for(int32 Agent = Batch * AgentsPerBatch; Agent < LastAgent; Agent++)
+		{
+			const float X = PositionsX[Agent];
+			const float Y = PositionsY[Agent];
+			NextPositionsX[Agent] = X;
+			NextPositionsY[Agent] = Y;
+			if(Promoted[Agent])
+				continue;
+
+			const FIntPoint Column = GridSpace.GetColumn(X, Y);
+			const int32 CellX = Column.X;
+			const int32 CellY = Column.Y;
+
+			float ToTargetX = TargetsX[Agent] - X;
+			float ToTargetY = TargetsY[Agent] - Y;
+			float Distance = FMath::Sqrt(ToTargetX * ToTargetX + ToTargetY * ToTargetY);
+			if(Distance < AgentRadius)
+			{
+				PickTarget(Agent, CellX, CellY);
+				ToTargetX = TargetsX[Agent] - X;
+				ToTargetY = TargetsY[Agent] - Y;
+				Distance = FMath::Sqrt(ToTargetX * ToTargetX + ToTargetY * ToTargetY);
+			}
+			float VelocityX = Distance > KINDA_SMALL_NUMBER ? ToTargetX / Distance * AgentSpeed : 0.f;
+			float VelocityY = Distance > KINDA_SMALL_NUMBER ? ToTargetY / Distance * AgentSpeed : 0.f;
+
+			// Push away from close agents of this and the neighbour cells
+			float PushX = 0.f;
+			float PushY = 0.f;
+			int32 NumChecked = 0;
+			for(int32 y = CellY - 1; y <= CellY + 1 && NumChecked < MaxNeighbours; y++)
+			{
+				for(int32 x = CellX - 1; x <= CellX + 1 && NumChecked < MaxNeighbours; x++)
+				{
+					if(x < 0 || y < 0 || x >= Footprint.X || y >= Footprint.Y)
+						continue;
+
+					const int32 Cell = y * Footprint.X + x;
+					for(int32 Sorted = CellStarts[Cell]; Sorted < CellStarts[Cell + 1] && NumChecked < MaxNeighbours; Sorted++)
+					{
+						const int32 Other = SortedAgents[Sorted];
+						if(Other == Agent)
+							continue;
+
+						NumChecked++;
+						const float AwayX = X - PositionsX[Other];
+						const float AwayY = Y - PositionsY[Other];
+						const float DistanceSquared = AwayX * AwayX + AwayY * AwayY;
+						if(DistanceSquared < AvoidanceDistance * AvoidanceDistance && DistanceSquared > KINDA_SMALL_NUMBER)
+						{
+							const float OtherDistance = FMath::Sqrt(DistanceSquared);
+							const float Strength = (AvoidanceDistance - OtherDistance) / AvoidanceDistance;
+							PushX += AwayX / OtherDistance * Strength;
+							PushY += AwayY / OtherDistance * Strength;
+						}
+					}
+				}
+			}
+			VelocityX += PushX * AgentSpeed * SeparationWeight;
+			VelocityY += PushY * AgentSpeed * SeparationWeight;
+
+			const float SpeedSquared = VelocityX * VelocityX + VelocityY * VelocityY;
+			if(SpeedSquared > AgentSpeed * AgentSpeed)
+			{
+				const float Scale = AgentSpeed / FMath::Sqrt(SpeedSquared);
+				VelocityX *= Scale;
+				VelocityY *= Scale;
+			}
+
+			// Agents don't leave the sidewalks: a step onto another cell stops the agent, it picks another way
+			const float NextX = X + VelocityX * DeltaTime;
+			const float NextY = Y + VelocityY * DeltaTime;
+			const FIntPoint NextColumn = GridSpace.GetColumn(NextX, NextY);
+			if(IsWalkable(NextColumn.X, NextColumn.Y))
+			{
+				NextPositionsX[Agent] = NextX;
+				NextPositionsY[Agent] = NextY;
+			}
+			else
+			{
+				PickTarget(Agent, CellX, CellY);
+			}
+			VelocitiesX[Agent] = VelocityX;
+			VelocitiesY[Agent] = VelocityY;
+		}
+	});
+
+	Swap(PositionsX, NextPositionsX);
+	Swap(PositionsY, NextPositionsY);
+}
+
+void UCityCrowdComponent::UpdatePromotion()
+{
+	const APawn* Player = UGameplayStatics::GetPlayerPawn(this, 0);
+	if(!Player || !PromotedPedestrianClass)
+		return;
+
+	const FVector Origin = GetOwner()->GetActorLocation();
+	const FVector PlayerLocal = Player->GetActorLocation() - Origin;
+	const float DemotionRadius = PromotionRadius * DemotionRadiusMultiplier;
+
+	// Far actors give their place back to their agents
+	for(int32 i = PromotedActors.Num() - 1; i >= 0; i--)
+	{
+		AActor* Actor = PromotedActors[i];
+		const int32 Agent = PromotedAgents[i];
+		if(IsValid(Actor) && FVector::DistSquared2D(Actor->GetActorLocation() - Origin, PlayerLocal) <= DemotionRadius * DemotionRadius)
+			continue;
+
+		if(IsValid(Actor))
+		{
+			const FVector ActorLocal = Actor->GetActorLocation() - Origin;
+			const FIntPoint ActorColumn = GridSpace.GetColumn(ActorLocal.X, ActorLocal.Y);
+			if(IsWalkable(ActorColumn.X, ActorColumn.Y))
+			{
+				PositionsX[Agent] = ActorLocal.X;
+				PositionsY[Agent] = ActorLocal.Y;
+			}
+			Actor->Destroy();
+		}
+		Promoted[Agent] = false;
+		PromotedActors.RemoveAtSwap(i);
+		PromotedAgents.RemoveAtSwap(i);
+	}
+
+	// Agents of the cells around the player become actors
+	const int32 CellsX = FMath::CeilToInt(PromotionRadius / GridSpace.CellSize.X);
+	const int32 CellsY = FMath::CeilToInt(PromotionRadius / GridSpace.CellSize.Y);
+	const FIntPoint PlayerColumn = GridSpace.GetColumn(PlayerLocal.X, PlayerLocal.Y);
+	const int32 PlayerX = PlayerColumn.X;
+	const int32 PlayerY = PlayerColumn.Y;
+	for(int32 y = FMath::Max(PlayerY - CellsY, 0); y <= FMath::Min(PlayerY + CellsY, Footprint.Y - 1); y++)
+	{
+		for(int32 x = FMath::Max(PlayerX - CellsX, 0); x <= FMath::Min(PlayerX + CellsX, Footprint.X - 1); x++)
+		{
+			const int32 Cell = y * Footprint.X + x;
+			for(int32 Sorted = CellStarts[Cell]; Sorted < CellStarts[Cell + 1]; Sorted++)
+			{
+				if(PromotedActors.Num() >= MaxPromotedAgents)
+					return;
+
+				const int32 Agent = SortedAgents[Sorted];
+				const FVector AgentLocal(PositionsX[Agent], PositionsY[Agent], 0.f);
+				if(Promoted[Agent] || FVector::DistSquared2D(AgentLocal, PlayerLocal) > PromotionRadius * PromotionRadius)
+					continue;
+
+				FActorSpawnParameters SpawnParams;
+				SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+				const FRotator Rotation(0.f, FMath::RadiansToDegrees(FMath::Atan2(VelocitiesY[Agent], VelocitiesX[Agent])), 0.f);
+				AActor* Actor = GetWorld()->SpawnActor<AActor>(PromotedPedestrianClass, Origin + AgentLocal, Rotation, SpawnParams);
+				if(Actor)
+				{
+					Promoted[Agent] = true;
+					PromotedActors.Add(Actor);
+					PromotedAgents.Add(Agent);
+				}
+			}
+		}
+	}
+}
+
+FTransform UCityCrowdComponent::MakeDrawnTransform(int32 Agent)
+{
+	DrawnX[Agent] = PositionsX[Agent];
+	DrawnY[Agent] = PositionsY[Agent];
+	DrawnYaw[Agent] = FMath::RadiansToDegrees(FMath::Atan2(VelocitiesY[Agent], VelocitiesX[Agent]));
+	DrawnHidden[Agent] = Promoted[Agent];
+
+	// Promoted agents are drawn by their actors
+	const FVector Scale = Promoted[Agent] ? FVector::ZeroVector : FVector::OneVector;
+	return FTransform(FRotator(0.f, DrawnYaw[Agent], 0.f), FVector(DrawnX[Agent], DrawnY[Agent], GridSpace.Origin.Z), Scale);
+}
+
+void UCityCrowdComponent::UpdateInstances()
+{
+	// Standing agents and small steps cost nothing: only changed instances are sent, as moves, not teleports,
+	// and the render state is dirtied once for all of them
+	int32 NumUpdated = 0;
+	for(int32 Agent = 0; Agent < GetNumAgents(); Agent++)
+	{
+		if(DrawnHidden[Agent] == Promoted[Agent]
+			&& FMath::Abs(PositionsX[Agent] - DrawnX[Agent]) < MinDrawnMove
+			&& FMath::Abs(PositionsY[Agent] - DrawnY[Agent]) < MinDrawnMove)
+		{
+			const float Yaw = FMath::RadiansToDegrees(FMath::Atan2(VelocitiesY[Agent], VelocitiesX[Agent]));
+			if(FMath::Abs(FRotator::NormalizeAxis(Yaw - DrawnYaw[Agent])) < MinDrawnTurn)
+				continue;
+		}
+
+		Instances->UpdateInstanceTransform(Agent, MakeDrawnTransform(Agent), false, false, false);
+		NumUpdated++;
+	}
+	if(NumUpdated > 0)
+	{
+		Instances->MarkRenderStateDirty();
+	}
+}
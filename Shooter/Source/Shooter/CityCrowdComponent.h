@@ -0,0 +1,128 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "WorldColumnRuns.h"
+#include "CityGridSpace.h"
+#include "CityCrowdComponent.generated.h"
+
+class UInstancedStaticMeshComponent;
+
+/**
+ * Pedestrians walking on the sidewalks of the generated city
+ * Agents are plain arrays (one array per field), stepped in parallel with avoidance of the agents in neighbour cells,
+ * and drawn as instances of one mesh. Agents near the player are promoted to actors of PromotedPedestrianClass
+ */
+UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
+class SHOOTER_API UCityCrowdComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UCityCrowdComponent();
+
+	// Seeds NumAgents agents on sidewalk cells of Columns. GridSpace is local to the owner
+	void Populate(const FWorldColumnRuns& Columns, const FCityGridSpace& InGridSpace, int32 Seed);
+
+	// Removes all agents and promoted actors
+	void Clear();
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	FORCEINLINE int32 GetNumAgents() const { return PositionsX.Num(); }
+
+protected:
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	// Moves all the agents by DeltaTime
+	void StepAgents(float DeltaTime);
+
+	// Sorts agents into buckets of cells for the neighbour search
+	void BucketAgents();
+
+	// Spawns actors for agents near the player and gives far actors back to the crowd
+	void UpdatePromotion();
+
+	// Sends the transforms of the agents which moved since they were drawn last time
+	void UpdateInstances();
+
+	// Transform of the instance of Agent, remembered as drawn
+	FTransform MakeDrawnTransform(int32 Agent);
+
+	bool IsWalkable(int32 x, int32 y) const;
+
+	// Picks a walkable cell next to (x, y) and puts the target of Agent into it
+	void PickTarget(int32 Agent, int32 x, int32 y);
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true", ClampMin=0, ClampMax=100000), Category = Crowd)
+	int32 NumAgents;
+
+	// cm per second
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true", ClampMin=0), Category = Crowd)
+	float AgentSpeed;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true", ClampMin=1), Category = Crowd)
+	float AgentRadius;
+
+	// Strength of pushing apart agents closer than 2 * AgentRadius
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true", ClampMin=0), Category = Crowd)
+	float SeparationWeight;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true"), Category = Crowd)
+	UStaticMesh* PedestrianMesh;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true"), Category = Crowd)
+	TSubclassOf<AActor> PromotedPedestrianClass;
+
+	// Agents closer to the player pawn than this become actors
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true", ClampMin=0), Category = Crowd)
+	float PromotionRadius;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true", ClampMin=0), Category = Crowd)
+	int32 MaxPromotedAgents;
+
+	// Time of the last StepAgents()
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"), Category = Crowd)
+	float LastStepMs;
+
+	UPROPERTY(Transient)
+	UInstancedStaticMeshComponent* Instances;
+
+	// Actors of promoted agents, [i] - agent PromotedAgents[i]
+	UPROPERTY(Transient)
+	TArray<AActor*> PromotedActors;
+	TArray<int32> PromotedAgents;
+
+	// Agents, local space of the owner
+	TArray<float> PositionsX;
+	TArray<float> PositionsY;
+	TArray<float> VelocitiesX;
+	TArray<float> VelocitiesY;
+	TArray<float> TargetsX;
+	TArray<float> TargetsY;
+	TArray<uint32> RandomStates;
+	// True while the agent is an actor: it's not simulated and not drawn
+	TArray<bool> Promoted;
+
+	// Positions of the next step
+	TArray<float> NextPositionsX;
+	TArray<float> NextPositionsY;
+
+	// [y * X + x] - first agent of the cell in SortedAgents, [X * Y] - end
+	TArray<int32> CellStarts;
+	TArray<int32> SortedAgents;
+
+	// [y * X + x] - sidewalk without a building
+	TArray<bool> WalkableCells;
+	FIntPoint Footprint;
+	FCityGridSpace GridSpace;
+
+	// Agents as their instances were drawn last time
+	TArray<float> DrawnX;
+	TArray<float> DrawnY;
+	TArray<float> DrawnYaw;
+	TArray<bool> DrawnHidden;
+};
@@ -0,0 +1,481 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CityFarmCommandlet.h"
+#include "CityFile.h"
+#include "Generator.h"
+#include "GenerationLogs.h"
+#include "GenerationMemory.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+// A farm touches its heartbeat every loop, a farm silent for longer is dead
+static const double FarmHeartbeatTimeoutSeconds = 60.0;
+
+UCityFarmCommandlet::UCityFarmCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+int32 UCityFarmCommandlet::Main(const FString& Params)
+{
+	if(!FParse::Value(*Params, TEXT("Spool="), SpoolDir))
+	{
+		UE_LOG(LogGeneration, Error, TEXT("UCityFarmCommandlet - -Spool=<Dir> is required"));
+		return 1;
+	}
+	SpoolDir = FPaths::ConvertRelativePathToFull(SpoolDir);
+
+	FString SeedRange;
+	if(FParse::Value(*Params, TEXT("Enqueue="), SeedRange))
+	{
+		FString ParamSet = TEXT("Default");
+		FParse::Value(*Params, TEXT("ParamSet="), ParamSet);
+		return Enqueue(SeedRange, ParamSet);
+	}
+
+	if(!FParse::Value(*Params, TEXT("Generator="), GeneratorClassPath))
+	{
+		UE_LOG(LogGeneration, Error, TEXT("UCityFarmCommandlet - -Generator=<Class path> is required, for example /Game/Blueprints/BP_Generator.BP_Generator_C"));
+		return 1;
+	}
+
+	if(FParse::Param(*Params, TEXT("Worker")))
+	{
+		int32 WorkerId = 0;
+		FParse::Value(*Params, TEXT("WorkerId="), WorkerId);
+		if(!FParse::Value(*Params, TEXT("FarmId="), FarmId))
+		{
+			UE_LOG(LogGeneration, Error, TEXT("UCityFarmCommandlet - -FarmId=<Id> is required for a worker"));
+			return 1;
+		}
+		return RunWorker(WorkerId);
+	}
+
+	FarmId = FGuid::NewGuid().ToString(EGuidFormats::Digits);
+
+	int32 NumWorkers = FPlatformMisc::NumberOfCores();
+	int32 MaxRetries = 2;
+	FParse::Value(*Params, TEXT("Workers="), NumWorkers);
+	FParse::Value(*Params, TEXT("MaxRetries="), MaxRetries);
+	return RunFarm(FMath::Max(NumWorkers, 1), FMath::Max(MaxRetries, 0));
+}
+
+int32 UCityFarmCommandlet::Enqueue(const FString& SeedRange, const FString& ParamSet)
+{
+	FString FirstString;
+	FString LastString;
+	if(!SeedRange.Split(TEXT("-"), &FirstString, &LastString))
+	{
+		FirstString = LastString = SeedRange;
+	}
+	const int32 FirstSeed = FCString::Atoi(*FirstString);
+	const int32 LastSeed = FCString::Atoi(*LastString);
+
+	IFileManager::Get().MakeDirectory(*GetJobsDir(TEXT("Pending")), true);
+	for(int32 Seed = FirstSeed; Seed <= LastSeed; Seed++)
+	{
+		const FString JobName = FString::Printf(TEXT("%s_Seed%d"), *ParamSet, Seed);
+		const FString Job = FString::Printf(TEXT("Seed=%d\nParamSet=%s\n"), Seed, *ParamSet);
+		FFileHelper::SaveStringToFile(Job, *FPaths::Combine(GetJobsDir(TEXT("Pending")), JobName + TEXT(".job")));
+	}
+
+	UE_LOG(LogGeneration, Display, TEXT("UCityFarmCommandlet - %d jobs of %s enqueued"), FMath::Max(LastSeed - FirstSeed + 1, 0), *ParamSet);
+	return 0;
+}
+
+int32 UCityFarmCommandlet::RunFarm(int32 NumWorkers, int32 MaxRetries)
+{
+	IFileManager& FileManager = IFileManager::Get();
+	for(const TCHAR* State : { TEXT("Pending"), TEXT("Running"), TEXT("Done"), TEXT("Failed") })
+	{
+		FileManager.MakeDirectory(*GetJobsDir(State), true);
+	}
+	FileManager.MakeDirectory(*GetCitiesDir(), true);
+	FileManager.MakeDirectory(*FPaths::Combine(SpoolDir, TEXT("Logs")), true);
+	FileManager.MakeDirectory(*FPaths::Combine(SpoolDir, TEXT("Farms")), true);
+
+	// Other farms may be working on the same spool - only jobs of dead ones are taken back
+	const FString HeartbeatPath = GetHeartbeatPath(FarmId);
+	FFileHelper::SaveStringToFile(FString::Printf(TEXT("%u"), FPlatformProcess::GetCurrentProcessId()), *HeartbeatPath);
+	RecoverOrphanedJobs(MaxRetries);
+
+	auto HasPendingJobs = [this, &FileManager]()
+	{
+		TArray<FString> Files;
+		FileManager.FindFiles(Files, *FPaths::Combine(GetJobsDir(TEXT("Pending")), TEXT("*.job")), true, false);
+		return Files.Num() > 0;
+	};
+
+	TArray<FProcHandle> Workers;
+	Workers.SetNum(NumWorkers);
+	for(int32 WorkerId = 0; WorkerId < NumWorkers; WorkerId++)
+	{
+		Workers[WorkerId] = LaunchWorker(WorkerId);
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	bool bAnyRunning = true;
+	while(bAnyRunning)
+	{
+		FPlatformProcess::Sleep(0.5f);
+		FileManager.SetTimeStamp(*HeartbeatPath, FDateTime::UtcNow());
+
+		bAnyRunning = false;
+		for(int32 WorkerId = 0; WorkerId < NumWorkers; WorkerId++)
+		{
+			FProcHandle& Worker = Workers[WorkerId];
+			if(!Worker.IsValid())
+				continue;
+
+			if(FPlatformProcess::IsProcRunning(Worker))
+			{
+				bAnyRunning = true;
+				continue;
+			}
+
+			int32 ReturnCode = 0;
+			FPlatformProcess::GetProcReturnCode(Worker, &ReturnCode);
+			FPlatformProcess::CloseProc(Worker);
+			Worker = FProcHandle();
+
+			// A job still in Running is the one the worker died on
+			if(ReturnCode != 0)
+			{
+				UE_LOG(LogGeneration, Warning, TEXT("UCityFarmCommandlet - worker %d exited with code %d"), WorkerId, ReturnCode);
+			}
+			RecoverJobs(WorkerId, MaxRetries);
+
+			// Recovered jobs need a worker again
+			if(HasPendingJobs())
+			{
+				Worker = LaunchWorker(WorkerId);
+				bAnyRunning |= Worker.IsValid();
+			}
+		}
+	}
+
+	FileManager.Delete(*HeartbeatPath);
+	WriteManifest();
+	UE_LOG(LogGeneration, Display, TEXT("UCityFarmCommandlet - farm finished in %.1f s"), FPlatformTime::Seconds() - StartTime);
+	return 0;
+}
+
+int32 UCityFarmCommandlet::RunWorker(int32 WorkerId)
+{
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("CityFarmWorld"));
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+
+	int32 NumJobs = 0;
+	int32 NumFailed = 0;
+	FString JobName;
+	FString RunningPath;
+	while(ClaimJob(WorkerId, JobName, RunningPath))
+	{
+		FString Entry;
+		const bool bSuccess = RunJob(World, JobName, RunningPath, Entry);
+		FFileHelper::SaveStringToFile(Entry, *FPaths::Combine(GetCitiesDir(), JobName + TEXT(".entry")));
+
+		// Moved out of Running only after the result is written - a crash before it gives the job back to the queue
+		IFileManager::Get().Move(*FPaths::Combine(GetJobsDir(bSuccess ? TEXT("Done") : TEXT("Failed")), JobName + TEXT(".job")), *RunningPath);
+
+		NumJobs++;
+		NumFailed += bSuccess ? 0 : 1;
+		CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+	}
+
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+
+	UE_LOG(LogGeneration, Display, TEXT("UCityFarmCommandlet - worker %d finished %d jobs, %d failed"), WorkerId, NumJobs, NumFailed);
+	return 0;
+}
+
+FProcHandle UCityFarmCommandlet::LaunchWorker(int32 WorkerId) const
+{
+	const FString LogPath = FPaths::Combine(SpoolDir, TEXT("Logs"), FString::Printf(TEXT("Worker%d.log"), WorkerId));
+	const FString Args = FString::Printf(TEXT("\"%s\" -run=CityFarm -Worker -FarmId=%s -WorkerId=%d -Spool=\"%s\" -Generator=\"%s\" -abslog=\"%s\" -nullrhi -unattended -nopause -nosplash"),
+		*FPaths::ConvertRelativePathToFull(FPaths::GetProjectFilePath()), *FarmId, WorkerId, *SpoolDir, *GeneratorClassPath, *LogPath);
+
+	FProcHandle Handle = FPlatformProcess::CreateProc(FPlatformProcess::ExecutablePath(), *Args, false, true, true,
+		nullptr, 0, nullptr, nullptr);
+	if(!Handle.IsValid())
+	{
+		UE_LOG(LogGeneration, Error, TEXT("UCityFarmCommandlet - can't start worker %d"), WorkerId);
+	}
+	return Handle;
+}
+
+bool UCityFarmCommandlet::ClaimJob(int32 WorkerId, FString& OutJobName, FString& OutRunningPath) const
+{
+	TArray<FString> Files;
+	IFileManager::Get().FindFiles(Files, *FPaths::Combine(GetJobsDir(TEXT("Pending")), TEXT("*.job")), true, false);
+	Files.Sort();
+
+	for(const FString& File : Files)
+	{
+		const FString JobName = FPaths::GetBaseFilename(File);
+		const FString RunningPath = FPaths::Combine(GetJobsDir(TEXT("Running")), JobName + GetWorkerSuffix(WorkerId) + TEXT(".job"));
+
+		// Rename is atomic: if another worker has taken the job first, the move fails
+		if(IFileManager::Get().Move(*RunningPath, *FPaths::Combine(GetJobsDir(TEXT("Pending")), File), false, false, false, true))
+		{
+			OutJobName = JobName;
+			OutRunningPath = RunningPath;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool UCityFarmCommandlet::RunJob(UWorld* World, const FString& JobName, const FString& JobPath, FString& OutEntry) const
+{
+	TArray<FString> JobLines;
+	FFileHelper::LoadFileToStringArray(JobLines, *JobPath);
+
+	// Lines of the param set first - lines of the job override them
+	FString ParamSet;
+	for(const FString& Line : JobLines)
+	{
+		FString Key;
+		FString Value;
+		if(Line.Split(TEXT("="), &Key, &Value) && Key.TrimStartAndEnd() == TEXT("ParamSet"))
+		{
+			ParamSet = Value.TrimStartAndEnd();
+		}
+	}
+	TArray<FString> Lines;
+	if(!ParamSet.IsEmpty())
+	{
+		FFileHelper::LoadFileToStringArray(Lines, *FPaths::Combine(SpoolDir, TEXT("ParamSets"), ParamSet + TEXT(".params")));
+	}
+	Lines.Append(JobLines);
+
+	// The generator and the registry of the previous job are destroyed
+	GenerationMemory::Reset();
+	UClass* GeneratorClass = LoadClass<AGenerator>(nullptr, *GeneratorClassPath);
+	AGenerator* Generator = GeneratorClass ? World->SpawnActor<AGenerator>(GeneratorClass, FTransform::Identity) : nullptr;
+	if(!Generator)
+	{
+		UE_LOG(LogGeneration, Error, TEXT("UCityFarmCommandlet - can't spawn generator %s"), *GeneratorClassPath);
+		OutEntry = FString::Printf(TEXT("%s,0,%s,NoGenerator,0,0,0,%s"), *JobName, *ParamSet, *GenerationMemory::GetEmptyCSVValues());
+		return false;
+	}
+
+	Generator->bSpawnScene = false;
+	ApplyParams(Generator, Lines);
+	Generator->WFCGenerator->InitTileRegistry();
+	ATileRegistry* Registry = Generator->WFCGenerator->GetTileRegistryActor();
+
+	const double StartTime = FPlatformTime::Seconds();
+	const bool bGenerated = Registry && Generator->Generate();
+	const double GenerationMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	// Validated by Generate() in development builds
+	int32 NumViolations = 0;
+	if(bGenerated)
+	{
+		NumViolations = Generator->WFCGenerator->GetLastNumViolations();
+		if(NumViolations == INDEX_NONE)
+		{
+			NumViolations = Generator->WFCGenerator->ValidateResult(Generator->GetWorldArray());
+		}
+	}
+
+	bool bSaved = false;
+	int64 FileSize = 0;
+	if(bGenerated)
+	{
+		const FString CityPath = FPaths::Combine(GetCitiesDir(), JobName + TEXT(".city"));
+		bSaved = CityFile::Save(CityPath, *Generator->GetWorldArray(), Generator->GetCurrentSeed(),
+			Registry->GetCompiledRules().VariantNames);
+		FileSize = IFileManager::Get().FileSize(*CityPath);
+	}
+
+	const TCHAR* Status = !bGenerated ? TEXT("GenerationFailed")
+		: !bSaved ? TEXT("SaveFailed")
+		: NumViolations > 0 ? TEXT("Invalid")
+		: TEXT("Ok");
+	// Peak and retained bytes of each stage, see GenerationMemory
+	OutEntry = FString::Printf(TEXT("%s,%d,%s,%s,%lld,%.1f,%d,%s"), *JobName, Generator->GetCurrentSeed(), *ParamSet,
+		Status, FileSize, GenerationMs, NumViolations, *GenerationMemory::GetCSVValues());
+
+	if(Registry)
+	{
+		Registry->Destroy();
+	}
+	Generator->Destroy();
+	return bSaved && NumViolations == 0;
+}
+
+void UCityFarmCommandlet::ApplyParams(AGenerator* Generator, const TArray<FString>& Lines) const
+{
+	for(const FString& Line : Lines)
+	{
+		FString Key;
+		FString Value;
+		if(!Line.Split(TEXT("="), &Key, &Value))
+			continue;
+
+		Key.TrimStartAndEndInline();
+		Value.TrimStartAndEndInline();
+		if(Key == TEXT("ParamSet") || Key == TEXT("Retry"))
+			continue;
+		if(Key == TEXT("Seed"))
+		{
+			Key = GET_MEMBER_NAME_STRING_CHECKED(AGenerator, GenerationSeed);
+		}
+
+		UObject* Target = Generator;
+		if(Key.RemoveFromStart(TEXT("WFC.")))
+		{
+			Target = Generator->WFCGenerator;
+		}
+
+		FProperty* Property = FindFProperty<FProperty>(Target->GetClass(), *Key);
+		if(!Property || !Property->ImportText(*Value, Property->ContainerPtrToValuePtr<void>(Target), PPF_None, Target))
+		{
+			UE_LOG(LogGeneration, Warning, TEXT("UCityFarmCommandlet - can't apply %s to %s"), *Line, *Target->GetClass()->GetName());
+		}
+	}
+}
+
+void UCityFarmCommandlet::RecoverJobs(int32 WorkerId, int32 MaxRetries) const
+{
+	TArray<FString> Files;
+	IFileManager::Get().FindFiles(Files, *FPaths::Combine(GetJobsDir(TEXT("Running")), TEXT("*") + GetWorkerSuffix(WorkerId) + TEXT(".job")), true, false);
+	for(const FString& File : Files)
+	{
+		RecoverJob(File, MaxRetries);
+	}
+}
+
+void UCityFarmCommandlet::RecoverOrphanedJobs(int32 MaxRetries) const
+{
+	TArray<FString> Files;
+	IFileManager::Get().FindFiles(Files, *FPaths::Combine(GetJobsDir(TEXT("Running")), TEXT("*.job")), true, false);
+
+	TMap<FString, bool> FarmsAlive;
+	for(const FString& File : Files)
+	{
+		// <Job>.w<Farm>-<Worker>.job
+		FString Owner = FPaths::GetExtension(FPaths::GetBaseFilename(File));
+		FString OwnerFarmId;
+		if(!Owner.RemoveFromStart(TEXT("w")) || !Owner.Split(TEXT("-"), &OwnerFarmId, nullptr))
+		{
+			UE_LOG(LogGeneration, Warning, TEXT("UCityFarmCommandlet - running job %s has no owner, it is recovered"), *File);
+			RecoverJob(File, MaxRetries);
+			continue;
+		}
+
+		bool* bAlive = FarmsAlive.Find(OwnerFarmId);
+		if(!bAlive)
+		{
+			bAlive = &FarmsAlive.Add(OwnerFarmId, IsFarmAlive(OwnerFarmId));
+		}
+		if(*bAlive)
+			continue;
+
+		RecoverJob(File, MaxRetries);
+	}
+
+	// Heartbeats of dead farms have no jobs left
+	for(const TPair<FString, bool>& Farm : FarmsAlive)
+	{
+		if(!Farm.Value)
+		{
+			IFileManager::Get().Delete(*GetHeartbeatPath(Farm.Key), false, false, true);
+		}
+	}
+}
+
+bool UCityFarmCommandlet::IsFarmAlive(const FString& InFarmId) const
+{
+	// MinValue if there is no heartbeat
+	const FDateTime Heartbeat = IFileManager::Get().GetTimeStamp(*GetHeartbeatPath(InFarmId));
+	return (FDateTime::UtcNow() - Heartbeat).GetTotalSeconds() < FarmHeartbeatTimeoutSeconds;
+}
+
+void UCityFarmCommandlet::RecoverJob(const FString& File, int32 MaxRetries) const
+{
+	IFileManager& FileManager = IFileManager::Get();
+	const FString RunningPath = FPaths::Combine(GetJobsDir(TEXT("Running")), File);
+	// <Job>.w<Farm>-<Worker>.job
+	const FString JobName = FPaths::GetBaseFilename(FPaths::GetBaseFilename(File));
+
+	TArray<FString> Lines;
+	FFileHelper::LoadFileToStringArray(Lines, *RunningPath);
+	int32 Retry = 0;
+	for(const FString& Line : Lines)
+	{
+		FString Value;
+		if(FParse::Value(*Line, TEXT("Retry="), Value))
+		{
+			Retry = FCString::Atoi(*Value);
+		}
+	}
+	Lines.RemoveAll([](const FString& Line) { return Line.StartsWith(TEXT("Retry=")); });
+	Lines.Add(FString::Printf(TEXT("Retry=%d"), Retry + 1));
+
+	const bool bGiveUp = Retry + 1 > MaxRetries;
+	const FString DestPath = FPaths::Combine(GetJobsDir(bGiveUp ? TEXT("Failed") : TEXT("Pending")), JobName + TEXT(".job"));
+	FFileHelper::SaveStringArrayToFile(Lines, *DestPath);
+	FileManager.Delete(*RunningPath);
+
+	if(bGiveUp)
+	{
+		FFileHelper::SaveStringToFile(FString::Printf(TEXT("%s,0,,Crashed,0,0,0,%s"), *JobName, *GenerationMemory::GetEmptyCSVValues()),
+			*FPaths::Combine(GetCitiesDir(), JobName + TEXT(".entry")));
+	}
+	UE_LOG(LogGeneration, Warning, TEXT("UCityFarmCommandlet - job %s recovered from a crashed worker, %s"),
+		*JobName, bGiveUp ? TEXT("failed") : TEXT("queued again"));
+}
+
+void UCityFarmCommandlet::WriteManifest() const
+{
+	TArray<FString> Files;
+	IFileManager::Get().FindFiles(Files, *FPaths::Combine(GetCitiesDir(), TEXT("*.entry")), true, false);
+	Files.Sort();
+
+	TArray<FString> Lines;
+	Lines.Add(TEXT("Job,Seed,ParamSet,Status,Bytes,Ms,Violations,") + GenerationMemory::GetCSVHeader());
+	for(const FString& File : Files)
+	{
+		FString Entry;
+		if(FFileHelper::LoadFileToString(Entry, *FPaths::Combine(GetCitiesDir(), File)))
+		{
+			Lines.Add(Entry.TrimStartAndEnd());
+		}
+	}
+
+	FFileHelper::SaveStringArrayToFile(Lines, *FPaths::Combine(SpoolDir, TEXT("manifest.csv")));
+	UE_LOG(LogGeneration, Display, TEXT("UCityFarmCommandlet - manifest of %d cities written"), Lines.Num() - 1);
+}
+
+FString UCityFarmCommandlet::GetWorkerSuffix(int32 WorkerId) const
+{
+	return FString::Printf(TEXT(".w%s-%d"), *FarmId, WorkerId);
+}
+
+FString UCityFarmCommandlet::GetHeartbeatPath(const FString& InFarmId) const
+{
+	return FPaths::Combine(SpoolDir, TEXT("Farms"), InFarmId + TEXT(".heartbeat"));
+}
+
+FString UCityFarmCommandlet::GetJobsDir(const TCHAR* State) const
+{
+	return FPaths::Combine(SpoolDir, TEXT("Jobs"), State);
+}
+
+FString UCityFarmCommandlet::GetCitiesDir() const
+{
+	return FPaths::Combine(SpoolDir, TEXT("Cities"));
+}
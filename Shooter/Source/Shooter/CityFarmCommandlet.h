@@ -0,0 +1,83 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "CityFarmCommandlet.generated.h"
+
+class AGenerator;
+
+/**
+ * Headless generation of many cities by several processes with a job queue in a spool directory
+ *
+ * Spool directory:
+ * - ParamSets/<Name>.params - "Property=Value" lines applied to the generator. "WFC.Property" - to its WFC component
+ * - Jobs/Pending/<Job>.job  - "Seed=N", "ParamSet=Name" and more "Property=Value" lines of this job only
+ * - Jobs/Running/<Job>.w<Farm>-<Worker>.job - taken by a worker of a farm: moving the file is the lock
+ * - Farms/<Farm>.heartbeat  - touched by a running farm. Running jobs of a farm without a fresh heartbeat are orphaned
+ * - Jobs/Done, Jobs/Failed  - finished jobs
+ * - Cities/<Job>.city and Cities/<Job>.entry - result of the job and its line of the manifest
+ * - manifest.csv - all the entries, written when the queue is empty. Memory columns - peak and retained bytes of GenerationMemory tags
+ *
+ * Usage:
+ * -run=CityFarm -Spool=<Dir> -Enqueue=<FirstSeed>-<LastSeed> [-ParamSet=<Name>]   - adds jobs
+ * -run=CityFarm -Spool=<Dir> -Generator=<Class path> [-Workers=N] [-MaxRetries=N] - runs N worker processes until the queue is empty
+ * -run=CityFarm -Spool=<Dir> -Generator=<Class path> -Worker -FarmId=F -WorkerId=K - one worker, started by the farm
+ * A worker which crashes gives its jobs back to the queue and is started again.
+ * Several farms may share a spool: a farm takes back only the jobs of its own workers and, when it starts, the jobs of dead farms
+ */
+UCLASS()
+class SHOOTER_API UCityFarmCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UCityFarmCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	int32 Enqueue(const FString& SeedRange, const FString& ParamSet);
+
+	int32 RunFarm(int32 NumWorkers, int32 MaxRetries);
+
+	int32 RunWorker(int32 WorkerId);
+
+	// Starts a worker process with the same project and spool
+	FProcHandle LaunchWorker(int32 WorkerId) const;
+
+	// Takes the first pending job. Returns false if the queue is empty
+	bool ClaimJob(int32 WorkerId, FString& OutJobName, FString& OutRunningPath) const;
+
+	// Generates the city of the job and saves it into Cities/. Returns false if generation failed
+	bool RunJob(UWorld* World, const FString& JobName, const FString& JobPath, FString& OutEntry) const;
+
+	// Applies "Property=Value" lines to the generator and its WFC component
+	void ApplyParams(AGenerator* Generator, const TArray<FString>& Lines) const;
+
+	// Moves jobs of a worker of this farm from Running back to Pending, or to Failed after MaxRetries
+	void RecoverJobs(int32 WorkerId, int32 MaxRetries) const;
+
+	// Recovers running jobs of farms which have no fresh heartbeat, e.g. killed with their workers
+	void RecoverOrphanedJobs(int32 MaxRetries) const;
+
+	// Moves one file of Running back to Pending, or to Failed after MaxRetries
+	void RecoverJob(const FString& File, int32 MaxRetries) const;
+
+	bool IsFarmAlive(const FString& InFarmId) const;
+
+	// ".w<Farm>-<Worker>" - owner of a job in Running
+	FString GetWorkerSuffix(int32 WorkerId) const;
+	FString GetHeartbeatPath(const FString& InFarmId) const;
+
+	void WriteManifest() const;
+
+	FString GetJobsDir(const TCHAR* State) const;
+	FString GetCitiesDir() const;
+
+	FString SpoolDir;
+	FString GeneratorClassPath;
+	// Unique per farm process, workers get the one of their farm
+	FString FarmId;
+};
@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CityFile.h"
+#include "GenerationLogs.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/BufferArchive.h"
+#include "Serialization/MemoryReader.h"
+
+// 'CITY'
+static const uint32 CityFileMagic = 0x59544943;
+static const uint32 CityFileVersion = 1;
+
+namespace CityFile
+{
+	// Planes of one-byte enums are written as they are
+	template<typename EnumType>
+	static void SerializePlane(FArchive& Ar, TArray<EnumType>& Plane)
+	{
+		static_assert(sizeof(EnumType) == 1, "Planes are serialized as bytes");
+		int32 Num = Plane.Num();
+		Ar << Num;
+		if(Ar.IsLoading())
+		{
+			Plane.SetNumUninitialized(FMath::Max(Num, 0));
+		}
+		Ar.Serialize(Plane.GetData(), Plane.Num());
+	}
+
+	bool Save(const FString& Path, UWorldItem3DArray& Array, int32 Seed, const TArray<FString>& VariantNames)
+	{
+		FBufferArchive Ar;
+		uint32 Magic = CityFileMagic;
+		uint32 Version = CityFileVersion;
+		TArray<FString> Names = VariantNames;
+		Ar << Magic << Version << Seed << Array.Bounds << Names;
+		SerializePlane(Ar, Array.TileTypes);
+		SerializePlane(Ar, Array.ColorTags);
+		Ar << Array.Columns;
+
+		return FFileHelper::SaveArrayToFile(Ar, *Path);
+	}
+
+	bool Load(const FString& Path, UWorldItem3DArray& OutArray, int32& OutSeed, TArray<FString>& OutVariantNames)
+	{
+		TArray<uint8> Data;
+		if(!FFileHelper::LoadFileToArray(Data, *Path))
+		{
+			UE_LOG(LogGeneration, Error, TEXT("CityFile::Load - can't read %s"), *Path);
+			return false;
+		}
+
+		FMemoryReader Ar(Data);
+		uint32 Magic = 0;
+		uint32 Version = 0;
+		Ar << Magic << Version;
+		if(Magic != CityFileMagic || Version != CityFileVersion)
+		{
+			UE_LOG(LogGeneration, Error, TEXT("CityFile::Load - %s is not a city of version %d"), *Path, CityFileVersion);
+			return false;
+		}
+
+		Ar << OutSeed << OutArray.Bounds << OutVariantNames;
+		SerializePlane(Ar, OutArray.TileTypes);
+		SerializePlane(Ar, OutArray.ColorTags);
+		Ar << OutArray.Columns;
+		OutArray.NumFilledSlabs = OutArray.Bounds.Z;
+
+		if(Ar.IsError() || OutArray.TileTypes.Num() != OutArray.Bounds.X * OutArray.Bounds.Y * OutArray.Bounds.Z)
+		{
+			UE_LOG(LogGeneration, Error, TEXT("CityFile::Load - %s is damaged"), *Path);
+			return false;
+		}
+		return true;
+	}
+}
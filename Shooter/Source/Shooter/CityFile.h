@@ -0,0 +1,18 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "WorldItem3DArray.h"
+
+/**
+ * Binary file of a generated city (.city): seed, typed planes, colours and column runs of UWorldItem3DArray
+ * with names of the variants, so the city can be read back without the tile registry
+ */
+namespace CityFile
+{
+	SHOOTER_API bool Save(const FString& Path, UWorldItem3DArray& Array, int32 Seed, const TArray<FString>& VariantNames);
+
+	// Fills Bounds, TileTypes, ColorTags and Columns of OutArray
+	SHOOTER_API bool Load(const FString& Path, UWorldItem3DArray& OutArray, int32& OutSeed, TArray<FString>& OutVariantNames);
+}
@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+// Automation tests of CityFile
+// Run in the editor: Session Frontend > Automation > Shooter.City.File, or "Automation RunTests Shooter.City.File"
+
+
+#include "CityFile.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCityFileRoundTripTest, "Shooter.City.File.RoundTrip",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FCityFileRoundTripTest::RunTest(const FString& Parameters)
+{
+	UWorldItem3DArray* Array = NewObject<UWorldItem3DArray>(GetTransientPackage());
+	Array->Init(2, 3, 4);
+	for(int32 Cell = 0; Cell < Array->TileTypes.Num(); Cell++)
+	{
+		Array->TileTypes[Cell] = (ETileType)(Cell % (int32)ETileType::ETT_MAX);
+		Array->ColorTags[Cell] = (ETileColorTag)(Cell % (int32)ETileColorTag::ETCT_MAX);
+	}
+	Array->Columns.Reset(FIntPoint(4, 3));
+	Array->Columns.Append(1, 1, ETileType::ETT_Sidewalks_Inner, 0, 1);
+	Array->Columns.Append(1, 1, ETileType::ETT_Building_Window_Section, 1, 12);
+	Array->Columns.Append(3, 2, ETileType::ETT_Road, 2, 1);
+	Array->Columns.Finish();
+
+	const int32 Seed = 4242;
+	const TArray<FString> VariantNames = { TEXT("Sidewalk:ETR_Forward"), TEXT("Window:ETR_Left"), TEXT("Road:ETR_Right") };
+	const FString Path = FPaths::Combine(FPaths::AutomationTransientDir(), TEXT("RoundTrip.city"));
+	if(!TestTrue(TEXT("City is saved"), CityFile::Save(Path, *Array, Seed, VariantNames)))
+	{
+		return false;
+	}
+
+	UWorldItem3DArray* Loaded = NewObject<UWorldItem3DArray>(GetTransientPackage());
+	int32 LoadedSeed = 0;
+	TArray<FString> LoadedNames;
+	if(TestTrue(TEXT("City is loaded"), CityFile::Load(Path, *Loaded, LoadedSeed, LoadedNames)))
+	{
+		TestEqual(TEXT("Seed"), LoadedSeed, Seed);
+		TestTrue(TEXT("Names of variants"), LoadedNames == VariantNames);
+		TestEqual(TEXT("Bounds"), Loaded->Bounds, Array->Bounds);
+		TestTrue(TEXT("Tile types"), Loaded->TileTypes == Array->TileTypes);
+		TestTrue(TEXT("Colours"), Loaded->ColorTags == Array->ColorTags);
+		TestEqual(TEXT("Filled slabs"), Loaded->NumFilledSlabs, Array->Bounds.Z);
+		TestEqual(TEXT("Runs"), Loaded->Columns.GetNumRuns(), Array->Columns.GetNumRuns());
+		TestEqual(TEXT("Height of the building"), Loaded->Columns.GetBuildingHeight(1, 1), 13);
+		TestEqual(TEXT("Variant of the top of the building"), Loaded->Columns.GetVariant(12, 1, 1), 1);
+		TestTrue(TEXT("Road is a street"), Loaded->Columns.IsStreet(3, 2));
+	}
+
+	// Another file with the extension of a city is refused
+	const FString DamagedPath = FPaths::Combine(FPaths::AutomationTransientDir(), TEXT("Damaged.city"));
+	FFileHelper::SaveStringToFile(TEXT("Not a city"), *DamagedPath);
+	AddExpectedError(TEXT("is not a city"), EAutomationExpectedErrorFlags::Contains, 1);
+	TestFalse(TEXT("Other file is loaded"), CityFile::Load(DamagedPath, *Loaded, LoadedSeed, LoadedNames));
+
+	IFileManager::Get().Delete(*Path);
+	IFileManager::Get().Delete(*DamagedPath);
+	return true;
+}
+
+#endif
@@ -0,0 +1,183 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CityGridRaycast.h"
+#include "Async/ParallelFor.h"
+
+static const int32 NoSolidHeight = MIN_int32;
+// Smaller batches are cheaper on the calling thread than the tasks
+static const int32 MinParallelRays = 64;
+
+FCityGridRaycast::FCityGridRaycast() :
+Footprint(FIntPoint::ZeroValue)
+{
+}
+
+void FCityGridRaycast::Reset()
+{
+	Footprint = FIntPoint::ZeroValue;
+	SolidHeights.Reset();
+}
+
+void FCityGridRaycast::Build(const FWorldColumnRuns& Columns, const FCityGridSpace& InGridSpace)
+{
+	Reset();
+	Footprint = Columns.GetFootprint();
+	GridSpace = InGridSpace;
+	SolidHeights.SetNumUninitialized(Footprint.X * Footprint.Y);
+
+	ParallelFor(Footprint.Y, [this, &Columns](int32 y)
+	{
+		for(int32 x = 0; x < Footprint.X; x++)
+		{
+			// Same columns as the collision of UCityChunkComponent
+			const int32 Height = Columns.GetBuildingHeight(x, y);
+			SolidHeights[y * Footprint.X + x] = Height > 0 ? Height : Columns.IsStreet(x, y) ? 0 : NoSolidHeight;
+		}
+	});
+}
+
+bool FCityGridRaycast::Raycast(const FVector& Start, const FVector& End, FCityRayHit& OutHit) const
+{
+	OutHit = FCityRayHit();
+	if(!IsBuilt())
+		return false;
+
+	// The segment in cells, T goes from 0 at Start to 1 at End
+	const FVector P0 = GridSpace.LocationToCells(Start);
+	const FVector Delta = GridSpace.LocationToCells(End) - P0;
+
+	// Nothing is solid around the city, so the walk starts and ends on the border of the footprint
+	float StartT = 0.f;
+	float EndT = 1.f;
+	int32 EnterAxis = INDEX_NONE;
+	for(int32 Axis = 0; Axis < 2; Axis++)
+	{
+		const float Size = Axis == 0 ? Footprint.X : Footprint.Y;
+		if(Delta[Axis] == 0.f)
+		{
+			if(P0[Axis] < 0.f || P0[Axis] >= Size)
+				return false;
+			continue;
+		}
+
+		const float NearT = ((Delta[Axis] > 0.f ? 0.f : Size) - P0[Axis]) / Delta[Axis];
+		const float FarT = ((Delta[Axis] > 0.f ? Size : 0.f) - P0[Axis]) / Delta[Axis];
+		if(NearT > StartT)
+		{
+			StartT = NearT;
+			EnterAxis = Axis;
+		}
+		EndT = FMath::Min(EndT, FarT);
+	}
+	if(StartT >= EndT)
+		return false;
+
+	const FVector Entry = P0 + Delta * StartT;
+	FIntPoint Cell(
+		FMath::Clamp(FMath::FloorToInt(Entry.X), 0, Footprint.X - 1),
+		FMath::Clamp(FMath::FloorToInt(Entry.Y), 0, Footprint.Y - 1));
+	const FIntPoint Step(Delta.X > 0.f ? 1 : -1, Delta.Y > 0.f ? 1 : -1);
+
+	// Line parameter between two borders of cells and of the next border, along each axis
+	const float StepTX = Delta.X != 0.f ? FMath::Abs(1.f / Delta.X) : BIG_NUMBER;
+	const float StepTY = Delta.Y != 0.f ? FMath::Abs(1.f / Delta.Y) : BIG_NUMBER;
+	float NextTX = Delta.X != 0.f ? ((Step.X > 0 ? Cell.X + 1 : Cell.X) - P0.X) / Delta.X : BIG_NUMBER;
+	float NextTY = Delta.Y != 0.f ? ((Step.Y > 0 ? Cell.Y + 1 : Cell.Y) - P0.Y) / Delta.Y : BIG_NUMBER;
+
+	float EnterT = StartT;
+	while(true)
+	{
+		const float ExitT = FMath::Min3(NextTX, NextTY, EndT);
+		const int32 SolidHeight = SolidHeights[Cell.Y * Footprint.X + Cell.X];
+		if(SolidHeight != NoSolidHeight)
+		{
+			// The column is solid below SolidHeight: the line is in it where it enters the column,
+			// or comes down through its top before it leaves the column
+			const float EnterZ = P0.Z + Delta.Z * EnterT;
+			float HitT = -1.f;
+			if(EnterZ < SolidHeight)
+			{
+				HitT = EnterT;
+				OutHit.Cell = FIntVector(Cell.X, Cell.Y, FMath::Max(FMath::FloorToInt(EnterZ), -1));
+				if(EnterAxis != INDEX_NONE)
+				{
+					OutHit.Normal = EnterAxis == 0 ? FVector(-Step.X, 0.f, 0.f) : FVector(0.f, -Step.Y, 0.f);
+				}
+			}
+			else if(Delta.Z < 0.f && P0.Z + Delta.Z * ExitT < SolidHeight)
+			{
+				HitT = (SolidHeight - P0.Z) / Delta.Z;
+				OutHit.Cell = FIntVector(Cell.X, Cell.Y, SolidHeight - 1);
+				OutHit.Normal = FVector::UpVector;
+			}
+
+			if(HitT >= 0.f)
+			{
+				// The hit cell is left through a side of the column or through its floor or ceiling
+				float CellExitT = FMath::Min3(NextTX, NextTY, 1.f);
+				if(Delta.Z != 0.f)
+				{
+					CellExitT = FMath::Min(CellExitT, ((Delta.Z > 0.f ? OutHit.Cell.Z + 1 : OutHit.Cell.Z) - P0.Z) / Delta.Z);
+				}
+
+				const float Length = (End - Start).Size();
+				OutHit.bHit = true;
+				OutHit.Location = GridSpace.CellsToLocation(P0 + Delta * HitT);
+				OutHit.Distance = HitT * Length;
+				OutHit.ExitDistance = FMath::Max(CellExitT, HitT) * Length;
+				return true;
+			}
+		}
+
+		if(ExitT >= EndT)
+			return false;
+
+		if(NextTX < NextTY)
+		{
+			NextTX += StepTX;
+			Cell.X += Step.X;
+			EnterAxis = 0;
+		}
+		else
+		{
+			NextTY += StepTY;
+			Cell.Y += Step.Y;
+			EnterAxis = 1;
+		}
+		EnterT = ExitT;
+	}
+}
+
+bool FCityGridRaycast::IsVisible(const FVector& From, const FVector& To) const
+{
+	FCityRayHit Hit;
+	return !Raycast(From, To, Hit);
+}
+
+void FCityGridRaycast::RaycastBatch(TArrayView<const FVector> Starts, TArrayView<const FVector> Ends, TArray<FCityRayHit>& OutHits) const
+{
+	check(Starts.Num() == Ends.Num());
+	OutHits.SetNum(Starts.Num(), false);
+
+	ParallelFor(Starts.Num(), [this, Starts, Ends, &OutHits](int32 Ray)
+	{
+		Raycast(Starts[Ray], Ends[Ray], OutHits[Ray]);
+	}, Starts.Num() < MinParallelRays);
+}
+
+void FCityGridRaycast::IsVisibleBatch(TArrayView<const FVector> Froms, TArrayView<const FVector> Tos, TArray<bool>& OutVisible) const
+{
+	check(Froms.Num() == Tos.Num());
+	OutVisible.SetNumUninitialized(Froms.Num(), false);
+
+	ParallelFor(Froms.Num(), [this, Froms, Tos, &OutVisible](int32 Ray)
+	{
+		OutVisible[Ray] = IsVisible(Froms[Ray], Tos[Ray]);
+	}, Froms.Num() < MinParallelRays);
+}
+
+SIZE_T FCityGridRaycast::GetAllocatedSize() const
+{
+	return SolidHeights.GetAllocatedSize();
+}
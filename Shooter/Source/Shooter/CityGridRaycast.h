@@ -0,0 +1,66 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "WorldColumnRuns.h"
+#include "CityGridSpace.h"
+
+struct FCityRayHit
+{
+	bool bHit = false;
+	// First blocking cell. Z is -1 when the ray hits the ground under a street
+	FIntVector Cell = FIntVector::ZeroValue;
+	// World location where the ray enters the solid part of the cell
+	FVector Location = FVector::ZeroVector;
+	// Normal of the entered face, zero if the ray starts inside a solid cell
+	FVector Normal = FVector::ZeroVector;
+	float Distance = 0.f;
+	// Distance where the ray leaves the cell, e.g. for a trace against a detailed mesh of the cell only
+	float ExitDistance = 0.f;
+};
+
+/**
+ * Line of sight and hitscan queries against the grid of the city instead of the physics scene
+ * Solid cells are the ones of the collision of UCityChunkComponent: a building column is solid up to its height,
+ * a street column has the ground under it, other columns are empty.
+ * The ray walks columns on the ground plane cell by cell (Amanatides & Woo) and checks its height range in each
+ * column against the solid height, so each query costs a few cells instead of a scene query.
+ * With grid collision (AGenerator::bBuildGridCollision) these boxes are the only collision of the city, so a grid hit is
+ * final: a physics trace into the hit cell would hit the same box. Pawns and vehicles aren't in the grid - trace them separately
+ * Queries are const and can run on any thread while the city isn't rebuilt
+ */
+class SHOOTER_API FCityGridRaycast
+{
+public:
+	FCityGridRaycast();
+
+	// GridSpace - cells of Columns in the world, the same as the spawned tiles
+	void Build(const FWorldColumnRuns& Columns, const FCityGridSpace& InGridSpace);
+
+	void Reset();
+
+	FORCEINLINE bool IsBuilt() const { return SolidHeights.Num() > 0; }
+	FORCEINLINE FIntPoint GetFootprint() const { return Footprint; }
+
+	// First blocking cell on the segment from Start to End. False if nothing blocks it
+	bool Raycast(const FVector& Start, const FVector& End, FCityRayHit& OutHit) const;
+
+	// True if no solid cell is between the points, e.g. between the eyes of an AI and its target
+	bool IsVisible(const FVector& From, const FVector& To) const;
+
+	// Raycast() of each pair of Starts and Ends, spread over worker threads. OutHits are in the order of the rays
+	void RaycastBatch(TArrayView<const FVector> Starts, TArrayView<const FVector> Ends, TArray<FCityRayHit>& OutHits) const;
+
+	// IsVisible() of each pair, spread over worker threads
+	void IsVisibleBatch(TArrayView<const FVector> Froms, TArrayView<const FVector> Tos, TArray<bool>& OutVisible) const;
+
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	FIntPoint Footprint;
+	FCityGridSpace GridSpace;
+
+	// [y * X + x] - cells of the column below this height are solid, NoSolidHeight for empty columns
+	TArray<int32> SolidHeights;
+};
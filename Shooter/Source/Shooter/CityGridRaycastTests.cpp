@@ -0,0 +1,169 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+// Automation tests of the hitscan and line of sight queries of FCityGridRaycast
+// Run in the editor: Session Frontend > Automation > Shooter.City.Raycast, or "Automation RunTests Shooter.City.Raycast"
+
+
+#include "CityGridRaycast.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	// Cells aren't cubes and the grid isn't at the origin, so a mixed up axis or space shows up
+	const FCityGridSpace RaycastTestGridSpace(FVector(-3000.f, 400.f, 120.f), FVector(400.f, 400.f, 350.f));
+
+	// Map of the city, a row per Y: R - street, . - empty column, digit - building of that height on a sidewalk
+	const TCHAR* RaycastTestMap[] = {
+		TEXT("R2.5"),
+		TEXT("RRRR") };
+
+	void MakeRaycastTestColumns(FWorldColumnRuns& Columns)
+	{
+		const int32 SizeX = FCString::Strlen(RaycastTestMap[0]);
+		const int32 SizeY = UE_ARRAY_COUNT(RaycastTestMap);
+		Columns.Reset(FIntPoint(SizeX, SizeY));
+		for(int32 y = 0; y < SizeY; y++)
+		{
+			for(int32 x = 0; x < SizeX; x++)
+			{
+				const TCHAR Symbol = RaycastTestMap[y][x];
+				if(Symbol == TEXT('R'))
+				{
+					Columns.Append(x, y, ETileType::ETT_Road, 0, 1);
+				}
+				else if(FChar::IsDigit(Symbol))
+				{
+					Columns.Append(x, y, ETileType::ETT_Sidewalks_Inner, 0, 1);
+					Columns.Append(x, y, ETileType::ETT_Building_Window_Section, 0, FChar::ConvertCharDigitToInt(Symbol) - 1);
+				}
+			}
+		}
+		Columns.Finish();
+	}
+
+	FVector Cells(float x, float y, float z)
+	{
+		return RaycastTestGridSpace.CellsToLocation(FVector(x, y, z));
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCityGridRaycastHeightsTest, "Shooter.City.Raycast.Heights",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FCityGridRaycastHeightsTest::RunTest(const FString& Parameters)
+{
+	FWorldColumnRuns Columns;
+	MakeRaycastTestColumns(Columns);
+	FCityGridRaycast Raycast;
+	Raycast.Build(Columns, RaycastTestGridSpace);
+	TestEqual(TEXT("Footprint of the map"), Raycast.GetFootprint(), FIntPoint(4, 2));
+
+	const FVector& CellSize = RaycastTestGridSpace.CellSize;
+	FCityRayHit Hit;
+
+	// Low along the first row: the low building stops it
+	if(TestTrue(TEXT("Low ray stops at the low building"), Raycast.Raycast(Cells(-1.f, 0.5f, 1.5f), Cells(6.f, 0.5f, 1.5f), Hit)))
+	{
+		TestEqual(TEXT("Cell of the low building"), Hit.Cell, FIntVector(1, 0, 1));
+		TestEqual(TEXT("Face of the low building"), Hit.Normal, FVector(-1.f, 0.f, 0.f));
+		TestEqual(TEXT("Range to the low building"), Hit.Distance, 2.f * CellSize.X, 0.1f);
+	}
+
+	// Higher: over the low building and the empty column into the tall one
+	if(TestTrue(TEXT("High ray stops at the tall building"), Raycast.Raycast(Cells(-1.f, 0.5f, 3.5f), Cells(6.f, 0.5f, 3.5f), Hit)))
+	{
+		TestEqual(TEXT("Cell of the tall building"), Hit.Cell, FIntVector(3, 0, 3));
+		TestEqual(TEXT("Face of the tall building"), Hit.Normal, FVector(-1.f, 0.f, 0.f));
+		TestEqual(TEXT("Point on the tall building"), Hit.Location, Cells(3.f, 0.5f, 3.5f), 0.1f);
+		TestEqual(TEXT("Range to the tall building"), Hit.Distance, 4.f * CellSize.X, 0.1f);
+		TestEqual(TEXT("Range out of the hit cell"), Hit.ExitDistance, 5.f * CellSize.X, 0.1f);
+	}
+
+	// Above every building
+	TestTrue(TEXT("Line of sight above the roofs"), Raycast.IsVisible(Cells(-1.f, 0.5f, 5.5f), Cells(6.f, 0.5f, 5.5f)));
+
+	// From outside the footprint back into it: the tall building is met first, on its far face
+	if(TestTrue(TEXT("Ray from outside stops at the tall building"), Raycast.Raycast(Cells(8.f, 0.5f, 4.f), Cells(-1.f, 0.5f, 4.f), Hit)))
+	{
+		TestEqual(TEXT("Cell met from outside"), Hit.Cell, FIntVector(3, 0, 4));
+		TestEqual(TEXT("Face met from outside"), Hit.Normal, FVector(1.f, 0.f, 0.f));
+		TestEqual(TEXT("Range from outside"), Hit.Distance, 4.f * CellSize.X, 0.1f);
+	}
+
+	// Straight down onto the low roof
+	if(TestTrue(TEXT("Falling ray stops at the low roof"), Raycast.Raycast(Cells(1.5f, 0.5f, 4.f), Cells(1.5f, 0.5f, 0.f), Hit)))
+	{
+		TestEqual(TEXT("Cell under the low roof"), Hit.Cell, FIntVector(1, 0, 1));
+		TestEqual(TEXT("Face of the low roof"), Hit.Normal, FVector::UpVector);
+		TestEqual(TEXT("Range to the low roof"), Hit.Distance, 2.f * CellSize.Z, 0.1f);
+		TestEqual(TEXT("Range out of the top floor"), Hit.ExitDistance, 3.f * CellSize.Z, 0.1f);
+	}
+
+	// A street has ground under it, an empty column has nothing at all
+	if(TestTrue(TEXT("Falling ray stops at the street"), Raycast.Raycast(Cells(0.5f, 1.5f, 2.f), Cells(0.5f, 1.5f, -1.f), Hit)))
+	{
+		TestEqual(TEXT("Cell under the street"), Hit.Cell, FIntVector(0, 1, -1));
+	}
+	TestFalse(TEXT("Falling ray stops in the empty column"), Raycast.Raycast(Cells(2.5f, 0.5f, 6.f), Cells(2.5f, 0.5f, -1.f), Hit));
+
+	// Leaves the footprint while it is still above the street, so it would hit only the ground beyond the city
+	TestFalse(TEXT("Ray out of the footprint stops"), Raycast.Raycast(Cells(3.5f, 1.5f, 6.f), Cells(9.5f, 1.5f, -1.f), Hit));
+	// Never enters the footprint
+	TestFalse(TEXT("Ray beside the footprint stops"), Raycast.Raycast(Cells(-2.f, 0.5f, 3.f), Cells(-2.f, 0.5f, -3.f), Hit));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCityGridRaycastBatchTest, "Shooter.City.Raycast.Batch",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FCityGridRaycastBatchTest::RunTest(const FString& Parameters)
+{
+	FWorldColumnRuns Columns;
+	MakeRaycastTestColumns(Columns);
+	FCityGridRaycast Raycast;
+	Raycast.Build(Columns, RaycastTestGridSpace);
+
+	// Enough rays for the batch to go to worker threads: a fan from above the street corner over the whole map
+	TArray<FVector> Starts;
+	TArray<FVector> Ends;
+	for(int32 Ray = 0; Ray < 128; Ray++)
+	{
+		const float Angle = 2.f * PI * Ray / 128;
+		Starts.Add(Cells(0.5f, 1.5f, 2.5f));
+		Ends.Add(Cells(0.5f + 6.f * FMath::Cos(Angle), 1.5f + 6.f * FMath::Sin(Angle), 2.5f - (Ray % 4)));
+	}
+
+	TArray<FCityRayHit> Hits;
+	Raycast.RaycastBatch(Starts, Ends, Hits);
+	TArray<bool> Visible;
+	Raycast.IsVisibleBatch(Starts, Ends, Visible);
+	if(!TestEqual(TEXT("Rays answered by the batch"), Hits.Num(), Starts.Num()) || !TestEqual(TEXT("Rays answered by the visibility batch"), Visible.Num(), Starts.Num()))
+	{
+		return false;
+	}
+
+	int32 NumHits = 0;
+	for(int32 Ray = 0; Ray < Starts.Num(); Ray++)
+	{
+		FCityRayHit Hit;
+		const bool bHit = Raycast.Raycast(Starts[Ray], Ends[Ray], Hit);
+		NumHits += bHit ? 1 : 0;
+		TestEqual(*FString::Printf(TEXT("Batched ray %d hits as a single one"), Ray), Hits[Ray].bHit, bHit);
+		TestEqual(*FString::Printf(TEXT("Batched ray %d stops in the same cell"), Ray), Hits[Ray].Cell, Hit.Cell);
+		TestEqual(*FString::Printf(TEXT("Batched ray %d stops at the same range"), Ray), Hits[Ray].Distance, Hit.Distance, 0.1f);
+		TestEqual(*FString::Printf(TEXT("Batched ray %d sees as a single one"), Ray), Visible[Ray], !bHit);
+	}
+	// The fan goes down into the street and at the buildings as well as out of the city
+	TestTrue(TEXT("Some batched rays stop"), NumHits > 0);
+	TestTrue(TEXT("Some batched rays pass"), NumHits < Starts.Num());
+
+	// An empty city has nothing solid
+	FCityGridRaycast Unbuilt;
+	FCityRayHit Hit;
+	TestFalse(TEXT("Ray of an unbuilt city stops"), Unbuilt.Raycast(Starts[0], Ends[0], Hit));
+	return true;
+}
+
+#endif
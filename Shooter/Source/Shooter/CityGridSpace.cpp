@@ -0,0 +1,36 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CityGridSpace.h"
+#include "GenerationLogs.h"
+
+FTransform FCityGridSpace::GetTileTransform(int32 x, int32 y, int32 z, ETileRotation Rotation) const
+{
+	// The pivot moves to the corner which the turned mesh starts from
+	FRotator TileRotation;
+	FVector PivotOffset;
+	switch (Rotation)
+	{
+	case ETileRotation::ETR_Undefined:
+		UE_LOG(LogGeneration, Error, TEXT("FCityGridSpace::GetTileTransform - ETileRotation::ETR_Undefined"));
+	case ETileRotation::ETR_Forward:
+	default:
+		PivotOffset = FVector(0);
+		TileRotation = FRotator(0);
+		break;
+	case ETileRotation::ETR_Backward:
+		PivotOffset = FVector(CellSize.X, -CellSize.Y, 0);
+		TileRotation = FRotator(0, 180, 0);
+		break;
+	case ETileRotation::ETR_Left:
+		PivotOffset = FVector(CellSize.X, 0, 0);
+		TileRotation = FRotator(0, -90, 0);
+		break;
+	case ETileRotation::ETR_Right:
+		PivotOffset = FVector(0, -CellSize.Y, 0);
+		TileRotation = FRotator(0, 90, 0);
+		break;
+	}
+
+	return FTransform(TileRotation, Origin + FVector(x, y, z) * CellSize + PivotOffset);
+}
@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TileRotation.h"
+
+/**
+ * Where cells of the city grid are in space
+ * Tile meshes are modelled along -Y from their pivot, and the pivot of tile (x, y, z) is placed at Origin + (x, y, z) * CellSize,
+ * so cell (x, y, z) covers [x; x + 1) along X, [y - 1; y) along Y and [z; z + 1) along Z, in cells from Origin
+ * Spawning of tiles, collision and navigation boxes, crowds, traffic and ray queries all take cells from here
+ */
+struct SHOOTER_API FCityGridSpace
+{
+	// Pivot of tile (0, 0, 0)
+	FVector Origin;
+	FVector CellSize;
+
+	FCityGridSpace() :
+	Origin(FVector::ZeroVector),
+	CellSize(FVector::OneVector)
+	{
+	}
+
+	FCityGridSpace(const FVector& InOrigin, const FVector& InCellSize) :
+	Origin(InOrigin),
+	CellSize(InCellSize)
+	{
+	}
+
+	// Location of a point given in cells, e.g. (x + 0.5, y + 0.5, z) - the middle of the floor of cell (x, y, z)
+	FORCEINLINE FVector CellsToLocation(const FVector& Cells) const
+	{
+		return Origin + FVector(Cells.X, Cells.Y - 1.f, Cells.Z) * CellSize;
+	}
+
+	// Inverse of CellsToLocation(): the floor of the result is the cell of the location
+	FORCEINLINE FVector LocationToCells(const FVector& Location) const
+	{
+		const FVector Cells = (Location - Origin) / CellSize;
+		return FVector(Cells.X, Cells.Y + 1.f, Cells.Z);
+	}
+
+	// Column (x, y) of a location on the ground plane
+	FORCEINLINE FIntPoint GetColumn(float X, float Y) const
+	{
+		return FIntPoint(FMath::FloorToInt((X - Origin.X) / CellSize.X), FMath::FloorToInt((Y - Origin.Y) / CellSize.Y + 1.f));
+	}
+
+	FORCEINLINE FIntVector GetCell(const FVector& Location) const
+	{
+		const FVector Cells = LocationToCells(Location);
+		return FIntVector(FMath::FloorToInt(Cells.X), FMath::FloorToInt(Cells.Y), FMath::FloorToInt(Cells.Z));
+	}
+
+	FORCEINLINE FBox GetCellBox(int32 x, int32 y, int32 z) const
+	{
+		return FBox(CellsToLocation(FVector(x, y, z)), CellsToLocation(FVector(x + 1, y + 1, z + 1)));
+	}
+
+	// Transform of a tile of cell (x, y, z) turned by Rotation, so its mesh still covers GetCellBox()
+	FTransform GetTileTransform(int32 x, int32 y, int32 z, ETileRotation Rotation) const;
+};
@@ -0,0 +1,637 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CityTrafficComponent.h"
+#include "GenerationLogs.h"
+#include "Async/ParallelFor.h"
+#include "Components/InstancedStaticMeshComponent.h"
+
+// A slow frame runs at most this many steps, the rest of the time is dropped
+static const int32 MaxStepsPerTick = 4;
+// A vehicle standing at the end of a dead end slower than this turns back, cm per second
+static const float TurnBackSpeed = 10.f;
+
+// Points of a turn sampled per cell to find the cells it drives over
+static const int32 TurnSamplesPerCell = 4;
+
+UCityTrafficComponent::UCityTrafficComponent() :
+NumVehicles(2000),
+VehicleMesh(nullptr),
+MaxSpeed(1100.f),
+MaxAcceleration(200.f),
+ComfortDeceleration(300.f),
+MinGap(200.f),
+TimeHeadway(1.2f),
+VehicleLength(450.f),
+StepsPerSecond(30),
+LastStepMs(0.f),
+Instances(nullptr),
+StepAccumulator(0.f)
+{
+	PrimaryComponentTick.bCanEverTick = true;
+}
+
+void UCityTrafficComponent::Populate(const FWorldLayoutIndex& Layout, const FWorldColumnRuns& Columns, const TArray<ETileType>& VariantTags,
+	const FCityGridSpace& InGridSpace, int32 Seed)
+{
+	Clear();
+	if(!VehicleMesh)
+	{
+		UE_LOG(LogGeneration, Warning, TEXT("UCityTrafficComponent::Populate - no VehicleMesh, the traffic is not spawned"));
+		return;
+	}
+
+	GridSpace = InGridSpace;
+	BuildLanes(Layout, Columns, VariantTags);
+	SpawnVehicles(Seed);
+
+	if(!Instances)
+	{
+		Instances = NewObject<UInstancedStaticMeshComponent>(GetOwner(), TEXT("TrafficInstances"));
+		Instances->SetupAttachment(GetOwner()->GetRootComponent());
+		Instances->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		Instances->SetCanEverAffectNavigation(false);
+		Instances->RegisterComponent();
+	}
+	Instances->SetStaticMesh(VehicleMesh);
+
+	InstanceTransforms.SetNum(GetNumVehicles());
+	UpdateInstances();
+	Instances->AddInstances(InstanceTransforms, false);
+
+	UE_LOG(LogGeneration, Display, TEXT("UCityTrafficComponent::Populate - %d lanes, %d junctions of %d cells, %d vehicles"),
+		Lanes.Num(), Junctions.Num(), CellReservations.Num(), GetNumVehicles());
+}
+
+void UCityTrafficComponent::Clear()
+{
+	if(Instances)
+	{
+		Instances->ClearInstances();
+	}
+	Lanes.Reset();
+	Junctions.Reset();
+	CellReservations.Reset();
+	Reservations.Reset();
+	VehicleLanes.Reset();
+	VehiclePreviousLanes.Reset();
+	VehiclePositions.Reset();
+	VehicleSpeeds.Reset();
+	VehicleTurns.Reset();
+	VehicleReserved.Reset();
+	VehicleRandomStreams.Reset();
+	InstanceTransforms.Reset();
+	StepAccumulator = 0.f;
+}
+
+void UCityTrafficComponent::BuildLanes(const FWorldLayoutIndex& Layout, const FWorldColumnRuns& Columns, const TArray<ETileType>& VariantTags)
+{
+	const FVector CellSize = GridSpace.CellSize;
+	const FIntPoint Footprint = Layout.GetFootprint();
+	const int32 NumCells = Footprint.X * Footprint.Y;
+
+	// Junctions - crossroads and cells of several roads (T-junctions of inner roads)
+	TArray<TPair<FIntPoint, FIntPoint>> RoadRects;
+	TArray<uint8> RoadCover;
+	RoadCover.Init(0, NumCells);
+	Layout.ForEachRoadRect([&RoadRects, &RoadCover, Footprint](const FIntPoint& Min, const FIntPoint& Max, ETileType Type)
+	{
+		const int32 Cover = Type == ETileType::ETT_Road_Crossroads ? 2 : 1;
+		if(Type == ETileType::ETT_Road)
+		{
+			RoadRects.Add(TPair<FIntPoint, FIntPoint>(Min, Max));
+		}
+		for(int32 y = FMath::Max(Min.Y, 0); y <= FMath::Min(Max.Y, Footprint.Y - 1); y++)
+		{
+			for(int32 x = FMath::Max(Min.X, 0); x <= FMath::Min(Max.X, Footprint.X - 1); x++)
+			{
+				uint8& CellCover = RoadCover[y * Footprint.X + x];
+				CellCover = (uint8)FMath::Min(CellCover + Cover, 255);
+			}
+		}
+	});
+
+	auto IsJunctionCell = [&RoadCover, Footprint](int32 x, int32 y)
+	{
+		return x >= 0 && y >= 0 && x < Footprint.X && y < Footprint.Y && RoadCover[y * Footprint.X + x] >= 2;
+	};
+
+	// Connected junction cells are one junction. Each junction cell gets its own index for reservations
+	TArray<int32> CellJunctions;
+	CellJunctions.Init(INDEX_NONE, NumCells);
+	TArray<int32> JunctionCells;
+	JunctionCells.Init(INDEX_NONE, NumCells);
+	int32 NumJunctionCells = 0;
+	TArray<FIntPoint> Stack;
+	for(int32 y = 0; y < Footprint.Y; y++)
+	{
+		for(int32 x = 0; x < Footprint.X; x++)
+		{
+			if(CellJunctions[y * Footprint.X + x] != INDEX_NONE || !IsJunctionCell(x, y))
+				continue;
+
+			const int32 Junction = Junctions.AddDefaulted();
+			CellJunctions[y * Footprint.X + x] = Junction;
+			JunctionCells[y * Footprint.X + x] = NumJunctionCells++;
+			Stack.Add(FIntPoint(x, y));
+			while(Stack.Num() > 0)
+			{
+				const FIntPoint Cell = Stack.Pop(false);
+				const FIntPoint Neighbours[4] = { Cell + FIntPoint(1, 0), Cell - FIntPoint(1, 0), Cell + FIntPoint(0, 1), Cell - FIntPoint(0, 1) };
+				for(const FIntPoint& Next : Neighbours)
+				{
+					if(IsJunctionCell(Next.X, Next.Y) && CellJunctions[Next.Y * Footprint.X + Next.X] == INDEX_NONE)
+					{
+						CellJunctions[Next.Y * Footprint.X + Next.X] = Junction;
+						JunctionCells[Next.Y * Footprint.X + Next.X] = NumJunctionCells++;
+						Stack.Add(Next);
+					}
+				}
+			}
+		}
+	}
+	CellReservations.Init(INDEX_NONE, NumJunctionCells);
+
+	// Each piece of a road between two junctions - lanes in each direction
+	int32 NumPieces = 0;
+	for(const TPair<FIntPoint, FIntPoint>& RoadRect : RoadRects)
+	{
+		// The longer side of a road is its length
+		const FIntPoint Size = RoadRect.Value - RoadRect.Key + FIntPoint(1, 1);
+		const bool bAlongY = Size.Y > Size.X;
+		const FIntPoint Min = RoadRect.Key.ComponentMax(FIntPoint::ZeroValue);
+		const FIntPoint Max = RoadRect.Value.ComponentMin(Footprint - FIntPoint(1, 1));
+
+		const int32 LengthMin = bAlongY ? Min.Y : Min.X;
+		const int32 LengthMax = bAlongY ? Max.Y : Max.X;
+		const int32 CrossMin = bAlongY ? Min.X : Min.Y;
+		const int32 CrossMax = bAlongY ? Max.X : Max.Y;
+		const int32 LengthLimit = bAlongY ? Footprint.Y : Footprint.X;
+		const float LengthCell = bAlongY ? CellSize.Y : CellSize.X;
+		const FVector2D Axis = bAlongY ? FVector2D(0.f, 1.f) : FVector2D(1.f, 0.f);
+		const FVector2D CrossAxis = bAlongY ? FVector2D(1.f, 0.f) : FVector2D(0.f, 1.f);
+
+		// Junction across the road at L, INDEX_NONE if there is none
+		auto GetJunctionAt = [&](int32 L)
+		{
+			if(L < 0 || L >= LengthLimit)
+				return (int32)INDEX_NONE;
+			for(int32 C = CrossMin; C <= CrossMax; C++)
+			{
+				const int32 Junction = bAlongY ? CellJunctions[L * Footprint.X + C] : CellJunctions[C * Footprint.X + L];
+				if(Junction != INDEX_NONE)
+					return Junction;
+			}
+			return (int32)INDEX_NONE;
+		};
+
+		// Road tiles across the road at L
+		auto HasTileTypeAt = [&](int32 L, ETileType Type)
+		{
+			for(int32 C = CrossMin; C <= CrossMax; C++)
+			{
+				const int32 Variant = bAlongY ? Columns.GetVariant(0, L, C) : Columns.GetVariant(0, C, L);
+				if(VariantTags.IsValidIndex(Variant) && VariantTags[Variant] == Type)
+					return true;
+			}
+			return false;
+		};
+
+		// In cells, so the grid space places them
+		auto CellsToLocal = [this](const FVector2D& Cells)
+		{
+			return FVector2D(GridSpace.CellsToLocation(FVector(Cells, 0.f)));
+		};
+
+		int32 L = LengthMin;
+		while(L <= LengthMax)
+		{
+			if(GetJunctionAt(L) != INDEX_NONE)
+			{
+				L++;
+				continue;
+			}
+			const int32 First = L;
+			while(L <= LengthMax && GetJunctionAt(L) == INDEX_NONE)
+			{
+				L++;
+			}
+			const int32 Last = L - 1;
+			const int32 Before = GetJunctionAt(First - 1);
+			const int32 After = GetJunctionAt(Last + 1);
+
+			// Lanes drive on the right half of the road, the first one next to the middle
+			const int32 Width = CrossMax - CrossMin + 1;
+			const int32 NumLanes = HasTileTypeAt(First, ETileType::ETT_Road_OneLine) ? 1 : FMath::Max(Width / 2, 1);
+			const float LaneWidth = Width * 0.5f / NumLanes;
+			const float Middle = (CrossMin + CrossMax + 1) * 0.5f;
+			const int32 Piece = NumPieces++;
+
+			for(int32 LaneInPiece = 0; LaneInPiece < NumLanes; LaneInPiece++)
+			{
+				const float LaneOffset = (LaneInPiece + 0.5f) * LaneWidth;
+
+				FTrafficLane Forward;
+				Forward.Direction = Axis;
+				// Right of direction (X, Y) is (-Y, X)
+				Forward.Start = CellsToLocal(Axis * First + CrossAxis * Middle + FVector2D(-Axis.Y, Axis.X) * LaneOffset);
+				Forward.Length = (Last - First + 1) * LengthCell;
+				Forward.FromJunction = Before;
+				Forward.ToJunction = After;
+				Forward.Piece = Piece;
+				Forward.bWantsJunction = false;
+
+				FTrafficLane Backward = Forward;
+				Backward.Direction = -Axis;
+				Backward.Start = CellsToLocal(Axis * (Last + 1) + CrossAxis * Middle + FVector2D(Axis.Y, -Axis.X) * LaneOffset);
+				Backward.FromJunction = After;
+				Backward.ToJunction = Before;
+
+				const int32 ForwardIndex = Lanes.Num();
+				Forward.ReverseLane = ForwardIndex + 1;
+				Backward.ReverseLane = ForwardIndex;
+				Lanes.Add(MoveTemp(Forward));
+				Lanes.Add(MoveTemp(Backward));
+
+				if(Before != INDEX_NONE)
+				{
+					Junctions[Before].OutLanes.Add(ForwardIndex);
+				}
+				if(After != INDEX_NONE)
+				{
+					Junctions[After].OutLanes.Add(ForwardIndex + 1);
+				}
+			}
+		}
+	}
+
+	BuildTurns(JunctionCells, Footprint);
+}
+
+void UCityTrafficComponent::BuildTurns(const TArray<int32>& JunctionCells, FIntPoint Footprint)
+{
+	const float SampleStep = FMath::Min(GridSpace.CellSize.X, GridSpace.CellSize.Y) / TurnSamplesPerCell;
+	for(FTrafficLane& Lane : Lanes)
+	{
+		if(Lane.ToJunction == INDEX_NONE)
+			continue;
+
+		for(int32 OutLane : Junctions[Lane.ToJunction].OutLanes)
+		{
+			const FTrafficLane& To = Lanes[OutLane];
+			FTrafficTurn& Turn = Lane.Turns.AddDefaulted_GetRef();
+			Turn.ToLane = OutLane;
+
+			// The same curve as GetVehicleTransform(). A sample at distance D along the turn is left by the back of the vehicle
+			// when its front is VehicleLength further, at position D - TurnLength + VehicleLength of To
+			const float TurnLength = GetTurnLength(Lane, To);
+			const FVector2D TurnStart = Lane.Start + Lane.Direction * Lane.Length;
+			const int32 NumSamples = FMath::Max(FMath::CeilToInt(TurnLength / SampleStep), 1);
+			for(int32 Sample = 0; Sample <= NumSamples; Sample++)
+			{
+				const float Alpha = (float)Sample / NumSamples;
+				const FVector2D Location = FMath::CubicInterp(TurnStart, Lane.Direction * TurnLength, To.Start, To.Direction * TurnLength, Alpha);
+				const FIntPoint Column = GridSpace.GetColumn(Location.X, Location.Y);
+				if(Column.X < 0 || Column.Y < 0 || Column.X >= Footprint.X || Column.Y >= Footprint.Y)
+					continue;
+
+				const int32 Cell = JunctionCells[Column.Y * Footprint.X + Column.X];
+				if(Cell == INDEX_NONE)
+					continue;
+
+				int32 TurnCell = Turn.Cells.Find(Cell);
+				if(TurnCell == INDEX_NONE)
+				{
+					TurnCell = Turn.Cells.Add(Cell);
+					Turn.ReleasePositions.Add(0.f);
+				}
+				Turn.ReleasePositions[TurnCell] = Alpha * TurnLength - TurnLength + VehicleLength;
+			}
+		}
+	}
+}
+
+void UCityTrafficComponent::SpawnVehicles(int32 Seed)
+{
+	FRandomStream SpawnStream(Seed);
+
+	// Random order of lanes, each lane is filled from its end with even spacing
+	TArray<int32> LaneOrder;
+	for(int32 Lane = 0; Lane < Lanes.Num(); Lane++)
+	{
+		LaneOrder.Add(Lane);
+	}
+	for(int32 i = LaneOrder.Num() - 1; i > 0; i--)
+	{
+		LaneOrder.Swap(i, SpawnStream.RandHelper(i + 1));
+	}
+
+	const float Spacing = VehicleLength + MinGap * 2.f;
+	bool bPlaced = true;
+	for(int32 Row = 0; bPlaced && GetNumVehicles() < NumVehicles; Row++)
+	{
+		bPlaced = false;
+		for(int32 LaneIndex : LaneOrder)
+		{
+			FTrafficLane& Lane = Lanes[LaneIndex];
+			const float Position = Lane.Length - (Row + 0.5f) * Spacing;
+			if(Position < 0.f || GetNumVehicles() >= NumVehicles)
+				continue;
+
+			const int32 Vehicle = VehicleLanes.Add(LaneIndex);
+			VehiclePreviousLanes.Add(INDEX_NONE);
+			VehiclePositions.Add(Position);
+			VehicleSpeeds.Add(0.f);
+			VehicleTurns.Add(INDEX_NONE);
+			VehicleReserved.Add(false);
+			VehicleRandomStreams.Add(FRandomStream(SpawnStream.RandHelper(MAX_int32)));
+			Lane.Vehicles.Add(Vehicle);
+			bPlaced = true;
+		}
+	}
+
+	if(GetNumVehicles() < NumVehicles)
+	{
+		UE_LOG(LogGeneration, Log, TEXT("UCityTrafficComponent::SpawnVehicles - roads are full with %d of %d vehicles"), GetNumVehicles(), NumVehicles);
+	}
+}
+
+void UCityTrafficComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if(GetNumVehicles() == 0)
+		return;
+
+	const double StartTime = FPlatformTime::Seconds();
+	const float FixedStep = 1.f / StepsPerSecond;
+	StepAccumulator += DeltaTime;
+	int32 NumSteps = 0;
+	while(StepAccumulator >= FixedStep && NumSteps < MaxStepsPerTick)
+	{
+		Step(FixedStep);
+		StepAccumulator -= FixedStep;
+		NumSteps++;
+	}
+	if(NumSteps == MaxStepsPerTick)
+	{
+		StepAccumulator = 0.f;
+	}
+	LastStepMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	if(NumSteps > 0 && Instances)
+	{
+		UpdateInstances();
+		Instances->BatchUpdateInstancesTransforms(0, InstanceTransforms, false, true, true);
+	}
+}
+
+void UCityTrafficComponent::Step(float DeltaTime)
+{
+	ParallelFor(Lanes.Num(), [this, DeltaTime](int32 LaneIndex)
+	{
+		StepLane(LaneIndex, DeltaTime);
+	});
+
+	ResolveJunctions();
+}
+
+float UCityTrafficComponent::GetAcceleration(float Speed, float Gap, float ApproachSpeed) const
+{
+	const float DesiredGap = MinGap
+		+ FMath::Max(0.f, Speed * TimeHeadway + Speed * ApproachSpeed / (2.f * FMath::Sqrt(MaxAcceleration * ComfortDeceleration)));
+	const float SpeedRatio = Speed / MaxSpeed;
+	const float GapRatio = DesiredGap / FMath::Max(Gap, 1.f);
+	return MaxAcceleration * (1.f - FMath::Square(FMath::Square(SpeedRatio)) - FMath::Square(GapRatio));
+}
+
+void UCityTrafficComponent::StepLane(int32 LaneIndex, float DeltaTime)
+{
+	FTrafficLane& Lane = Lanes[LaneIndex];
+	Lane.bWantsJunction = false;
+
+	for(int32 i = 0; i < Lane.Vehicles.Num(); i++)
+	{
+		const int32 Vehicle = Lane.Vehicles[i];
+		const float Speed = VehicleSpeeds[Vehicle];
+		const float Position = VehiclePositions[Vehicle];
+
+		float Acceleration;
+		float MaxPosition = BIG_NUMBER;
+		if(i > 0)
+		{
+			// The vehicle in front has already moved this step
+			const int32 Leader = Lane.Vehicles[i - 1];
+			const float Gap = VehiclePositions[Leader] - Position - VehicleLength;
+			Acceleration = GetAcceleration(Speed, Gap, Speed - VehicleSpeeds[Leader]);
+			MaxPosition = VehiclePositions[Leader] - VehicleLength;
+		}
+		else if(Lane.ToJunction != INDEX_NONE && !VehicleReserved[Vehicle])
+		{
+			// No reservation: the end of the lane is a standing obstacle. Asks for the junction when it has to start braking
+			const float Gap = Lane.Length - Position;
+			Acceleration = GetAcceleration(Speed, Gap, Speed);
+			MaxPosition = Lane.Length;
+			if(Gap < Speed * Speed / (2.f * ComfortDeceleration) + MinGap + VehicleLength)
+			{
+				Lane.bWantsJunction = true;
+			}
+		}
+		else if(Lane.ToJunction == INDEX_NONE)
+		{
+			// Dead end: a standing obstacle just past the end of the lane, so the vehicle stops at the end and turns back
+			const float Gap = Lane.Length + MinGap - Position;
+			Acceleration = GetAcceleration(Speed, Gap, Speed);
+			MaxPosition = Lane.Length;
+		}
+		else
+		{
+			Acceleration = GetAcceleration(Speed, BIG_NUMBER, 0.f);
+		}
+
+		const float NewSpeed = FMath::Max(0.f, Speed + Acceleration * DeltaTime);
+		VehicleSpeeds[Vehicle] = NewSpeed;
+		VehiclePositions[Vehicle] = FMath::Min(Position + NewSpeed * DeltaTime, MaxPosition);
+	}
+}
+
+int32 UCityTrafficComponent::ChooseTurn(int32 Vehicle, const FTrafficLane& Lane)
+{
+	if(Lane.Turns.Num() == 0)
+	{
+		// Dead end - turn back
+		return INDEX_NONE;
+	}
+
+	// Back into the same piece of road only when there is no other way
+	int32 NumChoices = 0;
+	int32 BackTurn = INDEX_NONE;
+	for(int32 Turn = 0; Turn < Lane.Turns.Num(); Turn++)
+	{
+		if(Lanes[Lane.Turns[Turn].ToLane].Piece != Lane.Piece)
+		{
+			NumChoices++;
+		}
+		else if(BackTurn == INDEX_NONE || Lane.Turns[Turn].ToLane == Lane.ReverseLane)
+		{
+			BackTurn = Turn;
+		}
+	}
+	if(NumChoices == 0)
+	{
+		return BackTurn;
+	}
+
+	int32 Choice = VehicleRandomStreams[Vehicle].RandHelper(NumChoices);
+	for(int32 Turn = 0; Turn < Lane.Turns.Num(); Turn++)
+	{
+		if(Lanes[Lane.Turns[Turn].ToLane].Piece == Lane.Piece)
+			continue;
+		if(Choice-- == 0)
+			return Turn;
+	}
+	return BackTurn;
+}
+
+bool UCityTrafficComponent::TryReserve(int32 Vehicle, const FTrafficTurn& Turn)
+{
+	for(int32 Cell : Turn.Cells)
+	{
+		if(CellReservations[Cell] != INDEX_NONE && CellReservations[Cell] != Vehicle)
+			return false;
+	}
+
+	for(int32 TurnCell = 0; TurnCell < Turn.Cells.Num(); TurnCell++)
+	{
+		const int32 Cell = Turn.Cells[TurnCell];
+		const FTrafficReservation Reservation = { Vehicle, Cell, Turn.ToLane, Turn.ReleasePositions[TurnCell] };
+		if(CellReservations[Cell] == Vehicle)
+		{
+			// Still held by the back of the vehicle from its last turn - now it's held for this one
+			FTrafficReservation* Held = Reservations.FindByPredicate([Cell](const FTrafficReservation& Other)
+			{
+				return Other.Cell == Cell;
+			});
+			check(Held);
+			*Held = Reservation;
+			continue;
+		}
+		CellReservations[Cell] = Vehicle;
+		Reservations.Add(Reservation);
+	}
+	return true;
+}
+
+void UCityTrafficComponent::ResolveJunctions()
+{
+	// A cell is released when the back of its vehicle has left it
+	for(int32 i = Reservations.Num() - 1; i >= 0; i--)
+	{
+		const FTrafficReservation& Reservation = Reservations[i];
+		if(VehicleLanes[Reservation.Vehicle] == Reservation.Lane && VehiclePositions[Reservation.Vehicle] >= Reservation.ReleasePosition)
+		{
+			CellReservations[Reservation.Cell] = INDEX_NONE;
+			Reservations.RemoveAtSwap(i, 1, false);
+		}
+	}
+
+	// Requests are granted in order of lanes, so the result doesn't depend on worker threads
+	for(const FTrafficLane& Lane : Lanes)
+	{
+		if(!Lane.bWantsJunction)
+			continue;
+
+		const int32 Vehicle = Lane.Vehicles[0];
+		if(VehicleTurns[Vehicle] == INDEX_NONE)
+		{
+			VehicleTurns[Vehicle] = ChooseTurn(Vehicle, Lane);
+		}
+		VehicleReserved[Vehicle] = TryReserve(Vehicle, Lane.Turns[VehicleTurns[Vehicle]]);
+	}
+
+	// Vehicles over the end of their lane go to the next one
+	for(int32 LaneIndex = 0; LaneIndex < Lanes.Num(); LaneIndex++)
+	{
+		while(Lanes[LaneIndex].Vehicles.Num() > 0)
+		{
+			FTrafficLane& Lane = Lanes[LaneIndex];
+			const int32 Vehicle = Lane.Vehicles[0];
+			const bool bTurnsBack = Lane.ToJunction == INDEX_NONE
+				&& VehicleSpeeds[Vehicle] < TurnBackSpeed && VehiclePositions[Vehicle] >= Lane.Length - MinGap;
+			if(VehiclePositions[Vehicle] < Lane.Length && !bTurnsBack)
+				break;
+			// Standing at the junction without its cells
+			if(Lane.ToJunction != INDEX_NONE && !VehicleReserved[Vehicle])
+				break;
+
+			// The vehicle enters the next lane at the start of the turn to it, behind the start of the lane
+			const int32 NextLaneIndex = Lane.ToJunction != INDEX_NONE ? Lane.Turns[VehicleTurns[Vehicle]].ToLane : Lane.ReverseLane;
+			FTrafficLane& NextLane = Lanes[NextLaneIndex];
+			const float TurnLength = GetTurnLength(Lane, NextLane);
+			float Entry = FMath::Max(VehiclePositions[Vehicle] - Lane.Length, 0.f) - TurnLength;
+			if(NextLane.Vehicles.Num() > 0)
+			{
+				const float Back = VehiclePositions[NextLane.Vehicles.Last()];
+				if(Back - VehicleLength - MinGap < -TurnLength)
+				{
+					// No room on the next lane - wait at the end of this one, keeping the cells
+					VehiclePositions[Vehicle] = FMath::Min(VehiclePositions[Vehicle], Lane.Length);
+					VehicleSpeeds[Vehicle] = 0.f;
+					break;
+				}
+				Entry = FMath::Min(Entry, Back - VehicleLength - MinGap);
+			}
+
+			Lane.Vehicles.RemoveAt(0, 1, false);
+			NextLane.Vehicles.Add(Vehicle);
+			VehicleLanes[Vehicle] = NextLaneIndex;
+			VehiclePreviousLanes[Vehicle] = LaneIndex;
+			VehiclePositions[Vehicle] = Entry;
+			VehicleTurns[Vehicle] = INDEX_NONE;
+			VehicleReserved[Vehicle] = false;
+		}
+	}
+}
+
+float UCityTrafficComponent::GetTurnLength(const FTrafficLane& From, const FTrafficLane& To)
+{
+	// The chord is close enough to the length of the curve for the speed along it
+	return FMath::Max(FVector2D::Distance(From.Start + From.Direction * From.Length, To.Start), 1.f);
+}
+
+FTransform UCityTrafficComponent::GetVehicleTransform(int32 Vehicle) const
+{
+	const FTrafficLane& Lane = Lanes[VehicleLanes[Vehicle]];
+	const float Position = VehiclePositions[Vehicle];
+	FVector2D Location = Lane.Start + Lane.Direction * Position;
+	FVector2D Direction = Lane.Direction;
+
+	const int32 PreviousLane = VehiclePreviousLanes[Vehicle];
+	if(Position < 0.f && PreviousLane != INDEX_NONE)
+	{
+		// On the turn: a Hermite curve from the end of the previous lane along its direction to the start of this one
+		const FTrafficLane& From = Lanes[PreviousLane];
+		const float TurnLength = GetTurnLength(From, Lane);
+		const float Alpha = FMath::Clamp(1.f + Position / TurnLength, 0.f, 1.f);
+		const FVector2D TurnStart = From.Start + From.Direction * From.Length;
+		const FVector2D StartTangent = From.Direction * TurnLength;
+		const FVector2D EndTangent = Lane.Direction * TurnLength;
+		Location = FMath::CubicInterp(TurnStart, StartTangent, Lane.Start, EndTangent, Alpha);
+		Direction = FMath::CubicInterpDerivative(TurnStart, StartTangent, Lane.Start, EndTangent, Alpha);
+		if(Direction.IsNearlyZero())
+		{
+			Direction = Lane.Direction;
+		}
+	}
+
+	const float Yaw = FMath::RadiansToDegrees(FMath::Atan2(Direction.Y, Direction.X));
+	return FTransform(FRotator(0.f, Yaw, 0.f), FVector(Location, GridSpace.Origin.Z));
+}
+
+void UCityTrafficComponent::UpdateInstances()
+{
+	for(int32 Vehicle = 0; Vehicle < GetNumVehicles(); Vehicle++)
+	{
+		InstanceTransforms[Vehicle] = GetVehicleTransform(Vehicle);
+	}
+}
@@ -0,0 +1,199 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "WorldColumnRuns.h"
+#include "WorldLayoutIndex.h"
+#include "CityGridSpace.h"
+#include "CityTrafficComponent.generated.h"
+
+class UInstancedStaticMeshComponent;
+
+// Way from the end of a lane over its junction to one of the lanes which leave the junction
+struct FTrafficTurn
+{
+	int32 ToLane;
+	// Cells of the junction the way drives over, indexes in CellReservations of UCityTrafficComponent
+	TArray<int32> Cells;
+	// [Cell] - position on ToLane from which the back of the vehicle has left the cell
+	TArray<float> ReleasePositions;
+};
+
+// One lane in one direction of a straight piece of road between two junctions
+struct FTrafficLane
+{
+	// Local space of the owner, cm
+	FVector2D Start;
+	FVector2D Direction;
+	float Length;
+
+	// Junction at the start and at the end of the lane, INDEX_NONE - dead end
+	int32 FromJunction;
+	int32 ToJunction;
+	// Same lane of the piece of road in the other direction
+	int32 ReverseLane;
+	// Piece of road of the lane. Lanes of one piece don't lead into each other at junctions, unless there's no other way
+	int32 Piece;
+
+	// Ways over ToJunction, empty at a dead end
+	TArray<FTrafficTurn> Turns;
+
+	// Vehicles on the lane, the front one first
+	TArray<int32> Vehicles;
+
+	// Set by the step of the lane: its front vehicle is close to ToJunction and has no reservation
+	bool bWantsJunction;
+};
+
+// Connected crossroads cells (or cells where roads overlap)
+struct FTrafficJunction
+{
+	TArray<int32> OutLanes;
+};
+
+// Cell of a junction held by a vehicle until the back of the vehicle has left it
+struct FTrafficReservation
+{
+	int32 Vehicle;
+	int32 Cell;
+	// The cell is released when the vehicle is on Lane at ReleasePosition or further
+	int32 Lane;
+	float ReleasePosition;
+};
+
+/**
+ * Vehicles driving on lanes extracted from the roads of FWorldLayoutIndex
+ * A piece of road between two junctions has a lane per two cells of its width in each direction, at least one,
+ * and each direction keeps to its right half - the halves of a wide road of HalfOfWideRoad tiles. A road of OneLine tiles
+ * has one lane in each direction whatever its width
+ * Lanes are stepped in parallel at a fixed rate: each vehicle follows the one in front of it (intelligent driver model).
+ * The front vehicle of a lane chooses its way over the next junction and stops there until every junction cell on the way
+ * is reserved for it, or at the end of a dead end, where it turns back. A vehicle holds each cell until its back has left it,
+ * so ways which don't cross are driven at the same time. Vehicles drive through junctions on a curve from the end of one lane
+ * to the start of the next
+ * Vehicles never change lanes between junctions, and cells are reserved only when the vehicle has to start braking
+ * for the junction - there is no planning of reservations ahead in time
+ * Vehicles are instances of one mesh, there are no actors per vehicle
+ */
+UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
+class SHOOTER_API UCityTrafficComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UCityTrafficComponent();
+
+	// Builds lanes and junctions from the roads and crossroads of Layout, then puts NumVehicles vehicles on the lanes
+	// Columns and VariantTags (ETileType of each variant of the solved tiles) tell the road tiles of the lanes
+	// InGridSpace - cells of Layout in the space of the owner
+	void Populate(const FWorldLayoutIndex& Layout, const FWorldColumnRuns& Columns, const TArray<ETileType>& VariantTags,
+		const FCityGridSpace& InGridSpace, int32 Seed);
+
+	void Clear();
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	FORCEINLINE int32 GetNumVehicles() const { return VehicleLanes.Num(); }
+	FORCEINLINE int32 GetNumLanes() const { return Lanes.Num(); }
+	FORCEINLINE int32 GetNumJunctions() const { return Junctions.Num(); }
+
+private:
+	void BuildLanes(const FWorldLayoutIndex& Layout, const FWorldColumnRuns& Columns, const TArray<ETileType>& VariantTags);
+
+	// Ways over the junctions at the ends of the lanes. JunctionCells - [y * Footprint.X + x] index of the junction cell, or INDEX_NONE
+	void BuildTurns(const TArray<int32>& JunctionCells, FIntPoint Footprint);
+
+	void SpawnVehicles(int32 Seed);
+
+	// One fixed step of the simulation
+	void Step(float DeltaTime);
+
+	// Worker thread: car following on one lane
+	void StepLane(int32 LaneIndex, float DeltaTime);
+
+	// Game thread: releases and grants reservations and moves vehicles over the ends of their lanes
+	void ResolveJunctions();
+
+	// Index of the way of a vehicle in the turns of Lane, INDEX_NONE at a dead end
+	int32 ChooseTurn(int32 Vehicle, const FTrafficLane& Lane);
+
+	// Reserves the cells of the turn for the vehicle if nobody else holds any of them
+	bool TryReserve(int32 Vehicle, const FTrafficTurn& Turn);
+
+	// Length of the curve from the end of From to the start of To, which a vehicle drives at negative positions of To
+	static float GetTurnLength(const FTrafficLane& From, const FTrafficLane& To);
+
+	FTransform GetVehicleTransform(int32 Vehicle) const;
+
+	// Acceleration by the intelligent driver model. Gap - free space to the obstacle in front, ApproachSpeed - speed towards it
+	float GetAcceleration(float Speed, float Gap, float ApproachSpeed) const;
+
+	void UpdateInstances();
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true", ClampMin=0, ClampMax=100000), Category = Traffic)
+	int32 NumVehicles;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true"), Category = Traffic)
+	UStaticMesh* VehicleMesh;
+
+	// Desired speed, cm per second
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true", ClampMin=1), Category = Traffic)
+	float MaxSpeed;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true", ClampMin=1), Category = Traffic)
+	float MaxAcceleration;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true", ClampMin=1), Category = Traffic)
+	float ComfortDeceleration;
+
+	// Gap kept to the vehicle in front when standing
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true", ClampMin=0), Category = Traffic)
+	float MinGap;
+
+	// Seconds to the vehicle in front when driving
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true", ClampMin=0), Category = Traffic)
+	float TimeHeadway;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true", ClampMin=1), Category = Traffic)
+	float VehicleLength;
+
+	// Steps of the simulation per second, independent of the frame rate
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true", ClampMin=1, ClampMax=120), Category = Traffic)
+	int32 StepsPerSecond;
+
+	// Time of the steps of the last tick
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"), Category = Traffic)
+	float LastStepMs;
+
+	UPROPERTY(Transient)
+	UInstancedStaticMeshComponent* Instances;
+
+	FCityGridSpace GridSpace;
+
+	TArray<FTrafficLane> Lanes;
+	TArray<FTrafficJunction> Junctions;
+
+	// [Junction cell] - vehicle which holds the cell, INDEX_NONE - free
+	TArray<int32> CellReservations;
+	TArray<FTrafficReservation> Reservations;
+
+	// Vehicles
+	TArray<int32> VehicleLanes;
+	// Lane the vehicle came from, the vehicle is on the turn from it while its position is negative. INDEX_NONE - spawned on its lane
+	TArray<int32> VehiclePreviousLanes;
+	TArray<float> VehiclePositions;
+	TArray<float> VehicleSpeeds;
+	// Way in the turns of the current lane, chosen when the vehicle first asks for the junction. INDEX_NONE - not chosen yet
+	TArray<int32> VehicleTurns;
+	// The cells of the way are reserved for the vehicle
+	TArray<bool> VehicleReserved;
+	// Each vehicle chooses its own way, so choices don't depend on the order of lanes
+	TArray<FRandomStream> VehicleRandomStreams;
+
+	// Time not simulated yet
+	float StepAccumulator;
+
+	TArray<FTransform> InstanceTransforms;
+};
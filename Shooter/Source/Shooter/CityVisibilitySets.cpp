@@ -0,0 +1,290 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CityVisibilitySets.h"
+#include "GenerationLogs.h"
+#include "Async/ParallelFor.h"
+
+// Distance of eye and target samples from the borders of their cells, so each sample is inside its own cell
+static const float SampleInset = 0.01f;
+
+FCityVisibilitySets::FCityVisibilitySets() :
+Footprint(FIntPoint::ZeroValue),
+NumBlocks(0),
+WordsPerSet(0),
+NumSets(0)
+{
+}
+
+void FCityVisibilitySets::Reset()
+{
+	Footprint = FIntPoint::ZeroValue;
+	NumBlocks = 0;
+	WordsPerSet = 0;
+	NumSets = 0;
+	ColumnBlocks.Reset();
+	CellSets.Reset();
+	SetBits.Reset();
+}
+
+void FCityVisibilitySets::Build(const FWorldColumnRuns& Columns, const TArray<FIntRect>& BlockRects, float MaxEyeHeight)
+{
+	Reset();
+	Footprint = Columns.GetFootprint();
+	NumBlocks = BlockRects.Num();
+	WordsPerSet = FMath::Max(1, FMath::DivideAndRoundUp(NumBlocks, 32));
+	const int32 NumColumns = Footprint.X * Footprint.Y;
+
+	TArray<int32> BuildingHeights;
+	BuildingHeights.SetNumUninitialized(NumColumns);
+	TArray<int32> StreetCells;
+	for(int32 y = 0; y < Footprint.Y; y++)
+	{
+		for(int32 x = 0; x < Footprint.X; x++)
+		{
+			BuildingHeights[y * Footprint.X + x] = Columns.GetBuildingHeight(x, y);
+			if(Columns.IsStreet(x, y))
+			{
+				StreetCells.Add(y * Footprint.X + x);
+			}
+		}
+	}
+
+	ColumnBlocks.Init(INDEX_NONE, NumColumns);
+	TArray<FIntRect> ClippedRects;
+	ClippedRects.Reserve(NumBlocks);
+	for(int32 Block = 0; Block < NumBlocks; Block++)
+	{
+		FIntRect Rect = BlockRects[Block];
+		Rect.Clip(FIntRect(FIntPoint::ZeroValue, Footprint));
+		ClippedRects.Add(Rect);
+		for(int32 y = Rect.Min.Y; y < Rect.Max.Y; y++)
+		{
+			for(int32 x = Rect.Min.X; x < Rect.Max.X; x++)
+			{
+				ColumnBlocks[y * Footprint.X + x] = Block;
+			}
+		}
+	}
+
+	// Points of each block a street cell may see: top corners of the edge columns on the outline of the block (its silhouette),
+	// and all top corners of inner columns which rise above the lowest edge column. A line to a lower point of a column
+	// passes below the line to its top, so the lower point is hidden whenever the top is. Targets are moved a bit
+	// into their column, so the line isn't checked against the column it ends on
+	TArray<FVector> Targets;
+	TArray<int32> BlockTargetStarts;
+	BlockTargetStarts.Reserve(NumBlocks + 1);
+	for(const FIntRect& Rect : ClippedRects)
+	{
+		BlockTargetStarts.Add(Targets.Num());
+
+		int32 MinEdgeHeight = MAX_int32;
+		for(int32 y = Rect.Min.Y; y < Rect.Max.Y; y++)
+		{
+			for(int32 x = Rect.Min.X; x < Rect.Max.X; x++)
+			{
+				if(x == Rect.Min.X || x == Rect.Max.X - 1 || y == Rect.Min.Y || y == Rect.Max.Y - 1)
+				{
+					MinEdgeHeight = FMath::Min(MinEdgeHeight, BuildingHeights[y * Footprint.X + x]);
+				}
+			}
+		}
+
+		for(int32 y = Rect.Min.Y; y < Rect.Max.Y; y++)
+		{
+			for(int32 x = Rect.Min.X; x < Rect.Max.X; x++)
+			{
+				const int32 Height = BuildingHeights[y * Footprint.X + x];
+				const bool bEdge = x == Rect.Min.X || x == Rect.Max.X - 1 || y == Rect.Min.Y || y == Rect.Max.Y - 1;
+				if(!bEdge && Height <= MinEdgeHeight)
+				{
+					continue;
+				}
+				for(int32 Corner = 0; Corner < 4; Corner++)
+				{
+					const int32 CornerX = x + (Corner & 1);
+					const int32 CornerY = y + (Corner >> 1);
+					const bool bOnOutline = CornerX == Rect.Min.X || CornerX == Rect.Max.X || CornerY == Rect.Min.Y || CornerY == Rect.Max.Y;
+					if(bEdge && !bOnOutline)
+					{
+						continue;
+					}
+					Targets.Add(FVector(
+						CornerX + (Corner & 1 ? -SampleInset : SampleInset),
+						CornerY + (Corner >> 1 ? -SampleInset : SampleInset),
+						Height));
+				}
+			}
+		}
+	}
+	BlockTargetStarts.Add(Targets.Num());
+
+	// The eye is sampled at the corners of the street cell at MaxEyeHeight: a line from a higher eye passes above the line
+	// from a lower eye to the same target, so the top of the range sees everything the lower eyes see
+	const FVector EyeCorners[4] =
+	{
+		FVector(SampleInset, SampleInset, MaxEyeHeight),
+		FVector(1.f - SampleInset, SampleInset, MaxEyeHeight),
+		FVector(SampleInset, 1.f - SampleInset, MaxEyeHeight),
+		FVector(1.f - SampleInset, 1.f - SampleInset, MaxEyeHeight)
+	};
+
+	TArray<uint32> StreetBits;
+	StreetBits.SetNumZeroed(StreetCells.Num() * WordsPerSet);
+	ParallelFor(StreetCells.Num(), [this, &StreetCells, &StreetBits, &Targets, &BlockTargetStarts, &BuildingHeights, &EyeCorners](int32 StreetIndex)
+	{
+		const int32 Cell = StreetCells[StreetIndex];
+		const FVector CellCorner(Cell % Footprint.X, Cell / Footprint.X, 0.f);
+		uint32* Bits = StreetBits.GetData() + StreetIndex * WordsPerSet;
+
+		for(int32 Block = 0; Block < NumBlocks; Block++)
+		{
+			bool bVisible = false;
+			for(int32 Target = BlockTargetStarts[Block]; Target < BlockTargetStarts[Block + 1] && !bVisible; Target++)
+			{
+				for(int32 Eye = 0; Eye < 4 && !bVisible; Eye++)
+				{
+					bVisible = IsLineOfSight(BuildingHeights, CellCorner + EyeCorners[Eye], Targets[Target]);
+				}
+			}
+			if(bVisible)
+			{
+				Bits[Block >> 5] |= 1u << (Block & 31);
+			}
+		}
+	});
+
+	// Each set is widened by the sets of the neighbouring street cells, for eyes between the samples
+	TArray<int32> StreetIndices;
+	StreetIndices.Init(INDEX_NONE, NumColumns);
+	for(int32 StreetIndex = 0; StreetIndex < StreetCells.Num(); StreetIndex++)
+	{
+		StreetIndices[StreetCells[StreetIndex]] = StreetIndex;
+	}
+	TArray<uint32> WideBits;
+	WideBits.SetNumZeroed(StreetCells.Num() * WordsPerSet);
+	ParallelFor(StreetCells.Num(), [this, &StreetCells, &StreetIndices, &StreetBits, &WideBits](int32 StreetIndex)
+	{
+		const int32 CellX = StreetCells[StreetIndex] % Footprint.X;
+		const int32 CellY = StreetCells[StreetIndex] / Footprint.X;
+		uint32* Bits = WideBits.GetData() + StreetIndex * WordsPerSet;
+		for(int32 y = FMath::Max(CellY - 1, 0); y <= FMath::Min(CellY + 1, Footprint.Y - 1); y++)
+		{
+			for(int32 x = FMath::Max(CellX - 1, 0); x <= FMath::Min(CellX + 1, Footprint.X - 1); x++)
+			{
+				const int32 Neighbour = StreetIndices[y * Footprint.X + x];
+				if(Neighbour == INDEX_NONE)
+					continue;
+
+				const uint32* NeighbourBits = StreetBits.GetData() + Neighbour * WordsPerSet;
+				for(int32 Word = 0; Word < WordsPerSet; Word++)
+				{
+					Bits[Word] |= NeighbourBits[Word];
+				}
+			}
+		}
+	});
+
+	// Equal sets are stored once
+	CellSets.Init(INDEX_NONE, NumColumns);
+	TMultiMap<uint32, int32> SetsByHash;
+	int64 NumVisible = 0;
+	for(int32 StreetIndex = 0; StreetIndex < StreetCells.Num(); StreetIndex++)
+	{
+		const uint32* Bits = WideBits.GetData() + StreetIndex * WordsPerSet;
+		const uint32 Hash = FCrc::MemCrc32(Bits, WordsPerSet * sizeof(uint32));
+
+		int32 Set = INDEX_NONE;
+		for(auto It = SetsByHash.CreateConstKeyIterator(Hash); It; ++It)
+		{
+			if(FMemory::Memcmp(SetBits.GetData() + It.Value() * WordsPerSet, Bits, WordsPerSet * sizeof(uint32)) == 0)
+			{
+				Set = It.Value();
+				break;
+			}
+		}
+		if(Set == INDEX_NONE)
+		{
+			Set = NumSets++;
+			SetBits.Append(Bits, WordsPerSet);
+			SetsByHash.Add(Hash, Set);
+		}
+		CellSets[StreetCells[StreetIndex]] = Set;
+
+		for(int32 Word = 0; Word < WordsPerSet; Word++)
+		{
+			NumVisible += FMath::CountBits(Bits[Word]);
+		}
+	}
+
+	UE_LOG(LogGeneration, Display, TEXT("FCityVisibilitySets::Build - %d street cells, %d unique sets, %.1f of %d blocks visible on average"),
+		StreetCells.Num(), NumSets, StreetCells.Num() > 0 ? (double)NumVisible / StreetCells.Num() : 0.0, NumBlocks);
+}
+
+bool FCityVisibilitySets::IsLineOfSight(const TArray<int32>& BuildingHeights, const FVector& Eye, const FVector& Target) const
+{
+	const FVector Delta = Target - Eye;
+	const FIntPoint TargetCell(FMath::FloorToInt(Target.X), FMath::FloorToInt(Target.Y));
+	FIntPoint Cell(FMath::FloorToInt(Eye.X), FMath::FloorToInt(Eye.Y));
+	const FIntPoint Step(Delta.X > 0.f ? 1 : -1, Delta.Y > 0.f ? 1 : -1);
+
+	// Line parameter between two borders of cells and of the next border, along each axis
+	const float StepTX = Delta.X != 0.f ? FMath::Abs(1.f / Delta.X) : BIG_NUMBER;
+	const float StepTY = Delta.Y != 0.f ? FMath::Abs(1.f / Delta.Y) : BIG_NUMBER;
+	float NextTX = Delta.X != 0.f ? (Step.X > 0 ? Cell.X + 1 - Eye.X : Eye.X - Cell.X) * StepTX : BIG_NUMBER;
+	float NextTY = Delta.Y != 0.f ? (Step.Y > 0 ? Cell.Y + 1 - Eye.Y : Eye.Y - Cell.Y) * StepTY : BIG_NUMBER;
+
+	while(Cell != TargetCell)
+	{
+		float EnterT;
+		if(NextTX < NextTY)
+		{
+			EnterT = NextTX;
+			NextTX += StepTX;
+			Cell.X += Step.X;
+		}
+		else
+		{
+			EnterT = NextTY;
+			NextTY += StepTY;
+			Cell.Y += Step.Y;
+		}
+		if(EnterT >= 1.f || Cell == TargetCell)
+		{
+			break;
+		}
+
+		// The line is the lowest where it enters the cell if it goes up, and where it leaves the cell if it goes down
+		const float ExitT = FMath::Min3(NextTX, NextTY, 1.f);
+		const float LineZ = Eye.Z + Delta.Z * (Delta.Z > 0.f ? EnterT : ExitT);
+		if(BuildingHeights[Cell.Y * Footprint.X + Cell.X] > LineZ)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int32 FCityVisibilitySets::GetBlock(int32 x, int32 y) const
+{
+	if(x < 0 || y < 0 || x >= Footprint.X || y >= Footprint.Y)
+	{
+		return INDEX_NONE;
+	}
+	return ColumnBlocks[y * Footprint.X + x];
+}
+
+bool FCityVisibilitySets::HasVisibleSet(int32 x, int32 y) const
+{
+	if(x < 0 || y < 0 || x >= Footprint.X || y >= Footprint.Y || CellSets.Num() == 0)
+	{
+		return false;
+	}
+	return CellSets[y * Footprint.X + x] != INDEX_NONE;
+}
+
+bool FCityVisibilitySets::IsBlockVisible(int32 x, int32 y, int32 Block) const
+{
+	const uint32* Bits = SetBits.GetData() + CellSets[y * Footprint.X + x] * WordsPerSet;
+	return (Bits[Block >> 5] >> (Block & 31)) & 1u;
+}
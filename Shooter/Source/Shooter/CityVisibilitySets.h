@@ -0,0 +1,54 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "WorldColumnRuns.h"
+
+/**
+ * Potentially visible blocks of each street cell, computed on the CPU from the grid
+ * A block is visible from a street cell if a line from an eye over the cell to a top corner on the silhouette of the block
+ * isn't covered by a building in between. Sets are conservative for eyes up to MaxEyeHeight: the eye is sampled
+ * at the top of that range on the corners of the cell, and every set includes the sets of the neighbouring street cells
+ * Cells of one street mostly see the same blocks, so equal sets are stored once
+ */
+class SHOOTER_API FCityVisibilitySets
+{
+public:
+	FCityVisibilitySets();
+
+	// BlockRects - buildings of the blocks in cells (Max is exclusive)
+	// MaxEyeHeight - in tiles above the ground, the sets don't hold for a higher eye
+	void Build(const FWorldColumnRuns& Columns, const TArray<FIntRect>& BlockRects, float MaxEyeHeight);
+
+	void Reset();
+
+	FORCEINLINE bool IsBuilt() const { return ColumnBlocks.Num() > 0; }
+	FORCEINLINE int32 GetNumBlocks() const { return NumBlocks; }
+	FORCEINLINE int32 GetNumSets() const { return NumSets; }
+
+	// Block which column (x, y) belongs to, INDEX_NONE out of blocks
+	int32 GetBlock(int32 x, int32 y) const;
+
+	// False if (x, y) is out of the city or isn't a street: there is no set, every block may be visible
+	bool HasVisibleSet(int32 x, int32 y) const;
+
+	// True if Block may be visible from street cell (x, y). Call only if HasVisibleSet()
+	bool IsBlockVisible(int32 x, int32 y, int32 Block) const;
+
+private:
+	// Walks cells under the line from Eye to Target (in tiles) and checks them against BuildingHeights
+	bool IsLineOfSight(const TArray<int32>& BuildingHeights, const FVector& Eye, const FVector& Target) const;
+
+	FIntPoint Footprint;
+	int32 NumBlocks;
+	int32 WordsPerSet;
+	int32 NumSets;
+
+	// [y * X + x] - block of the column
+	TArray<int32> ColumnBlocks;
+	// [y * X + x] - set of the street cell, INDEX_NONE for other cells
+	TArray<int32> CellSets;
+	// [Set * WordsPerSet] - bits of visible blocks
+	TArray<uint32> SetBits;
+};
@@ -0,0 +1,26 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GenerationArena.h"
+#include "GenerationLogs.h"
+
+TAtomic<int64> FGenerationArenaStats::NumAllocations(0);
+TAtomic<int64> FGenerationArenaStats::NumBytes(0);
+
+FGenerationArenaScope::FGenerationArenaScope(const TCHAR* InStageName) :
+Mark(FMemStack::Get()),
+StageName(InStageName),
+StartAllocations(FGenerationArenaStats::NumAllocations.Load()),
+StartBytes(FGenerationArenaStats::NumBytes.Load()),
+StartTime(FPlatformTime::Seconds())
+{
+}
+
+FGenerationArenaScope::~FGenerationArenaScope()
+{
+	const int64 Allocations = FGenerationArenaStats::NumAllocations.Load() - StartAllocations;
+	const int64 Bytes = FGenerationArenaStats::NumBytes.Load() - StartBytes;
+	
+	UE_LOG(LogGeneration, Display, TEXT("Generation stage %s: %.2f ms, %lld allocations (%.1f KB) served by the arena instead of the heap"),
+		StageName, (FPlatformTime::Seconds() - StartTime) * 1000.0, Allocations, Bytes / 1024.0);
+}
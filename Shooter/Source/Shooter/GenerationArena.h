@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/MemStack.h"
+
+// Transient data of generation lives on FMemStack - the engine's linear arena, one per thread.
+// Each stage pushes an FMemMark and everything allocated after it is released in one shot when the mark pops.
+// Worker threads of parallel stages push their own FMemMark, so every task works in its own sub-arena.
+
+struct SHOOTER_API FGenerationArenaStats
+{
+	// Allocations and bytes served by the arena instead of the general-purpose allocator
+	static TAtomic<int64> NumAllocations;
+	static TAtomic<int64> NumBytes;
+
+	static FORCEINLINE void RecordAllocation(SIZE_T Bytes)
+	{
+		NumAllocations.IncrementExchange();
+		NumBytes.AddExchange((int64)Bytes);
+	}
+};
+
+// TMemStackAllocator which counts its allocations into FGenerationArenaStats
+template<uint32 Alignment = DEFAULT_ALIGNMENT>
+class TGenerationArenaAllocator : public TMemStackAllocator<Alignment>
+{
+	typedef TMemStackAllocator<Alignment> Super;
+	
+public:
+	typedef typename Super::SizeType SizeType;
+
+	template<typename ElementType>
+	class ForElementType : public Super::template ForElementType<ElementType>
+	{
+	public:
+		void ResizeAllocation(SizeType PreviousNumElements, SizeType NumElements, SIZE_T NumBytesPerElement)
+		{
+			// Memory stack allocator pushes a new block on every resize
+			if(NumElements > 0)
+			{
+				FGenerationArenaStats::RecordAllocation(NumElements * NumBytesPerElement);
+			}
+			Super::template ForElementType<ElementType>::ResizeAllocation(PreviousNumElements, NumElements, NumBytesPerElement);
+		}
+	};
+};
+
+template<typename ElementType>
+using TGenerationArenaArray = TArray<ElementType, TGenerationArenaAllocator<>>;
+
+/**
+ * Arena of one generation stage on the current thread
+ * Releases everything allocated on this thread's FMemStack during the stage and logs what the arena has served
+ */
+class SHOOTER_API FGenerationArenaScope
+{
+public:
+	FGenerationArenaScope(const TCHAR* InStageName);
+	~FGenerationArenaScope();
+
+private:
+	FMemMark Mark;
+	const TCHAR* StageName;
+	int64 StartAllocations;
+	int64 StartBytes;
+	double StartTime;
+};
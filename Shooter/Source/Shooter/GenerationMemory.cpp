@@ -0,0 +1,190 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GenerationMemory.h"
+#include "GenerationLogs.h"
+#include "HAL/LowLevelMemStats.h"
+
+struct FGenerationMemoryStat
+{
+	TAtomic<int64> Retained;
+	TAtomic<int64> Peak;
+};
+
+// [EGenerationMemoryTag]
+static FGenerationMemoryStat Stats[(int32)EGenerationMemoryTag::MAX];
+
+static const TCHAR* TagNames[] =
+{
+	TEXT("Roads"),
+	TEXT("Blocks"),
+	TEXT("WorldGrid"),
+	TEXT("Domains"),
+	TEXT("PropagationQueue"),
+	TEXT("Registry"),
+	TEXT("SpawnedTiles")
+};
+static_assert(UE_ARRAY_COUNT(TagNames) == (int32)EGenerationMemoryTag::MAX, "Every generation memory tag needs a name");
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+// Full list - "stat LLMFull", summary - "stat LLM"
+DECLARE_LLM_MEMORY_STAT(TEXT("City Roads"), STAT_CityRoadsLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("City Blocks"), STAT_CityBlocksLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("City WorldGrid"), STAT_CityWorldGridLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("City Domains"), STAT_CityDomainsLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("City PropagationQueue"), STAT_CityPropagationQueueLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("City Registry"), STAT_CityRegistryLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("City SpawnedTiles"), STAT_CitySpawnedTilesLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("City Generation"), STAT_CityGenerationSummaryLLM, STATGROUP_LLM);
+
+static bool RegisterLLMTags()
+{
+	const FName StatNames[] =
+	{
+		GET_STATFNAME(STAT_CityRoadsLLM),
+		GET_STATFNAME(STAT_CityBlocksLLM),
+		GET_STATFNAME(STAT_CityWorldGridLLM),
+		GET_STATFNAME(STAT_CityDomainsLLM),
+		GET_STATFNAME(STAT_CityPropagationQueueLLM),
+		GET_STATFNAME(STAT_CityRegistryLLM),
+		GET_STATFNAME(STAT_CitySpawnedTilesLLM)
+	};
+	static_assert(UE_ARRAY_COUNT(StatNames) == (int32)EGenerationMemoryTag::MAX, "Every generation memory tag needs an LLM stat");
+
+	for(int32 Tag = 0; Tag < (int32)EGenerationMemoryTag::MAX; Tag++)
+	{
+		FLowLevelMemTracker::Get().RegisterProjectTag((int32)ELLMTag::ProjectTagStart + Tag, TagNames[Tag],
+			StatNames[Tag], GET_STATFNAME(STAT_CityGenerationSummaryLLM));
+	}
+	return true;
+}
+#endif
+
+namespace GenerationMemory
+{
+	static void UpdatePeak(FGenerationMemoryStat& Stat, int64 Retained)
+	{
+		int64 Peak = Stat.Peak.Load();
+		while(Retained > Peak && !Stat.Peak.CompareExchange(Peak, Retained))
+		{
+		}
+	}
+
+	void Add(EGenerationMemoryTag Tag, int64 Bytes)
+	{
+		FGenerationMemoryStat& Stat = Stats[(int32)Tag];
+		UpdatePeak(Stat, Stat.Retained.AddExchange(Bytes) + Bytes);
+	}
+
+	void Set(EGenerationMemoryTag Tag, int64 Bytes)
+	{
+		FGenerationMemoryStat& Stat = Stats[(int32)Tag];
+		Stat.Retained.Store(Bytes);
+		UpdatePeak(Stat, Bytes);
+	}
+
+	int64 GetRetained(EGenerationMemoryTag Tag)
+	{
+		return Stats[(int32)Tag].Retained.Load();
+	}
+
+	int64 GetPeak(EGenerationMemoryTag Tag)
+	{
+		return Stats[(int32)Tag].Peak.Load();
+	}
+
+	void ResetPeaks()
+	{
+		for(FGenerationMemoryStat& Stat : Stats)
+		{
+			Stat.Peak.Store(Stat.Retained.Load());
+		}
+	}
+
+	void Reset()
+	{
+		for(FGenerationMemoryStat& Stat : Stats)
+		{
+			Stat.Retained.Store(0);
+			Stat.Peak.Store(0);
+		}
+	}
+
+	const TCHAR* GetTagName(EGenerationMemoryTag Tag)
+	{
+		return TagNames[(int32)Tag];
+	}
+
+	void LogSummary()
+	{
+		int64 TotalPeak = 0;
+		int64 TotalRetained = 0;
+		UE_LOG(LogGeneration, Display, TEXT("Generation memory:      Peak KB   Retained KB"));
+		for(int32 Tag = 0; Tag < (int32)EGenerationMemoryTag::MAX; Tag++)
+		{
+			const int64 Peak = Stats[Tag].Peak.Load();
+			const int64 Retained = Stats[Tag].Retained.Load();
+			UE_LOG(LogGeneration, Display, TEXT("  %-20s %10.1f %13.1f"), TagNames[Tag], Peak / 1024.0, Retained / 1024.0);
+			TotalPeak += Peak;
+			TotalRetained += Retained;
+		}
+		// Peaks of different tags may happen at different times, so the sum is the upper bound of the peak
+		UE_LOG(LogGeneration, Display, TEXT("  %-20s %10.1f %13.1f"), TEXT("Total"), TotalPeak / 1024.0, TotalRetained / 1024.0);
+	}
+
+	FString GetCSVHeader()
+	{
+		FString Header;
+		for(int32 Tag = 0; Tag < (int32)EGenerationMemoryTag::MAX; Tag++)
+		{
+			Header += FString::Printf(TEXT("%s%sPeak,%sRetained"), Tag > 0 ? TEXT(",") : TEXT(""), TagNames[Tag], TagNames[Tag]);
+		}
+		return Header;
+	}
+
+	FString GetCSVValues()
+	{
+		FString Values;
+		for(int32 Tag = 0; Tag < (int32)EGenerationMemoryTag::MAX; Tag++)
+		{
+			Values += FString::Printf(TEXT("%s%lld,%lld"), Tag > 0 ? TEXT(",") : TEXT(""), Stats[Tag].Peak.Load(), Stats[Tag].Retained.Load());
+		}
+		return Values;
+	}
+
+	FString GetEmptyCSVValues()
+	{
+		FString Values;
+		for(int32 Tag = 0; Tag < (int32)EGenerationMemoryTag::MAX; Tag++)
+		{
+			Values += Tag > 0 ? TEXT(",0,0") : TEXT("0,0");
+		}
+		return Values;
+	}
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+	ELLMTag GetLLMTag(EGenerationMemoryTag Tag)
+	{
+		static const bool bRegistered = RegisterLLMTags();
+		(void)bRegistered;
+		return (ELLMTag)((int32)ELLMTag::ProjectTagStart + (int32)Tag);
+	}
+#endif
+}
+
+FGenerationMemoryCounter::FGenerationMemoryCounter(EGenerationMemoryTag InTag) :
+Tag(InTag),
+Bytes(0)
+{
+}
+
+FGenerationMemoryCounter::~FGenerationMemoryCounter()
+{
+	GenerationMemory::Add(Tag, -Bytes);
+}
+
+void FGenerationMemoryCounter::Set(int64 InBytes)
+{
+	GenerationMemory::Add(Tag, InBytes - Bytes);
+	Bytes = InBytes;
+}
@@ -0,0 +1,88 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/LowLevelMemTracker.h"
+
+// What the memory of generation is spent on
+// Each tag is a tag of the engine's low-level memory tracker (run with -llm, see "stat LLM") and a counter of GenerationMemory
+enum class EGenerationMemoryTag : uint8
+{
+	Roads,
+	Blocks,
+	// Typed planes, colours, variants and columns of UWorldItem3DArray, the layout index and the grid raycast
+	WorldGrid,
+	// Candidate masks of all WFC solvers
+	Domains,
+	PropagationQueue,
+	// Compiled rules and superposition arrays of ATileRegistry
+	Registry,
+	// Tile actors and their components. Meshes and materials are shared and not counted
+	SpawnedTiles,
+	MAX
+};
+
+/**
+ * Counters of generation memory by tag, which work in any build, unlike LLM
+ * Retained - bytes counted now. Peak - the largest amount since the last ResetPeaks()
+ * Counters are explicit: a structure reports its GetAllocatedSize(), not every allocation is hooked
+ */
+namespace GenerationMemory
+{
+	// Adds Bytes to the counter of the tag, negative - released. Thread-safe
+	SHOOTER_API void Add(EGenerationMemoryTag Tag, int64 Bytes);
+
+	// Sets the counter of the tag - for structures measured as a whole
+	SHOOTER_API void Set(EGenerationMemoryTag Tag, int64 Bytes);
+
+	SHOOTER_API int64 GetRetained(EGenerationMemoryTag Tag);
+	SHOOTER_API int64 GetPeak(EGenerationMemoryTag Tag);
+
+	// Peaks start again from the retained amounts - called at the start of each generation
+	SHOOTER_API void ResetPeaks();
+
+	// Zeroes all the counters - when everything counted so far is gone (a job of UCityFarmCommandlet)
+	SHOOTER_API void Reset();
+
+	SHOOTER_API const TCHAR* GetTagName(EGenerationMemoryTag Tag);
+
+	// Logs peak and retained KB of every tag
+	SHOOTER_API void LogSummary();
+
+	// "<Tag>Peak,<Tag>Retained..." columns in bytes, for manifests of UCityFarmCommandlet
+	SHOOTER_API FString GetCSVHeader();
+	SHOOTER_API FString GetCSVValues();
+	// The same amount of columns with zeros
+	SHOOTER_API FString GetEmptyCSVValues();
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+	// Project tag of LLM. The tags are registered on the first call
+	SHOOTER_API ELLMTag GetLLMTag(EGenerationMemoryTag Tag);
+#endif
+}
+
+/**
+ * Scoped counter: counts bytes of an owner into a tag until it's destroyed
+ * Set() can be called again when the owner grows or shrinks
+ */
+class SHOOTER_API FGenerationMemoryCounter
+{
+public:
+	FGenerationMemoryCounter(EGenerationMemoryTag InTag);
+	~FGenerationMemoryCounter();
+
+	void Set(int64 InBytes);
+
+private:
+	EGenerationMemoryTag Tag;
+	int64 Bytes;
+};
+
+// Allocations of the scope go to the LLM tag of EGenerationMemoryTag::Tag
+// FMemStack takes pages from LLM on its first use only - arena memory is tagged by the stage which grew the arena
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+	#define GENERATION_LLM_SCOPE(Tag) LLM_SCOPE(GenerationMemory::GetLLMTag(EGenerationMemoryTag::Tag))
+#else
+	#define GENERATION_LLM_SCOPE(Tag)
+#endif
@@ -2,7 +2,7 @@
 
 
 #include "Generator.h"
-#include "WorldArrayItem.h"
+#include "WorldGridRasterizer.h"
 
 #include <chrono>
 
@@ -10,15 +10,28 @@
 #include "ShooterGameInstance.h"
 #include "ToolContextInterfaces.h"
 #include "Algo/ForEach.h"
+#include "Engine/CollisionProfile.h"
+#include "Kismet/GameplayStatics.h"
+#include "Misc/Paths.h"
+#include "Async/ParallelFor.h"
+#include "GenerationMemory.h"
+#include "WFCRuleAnalysis.h"
+#include "WorldImageExport.h"
 
 DEFINE_LOG_CATEGORY(LogRoadGeneration);
 DEFINE_LOG_CATEGORY(LogGeneration);
 
+// Floors of a building which WFC has to solve before the top one can be repeated: ground, door floor and a window floor
+static const int32 BuildingTemplateHeight = 3;
+// Wider slabs are not drawn into the log - a line per row of such a map is unreadable anyway
+static const int32 MaxLoggedSliceSize = 200;
+
 // Sets default values
 AGenerator::AGenerator() :
 BuildingBlockHeight(300.f),
 MinTileElementSize(FIntVector(500.f, 500.f, 300.f)),
 DesirableCityHeight(2),
+CityHeightRandomRange(0),
 CityBorderWidth(0),
 MinimumGeneratedArea(FIntVector(10, 10, 1)),
 MinBasicRoadOffset(30),
@@ -34,15 +47,36 @@ MaxBlockSide(4)
 	RootComponent = GenerationBounds;
 
 	WFCGenerator = CreateDefaultSubobject<UWFCGeneratorComponent>(TEXT("WFC Generator"));
+
+	Crowd = CreateDefaultSubobject<UCityCrowdComponent>(TEXT("Crowd"));
+	Traffic = CreateDefaultSubobject<UCityTrafficComponent>(TEXT("Traffic"));
 }
 
 bool AGenerator::Generate()
 {
+	return Regenerate(GenerationSeed);
+}
+
+bool AGenerator::Regenerate(int32 Seed)
+{
+	ResetGeneration();
+
+	CurrentSeed = Seed != 0 ? Seed : FMath::RandRange(1, MAX_int32);
+	LayoutRandomStream.Initialize(CurrentSeed);
+	UE_LOG(LogGeneration, Display, TEXT("Generation seed: %d"), CurrentSeed);
+	GenerationMemory::ResetPeaks();
 	
 	MakeWorldArrayBounds();
 	
-	WorldArray = NewObject<UWorldItem3DArray>();
-	WorldArray->Init(WorldArrayBounds.Z, WorldArrayBounds.Y, WorldArrayBounds.X);
+	{
+		GENERATION_LLM_SCOPE(WorldGrid);
+		// The same grid for every city, its planes are reallocated only when the bounds change
+		if(!WorldArray)
+		{
+			WorldArray = NewObject<UWorldItem3DArray>();
+		}
+		WorldArray->Init(WorldArrayBounds.Z, WorldArrayBounds.Y, WorldArrayBounds.X);
+	}
 
 	GenerateRoadsMap();
 
@@ -54,35 +88,116 @@ bool AGenerator::Generate()
 	// Pseudo-recursively divide blocks
 	DivideBlocks();
 	
-	// Init values of empty array
-	DrawArrayEmpty();
-	FillEmptyCityBorderArea();
 	DrawRoadsMapInArray();
 
+	AssignBuildingColours();
+	AssignBuildingHeights();
+
+	if(bExportImages)
+	{
+		ExportImages(FPaths::Combine(WorldImageExport::GetExportDirectory(), FString::Printf(TEXT("Seed%d"), CurrentSeed)));
+	}
+
 	if(bUseWFC)
 	{
 		// Finally, WFC
 		if(WFCGenerator)
 		{
-			TArray<UWorldArrayItem*> WfcResult;
-			bool WfcSuccess = WFCGenerator->Generate(WorldArray, WfcResult);
+			bool WfcSuccess = WFCGenerator->Generate(WorldArray, CurrentSeed);
 	
 			if(WfcSuccess)
 			{
 				UE_LOG(LogGeneration, Display, TEXT("WFC stage 1 finished successfully!"));
-				SpawnWorldScene(WfcResult, WorldArray->Bounds);
+				BuildWorldColumns(WorldArray);
+				if(bBuildGridNavigation || bBuildGridCollision)
+				{
+					BuildCityChunks(WorldArray);
+				}
+				VisibilitySets.Reset();
+				if(bBuildVisibilitySets)
+				{
+					BuildVisibilitySets(WorldArray);
+				}
+				if(bSpawnScene)
+				{
+					SpawnWorldScene(WorldArray);
+					if(Crowd)
+					{
+						Crowd->Populate(WorldArray->Columns, GetLocalGridSpace(), CurrentSeed);
+					}
+					if(Traffic)
+					{
+						Traffic->Populate(LayoutIndex, WorldArray->Columns, WFCGenerator->GetTileRegistryActor()->GetCompiledRules().VariantTags,
+							GetLocalGridSpace(), CurrentSeed);
+					}
+				}
 			}
 			else
 			{
 				UE_LOG(LogGeneration, Error, TEXT("WFC stage 1 finished unsuccessfully!"));
 			}
 
+			GenerationMemory::LogSummary();
 			return WfcSuccess;
 		}
 	}
+	GenerationMemory::LogSummary();
 	return false;
 }
 
+void AGenerator::ResetGeneration()
+{
+	// Tiles of the previous city wait in the pool for the next one
+	if(!bPoolTiles)
+	{
+		TilePool.Empty();
+	}
+	for(ATile* Tile : GeneratedCity)
+	{
+		if(bPoolTiles)
+		{
+			TilePool.Release(Tile);
+		}
+		else if(IsValid(Tile))
+		{
+			Tile->Destroy();
+		}
+	}
+	GeneratedCity.Reset();
+	for(TArray<ATile*>& Tiles : ColumnTiles)
+	{
+		Tiles.Reset();
+	}
+	for(TArray<ATile*>& Tiles : BlockTiles)
+	{
+		Tiles.Reset();
+	}
+	if(Crowd)
+	{
+		Crowd->Clear();
+	}
+	if(Traffic)
+	{
+		Traffic->Clear();
+	}
+
+	// Reset() keeps the allocations - the next city is usually about as big as this one
+	XRoadPointsArray.Reset();
+	YRoadPointsArray.Reset();
+	Roads.Reset();
+	Blocks.Reset();
+	ResBlocks.Reset();
+	BlocksNotDivided.Reset();
+	BlocksNotAttempted.Reset();
+	BuildingHeights.Reset();
+	RoadsBeforeDivision = 0;
+	AmountOfSuccessfulCuts = 0;
+	RoadGenDebugValues = FRoadGenDebugValues();
+	GridRaycast.Reset();
+	VisibilitySets.Reset();
+	LastViewCell = FIntPoint(INDEX_NONE, INDEX_NONE);
+}
+
 bool AGenerator::ValidateInput()
 {
 	TArray<FString> ErrorMsgs;
@@ -138,6 +253,11 @@ void AGenerator::BeginPlay()
 			WideRoadGenerationChancePercent);
 	}
 
+	if(WFCGenerator && WFCGenerator->GetTileRegistryActor())
+	{
+		WFCGenerator->GetTileRegistryActor()->OnRulesChanged.AddUObject(this, &AGenerator::OnTileRulesChanged);
+	}
+
 	Generate();
 }
 
@@ -146,6 +266,10 @@ void AGenerator::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
+	if(VisibilitySets.IsBuilt())
+	{
+		UpdateVisibleBlocks();
+	}
 }
 
 void AGenerator::ValidateBasicRoadCoords()
@@ -178,6 +302,8 @@ void AGenerator::ValidateBasicRoadCoords()
 
 void AGenerator::GenerateRoadsMap()
 {
+	GENERATION_LLM_SCOPE(Roads);
+
 	// Define the bounds of area where roads can be generated
 	SetupRoadGenerationAreaBounds();
 
@@ -189,6 +315,8 @@ void AGenerator::GenerateRoadsMap()
 	// Translates basic road coords into geometric roads
 	GenerateRoadsByCoords();
 	check(Roads.Num() >= 1);
+
+	GenerationMemory::Set(EGenerationMemoryTag::Roads, GetRoadsAllocatedSize());
 }
 
 
@@ -249,7 +377,7 @@ bool AGenerator::GenerateSingleBasicRoadCoord(int& LastRoadIndex, int EndBound,
 	}
 	else
 	{
-		if(FMath::RandRange(1, 100) <= WideRoadGenerationChancePercent)
+		if(LayoutRandomStream.RandRange(1, 100) <= WideRoadGenerationChancePercent)
 		{
 			roadCoord.RoadWidth = WideRoadWidth;
 		}
@@ -265,7 +393,7 @@ bool AGenerator::GenerateSingleBasicRoadCoord(int& LastRoadIndex, int EndBound,
 	}
 	else
 	{
-		int offset = FMath::RandRange(MinBasicRoadOffset, MaxBasicRoadOffset);
+		int offset = LayoutRandomStream.RandRange(MinBasicRoadOffset, MaxBasicRoadOffset);
 		// Min and max coordinates across the width of the road
 		int currRoadMinGeneratedCoord = LastRoadIndex + offset;
 		int currRoadMaxGeneratedCoord = currRoadMinGeneratedCoord + (roadCoord.RoadWidth - 1);
@@ -362,247 +490,379 @@ void AGenerator::GenerateRoadsByCoords()
 
 void AGenerator::DrawRoadsMapInArray()
 {
-	// Draw all roads into array
+	GENERATION_LLM_SCOPE(WorldGrid);
+
+	// Draw all roads, blocks and buildings into array
 	RoadGenDebugValues.IntersectionsAmount = 0;
-	// UE_LOG(LogGeneration, Warning, TEXT("AGenerator::DrawRoadsMapInArray(): "));
-	
-	for(int x = 0; x < XRoadPointsArray.Num(); x++)
-		for(int y = 0; y < YRoadPointsArray.Num(); y++)
-		{
-			FIntVector currPoint = FIntVector(XRoadPointsArray[x].coord, YRoadPointsArray[y].coord, 0);
-			FIntVector endPoint = currPoint + FIntVector(XRoadPointsArray[x].RoadWidth - 1, YRoadPointsArray[y].RoadWidth - 1, 0);
 
-			for(int xx = currPoint.X; xx <= endPoint.X; xx++)
-			{
-				for(int yy = currPoint.Y; yy <= endPoint.Y; yy++)
-				{
-					DrawArrayElementBasicRoad(yy, xx, ETileType::ETT_Road_Crossroads);
-				}
-			}
-		}
-	
 	for(int i = 0; i < Roads.Num(); i++)
 	{
-		DrawRoadInArray(Roads[i]);
+		CheckRoadInArrayBounds(Roads[i]);
 	}
-	// UE_LOG(LogGeneration, Warning, TEXT("AGenerator::DrawRoadsMapInArray(): END"));
 
-	for(int i = 0; i < Blocks.Num(); i++)
+	FIntPoint StartCityCoord;
+	FIntPoint EndCityCoord;
+	GetCityArea(StartCityCoord, EndCityCoord);
+	
+	LayoutIndex.Build(FIntPoint(WorldArray->Bounds.X, WorldArray->Bounds.Y), StartCityCoord, EndCityCoord,
+		XRoadPointsArray, YRoadPointsArray, Roads, Blocks);
+	// Only WFC reads the dense planes, and only the slabs it solves - they are drawn span by span.
+	// Everything else asks LayoutIndex for single elements
+	const int32 NumSolvedSlabs = bUseWFC && WFCGenerator ? WFCGenerator->GetSolvedBounds(WorldArray).Z : 0;
+	FWorldGridRasterizer Rasterizer(*WorldArray);
+	Rasterizer.Rasterize(StartCityCoord, EndCityCoord, XRoadPointsArray, YRoadPointsArray, Roads, Blocks, NumSolvedSlabs);
+	GenerationMemory::Set(EGenerationMemoryTag::WorldGrid, WorldArray->GetAllocatedSize() + LayoutIndex.GetAllocatedSize());
+
+	// Drawing every slab costs more than filling it on big maps: only with "log LogRoadGeneration Verbose"
+	if(UE_LOG_ACTIVE(LogRoadGeneration, Verbose) && WorldArray->Bounds.X <= MaxLoggedSliceSize && WorldArray->Bounds.Y <= MaxLoggedSliceSize)
 	{
-		DrawBlockInArray(Blocks[i]);
+		for(int z = 0; z < WorldArray->Bounds.Z; z++)
+		{
+			LogDrawArray2DSlice(z);
+		}
 	}
+}
 
-	Draw3DItemsInArray();
-
-	for(int z = 0; z < WorldArray->Bounds.Z; z++)
+void AGenerator::AssignBuildingColours()
+{
+	const TArray<ETileColorTag> Colours = GetBuildingColours();
+	if(Colours.Num() == 0)
 	{
-		LogDrawArray2DSlice(z);
+		UE_LOG(LogGeneration, Display, TEXT("AGenerator::AssignBuildingColours - building tiles have no common colour, colours are left to WFC"));
+		return;
 	}
-}
 
-void AGenerator::DrawRoadInArray(FRoad Road)
-{
-	CheckRoadInArrayBounds(Road);
+	// Palette of a colour: 01_A..01_F -> 0, 02_A..02_F -> 1...
+	auto GetPalette = [](ETileColorTag Colour)
+	{
+		return Colour <= ETileColorTag::ETCT_04_F ? ((int32)Colour - 1) / 6 : (int32)Colour;
+	};
 
-	ETileType BaseRoadType = ETileType::ETT_Road;
-		
-	if(Road.bDirectedAlongX)
+	FRandomStream ColourRandomStream(CurrentSeed);
+	TArray<ETileColorTag> PaletteColours;
+	for(const FBlock& Block : Blocks)
 	{
-		for(int i = Road.StartPoint.Y; i <= Road.EndPoint.Y; i++)
+		const ETileColorTag BuildingColour = Colours[ColourRandomStream.RandHelper(Colours.Num())];
+
+		PaletteColours.Reset();
+		for(ETileColorTag Colour : Colours)
 		{
+			if(GetPalette(Colour) == GetPalette(BuildingColour))
 			{
-				for(int j = 0; j < Road.RoadWidth; j++)
-				{
-					ETileType currentType = BaseRoadType;
-					DrawArrayElementBasicRoad(i, Road.StartPoint.X + j, currentType);
-				}
+				PaletteColours.Add(Colour);
 			}
 		}
-	}
-	else
-	{
-		// Road directed along Y
-		for(int i = Road.StartPoint.X; i <= Road.EndPoint.X; i++)
+		
+		// Same rectangle as the building floor of FWorldLayoutIndex
+		const FIntPoint Min(Block.StartCorner.X + 1, Block.StartCorner.Y + 1);
+		const FIntPoint Max(Block.EndCorner.X - 1, Block.EndCorner.Y - 1);
+		if(bVerticallyConsistentColoursInBld)
 		{
-			for(int j = 0; j < Road.RoadWidth; j++)
+			for(int32 z = 1; z < WorldArray->NumFilledSlabs; z++)
 			{
-				ETileType currentType = BaseRoadType;
-				DrawArrayElementBasicRoad(Road.StartPoint.Y + j, i, currentType);
+				WorldArray->FillColorRect(z, Min, Max, BuildingColour);
+			}
+			continue;
+		}
+
+		// Each vertical column of the building takes its own colour of the palette, and keeps it on all its floors
+		for(int32 y = Min.Y; y <= Max.Y; y++)
+		{
+			for(int32 x = Min.X; x <= Max.X; x++)
+			{
+				const ETileColorTag ColumnColour = PaletteColours[ColourRandomStream.RandHelper(PaletteColours.Num())];
+				for(int32 z = 1; z < WorldArray->NumFilledSlabs; z++)
+				{
+					WorldArray->FillColorRect(z, FIntPoint(x, y), FIntPoint(x, y), ColumnColour);
+				}
 			}
 		}
 	}
 }
 
-
-void AGenerator::DrawArrayElementBasicRoad(int Y, int X, ETileType RoadType)
+TArray<ETileColorTag> AGenerator::GetBuildingColours() const
 {
-	if(Y > WorldArrayBounds.Y - 1
-	|| X > WorldArrayBounds.X - 1
-	|| Y < 0 || X < 0)
+	TArray<ETileColorTag> Colours;
+	ATileRegistry* reg = WFCGenerator ? WFCGenerator->GetTileRegistryActor() : nullptr;
+	if(!reg)
+		return Colours;
+
+	const FWFCCompiledRules& Rules = reg->GetCompiledRules();
+	const FWFCBitsetKernelTable& Kernels = WFCBitsetKernels::Get();
+	const TArray<ETileType> BuildingTags = {
+		ETileType::ETT_Building_Door_Corner,
+		ETileType::ETT_Building_Door_Section,
+		ETileType::ETT_Building_Window_Corner,
+		ETileType::ETT_Building_Window_Section,
+		ETileType::ETT_Building_Greeble_Cube };
+
+	TArray<uint64> Candidates;
+	Candidates.SetNumUninitialized(Rules.NumWords);
+	for(int32 Colour = 1; Colour < (int32)ETileColorTag::ETCT_MAX; Colour++)
 	{
-		UE_LOG(LogRoadGeneration, Error, TEXT("AGenerator::DrawArrayElementBasicRoad ERROR: Invalid input coord! /nInput: X:%d, Y:%d;/nWorld: X:%d, Y:%d."),
-			X, Y, WorldArrayBounds.X, WorldArrayBounds.Y);
+		const uint64* ColourDomain = Rules.GetColorDomain((ETileColorTag)Colour);
+		bool bFitsAllTags = true;
+		bool bHasOwnTiles = false;
+		for(ETileType Tag : BuildingTags)
+		{
+			const uint64* TagDomain = Rules.GetTagDomain(Tag);
+			if(Kernels.PopCount(TagDomain, Rules.NumWords) == 0)
+				continue;
 
-		return;
-	}
+			FMemory::Memcpy(Candidates.GetData(), TagDomain, Rules.NumWords * sizeof(uint64));
+			Kernels.AndInto(Candidates.GetData(), ColourDomain, Rules.NumWords);
+			bFitsAllTags &= Kernels.PopCount(Candidates.GetData(), Rules.NumWords) > 0;
+		}
 
-	UWorldArrayItem* Item = WorldArray->GetElement(0, Y, X);
-	if(!Item)
-	{
-		Item = NewObject<UWorldArrayItem>();
+		// Colour made only of indifferent tiles is no colour
+		WFCBitsetKernels::ForEachSetBit(ColourDomain, Rules.NumWords, [&](int32 Variant)
+		{
+			// Rows without an instance have no colour of their own
+			const ATile* TileInstance = reg->RegistryArray[Rules.Variants[Variant].TileIndexInRegister].TileInstance;
+			if(!TileInstance)
+				return;
+
+			bHasOwnTiles |= TileInstance->GetColorTag() == (ETileColorTag)Colour
+				&& BuildingTags.Contains(Rules.VariantTags[Variant]);
+		});
+
+		if(bFitsAllTags && bHasOwnTiles)
+		{
+			Colours.Add((ETileColorTag)Colour);
+		}
 	}
+	return Colours;
+}
 
-	if(Item->TileType != ETileType::ETT_Road_Crossroads)
+void AGenerator::AssignBuildingHeights()
+{
+	FRandomStream HeightRandomStream((int32)HashCombine(GetTypeHash(CurrentSeed), GetTypeHash(DesirableCityHeight)));
+	
+	BuildingHeights.SetNumUninitialized(Blocks.Num());
+	for(int32 BlockIndex = 0; BlockIndex < Blocks.Num(); BlockIndex++)
 	{
-		Item->SetType(RoadType);
+		// Ground and door floor at least
+		BuildingHeights[BlockIndex] = FMath::Max(2,
+			DesirableCityHeight + HeightRandomStream.RandRange(-CityHeightRandomRange, CityHeightRandomRange));
 	}
-	
-	WorldArray->SetElement(0, Y, X, Item);
 }
 
-void AGenerator::DrawBlockInArray(FBlock Block)
+void AGenerator::BuildWorldColumns(UWorldItem3DArray* Array)
 {
-	for(int x = Block.StartCorner.X; x <= Block.EndCorner.X; x++)
+	GENERATION_LLM_SCOPE(WorldGrid);
+
+	const FWFCCompiledRules& Rules = WFCGenerator->GetTileRegistryActor()->GetCompiledRules();
+	const FIntVector Bounds = Array->Bounds;
+	const int32 SlabSize = Bounds.Y * Bounds.X;
+	// Floors above the solved ones have no tiles, the top solved floor is the template of upper floors
+	const int32 SolvedHeight = WFCGenerator->GetSolvedBounds(Array).Z;
+	const int32 TopZ = SolvedHeight - 1;
+	int32 NumWithoutTemplate = 0;
+
+	// Height of the building of each column, INDEX_NONE out of buildings
+	TArray<int32> ColumnHeights;
+	ColumnHeights.Init(INDEX_NONE, SlabSize);
+	
+	for(int32 BlockIndex = 0; BlockIndex < Blocks.Num(); BlockIndex++)
 	{
-		for(int y = Block.StartCorner.Y; y <= Block.EndCorner.Y; y++)
+		const FBlock& Block = Blocks[BlockIndex];
+		// Same rectangle as the building floor of FWorldLayoutIndex
+		const FIntPoint Min(FMath::Max(Block.StartCorner.X + 1, 0), FMath::Max(Block.StartCorner.Y + 1, 0));
+		const FIntPoint Max(FMath::Min(Block.EndCorner.X - 1, Bounds.X - 1), FMath::Min(Block.EndCorner.Y - 1, Bounds.Y - 1));
+		int32 Height = BuildingHeights.IsValidIndex(BlockIndex) ? BuildingHeights[BlockIndex] : SolvedHeight;
+
+		// Upper floors repeat the top solved floor - it has to be a window floor which fits on top of itself
+		if(Height > SolvedHeight && SolvedHeight < BuildingTemplateHeight)
 		{
-			UWorldArrayItem* Item = NewObject<UWorldArrayItem>();
-			if(x == Block.StartCorner.X && y == Block.StartCorner.Y
-				|| x == Block.StartCorner.X && y == Block.EndCorner.Y
-				|| x == Block.EndCorner.X && y == Block.StartCorner.Y
-				|| x == Block.EndCorner.X && y == Block.EndCorner.Y
-			)
+			NumWithoutTemplate++;
+			Height = SolvedHeight;
+		}
+		else if(Height > SolvedHeight)
+		{
+			bool bStackable = true;
+			for(int32 y = Min.Y; y <= Max.Y && bStackable; y++)
 			{
-				Item->SetType(ETileType::ETT_Sidewalks_Corner);
+				for(int32 x = Min.X; x <= Max.X && bStackable; x++)
+				{
+					const int32 Variant = Array->SolvedVariants[TopZ * SlabSize + y * Bounds.X + x];
+					bStackable = Variant != INDEX_NONE
+						&& WFCBitsetKernels::TestBit(Rules.GetCompatible(Variant, (int32)ETileCompatibilityDeltaPosition::ETDP_OnTop), Variant);
+				}
 			}
-			else if(x == Block.StartCorner.X || x == Block.EndCorner.X || y == Block.StartCorner.Y || y == Block.EndCorner.Y)
+
+			if(!bStackable)
 			{
-				Item->SetType(ETileType::ETT_Sidewalks_Borderline);
+				UE_LOG(LogGeneration, Log, TEXT("AGenerator::BuildWorldColumns - top floor of block %d can't be repeated, the building stays %d high"),
+					BlockIndex, SolvedHeight);
+				Height = SolvedHeight;
 			}
-			else
+		}
+
+		for(int32 y = Min.Y; y <= Max.Y; y++)
+		{
+			for(int32 x = Min.X; x <= Max.X; x++)
 			{
-				Item->SetType(ETileType::ETT_Sidewalks_Inner);
+				ColumnHeights[y * Bounds.X + x] = Height;
 			}
-			// Superposition array is set after the full map generation
-			WorldArray->SetElement(0, y, x, Item);
 		}
 	}
+
+	if(NumWithoutTemplate > 0)
+	{
+		UE_LOG(LogGeneration, Warning, TEXT("AGenerator::BuildWorldColumns - %d buildings stay %d high: WFC solves %d floors (bDebugWFCOnlyFloor: %d), the template of upper floors needs %d"),
+			NumWithoutTemplate, SolvedHeight, SolvedHeight, WFCGenerator->bDebugWFCOnlyFloor, BuildingTemplateHeight);
+	}
+
+	FWorldColumnRuns& Columns = Array->Columns;
+	Columns.Reset(FIntPoint(Bounds.X, Bounds.Y));
+	for(int32 y = 0; y < Bounds.Y; y++)
+	{
+		for(int32 x = 0; x < Bounds.X; x++)
+		{
+			const int32 Column = y * Bounds.X + x;
+			const int32 Height = ColumnHeights[Column] != INDEX_NONE ? ColumnHeights[Column] : SolvedHeight;
 			
+			for(int32 z = 0; z < FMath::Min(Height, SolvedHeight); z++)
+			{
+				const int32 LinearIndex = z * SlabSize + Column;
+				Columns.Append(x, y, Array->TileTypes[LinearIndex], Array->SolvedVariants[LinearIndex],
+					z == TopZ ? Height - TopZ : 1);
+			}
+		}
+	}
+	Columns.Finish();
+	GridRaycast.Build(Columns, GetGridSpace());
+	GenerationMemory::Set(EGenerationMemoryTag::WorldGrid,
+		Array->GetAllocatedSize() + LayoutIndex.GetAllocatedSize() + GridRaycast.GetAllocatedSize());
+
+	UE_LOG(LogGeneration, Display, TEXT("AGenerator::BuildWorldColumns - %d runs, max height %d, %llu KB (dense: %llu KB)"),
+		Columns.GetNumRuns(), Columns.GetMaxHeight(), (uint64)Columns.GetAllocatedSize() / 1024,
+		(uint64)SlabSize * Columns.GetMaxHeight() * (sizeof(ETileType) + sizeof(int32)) / 1024);
 }
 
-void AGenerator::Draw3DItemsInArray()
+void AGenerator::BuildCityChunks(UWorldItem3DArray* Array)
 {
-	FIntVector start, end;
-	
-	start.X = XRoadPointsArray[0].coord;
-	start.Y = YRoadPointsArray[0].coord;
-	start.Z = 1;
-	end.X = XRoadPointsArray[XRoadPointsArray.Num()-1].coord + XRoadPointsArray[XRoadPointsArray.Num()-1].RoadWidth - 1;
-	end.Y = YRoadPointsArray[YRoadPointsArray.Num()-1].coord + YRoadPointsArray[YRoadPointsArray.Num()-1].RoadWidth - 1;
-	end.Z = WorldArrayBounds.Z - 1;
-	
-	// Setup everything as Air
-	for(int z = start.Z; z <= end.Z; z++)
+	const FWorldColumnRuns& Columns = Array->Columns;
+	const FIntPoint Footprint = Columns.GetFootprint();
+	const FIntPoint NumChunks(
+		(Footprint.X + CityChunkSize - 1) / CityChunkSize,
+		(Footprint.Y + CityChunkSize - 1) / CityChunkSize);
+
+	// Other layout of chunks - nothing to keep
+	if(NumChunks != NumCityChunks)
 	{
-		for(int y = start.Y; y <= end.Y; y++)
-		{	
-			for(int x = start.X; x <= end.X; x++)
+		for(UCityChunkComponent* Chunk : CityChunks)
+		{
+			if(Chunk)
 			{
-				UWorldArrayItem* Air = NewObject<UWorldArrayItem>();
-				Air->SetType(ETileType::ETT_Air);
-			
-				WorldArray->SetElement(z, y, x, Air);
+				Chunk->DestroyComponent();
 			}
 		}
+		CityChunks.Reset();
+		NumCityChunks = NumChunks;
 	}
 
-	// Setup inner area of each block as Building
-	for(int b = 0; b < Blocks.Num(); b++)
+	const FCityGridSpace GridSpace = GetLocalGridSpace();
+	int32 NumRebuilt = 0;
+	for(int32 ChunkY = 0; ChunkY < NumChunks.Y; ChunkY++)
 	{
-		for(int z = 1; z < WorldArray->Bounds.Z; z++)
+		for(int32 ChunkX = 0; ChunkX < NumChunks.X; ChunkX++)
 		{
-			for(int y = Blocks[b].StartCorner.Y+1; y <= Blocks[b].EndCorner.Y-1; y++)
-			{	
-				for(int x = Blocks[b].StartCorner.X+1; x <= Blocks[b].EndCorner.X-1; x++)
-				{
-					ETileType currType = ETileType::ETT_Building;
-					if(x == Blocks[b].StartCorner.X+1 && y == Blocks[b].StartCorner.Y+1
-						|| x == Blocks[b].EndCorner.X-1 && y == Blocks[b].StartCorner.Y+1
-						|| x == Blocks[b].StartCorner.X+1 && y == Blocks[b].EndCorner.Y-1
-						|| x == Blocks[b].EndCorner.X-1 && y == Blocks[b].EndCorner.Y-1
-						)
-					{
-						// current is corner of building block
-						
-						if(z == 1)
-							currType = ETileType::ETT_Building_Door_Corner;
-						else
-							currType = ETileType::ETT_Building_Window_Corner;
-					}
-					else
-					{
-						// not any corner => check for border
-						if(x == Blocks[b].StartCorner.X+1
-							|| x == Blocks[b].EndCorner.X-1
-							|| y == Blocks[b].StartCorner.Y+1
-							|| y == Blocks[b].EndCorner.Y-1
-							)
-						{
-							if(z == 1)
-								currType = ETileType::ETT_Building_Door_Section;
-							else
-								currType = ETileType::ETT_Building_Window_Section;
-						}
-						else
-						{
-							// not corner, not border => inside of block
-							currType = ETileType::ETT_Building_Greeble_Cube;
-						}
-					}
-					
-					UWorldArrayItem* Building = NewObject<UWorldArrayItem>();
-					Building->SetType(currType);
-			
-					WorldArray->SetElement(z, y, x, Building);
-				}
+			const int32 ChunkIndex = ChunkY * NumChunks.X + ChunkX;
+			if(!CityChunks.IsValidIndex(ChunkIndex))
+			{
+				// Destroyed chunks of the previous layout may still hold their names until garbage collection
+				const FName ChunkName = MakeUniqueObjectName(this, UCityChunkComponent::StaticClass(), *FString::Printf(TEXT("CityChunk_%d_%d"), ChunkX, ChunkY));
+				UCityChunkComponent* NewChunk = NewObject<UCityChunkComponent>(this, ChunkName);
+				NewChunk->SetupAttachment(RootComponent);
+				CityChunks.Add(NewChunk);
+			}
+			UCityChunkComponent* Chunk = CityChunks[ChunkIndex];
+			Chunk->SetCanEverAffectNavigation(bBuildGridNavigation);
+			Chunk->SetCollisionProfileName(bBuildGridCollision
+				? UCollisionProfile::BlockAll_ProfileName
+				: UCollisionProfile::NoCollision_ProfileName);
+
+			const FIntPoint ChunkMin(ChunkX * CityChunkSize, ChunkY * CityChunkSize);
+			const FIntPoint ChunkMax(FMath::Min(ChunkMin.X + CityChunkSize, Footprint.X), FMath::Min(ChunkMin.Y + CityChunkSize, Footprint.Y));
+			if(Chunk->Build(Columns, ChunkMin, ChunkMax, GridSpace))
+			{
+				NumRebuilt++;
+			}
+
+			// Registration adds the chunk to the navigation octree
+			if(!Chunk->IsRegistered())
+			{
+				Chunk->RegisterComponent();
 			}
 		}
 	}
+
+	UE_LOG(LogGeneration, Display, TEXT("AGenerator::BuildCityChunks - %d of %d chunks changed"), NumRebuilt, CityChunks.Num());
 }
 
-void AGenerator::DrawArrayElementEmpty(int Z, int Y, int X)
+void AGenerator::BuildVisibilitySets(UWorldItem3DArray* Array)
 {
-	if(Y > WorldArrayBounds.Y - 1
-	|| X > WorldArrayBounds.X - 1
-	|| Y < 0 || X < 0)
+	TArray<FIntRect> BlockRects;
+	BlockRects.Reserve(Blocks.Num());
+	for(const FBlock& Block : Blocks)
 	{
-		UE_LOG(LogRoadGeneration, Error, TEXT("AGenerator::DrawArrayElementEmpty ERROR: Invalid input coord! /nInput: X:%d, Y:%d;/nWorld: X:%d, Y:%d."),
-			X, Y, WorldArrayBounds.X, WorldArrayBounds.Y);
-
-		return;
+		// Same rectangle as the building floor of FWorldLayoutIndex
+		BlockRects.Add(FIntRect(
+			FIntPoint(Block.StartCorner.X + 1, Block.StartCorner.Y + 1),
+			FIntPoint(Block.EndCorner.X, Block.EndCorner.Y)));
 	}
-	
-	UWorldArrayItem* Item = NewObject<UWorldArrayItem>();
-	// Item->SetParams(ETileType::ETT_Undefined, TArray<FWorldArrayWFCSuperpositionElement> {});
-	Item->SetType(ETileType::ETT_Undefined);
-			
-	WorldArray->SetElement(Z, Y, X, Item);
+	VisibilitySets.Build(Array->Columns, BlockRects, VisibilityEyeHeight);
 }
 
-void AGenerator::DrawArrayEmpty()
+void AGenerator::UpdateVisibleBlocks()
 {
-	for(int z = 0; z < WorldArrayBounds.Z; z++)
+	const APlayerCameraManager* Camera = UGameplayStatics::GetPlayerCameraManager(this, 0);
+	if(!Camera)
+	{
+		return;
+	}
+
+	// Sets are made for the eye near the ground: a higher camera gets no set
+	const FVector ViewCells = GetGridSpace().LocationToCells(Camera->GetCameraLocation());
+	const bool bNearGround = ViewCells.Z < VisibilityEyeHeight;
+	const FIntPoint ViewCell = bNearGround
+		? FIntPoint(FMath::FloorToInt(ViewCells.X), FMath::FloorToInt(ViewCells.Y))
+		: FIntPoint(MAX_int32, MAX_int32);
+	if(ViewCell == LastViewCell)
+	{
+		return;
+	}
+	LastViewCell = ViewCell;
+
+	// Inside a block or out of the city - no set, show everything
+	const bool bHasSet = VisibilitySets.HasVisibleSet(ViewCell.X, ViewCell.Y);
+	for(int32 Block = 0; Block < BlockTiles.Num(); Block++)
 	{
-		for(int y = 0; y < WorldArrayBounds.Y; y++)
-		{	
-			for(int x = 0; x < WorldArrayBounds.X; x++)
+		const bool bVisible = !bHasSet || VisibilitySets.IsBlockVisible(ViewCell.X, ViewCell.Y, Block);
+		if(bVisible == BlockVisible[Block])
+		{
+			continue;
+		}
+		BlockVisible[Block] = bVisible;
+		for(ATile* Tile : BlockTiles[Block])
+		{
+			if(Tile)
 			{
-				DrawArrayElementEmpty(z, y, x);
+				Tile->SetActorHiddenInGame(!bVisible);
 			}
 		}
 	}
 }
 
+void AGenerator::GetCityArea(FIntPoint& OutStart, FIntPoint& OutEnd) const
+{
+	OutStart.X = XRoadPointsArray[0].coord;
+	OutStart.Y = YRoadPointsArray[0].coord;
+	OutEnd.X = XRoadPointsArray[XRoadPointsArray.Num()-1].coord + XRoadPointsArray[XRoadPointsArray.Num()-1].RoadWidth - 1;
+	OutEnd.Y = YRoadPointsArray[YRoadPointsArray.Num()-1].coord + YRoadPointsArray[YRoadPointsArray.Num()-1].RoadWidth - 1;
+}
+
 
 int AGenerator::RoundUp(int numToRound, int multiple) const
 {
@@ -644,6 +904,14 @@ void AGenerator::ValidateWorldArrayBounds()
 	{
 		WorldArrayBounds.Z = MinimumGeneratedArea.Z;
 	}
+
+	// Buildings higher than the array repeat its top floor, so the array has to hold the whole template
+	if(DesirableCityHeight + CityHeightRandomRange > WorldArrayBounds.Z && WorldArrayBounds.Z < BuildingTemplateHeight)
+	{
+		UE_LOG(LogGeneration, Warning, TEXT("AGenerator::ValidateWorldArrayBounds - WorldArrayBounds.Z %d can't hold the template of buildings %d floors high, raised to %d"),
+			WorldArrayBounds.Z, DesirableCityHeight + CityHeightRandomRange, BuildingTemplateHeight);
+		WorldArrayBounds.Z = BuildingTemplateHeight;
+	}
 }
 
 void AGenerator::CheckRoadInArrayBounds(FRoad Road) const
@@ -750,6 +1018,7 @@ void AGenerator::LogDrawArray2DSlice(int32 ZLevel)
 	for(int y = 0; y < WorldArrayBounds.Y; y++)
 	{
 		FString curr = "";
+		curr.Reserve(WorldArrayBounds.X + 8);
 
 		// Show Y coordinate
 		if(y <= 9)
@@ -761,7 +1030,7 @@ void AGenerator::LogDrawArray2DSlice(int32 ZLevel)
 		
 		for(int x = 0; x < WorldArrayBounds.X; x++)
 		{
-			ETileType Element = WorldArray->GetElement(ZLevel, y, x)->TileType;
+			ETileType Element = LayoutIndex.GetTileType(x, y, ZLevel);
 			FString addedString;
 			addedString = GetLogSymbolByTileType(Element);
 			
@@ -773,97 +1042,300 @@ void AGenerator::LogDrawArray2DSlice(int32 ZLevel)
 	// The top line shown in log is the oldest one
 	for(int i = 0; i < lines.Num(); i++)
 	{
-		UE_LOG(LogRoadGeneration, Log, TEXT("%s"), *lines[i]);
+		UE_LOG(LogRoadGeneration, Verbose, TEXT("%s"), *lines[i]);
+	}
+}
+
+bool AGenerator::ExportImages(const FString& Directory) const
+{
+	if(!WorldArray)
+		return false;
+
+	const TCHAR* Extension = bExportImagesAsPNG ? TEXT("png") : TEXT("ppm");
+	FWorldImage Image;
+	bool bSaved = true;
+
+	WorldImageExport::DrawLayout(LayoutIndex, Image);
+	bSaved &= WorldImageExport::SaveImage(Image, FPaths::Combine(Directory, FString::Printf(TEXT("Layout.%s"), Extension)));
+
+	for(int32 z = 0; z < WorldArray->Bounds.Z; z++)
+	{
+		WorldImageExport::DrawSlice(LayoutIndex, z, Image);
+		bSaved &= WorldImageExport::SaveImage(Image, FPaths::Combine(Directory, FString::Printf(TEXT("Slice_Z%d.%s"), z, Extension)));
+	}
+
+	// Entropy of the candidates the solver starts from - pruned by the layout the same way
+	// Only the slabs of the dense grid take part in WFC
+	ATileRegistry* Registry = WFCGenerator ? WFCGenerator->GetTileRegistryActor() : nullptr;
+	if(Registry && WorldArray->NumFilledSlabs > 0)
+	{
+		const FWFCCompiledRules& Rules = Registry->GetCompiledRules();
+		const FIntVector FilledBounds(WorldArray->Bounds.X, WorldArray->Bounds.Y, WorldArray->NumFilledSlabs);
+		TArray<uint64> TagDomains;
+		WFCRuleAnalysis::PruneTagDomains(Rules, WFCRuleAnalysis::GetTagAdjacency(WorldArray->TileTypes, FilledBounds), TagDomains);
+
+		TArray<float> Entropy;
+		for(int32 z = 0; z < FilledBounds.Z; z++)
+		{
+			WorldImageExport::GetInitialEntropy(Rules, TagDomains, *WorldArray, z, Entropy);
+			WorldImageExport::DrawHeatmap(Entropy, WorldArray->Bounds.X, WorldArray->Bounds.Y, Image);
+			bSaved &= WorldImageExport::SaveImage(Image, FPaths::Combine(Directory, FString::Printf(TEXT("Entropy_Z%d.%s"), z, Extension)));
+		}
 	}
+	return bSaved;
 }
 
-void AGenerator::SpawnWorldScene(TArray<UWorldArrayItem*> Array, FIntVector Bounds)
+void AGenerator::SpawnWorldScene(UWorldItem3DArray* Array)
 {
+	GENERATION_LLM_SCOPE(SpawnedTiles);
+
+	ATileRegistry* reg = WFCGenerator->GetTileRegistryActor();
+
+	// Variants of symmetric tiles stand for several rotations which look the same - pick one of them
+	FRandomStream SpawnRandomStream(CurrentSeed);
+
+	// Lists of tiles keep their allocations from the previous city
+	BlockTiles.SetNum(VisibilitySets.GetNumBlocks());
+	for(TArray<ATile*>& Tiles : BlockTiles)
+	{
+		Tiles.Reset();
+	}
+	BlockVisible.Init(true, VisibilitySets.GetNumBlocks());
+	LastViewCell = FIntPoint(INDEX_NONE, INDEX_NONE);
+	ColumnTiles.SetNum(Array->Bounds.X * Array->Bounds.Y);
+	for(TArray<ATile*>& Tiles : ColumnTiles)
+	{
+		Tiles.Reset();
+	}
+	
+	for(int y = 0; y < Array->Bounds.Y; y++)
+	{
+		for(int x = 0; x < Array->Bounds.X; x++)
+		{
+			SpawnBuildingBlockColumn(Array, x, y, reg, SpawnRandomStream);
+		}
+	}
+
+	int32 NumReused;
+	int32 NumSpawned;
+	TilePool.GetAndResetCounters(NumReused, NumSpawned);
+	const int32 NumTrimmed = TilePool.Trim(MaxPooledTiles);
+	UE_LOG(LogGeneration, Display, TEXT("AGenerator::SpawnWorldScene - %d tiles taken from the pool, %d spawned, %d left in the pool, %d destroyed"),
+		NumReused, NumSpawned, TilePool.Num(), NumTrimmed);
+	GenerationMemory::Set(EGenerationMemoryTag::SpawnedTiles, GetSpawnedTilesSize());
+}
+
+void AGenerator::OnTileRulesChanged(const TBitArray<>& ChangedVariants)
+{
+	if(!bUseWFC || !WFCGenerator || !WorldArray || WorldArray->SolvedVariants.Num() == 0)
+		return;
+
+	const double StartTime = FPlatformTime::Seconds();
+	const FWorldColumnRuns OldColumns = WorldArray->Columns;
+	if(!WFCGenerator->Resolve(WorldArray, CurrentSeed, ChangedVariants))
+	{
+		UE_LOG(LogGeneration, Error, TEXT("AGenerator::OnTileRulesChanged - WFC can't solve the city with the new rules!"));
+		return;
+	}
+
+	// Heights of buildings depend on their top floors, so chunks and visibility may change too
+	BuildWorldColumns(WorldArray);
+	if(bBuildGridNavigation || bBuildGridCollision)
+	{
+		BuildCityChunks(WorldArray);
+	}
+	VisibilitySets.Reset();
+	if(bBuildVisibilitySets)
+	{
+		BuildVisibilitySets(WorldArray);
+	}
+
+	if(!bSpawnScene || ColumnTiles.Num() == 0)
+		return;
+
+	// All the variants are new after a change of the list of tiles - every column is spawned again
+	const FWorldColumnRuns& Columns = WorldArray->Columns;
+	const FIntPoint Footprint = Columns.GetFootprint();
+	TBitArray<> ChangedColumns(ChangedVariants.Num() == 0, Footprint.X * Footprint.Y);
+	for(int32 y = 0; y < Footprint.Y && ChangedVariants.Num() > 0; y++)
+	{
+		for(int32 x = 0; x < Footprint.X; x++)
+		{
+			const TArrayView<const FWorldColumnRun> OldRuns = OldColumns.GetColumn(x, y);
+			const TArrayView<const FWorldColumnRun> NewRuns = Columns.GetColumn(x, y);
+			bool bChanged = OldRuns.Num() != NewRuns.Num();
+			for(int32 Run = 0; Run < NewRuns.Num() && !bChanged; Run++)
+			{
+				bChanged = OldRuns[Run].Variant != NewRuns[Run].Variant || OldRuns[Run].Count != NewRuns[Run].Count;
+			}
+			ChangedColumns[y * Footprint.X + x] = bChanged;
+		}
+	}
+	RespawnColumns(WorldArray, ChangedColumns);
+
+	UE_LOG(LogGeneration, Display, TEXT("AGenerator::OnTileRulesChanged - %d of %d columns spawned again in %.1f ms"),
+		ChangedColumns.CountSetBits(), ChangedColumns.Num(), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+}
+
+void AGenerator::RespawnColumns(UWorldItem3DArray* Array, const TBitArray<>& ChangedColumns)
+{
+	GENERATION_LLM_SCOPE(SpawnedTiles);
+
 	ATileRegistry* reg = WFCGenerator->GetTileRegistryActor();
-	for(int z = 0; z < Bounds.Z; z++)
+	FRandomStream SpawnRandomStream(CurrentSeed);
+
+	TSet<ATile*> DestroyedTiles;
+	for(TConstSetBitIterator<> It(ChangedColumns); It; ++It)
 	{
-		for(int y = 0; y < Bounds.Y; y++)
+		for(ATile* Tile : ColumnTiles[It.GetIndex()])
 		{
-			for(int x = 0; x < Bounds.X; x++)
+			if(bPoolTiles)
+			{
+				TilePool.Release(Tile);
+			}
+			else if(Tile)
 			{
-				int32 LinearIndex = z * Bounds.Y * Bounds.X + y * Bounds.X + x;
-				if(Array[LinearIndex]->bIsChosen
-					&& Array[LinearIndex]->TileType != ETileType::ETT_Air
-					&& Array[LinearIndex]->TileType != ETileType::ETT_NoCity)
+				Tile->Destroy();
+			}
+			DestroyedTiles.Add(Tile);
+		}
+		ColumnTiles[It.GetIndex()].Reset();
+	}
+	GeneratedCity.RemoveAll([&DestroyedTiles](ATile* Tile)
+	{
+		return DestroyedTiles.Contains(Tile);
+	});
+
+	// Blocks of the new visibility sets, everything is shown until the next UpdateVisibleBlocks()
+	BlockTiles.SetNum(VisibilitySets.GetNumBlocks());
+	for(TArray<ATile*>& Tiles : BlockTiles)
+	{
+		Tiles.Reset();
+	}
+	BlockVisible.Init(true, VisibilitySets.GetNumBlocks());
+	LastViewCell = FIntPoint(INDEX_NONE, INDEX_NONE);
+
+	for(int y = 0; y < Array->Bounds.Y; y++)
+	{
+		for(int x = 0; x < Array->Bounds.X; x++)
+		{
+			const int32 Column = y * Array->Bounds.X + x;
+			if(ChangedColumns[Column])
+			{
+				SpawnBuildingBlockColumn(Array, x, y, reg, SpawnRandomStream);
+				continue;
+			}
+
+			const int32 Block = VisibilitySets.GetBlock(x, y);
+			for(ATile* Tile : ColumnTiles[Column])
+			{
+				Tile->SetActorHiddenInGame(false);
+				if(BlockTiles.IsValidIndex(Block))
 				{
-					if(Array[LinearIndex]->PossibleTiles.Num() > 1)
-					{
-						UE_LOG(LogGeneration, Error, TEXT("AGenerator::SpawnWorldScene - Array[LinearIndex]->PossibleTiles.Num() > 1!"));
-					}
-					
-					if(Array[LinearIndex]->PossibleTiles.Num() == 0)
-					{
-						UE_LOG(LogGeneration, Error, TEXT("AGenerator::SpawnWorldScene - Array[LinearIndex]->PossibleTiles.Num() == 0!"));
-						continue;
-					}
-					
-					FVector BaseLocation = GetActorLocation()
-						+ FVector(x * MinTileElementSize.X, y * MinTileElementSize.Y, z * MinTileElementSize.Z);
+					BlockTiles[Block].Add(Tile);
+				}
+			}
+		}
+	}
+	TilePool.Trim(MaxPooledTiles);
+	GenerationMemory::Set(EGenerationMemoryTag::SpawnedTiles, GetSpawnedTilesSize());
+}
 
-					FRotator BaseRotation = FRotator::ZeroRotator;
+SIZE_T AGenerator::GetRoadsAllocatedSize() const
+{
+	return Roads.GetAllocatedSize() + XRoadPointsArray.GetAllocatedSize() + YRoadPointsArray.GetAllocatedSize();
+}
 
-					FTransform BaseTransform = FTransform(BaseRotation, BaseLocation);
-				
-					// Make rotation by array el rotation
-					FTransform MeshInnerTransform = MakeTransformByRotationEnum(Array[LinearIndex]->TileRotation);
-
-					FVector ResultingLocation = BaseLocation + MeshInnerTransform.GetLocation();
-					FQuat ResultingQuatRotation = MeshInnerTransform.GetRotation();
-					FRotator ResultingRotation = ResultingQuatRotation.Rotator();
-					FTransform ResultingTransform = FTransform(ResultingQuatRotation, ResultingLocation);
-
-					// Spawn
-					int32 currTileRegIndex = Array[LinearIndex]->ChosenTileIndex;
-					TSubclassOf<ATile> currTileClass = reg->RegistryArray[currTileRegIndex].Tile;
-					ATile* newTile = GetWorld()->SpawnActor<ATile>(currTileClass, ResultingLocation, ResultingRotation);
-					GeneratedCity.Add(newTile);
+SIZE_T AGenerator::GetSpawnedTilesSize() const
+{
+	SIZE_T Size = GeneratedCity.GetAllocatedSize() + ColumnTiles.GetAllocatedSize();
+	for(const TArray<ATile*>& Column : ColumnTiles)
+	{
+		Size += Column.GetAllocatedSize();
+	}
+	for(const ATile* Tile : GeneratedCity)
+	{
+		if(!Tile)
+			continue;
+
+		Size += Tile->GetClass()->GetStructureSize();
+		for(const UActorComponent* Component : Tile->GetComponents())
+		{
+			Size += Component->GetClass()->GetStructureSize();
+		}
+	}
+	return Size;
+}
+
+void AGenerator::SpawnBuildingBlockColumn(UWorldItem3DArray* Array, int x, int y, ATileRegistry* reg, FRandomStream& SpawnRandomStream)
+{
+	const FWFCCompiledRules& Rules = reg->GetCompiledRules();
+
+	int z = 0;
+	for(const FWorldColumnRun& Run : Array->Columns.GetColumn(x, y))
+	{
+		if(Run.Variant != INDEX_NONE
+			&& Run.Type != ETileType::ETT_Air
+			&& Run.Type != ETileType::ETT_NoCity)
+		{
+			const FWorldArrayWFCSuperpositionElement& Chosen = Rules.Variants[Run.Variant];
+			TSubclassOf<ATile> currTileClass = reg->RegistryArray[Chosen.TileIndexInRegister].Tile;
+
+			// One rotation for the whole run, so repeated floors look the same
+			const TArray<ETileRotation> Rotations = currTileClass.GetDefaultObject()->GetEquivalentRotations(Chosen.Rotation);
+			const ETileRotation SpawnRotation = Rotations.Num() > 0
+				? Rotations[SpawnRandomStream.RandHelper(Rotations.Num())]
+				: Chosen.Rotation;
+			
+			const FCityGridSpace GridSpace = GetGridSpace();
+			for(int RunZ = z; RunZ < z + Run.Count; RunZ++)
+			{
+				const FTransform TileTransform = GridSpace.GetTileTransform(x, y, RunZ, SpawnRotation);
+				const FVector ResultingLocation = TileTransform.GetLocation();
+				const FRotator ResultingRotation = TileTransform.Rotator();
+
+				// Spawn, or take a tile of the previous city
+				bool bSpawned;
+				ATile* newTile = TilePool.Acquire(GetWorld(), currTileClass, ResultingLocation, ResultingRotation, bSpawned);
+				// Pooled tiles too: the settings may have changed since they were spawned
+				ApplyGridSettings(newTile);
+				GeneratedCity.Add(newTile);
+				ColumnTiles[y * Array->Bounds.X + x].Add(newTile);
+				const int32 Block = VisibilitySets.GetBlock(x, y);
+				if(BlockTiles.IsValidIndex(Block))
+				{
+					BlockTiles[Block].Add(newTile);
 				}
 			}
 		}
+		z += Run.Count;
 	}
 }
 
-FTransform AGenerator::MakeTransformByRotationEnum(ETileRotation enumRot)
+void AGenerator::ApplyGridSettings(ATile* Tile) const
 {
-	FRotator Rotation;
-	FVector Location;
-	switch (enumRot)
-	{
-	case ETileRotation::ETR_Undefined:
-		UE_LOG(LogGeneration, Error, TEXT("AGenerator::MakeTransformByRotationEnum - ETileRotation::ETR_Undefined"));
-	case ETileRotation::ETR_Forward:
-		Location = FVector(0);
-		Rotation = FRotator(0);
-		break;
-	case ETileRotation::ETR_Backward:
-		Location = FVector(MinTileElementSize.X, -MinTileElementSize.Y, 0);
-		Rotation = FRotator(0, 180, 0);
-		break;
-	case ETileRotation::ETR_Left:
-		Location = FVector(MinTileElementSize.X, 0, 0);
-		Rotation = FRotator(0, -90, 0);
-		break;
-	case ETileRotation::ETR_Right:
-		Location = FVector(0, -MinTileElementSize.Y, 0);
-		Rotation = FRotator(0, 90, 0);
-		break;
-	}
-
-	FTransform res = FTransform();
-	res.SetScale3D(FVector(1.f));
-	res.SetLocation(Location);
-	res.SetRotation(Rotation.Quaternion());
-
-	return res;
+	if(!bBuildGridNavigation && !bBuildGridCollision)
+		return;
+
+	// Every primitive of the tile, not only its main mesh - blueprints of tiles may add their own
+	TInlineComponentArray<UPrimitiveComponent*> Primitives(Tile);
+	for(UPrimitiveComponent* Primitive : Primitives)
+	{
+		if(bBuildGridNavigation)
+		{
+			Primitive->SetCanEverAffectNavigation(false);
+		}
+		if(bBuildGridCollision)
+		{
+			Primitive->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		}
+	}
 }
 
 void AGenerator::MakeBlocks()
 {
+	GENERATION_LLM_SCOPE(Blocks);
+
 	for(int y = 1; y < YRoadPointsArray.Num(); y++)
 	{
 		for(int x = 1; x < XRoadPointsArray.Num(); x++)
@@ -886,109 +1358,127 @@ void AGenerator::MakeBlocks()
 
 void AGenerator::DivideBlocks()
 {
-	TQueue<FBlock> Queue;
-	ResBlocks.Empty();
+	FGenerationArenaScope ArenaScope(TEXT("DivideBlocks"));
+	GENERATION_LLM_SCOPE(Blocks);
+	
+	ResBlocks.Reset();
 
 	AmountOfSuccessfulCuts = 0;
-	
-	for(int i = 0; i < Blocks.Num(); i++)
+
+	// Each top-level block is divided independently of the others,
+	// so every block is a separate task which writes only into its own result buffer
+	TArray<FBlockDivisionResult> DivisionResults;
+	DivisionResults.SetNum(Blocks.Num());
+
+	ParallelFor(Blocks.Num(), [this, &DivisionResults](int32 BlockIndex)
+	{
+		FBlockDivisionResult& Result = DivisionResults[BlockIndex];
+		Result.RandomStream.Initialize((int32)HashCombine(GetTypeHash(CurrentSeed), GetTypeHash(BlockIndex)));
+		DivideTopLevelBlock(Blocks[BlockIndex], Result);
+	});
+
+	// Results of the tasks live together with the blocks until the end of the stage
+	SIZE_T DivisionSize = DivisionResults.GetAllocatedSize();
+	for(const FBlockDivisionResult& Result : DivisionResults)
 	{
-		Queue.Enqueue(Blocks[i]);
+		DivisionSize += Result.Roads.GetAllocatedSize() + Result.ResBlocks.GetAllocatedSize()
+			+ Result.BlocksNotDivided.GetAllocatedSize() + Result.BlocksNotAttempted.GetAllocatedSize();
 	}
+	GenerationMemory::Add(EGenerationMemoryTag::Blocks, DivisionSize);
 
-	int DebugQueueIsNotEmpty = 0;
-	while(!Queue.IsEmpty())
+	// Merge in order of top-level blocks, so the result doesn't depend on the order in which tasks have finished
+	for(int i = 0; i < DivisionResults.Num(); i++)
 	{
-		DebugQueueIsNotEmpty++;
+		Roads.Append(DivisionResults[i].Roads);
+		ResBlocks.Append(DivisionResults[i].ResBlocks);
+		BlocksNotDivided.Append(DivisionResults[i].BlocksNotDivided);
+		BlocksNotAttempted.Append(DivisionResults[i].BlocksNotAttempted);
+		AmountOfSuccessfulCuts += DivisionResults[i].AmountOfSuccessfulCuts;
+	}
 
-		if(DebugQueueIsNotEmpty >= 10000)
-		{
-			int a = 27;
-			a++;
-			UE_LOG(LogRoadGeneration, Error, TEXT("DivideBlocks - infinite cycle!!!"));
-			break;
-		}
+	if(ResBlocks.Num() != Blocks.Num() + AmountOfSuccessfulCuts)
+	{
+		UE_LOG(LogGeneration, Error,
+			TEXT("ResBlocks.Num(), Blocks.Num(), AmountOfSuccessfulCuts: %d != %d + %d => false"), ResBlocks.Num(), Blocks.Num(), AmountOfSuccessfulCuts);
+		
+	}
+	
+	Blocks = ResBlocks;
+
+	// Peak - the merged blocks together with the results, retained - the merged blocks only
+	const SIZE_T BlocksSize = Blocks.GetAllocatedSize() + ResBlocks.GetAllocatedSize()
+		+ BlocksNotDivided.GetAllocatedSize() + BlocksNotAttempted.GetAllocatedSize();
+	GenerationMemory::Add(EGenerationMemoryTag::Blocks, BlocksSize);
+	GenerationMemory::Set(EGenerationMemoryTag::Blocks, BlocksSize);
+	GenerationMemory::Set(EGenerationMemoryTag::Roads, GetRoadsAllocatedSize());
+}
 
-		FBlock block;
-		if(Queue.Dequeue(block))
+void AGenerator::DivideTopLevelBlock(FBlock TopLevelBlock, FBlockDivisionResult& OutResult) const
+{
+	// FIFO of blocks to divide: PendingBlocks[NextBlock..] are not processed yet
+	// Every successful cut makes strictly smaller blocks, so the cycle always ends - no need for an iterations cap
+	// Lives in the sub-arena of this task - only OutResult leaves it
+	FMemMark Mark(FMemStack::Get());
+	TGenerationArenaArray<FBlock> PendingBlocks;
+	PendingBlocks.Add(TopLevelBlock);
+	int32 NextBlock = 0;
+
+	while(NextBlock < PendingBlocks.Num())
+	{
+		FBlock block = PendingBlocks[NextBlock++];
+
+		// Check if this block should be attempted to be divided at all
+		if(CheckDividableBlockRestrictions(block))
 		{
-			// Check if this block should be attempted to be divided at all
-			if(CheckDividableBlockRestrictions(block))
-			{
-				const bool LongerSideIsX = block.GetBounds().X > block.GetBounds().Y;
+			const bool LongerSideIsX = block.GetBounds().X > block.GetBounds().Y;
 
-				// true => we go from min X to max X to make cuts
-				bool CutAcrossX = !LongerSideIsX;
+			// true => we go from min X to max X to make cuts
+			bool CutAcrossX = !LongerSideIsX;
 
-				// Switch cut side randomly
-				if(FMath::RandRange(1, 100) <= SwitchSideToCutAcrossChance)
-				{
-					CutAcrossX = !CutAcrossX;
-				}
+			// Switch cut side randomly
+			if(OutResult.RandomStream.RandRange(1, 100) <= SwitchSideToCutAcrossChance)
+			{
+				CutAcrossX = !CutAcrossX;
+			}
 
-				bool MadeInnerCut = PerformOffsetCuts(Queue, block, CutAcrossX);
+			bool MadeInnerCut = PerformOffsetCuts(PendingBlocks, block, CutAcrossX, OutResult);
 
-				if(!MadeInnerCut)
-				{
-					// if haven't made any cuts, try another side with a chance to skip
-					// don't allow skipping if the block is too large
-					if(!(FMath::RandRange(1, 100) <= SkipSecondOffsetCutsAttemptChance
-							&& block.GetArea() > MaxBlockAreaToSkipDivision)
-							)
-					{
-						MadeInnerCut = PerformOffsetCuts(Queue, block, !CutAcrossX);
-					}
-				}
-				
-				if(MadeInnerCut)
-				{
-					// successful cut at either side
-					// blocks have been already made and added to Queue, road was already made
-					continue;
-				}
-				else
+			if(!MadeInnerCut)
+			{
+				// if haven't made any cuts, try another side with a chance to skip
+				// don't allow skipping if the block is too large
+				if(!(OutResult.RandomStream.RandRange(1, 100) <= SkipSecondOffsetCutsAttemptChance
+						&& block.GetArea() > MaxBlockAreaToSkipDivision)
+						)
 				{
-					// if can't make a cut on either side
-					// put block into result array
-
-					FBlock notDivided;
-					notDivided.StartCorner = block.StartCorner;
-					notDivided.EndCorner = block.EndCorner;
-					BlocksNotDivided.Add(notDivided);
-										
-					ResBlocks.Add(block);
+					MadeInnerCut = PerformOffsetCuts(PendingBlocks, block, !CutAcrossX, OutResult);
 				}
 			}
-			else
+			
+			if(MadeInnerCut)
 			{
-				// if couldn't even attempt to cut this block, put this block out of the queue, into the resulting blocks array
-				ResBlocks.Add(block);
-
-				FBlock notAttempted;
-				notAttempted.StartCorner = block.StartCorner;
-				notAttempted.EndCorner = block.EndCorner;
-				BlocksNotAttempted.Add(notAttempted);
+				// successful cut at either side
+				// blocks have been already made and added to PendingBlocks, road was already made
+				continue;
 			}
+
+			// if can't make a cut on either side
+			// put block into result array
+			OutResult.BlocksNotDivided.Add(block);
+			OutResult.ResBlocks.Add(block);
 		}
 		else
 		{
-			// can't dequeue
-			break;
+			// if couldn't even attempt to cut this block, put this block out of the queue, into the resulting blocks array
+			OutResult.ResBlocks.Add(block);
+			OutResult.BlocksNotAttempted.Add(block);
 		}
 	}
-	if(ResBlocks.Num() != Blocks.Num() + AmountOfSuccessfulCuts)
-	{
-		UE_LOG(LogGeneration, Error,
-			TEXT("ResBlocks.Num(), Blocks.Num(), AmountOfSuccessfulCuts: %d != %d + %d => false"), ResBlocks.Num(), Blocks.Num(), AmountOfSuccessfulCuts);
-		
-	}
-	
-	Blocks = ResBlocks;
 }
 
-bool AGenerator::PerformOffsetCuts(TQueue<FBlock>& Queue, FBlock blockToCut, bool CutAcrossX)
+bool AGenerator::PerformOffsetCuts(TGenerationArenaArray<FBlock>& PendingBlocks, FBlock blockToCut, bool CutAcrossX, FBlockDivisionResult& OutResult) const
 {
-	TArray<int32> InnerRoadCuts;
+	TGenerationArenaArray<int32> InnerRoadCuts;
 	bool MadeInnerCut = false;
 	// i - moving coordinate of a thin inner road
 	// we calculate offset for roads => i holds a coordinate of road - not of a block corner
@@ -1001,7 +1491,7 @@ bool AGenerator::PerformOffsetCuts(TQueue<FBlock>& Queue, FBlock blockToCut, boo
 	{
 
 		// offset for the next road
-		int32 Offset = FMath::RandRange(MinBlockSide + 1, MaxBlockSide + 1);
+		int32 Offset = OutResult.RandomStream.RandRange(MinBlockSide + 1, MaxBlockSide + 1);
 		int32 NextRoad = currRoad + Offset;
 		if(NextRoad < Bound)
 		{
@@ -1044,13 +1534,13 @@ bool AGenerator::PerformOffsetCuts(TQueue<FBlock>& Queue, FBlock blockToCut, boo
 				// if it's our first attempt to cut => with rand chance, try cutting in half
 				if(currRoad == start)
 				{
-					if(FMath::RandRange(1, 100) <= HalfCutPercent)
+					if(OutResult.RandomStream.RandRange(1, 100) <= HalfCutPercent)
 					{
 						int Width = CutAcrossX ? blockToCut.GetBounds().X : blockToCut.GetBounds().Y;
 						int halfWidth = Width / 2;
 						if(Width % 2 == 1)
 						{
-							if(FMath::RandBool())
+							if(OutResult.RandomStream.RandHelper(2) == 1)
 							{
 								halfWidth++;
 							}
@@ -1092,26 +1582,26 @@ bool AGenerator::PerformOffsetCuts(TQueue<FBlock>& Queue, FBlock blockToCut, boo
 		
 		for(int i = 0; i < InnerRoadCuts.Num(); i++)
 		{
-			TArray<FBlock> blocksAfterDivision;
-			if(PerformOneBlockCut(dividableBlock, blocksAfterDivision, InnerRoadCuts[i], CutAcrossX))
+			TGenerationArenaArray<FBlock> blocksAfterDivision;
+			if(PerformOneBlockCut(dividableBlock, blocksAfterDivision, InnerRoadCuts[i], CutAcrossX, OutResult))
 			{
 				check(blocksAfterDivision.Num() == 0 || blocksAfterDivision.Num() == 2);
 				if(blocksAfterDivision.Num() != 0)
 				{
 					dividableBlock = blocksAfterDivision[1];
-					Queue.Enqueue(blocksAfterDivision[0]);
+					PendingBlocks.Add(blocksAfterDivision[0]);
 					// blocksAfterDivision is created on each iteration - it will not persist on next iteration, no need to empty it
-					AmountOfSuccessfulCuts++; // debug
+					OutResult.AmountOfSuccessfulCuts++; // debug
 				}
 			}
 			// else - we act as current InnerRoadCuts[i] hasn't existed and continue the cycle with the next cut
 		}
 
 		if(CheckValidResultingBlockWithFuturePossibleDivision(dividableBlock.GetBounds().X, dividableBlock.GetBounds().Y))
-			Queue.Enqueue(dividableBlock);
+			PendingBlocks.Add(dividableBlock);
 		else
 		{
-			ResBlocks.Add(dividableBlock);
+			OutResult.ResBlocks.Add(dividableBlock);
 		}
 		InnerRoadCuts.Empty();
 	}
@@ -1123,7 +1613,7 @@ bool AGenerator::PerformOffsetCuts(TQueue<FBlock>& Queue, FBlock blockToCut, boo
 	return MadeInnerCut;
 }
 
-bool AGenerator::PerformOneBlockCut(FBlock block, TArray<FBlock>& OutBlockPair, int32 CutCoord, bool CutAcrossX)
+bool AGenerator::PerformOneBlockCut(FBlock block, TGenerationArenaArray<FBlock>& OutBlockPair, int32 CutCoord, bool CutAcrossX, FBlockDivisionResult& OutResult) const
 {
 	// Make two blocks
 	int32 FirstBlockEndX, FirstBlockEndY, SecondBlockStartX, SecondBlockStartY;
@@ -1194,82 +1684,15 @@ bool AGenerator::PerformOneBlockCut(FBlock block, TArray<FBlock>& OutBlockPair,
 		EndRoadPoint = FIntVector(block.EndCorner.X + 1, CutCoord, block.EndCorner.Z);
 	}
 	innerRoad.Init(StartRoadPoint, EndRoadPoint, InnerRoadWidth, CutAcrossX);
-	Roads.Add(innerRoad);
+	OutResult.Roads.Add(innerRoad);
 
-	UE_LOG(LogGeneration, Warning, TEXT("innerRoad: index in Roads[] = %d"), Roads.Num()-1);
-	UE_LOG(LogGeneration, Warning, TEXT("StartRoadPoint = %d %d %d"), StartRoadPoint.X, StartRoadPoint.Y, StartRoadPoint.Z);
-	UE_LOG(LogGeneration, Warning, TEXT("EndRoadPoint = %d %d %d"), EndRoadPoint.X, EndRoadPoint.Y, EndRoadPoint.Z);
+	UE_LOG(LogGeneration, Verbose, TEXT("innerRoad: StartRoadPoint = %d %d %d; EndRoadPoint = %d %d %d"),
+		StartRoadPoint.X, StartRoadPoint.Y, StartRoadPoint.Z, EndRoadPoint.X, EndRoadPoint.Y, EndRoadPoint.Z);
 	
 	return true;
 }
 
-void AGenerator::FillEmptyCityBorderArea()
-{
-	FIntVector StartCityCoord;
-	FIntVector EndCityCoord;
-
-	StartCityCoord.X = XRoadPointsArray[0].coord;
-	StartCityCoord.Y = YRoadPointsArray[0].coord;
-	EndCityCoord.X = XRoadPointsArray[XRoadPointsArray.Num()-1].coord + XRoadPointsArray[XRoadPointsArray.Num()-1].RoadWidth - 1;
-	EndCityCoord.Y = YRoadPointsArray[YRoadPointsArray.Num()-1].coord + YRoadPointsArray[YRoadPointsArray.Num()-1].RoadWidth - 1;
-
-	ETileType emptyType = ETileType::ETT_NoCity;
-	// ETileType emptyType = ETileType::ETT_Air;
-	// Y start
-	for(int y = 0; y < StartCityCoord.Y; y++)
-	{
-		for(int x = 0; x < WorldArray->Bounds.X; x++)
-		{
-			for(int z = 0; z < WorldArray->Bounds.Z; z++)
-			{
-				UWorldArrayItem* current = WorldArray->GetElement(z, y, x);
-				current->bIsChosen = true;
-				current->TileType = emptyType;
-			}
-		}
-	}
-	// Y end
-	for(int y = EndCityCoord.Y + 1; y < WorldArray->Bounds.Y; y++)
-	{
-		for(int x = 0; x < WorldArray->Bounds.X; x++)
-		{
-			for(int z = 0; z < WorldArray->Bounds.Z; z++)
-			{
-				UWorldArrayItem* current = WorldArray->GetElement(z, y, x);
-				current->bIsChosen = true;
-				current->TileType = emptyType;
-			}
-		}
-	}
-	// X start
-	for(int y = 0; y < WorldArray->Bounds.Y; y++)
-	{
-		for(int x = 0; x < StartCityCoord.X; x++)
-		{
-			for(int z = 0; z < WorldArray->Bounds.Z; z++)
-			{
-				UWorldArrayItem* current = WorldArray->GetElement(z, y, x);
-				current->bIsChosen = true;
-				current->TileType = emptyType;
-			}
-		}
-	}
-	// X end
-	for(int y = 0; y < WorldArray->Bounds.Y; y++)
-	{
-		for(int x = EndCityCoord.X + 1; x < WorldArray->Bounds.X; x++)
-		{
-			for(int z = 0; z < WorldArray->Bounds.Z; z++)
-			{
-				UWorldArrayItem* current = WorldArray->GetElement(z, y, x);
-				current->bIsChosen = true;
-				current->TileType = emptyType;
-			}
-		}
-	}
-}
-
-bool AGenerator::CheckValidResultingBlockRestrictions(FBlock block)
+bool AGenerator::CheckValidResultingBlockRestrictions(FBlock block) const
 {
 	bool TooShortX = FMath::Abs(block.EndCorner.X - block.StartCorner.X + 1) < (MinBlockSide);
 	bool TooShortY = FMath::Abs(block.EndCorner.Y - block.StartCorner.Y + 1) < (MinBlockSide);
@@ -1282,7 +1705,7 @@ bool AGenerator::CheckValidResultingBlockRestrictions(FBlock block)
 	return true;
 }
 
-bool AGenerator::CheckDividableBlockRestrictions(FBlock block)
+bool AGenerator::CheckDividableBlockRestrictions(FBlock block) const
 {
 	bool TooShortX = FMath::Abs(block.EndCorner.X - block.StartCorner.X) < (BlockSideIsTooShortMultiplier * MinBlockSide);
 	bool TooShortY = FMath::Abs(block.EndCorner.Y - block.StartCorner.Y) < (BlockSideIsTooShortMultiplier * MinBlockSide);
@@ -1301,7 +1724,7 @@ bool AGenerator::CheckDividableBlockRestrictions(FBlock block)
 	return true;
 }
 
-bool AGenerator::CheckValidResultingBlockWithFuturePossibleDivision(int32 width, int32 length)
+bool AGenerator::CheckValidResultingBlockWithFuturePossibleDivision(int32 width, int32 length) const
 {
 	if(length < width)
 	{
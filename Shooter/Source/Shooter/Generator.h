@@ -13,7 +13,17 @@
 #include "Road.h"
 #include "RoadBaseCoord.h"
 #include "Block.h"
+#include "BlockDivisionResult.h"
+#include "GenerationArena.h"
 #include "WFCGeneratorComponent.h"
+#include "CityChunkComponent.h"
+#include "CityVisibilitySets.h"
+#include "CityGridRaycast.h"
+#include "CityGridSpace.h"
+#include "CityCrowdComponent.h"
+#include "CityTrafficComponent.h"
+#include "WorldLayoutIndex.h"
+#include "TilePool.h"
 #include "Generator.generated.h"
 
 USTRUCT()
@@ -39,6 +49,14 @@ public:
 	UPROPERTY(VisibleAnywhere, BlueprintReadWrite)
 	UWFCGeneratorComponent* WFCGenerator;
 
+	// Pedestrians on the sidewalks, populated after the scene is spawned
+	UPROPERTY(VisibleAnywhere, BlueprintReadWrite)
+	UCityCrowdComponent* Crowd;
+
+	// Vehicles on the roads, populated after the scene is spawned
+	UPROPERTY(VisibleAnywhere, BlueprintReadWrite)
+	UCityTrafficComponent* Traffic;
+
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite)
 	float BuildingBlockHeight;
 
@@ -51,12 +69,79 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	bool bUseWFC = true;
 
+	// True - one colour per building, false - one colour per vertical column of a building, see AssignBuildingColours()
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	bool bVerticallyConsistentColoursInBld = true;
 
+	// Seed of the whole generation. 0 - pick a random seed on each generation
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 GenerationSeed = 0;
+
+	// False - Generate() only fills WorldArray and spawns no tiles (headless generation of UCityFarmCommandlet)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bSpawnScene = true;
+
+	// Navigation is made from the grid (UCityChunkComponent), spawned tiles don't affect it
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bBuildGridNavigation = true;
+
+	// Collision is made from the grid (UCityChunkComponent): merged boxes per chunk, spawned tiles have no collision
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bBuildGridCollision = true;
+
+	// Computes blocks visible from each street cell after generation and hides the others around the player camera
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bBuildVisibilitySets = true;
+
+	// Highest eye above the ground which visibility sets hold for, in tiles. A higher camera sees every block
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin="0"))
+	float VisibilityEyeHeight = 1.6f;
+
+	// Side of a navigation and collision chunk in tiles. Only chunks which changed since the last generation are rebuilt
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin="1", ClampMax="64"))
+	int32 CityChunkSize = 16;
+
+	// Writes the layout, every Z-slab and the initial entropy of WFC into Saved/CityImages/Seed<N> before WFC
+	// Turned on for headless runs with "bExportImages=True" in a param set of UCityFarmCommandlet
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bExportImages = false;
+
+	// False - binary PPM without compression, which is faster to write than PNG
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bExportImagesAsPNG = true;
+
+	// Tiles of the previous city are hidden and placed again by the next generation instead of being destroyed and spawned
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bPoolTiles = true;
+
+	// Pooled tiles left unused by a generation are destroyed down to this amount, so one big city doesn't keep its tiles forever
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin="0"))
+	int32 MaxPooledTiles = 4096;
+
 	TArray<ATile*> GeneratedCity;
 	
+	// Generates the city of GenerationSeed in place of the current one, see Regenerate()
 	bool Generate();
+
+	// Replaces the current city with the city of Seed (0 - a random seed), e.g. between matches
+	// State of the previous city is reset, but its buffers and grid stay allocated and its tiles go to the pool
+	UFUNCTION(BlueprintCallable)
+	bool Regenerate(int32 Seed);
+
+	FORCEINLINE UWorldItem3DArray* GetWorldArray() const { return WorldArray; }
+	FORCEINLINE int32 GetCurrentSeed() const { return CurrentSeed; }
+	// Types of elements of the whole city without a grid, built with the road map
+	FORCEINLINE const FWorldLayoutIndex& GetLayoutIndex() const { return LayoutIndex; }
+	// Line of sight and hitscan against the grid of the current city, rebuilt with the columns
+	FORCEINLINE const FCityGridRaycast& GetGridRaycast() const { return GridRaycast; }
+
+	// Cells of the city in the world - tiles are spawned there
+	FORCEINLINE FCityGridSpace GetGridSpace() const { return FCityGridSpace(GetActorLocation(), FVector(MinTileElementSize)); }
+	// The same cells relative to the generator, for its components
+	FORCEINLINE FCityGridSpace GetLocalGridSpace() const { return FCityGridSpace(FVector::ZeroVector, FVector(MinTileElementSize)); }
+
+	// Writes Layout, Slice_Z<Z> and Entropy_Z<Z> images of the current WorldArray into Directory. Returns false if any of them failed
+	bool ExportImages(const FString& Directory) const;
 	
 	FRoadGenDebugValues RoadGenDebugValues;
 
@@ -66,11 +151,34 @@ protected:
 
 	bool ValidateInput();
 
+	// Clears everything of the previous generation, keeping the allocations, and releases its tiles into TilePool
+	void ResetGeneration();
+
 	// Macro function - processes all the road map generation from start to finish
 	void GenerateRoadsMap();
 
+	// Builds LayoutIndex from roads and blocks and draws the slabs of WorldArray which WFC solves with FWorldGridRasterizer
 	void DrawRoadsMapInArray();
 
+	// Chooses the colour of each building (block) and writes it into WorldArray->ColorTags,
+	// so WFC gets only tiles of this colour and doesn't have to solve colours
+	// A vertical column always keeps one colour on all its floors. bVerticallyConsistentColoursInBld = true - the whole building
+	// takes one colour, false - each column of the building takes its own colour of the same palette (01, 02...)
+	void AssignBuildingColours();
+
+	// Colours every building tag of the registry has tiles for (or indifferent tiles)
+	TArray<ETileColorTag> GetBuildingColours() const;
+
+	// Chooses the height of each building: DesirableCityHeight +- CityHeightRandomRange. Fills BuildingHeights
+	void AssignBuildingHeights();
+
+	// Compresses the solved planes of Array into Array->Columns. The top solved floor of a building is its template:
+	// it's repeated up to the height of the building, so upper floors take no memory and no WFC
+	void BuildWorldColumns(UWorldItem3DArray* Array);
+
+	// Builds the geometry of CityChunks from Array->Columns. Chunks which haven't changed keep their navmesh tiles and bodies
+	void BuildCityChunks(UWorldItem3DArray* Array);
+
 	// Makes bounds of world generation 3D array - FIntVector WorldArrayBounds
 	void MakeWorldArrayBounds();
 
@@ -90,41 +198,45 @@ protected:
 	// Translates basic road points (X/YRoadPointsArray) into FRoads 
 	void GenerateRoadsByCoords();
 
-	// Sets parameters of array elements which correspond to road 
-	void DrawRoadInArray(FRoad Road);
-
-	// Sets parameters of array elements which correspond to road 
-	void DrawBlockInArray(FBlock Block);
-
-	void Draw3DItemsInArray();
+	// Gets inclusive XY bounds of the city (the area between the first and the last basic roads)
+	void GetCityArea(FIntPoint& OutStart, FIntPoint& OutEnd) const;
 
 	void ValidateWorldArrayBounds();
 
-	// Fills array with empty elements
-	void DrawArrayEmpty();
-	// Sets one element of 3D array as empty
-	void DrawArrayElementEmpty(int Z, int Y, int X);
-	// Sets parameters of one element of 3D array that is a part of a road 
-	void DrawArrayElementBasicRoad(int Y, int X, ETileType RoadType);
-	
 	int RoundUp(int numToRound, int multiple) const;
 	int RoundDown(int numToRound, int multiple) const;
 
-	void FillEmptyCityBorderArea();
-
 	void LogDrawArray2DSlice(int32 ZLevel);
 
 	FString GetLogSymbolByTileType(ETileType type) const;
 
-	void SpawnWorldScene(TArray<UWorldArrayItem*> Array, FIntVector Bounds);
+	// Spawns tiles chosen by WFC, column by column (Array->Columns)
+	void SpawnWorldScene(UWorldItem3DArray* Array);
 
 	void SpawnBuildingBlock(FBlock block);
 
-	void SpawnBuildingBlockColumn(int x, int y, int buildingHeight, ETileType FloorType, ETileType WindowType,
-		ETileRotation RotationTag,
-		ATileRegistry* &reg);
+	// Fills VisibilitySets from Array->Columns and building rectangles of Blocks
+	void BuildVisibilitySets(UWorldItem3DArray* Array);
+
+	// Shows only blocks visible from the street cell of the player camera. Off the streets everything is shown
+	void UpdateVisibleBlocks();
+
+	// Re-solves the elements affected by changed rules of the tile registry and respawns the columns which changed
+	void OnTileRulesChanged(const TBitArray<>& ChangedVariants);
+
+	// Destroys the tiles of ChangedColumns ([y * X + x]) and spawns them again from Array->Columns
+	void RespawnColumns(UWorldItem3DArray* Array, const TBitArray<>& ChangedColumns);
+
+	SIZE_T GetRoadsAllocatedSize() const;
+
+	// Tile actors and their components, shallow - shared meshes and materials are not counted
+	SIZE_T GetSpawnedTilesSize() const;
 
-	FTransform MakeTransformByRotationEnum(ETileRotation enumRot);
+	// Spawns all the tiles of column (x, y) from the ground up
+	void SpawnBuildingBlockColumn(UWorldItem3DArray* Array, int x, int y, ATileRegistry* reg, FRandomStream& SpawnRandomStream);
+
+	// Takes the tile out of navigation and collision which are made from the grid (bBuildGridNavigation, bBuildGridCollision)
+	void ApplyGridSettings(ATile* Tile) const;
 
 // BLOCKS DIVISION ================================
 	
@@ -148,21 +260,26 @@ protected:
 	int MaxBlockAreaToSkipDivision = 100;
 	void MakeBlocks();
 
+	// Divides all top-level blocks in parallel, then merges the results into Roads and Blocks
 	void DivideBlocks();
 
+	// Fully divides one top-level block. Called from worker threads:
+	// must read only the division params and write only into OutResult
+	void DivideTopLevelBlock(FBlock TopLevelBlock, FBlockDivisionResult& OutResult) const;
+
 	int AmountOfSuccessfulCuts = 0; // DEBUG
 	
 	// Returns true if such block can exist in world (for example, is not less that minimum)
-	bool CheckValidResultingBlockRestrictions(FBlock block);
+	bool CheckValidResultingBlockRestrictions(FBlock block) const;
 	// Returns true if this block can be attempted to be divided
-	bool CheckDividableBlockRestrictions(FBlock block);
+	bool CheckDividableBlockRestrictions(FBlock block) const;
 
-	bool CheckValidResultingBlockWithFuturePossibleDivision(int32 width, int32 length);
+	bool CheckValidResultingBlockWithFuturePossibleDivision(int32 width, int32 length) const;
 
 	// Makes roads inside the block by cutting it across one of axis with random offset
 	// If made any successful cut:
-	// - makes new FBlocks and enqueues it into Queue (to divide further)
-	// - adds a new FRoad to Roads
+	// - makes new FBlocks and adds them into PendingBlocks (to divide further)
+	// - adds a new FRoad to OutResult.Roads
 	// - returns true
 	// If haven't made any successful cut, returns false
 	// 
@@ -170,9 +287,9 @@ protected:
 	// - blockToCut, dividableBlock in PerformOffsetCuts()
 	// - block, firstBlock, secondBLock, OutBlockPair in PerformOneBlockCut()
 	// TODO: REFACTORING Try to remove InnerCuts and make one block right after one successful cut
-	bool PerformOffsetCuts(TQueue<FBlock>& Queue, FBlock block, bool CutAcrossX);
+	bool PerformOffsetCuts(TGenerationArenaArray<FBlock>& PendingBlocks, FBlock block, bool CutAcrossX, FBlockDivisionResult& OutResult) const;
 
-	bool PerformOneBlockCut(FBlock block, TArray<FBlock>& OutBlockPair, int32 CutCoord, bool CutAcrossX);
+	bool PerformOneBlockCut(FBlock block, TGenerationArenaArray<FBlock>& OutBlockPair, int32 CutCoord, bool CutAcrossX, FBlockDivisionResult& OutResult) const;
 
 public:	
 	// Called every frame
@@ -185,11 +302,33 @@ private:
 	TArray<FRoad> Roads;
 	TArray<FBlock> Blocks;
 	TArray<FBlock> ResBlocks;
+	FWorldLayoutIndex LayoutIndex;
 	// The height of the generated area array (in tiles, not in world / local coordinates)
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin="2", ClampMax="10", AllowPrivateAccess="true"))
+	// Buildings higher than WorldArrayBounds.Z repeat their top solved floor, so it's not limited by the size of the array.
+	// The array is raised to hold the template (ground, door and window floor) when needed, see ValidateWorldArrayBounds()
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin="2", ClampMax="100", AllowPrivateAccess="true"))
 	int DesirableCityHeight;
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin="1", ClampMax="10", AllowPrivateAccess="true"))
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin="0", ClampMax="50", AllowPrivateAccess="true"))
 	int CityHeightRandomRange;
+	// Height of each building of Blocks, including the ground
+	TArray<int32> BuildingHeights;
+
+	// [y * ChunksX + x] chunks of the city, kept between generations
+	UPROPERTY()
+	TArray<UCityChunkComponent*> CityChunks;
+	FIntPoint NumCityChunks = FIntPoint::ZeroValue;
+
+	FCityGridRaycast GridRaycast;
+
+	FCityVisibilitySets VisibilitySets;
+	// Spawned tiles of each block of VisibilitySets
+	TArray<TArray<ATile*>> BlockTiles;
+	// [y * X + x] - spawned tiles of each column
+	TArray<TArray<ATile*>> ColumnTiles;
+	TArray<bool> BlockVisible;
+	// Cell of the camera on the last UpdateVisibleBlocks(), INDEX_NONE - update on the next tick
+	FIntPoint LastViewCell = FIntPoint(INDEX_NONE, INDEX_NONE);
+	FTilePool TilePool;
 	
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin="0", ClampMax="100", AllowPrivateAccess="true"))
 	int WideRoadGenerationChancePercent = 20;
@@ -229,6 +368,11 @@ private:
 	// Holds basic road points from which the roads will be later generated
 	TArray<FRoadBaseCoord> XRoadPointsArray;
 	TArray<FRoadBaseCoord> YRoadPointsArray;
+
+	// Seed used by the current generation (GenerationSeed or a random one)
+	int32 CurrentSeed = 0;
+	// Random stream of the road map generation
+	FRandomStream LayoutRandomStream;
 // ==================================================================
 	// DEBUG FIELDS AND METHODS!
 protected:
@@ -6,8 +6,6 @@
 #include "Weapon.h"
 #include "GameFramework/CharacterMovementComponent.h"
 #include "Shooter/ShooterCharacter.h"
-#include "GameFramework/CharacterMovementComponent.h"
-#include "Kismet/KismetMathLibrary.h"
 
 UShooterAnimInstance::UShooterAnimInstance() :
 Speed(0.f),
@@ -16,10 +14,6 @@ bIsAccelerating(false),
 MovementOffsetYaw(0.f),
 LastMovementOffsetYaw(0.f),
 bAiming(false),
-CharacterRotation(FRotator(0.f)),
-CharacterRotationLastFrame(FRotator(0.f)),
-TIPCharacterYaw(0.f),
-TIPCharacterYawLastFrame(0.f),
 YawDelta(0.f),
 RootYawOffset(0.f),
 Pitch(0),
@@ -33,48 +27,122 @@ bShouldUseFABRIK(false)
 	
 }
 
+// Curves read by turn in place - names are made once, not on every update
+static const FName TurningCurveName(TEXT("Turning"));
+static const FName RotationCurveName(TEXT("Rotation"));
+
+FShooterAnimInstanceProxy::FShooterAnimInstanceProxy(UAnimInstance* InAnimInstance) :
+FAnimInstanceProxy(InAnimInstance),
+ShooterInstance(Cast<UShooterAnimInstance>(InAnimInstance))
+{
+}
+
+void FShooterAnimInstanceProxy::PreUpdate(UAnimInstance* InAnimInstance, float DeltaSeconds)
+{
+	Super::PreUpdate(InAnimInstance, DeltaSeconds);
+
+	ShooterInstance = Cast<UShooterAnimInstance>(InAnimInstance);
+	if(ShooterInstance)
+	{
+		ShooterInstance->GatherSnapshot(Snapshot);
+	}
+}
+
+void FShooterAnimInstanceProxy::Update(float DeltaSeconds)
+{
+	Super::Update(DeltaSeconds);
+
+	if(ShooterInstance == nullptr)
+		return;
+
+	const TMap<FName, float>& Curves = GetAnimationCurves(EAnimCurveType::AttributeCurve);
+	const float* Turning = Curves.Find(TurningCurveName);
+	const float* Rotation = Curves.Find(RotationCurveName);
+	Snapshot.TurningCurve = Turning ? *Turning : 0.f;
+	Snapshot.RotationCurve = Rotation ? *Rotation : 0.f;
+
+	State.Update(Snapshot, DeltaSeconds);
+}
+
+void FShooterAnimInstanceProxy::PostUpdate(UAnimInstance* InAnimInstance) const
+{
+	Super::PostUpdate(InAnimInstance);
+
+	if(UShooterAnimInstance* Instance = Cast<UShooterAnimInstance>(InAnimInstance))
+	{
+		Instance->ApplyState(State);
+	}
+}
+
+FAnimInstanceProxy* UShooterAnimInstance::CreateAnimInstanceProxy()
+{
+	return new FShooterAnimInstanceProxy(this);
+}
+
 void UShooterAnimInstance::UpdateAnimationProperties(float DeltaTime)
+{
+}
+
+void UShooterAnimInstance::GatherSnapshot(FShooterAnimSnapshot& OutSnapshot)
 {
 	if(ShooterCharacter == nullptr)
 	{
 		ShooterCharacter = Cast<AShooterCharacter>(TryGetPawnOwner());
 	}
-	
-	if(ShooterCharacter)
+
+	OutSnapshot.bHasCharacter = ShooterCharacter != nullptr;
+	if(ShooterCharacter == nullptr)
+		return;
+
+	const UCharacterMovementComponent* Movement = ShooterCharacter->GetCharacterMovement();
+	const ECombatState CombatState = ShooterCharacter->GetCombatState();
+
+	OutSnapshot.Velocity = ShooterCharacter->GetVelocity();
+	OutSnapshot.bAccelerating = Movement->GetCurrentAcceleration().SizeSquared() > 0.f;
+	OutSnapshot.bFalling = Movement->IsFalling();
+	OutSnapshot.AimRotation = ShooterCharacter->GetBaseAimRotation();
+	OutSnapshot.ActorRotation = ShooterCharacter->GetActorRotation();
+	OutSnapshot.bCrouching = ShooterCharacter->GetCrouching();
+	OutSnapshot.bAiming = ShooterCharacter->GetAiming();
+	OutSnapshot.bReloading = CombatState == ECombatState::ECS_Reloading;
+	OutSnapshot.bEquipping = CombatState == ECombatState::ECS_Equipping;
+	OutSnapshot.bShouldUseFABRIK = CombatState == ECombatState::ECS_Unnocupied
+			|| CombatState == ECombatState::ECS_FireTimerInProgress;
+
+	// Check if ShooterCharacter has a valid EquippedWeapon
+	if(ShooterCharacter->GetEquippedWeapon())
+	{
+		OutSnapshot.EquippedWeaponType = ShooterCharacter->GetEquippedWeapon()->GetWeaponType();
+	}
+}
+
+void FShooterAnimState::Update(const FShooterAnimSnapshot& Snapshot, float DeltaTime)
+{
+	if(Snapshot.bHasCharacter)
 	{
-		bCrouching = ShooterCharacter->GetCrouching();
-		bReloading = ShooterCharacter->GetCombatState() == ECombatState::ECS_Reloading;
-		bEquipping = ShooterCharacter->GetCombatState() == ECombatState::ECS_Equipping;
-		bShouldUseFABRIK = ShooterCharacter->GetCombatState() == ECombatState::ECS_Unnocupied
-				|| ShooterCharacter->GetCombatState() == ECombatState::ECS_FireTimerInProgress;
+		bCrouching = Snapshot.bCrouching;
+		bReloading = Snapshot.bReloading;
+		bEquipping = Snapshot.bEquipping;
+		bShouldUseFABRIK = Snapshot.bShouldUseFABRIK;
 		
 		// Get the lateral speed of the character from Velocity
-		FVector Velocity{ShooterCharacter->GetVelocity()};
+		FVector Velocity{Snapshot.Velocity};
 		Velocity.Z = 0;
 		Speed = Velocity.Size();
 
 		// Is the character in the air?
-		bIsInAir = ShooterCharacter->GetCharacterMovement()->IsFalling();
+		bIsInAir = Snapshot.bFalling;
 
 		// Is the character accelerating (= not standing still)?
-		if(ShooterCharacter->GetCharacterMovement()->GetCurrentAcceleration().Size() > 0.f)
-		{
-			bIsAccelerating = true;
-		}
-		else
-		{
-			bIsAccelerating = false;
-		}
+		bIsAccelerating = Snapshot.bAccelerating;
 
-		FRotator AimRotation = ShooterCharacter->GetBaseAimRotation();
-		FRotator MovementRotation = UKismetMathLibrary::MakeRotFromX(
-			ShooterCharacter->GetVelocity());
-		MovementOffsetYaw = UKismetMathLibrary::NormalizedDeltaRotator(MovementRotation, AimRotation).Yaw;
+		const FRotator MovementRotation = Snapshot.Velocity.Rotation();
+		MovementOffsetYaw = (MovementRotation - Snapshot.AimRotation).GetNormalized().Yaw;
 
-		if(ShooterCharacter->GetVelocity().Size() > 0.f)
+		if(!Snapshot.Velocity.IsZero())
 			LastMovementOffsetYaw = MovementOffsetYaw;
 
-		bAiming = ShooterCharacter->GetAiming();
+		bAiming = Snapshot.bAiming;
 
 		if(bReloading)
 		{
@@ -93,22 +161,12 @@ void UShooterAnimInstance::UpdateAnimationProperties(float DeltaTime)
 			OffsetState = EOffsetState::EOS_Hip;
 		}
 
-		// Check if ShooterCharacter has a valid EquippedWeapon
-		if(ShooterCharacter->GetEquippedWeapon())
-		{
-			EquippedWeaponType = ShooterCharacter->GetEquippedWeapon()->GetWeaponType();
-		}
-
-		// if(GEngine)
-		// {
-		// 	GEngine->AddOnScreenDebugMessage(2, -1, FColor::Black, FString::Printf(TEXT("bShouldUseFABRIK - %d"), bShouldUseFABRIK));
-		// 	GEngine->AddOnScreenDebugMessage(2, -1, FColor::Black, FString::Printf(TEXT("CombatState - %d"), ShooterCharacter->GetCombatState()));
-		// }
+		EquippedWeaponType = Snapshot.EquippedWeaponType;
 	}
 
-	TurnInPlace();
+	TurnInPlace(Snapshot);
 	
-	Lean(DeltaTime);
+	Lean(Snapshot, DeltaTime);
 }
 
 void UShooterAnimInstance::NativeInitializeAnimation()
@@ -116,18 +174,39 @@ void UShooterAnimInstance::NativeInitializeAnimation()
 	ShooterCharacter = Cast<AShooterCharacter>(TryGetPawnOwner());
 }
 
-void UShooterAnimInstance::TurnInPlace()
+void UShooterAnimInstance::ApplyState(const FShooterAnimState& State)
 {
-	if(ShooterCharacter == nullptr)
+	Speed = State.Speed;
+	bIsInAir = State.bIsInAir;
+	bIsAccelerating = State.bIsAccelerating;
+	MovementOffsetYaw = State.MovementOffsetYaw;
+	LastMovementOffsetYaw = State.LastMovementOffsetYaw;
+	bAiming = State.bAiming;
+	RootYawOffset = State.RootYawOffset;
+	Pitch = State.Pitch;
+	bReloading = State.bReloading;
+	OffsetState = State.OffsetState;
+	YawDelta = State.YawDelta;
+	bCrouching = State.bCrouching;
+	bEquipping = State.bEquipping;
+	RecoilWeight = State.RecoilWeight;
+	bTurningInPlace = State.bTurningInPlace;
+	bShouldUseFABRIK = State.bShouldUseFABRIK;
+	EquippedWeaponType = State.EquippedWeaponType;
+}
+
+void FShooterAnimState::TurnInPlace(const FShooterAnimSnapshot& Snapshot)
+{
+	if(!Snapshot.bHasCharacter)
 		return;
 
-	Pitch = ShooterCharacter->GetBaseAimRotation().Pitch;
+	Pitch = Snapshot.AimRotation.Pitch;
 
 	if(Speed > 0 || bIsInAir)
 	{
 		// Don't want to turn in place; Character is moving
 		RootYawOffset = 0.f;
-		TIPCharacterYaw = ShooterCharacter->GetActorRotation().Yaw;
+		TIPCharacterYaw = Snapshot.ActorRotation.Yaw;
 		TIPCharacterYawLastFrame = TIPCharacterYaw;
 		RotationCurveLastFrame = 0.f;
 		RotationCurve = 0.f;
@@ -136,20 +215,20 @@ void UShooterAnimInstance::TurnInPlace()
 	else
 	{
 		TIPCharacterYawLastFrame = TIPCharacterYaw;
-		TIPCharacterYaw = ShooterCharacter->GetActorRotation().Yaw;
+		TIPCharacterYaw = Snapshot.ActorRotation.Yaw;
 		const float TIPYawDelta { TIPCharacterYaw - TIPCharacterYawLastFrame };
 
 		// Root Yaw Offset updated and clamped to [180, 180]
-		RootYawOffset = UKismetMathLibrary::NormalizeAxis( RootYawOffset - TIPYawDelta);
+		RootYawOffset = FRotator::NormalizeAxis( RootYawOffset - TIPYawDelta);
 
 		// 1.0 if turning, 0.0 if not
-		const float Turning { GetCurveValue(TEXT("Turning"))};
+		const float Turning { Snapshot.TurningCurve };
 		if(Turning > 0)
 		{
 			bTurningInPlace = true;
 			
 			RotationCurveLastFrame = RotationCurve;
-			RotationCurve = GetCurveValue(TEXT("Rotation"));
+			RotationCurve = Snapshot.RotationCurve;
 
 			const float DeltaRotation { RotationCurve - RotationCurveLastFrame };
 
@@ -212,15 +291,15 @@ void UShooterAnimInstance::TurnInPlace()
 	}
 }
 
-void UShooterAnimInstance::Lean(float DeltaTime)
+void FShooterAnimState::Lean(const FShooterAnimSnapshot& Snapshot, float DeltaTime)
 {
-	if(ShooterCharacter == nullptr)
+	if(!Snapshot.bHasCharacter || DeltaTime <= 0.f)
 		return;
 
 	CharacterRotationLastFrame = CharacterRotation;
-	CharacterRotation = ShooterCharacter->GetActorRotation();
+	CharacterRotation = Snapshot.ActorRotation;
 
-	const FRotator Delta{ UKismetMathLibrary::NormalizedDeltaRotator(CharacterRotation, CharacterRotationLastFrame)};
+	const FRotator Delta{ (CharacterRotation - CharacterRotationLastFrame).GetNormalized() };
 	
 	const float Target{ (Delta.Yaw) / DeltaTime };
 	const float Interp{ FMath::FInterpTo(YawDelta, Target, DeltaTime, 6.f)};
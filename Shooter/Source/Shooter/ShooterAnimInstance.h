@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "Animation/AnimInstance.h"
+#include "Animation/AnimInstanceProxy.h"
 #include "WeaponType.h"
 #include "ShooterAnimInstance.generated.h"
 
@@ -18,6 +19,101 @@ enum class EOffsetState : uint8
 	EOS_MAX UMETA(DisplayName = "DefaultMAX")
 };
 
+// Everything the animation update needs from the character, copied on the game thread
+struct FShooterAnimSnapshot
+{
+	bool bHasCharacter = false;
+	FVector Velocity = FVector::ZeroVector;
+	bool bAccelerating = false;
+	bool bFalling = false;
+	FRotator AimRotation = FRotator::ZeroRotator;
+	FRotator ActorRotation = FRotator::ZeroRotator;
+	bool bCrouching = false;
+	bool bAiming = false;
+	bool bReloading = false;
+	bool bEquipping = false;
+	bool bShouldUseFABRIK = false;
+	EWeaponType EquippedWeaponType = EWeaponType::EWT_MAX;
+
+	// Curves of the last evaluated pose, read on the worker thread
+	float TurningCurve = 0.f;
+	float RotationCurve = 0.f;
+};
+
+// Animation properties computed from snapshots, with the state turn in place and lean carry between frames
+// Owned by the proxy, so the worker thread writes nothing else
+struct FShooterAnimState
+{
+	float Speed = 0.f;
+	bool bIsInAir = false;
+	bool bIsAccelerating = false;
+	float MovementOffsetYaw = 0.f;
+	float LastMovementOffsetYaw = 0.f;
+	bool bAiming = false;
+	// Yaw of Character this frame; Only updated when standing still and not in air
+	float TIPCharacterYaw = 0.f;
+	// Yaw of Character the previous frame; Only updated when standing still and not in air
+	float TIPCharacterYawLastFrame = 0.f;
+	float RootYawOffset = 0.f;
+	// Rotation curve value this frame
+	float RotationCurve = 0.f;
+	// Rotation curve value last frame
+	float RotationCurveLastFrame = 0.f;
+	float Pitch = 0.f;
+	bool bReloading = false;
+	EOffsetState OffsetState = EOffsetState::EOS_Hip;
+	// Char yaw this frame
+	FRotator CharacterRotation = FRotator::ZeroRotator;
+	// Char yaw last frame
+	FRotator CharacterRotationLastFrame = FRotator::ZeroRotator;
+	float YawDelta = 0.f;
+	bool bCrouching = false;
+	bool bEquipping = false;
+	float RecoilWeight = 1.f;
+	bool bTurningInPlace = false;
+	bool bShouldUseFABRIK = false;
+	EWeaponType EquippedWeaponType = EWeaponType::EWT_MAX;
+
+	// Any thread: the offset state, turn in place and lean of the frame of Snapshot
+	void Update(const FShooterAnimSnapshot& Snapshot, float DeltaTime);
+
+	// Handle turning in place variables
+	void TurnInPlace(const FShooterAnimSnapshot& Snapshot);
+
+	// Handle calculations for leaning when running
+	void Lean(const FShooterAnimSnapshot& Snapshot, float DeltaTime);
+};
+
+/**
+ * Splits the update of UShooterAnimInstance: PreUpdate() takes a snapshot of the character on the game thread,
+ * Update() computes the offset state, turn in place and lean into State on a worker thread,
+ * PostUpdate() copies State into the properties of the instance on the game thread
+ * The Blueprint graph sees the properties of the previous update, as it sees curves of the previous pose
+ */
+USTRUCT()
+struct FShooterAnimInstanceProxy : public FAnimInstanceProxy
+{
+	GENERATED_BODY()
+
+	FShooterAnimInstanceProxy() :
+	ShooterInstance(nullptr)
+	{
+	}
+
+	FShooterAnimInstanceProxy(UAnimInstance* InAnimInstance);
+
+protected:
+	virtual void PreUpdate(UAnimInstance* InAnimInstance, float DeltaSeconds) override;
+	virtual void Update(float DeltaSeconds) override;
+	virtual void PostUpdate(UAnimInstance* InAnimInstance) const override;
+
+private:
+	class UShooterAnimInstance* ShooterInstance;
+
+	FShooterAnimSnapshot Snapshot;
+	FShooterAnimState State;
+};
+
 /**
  * 
  */
@@ -28,17 +124,20 @@ class SHOOTER_API UShooterAnimInstance : public UAnimInstance
 public:
 	UShooterAnimInstance();
 	
+	// The properties are updated by FShooterAnimInstanceProxy now. Kept for the Blueprint graph which still calls it
 	UFUNCTION(BlueprintCallable)
 	void UpdateAnimationProperties(float DeltaTime);
 	
 	virtual void NativeInitializeAnimation() override;
 
 protected:
-	// Handle turning in place variables
-	void TurnInPlace();
+	virtual FAnimInstanceProxy* CreateAnimInstanceProxy() override;
 
-	// Handle calculations for leaning when running
-	void Lean(float DeltaTime);
+	// Game thread: copies the state of ShooterCharacter into OutSnapshot
+	void GatherSnapshot(FShooterAnimSnapshot& OutSnapshot);
+
+	// Game thread: copies the properties computed by the proxy into the properties of the Blueprint graph
+	void ApplyState(const FShooterAnimState& State);
 
 private:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Movement, meta = (AllowPrivateAccess = "true"))
@@ -65,21 +164,9 @@ private:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Movement, meta = (AllowPrivateAccess = "true"))
 	bool bAiming;
 
-	// Yaw of Character this frame; Only updated when standing still and not in air
-	float TIPCharacterYaw;
-
-	// Yaw of Character the previous frame; Only updated when standing still and not in air
-	float TIPCharacterYawLastFrame;
-
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Turn In Place", meta = (AllowPrivateAccess = "true"))
 	float RootYawOffset;
 
-	// Rotation curve value this frame
-	float RotationCurve;
-	
-	// Rotation curve value last frame
-	float RotationCurveLastFrame;
-
 	// The pitch of the aim rotation, used for Aim Offset
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Turn In Place", meta = (AllowPrivateAccess = "true"))
 	float Pitch;
@@ -92,12 +179,6 @@ private:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Turn In Place", meta = (AllowPrivateAccess = "true"))
 	EOffsetState OffsetState;
 
-	// Char yaw this frame
-	FRotator CharacterRotation;
-
-	// Char yaw last frame 
-	FRotator CharacterRotationLastFrame;
-
 	// Yaw delta used for leaning in the running blendspace
 	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, Category = Lean, meta = (AllowPrivateAccess = "true"))
 	float YawDelta;
@@ -121,4 +202,10 @@ private:
 	// True when not reloading or equipping
 	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true"))
 	bool bShouldUseFABRIK;
+
+	// Type of the weapon in the hands of the character
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Combat, meta = (AllowPrivateAccess = "true"))
+	EWeaponType EquippedWeaponType;
+
+	friend struct FShooterAnimInstanceProxy;
 };
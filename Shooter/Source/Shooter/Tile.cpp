@@ -59,6 +59,76 @@ TArray<ETileRotation> ATile::GetPossibleTileRotations() const
 	return Rotations;
 }
 
+int32 ATile::GetRotationalSymmetryPeriod() const
+{
+	if(Symmetry.Contains(ETileSymmetry::ETR_FourSides))
+		return 1;
+
+	// Transforms of the square: Quarter turns after a mirror over the Forward axis if bMirror. 8 in total
+	struct FSquareTransform
+	{
+		int32 Quarter;
+		bool bMirror;
+
+		bool operator==(const FSquareTransform& Other) const { return Quarter == Other.Quarter && bMirror == Other.bMirror; }
+
+		// This after Other. A mirror turns the quarters back
+		FSquareTransform operator*(const FSquareTransform& Other) const
+		{
+			return { (Quarter + (bMirror ? 4 - Other.Quarter : Other.Quarter)) % 4, bMirror != Other.bMirror };
+		}
+	};
+
+	// Mirror over an axis Eighths * 45 degrees from Forward is the Forward mirror turned by Eighths quarters
+	TArray<FSquareTransform, TInlineAllocator<8>> Orbit = { { 0, false } };
+	for(ETileSymmetry Mirror : Symmetry)
+	{
+		const int32 Eighths = Mirror == ETileSymmetry::ETS_RtLt ? 0
+			: Mirror == ETileSymmetry::ETS_FwdRt ? 1
+			: Mirror == ETileSymmetry::ETS_FwdBwd ? 2
+			: Mirror == ETileSymmetry::ETS_BwdLt ? 3
+			: INDEX_NONE;
+		if(Eighths != INDEX_NONE)
+		{
+			Orbit.AddUnique(FSquareTransform{ Eighths, true });
+		}
+	}
+
+	// Everything the mirrors make together, e.g. a diagonal and an axis make a quarter turn
+	for(int32 Added = 1; Added > 0;)
+	{
+		Added = 0;
+		for(int32 i = 0; i < Orbit.Num(); i++)
+		{
+			for(int32 j = 0; j < Orbit.Num(); j++)
+			{
+				const int32 NumBefore = Orbit.Num();
+				Orbit.AddUnique(Orbit[i] * Orbit[j]);
+				Added += Orbit.Num() - NumBefore;
+			}
+		}
+	}
+
+	for(int32 Period = 1; Period < 4; Period++)
+	{
+		if(Orbit.Contains(FSquareTransform{ Period, false }))
+			return Period;
+	}
+	return 4;
+}
+
+TArray<ETileRotation> ATile::GetEquivalentRotations(ETileRotation Rotation) const
+{
+	const int32 Period = GetRotationalSymmetryPeriod();
+	
+	TArray<ETileRotation> Rotations = GetPossibleTileRotations();
+	Rotations.RemoveAll([Rotation, Period](ETileRotation Other)
+	{
+		return ((int32)Other - (int32)Rotation + 4) % Period != 0;
+	});
+	return Rotations;
+}
+
 // Called when the game starts or when spawned
 void ATile::BeginPlay()
 {
@@ -22,6 +22,13 @@ public:
 	ATile();
 
 	TArray<ETileRotation> GetPossibleTileRotations() const;
+
+	// Amount of quarter turns after which the tile looks the same: the smallest turn among all the transforms of the square
+	// its Symmetry mirrors make together. 1 - four sides, or a diagonal and an axis; 2 - two perpendicular mirrors; 4 - otherwise
+	int32 GetRotationalSymmetryPeriod() const;
+
+	// Possible rotations which look the same as Rotation under the symmetry of the tile (including Rotation itself)
+	TArray<ETileRotation> GetEquivalentRotations(ETileRotation Rotation) const;
 private:
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
 	USceneComponent* SceneRoot;
@@ -70,6 +77,7 @@ public:
 	void SetIndexInRegister(int Value);
 	
 	FORCEINLINE int GetWeight() const { return Weight; }
+	FORCEINLINE UStaticMeshComponent* GetMainMesh() const { return MainMesh; }
 	FORCEINLINE ETileType GetTileTypeTag() const { return TileTypeTag; }
 	FORCEINLINE ETileColorTag GetColorTag() const { return ColorTag; }
 
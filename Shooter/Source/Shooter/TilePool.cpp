@@ -0,0 +1,100 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TilePool.h"
+#include "Engine/World.h"
+
+ATile* FTilePool::Acquire(UWorld* World, TSubclassOf<ATile> TileClass, const FVector& Location, const FRotator& Rotation, bool& bOutSpawned)
+{
+	if(TArray<ATile*>* Tiles = FreeTiles.Find(TileClass.Get()))
+	{
+		// Tiles could be destroyed with the level while they were in the pool
+		while(Tiles->Num() > 0)
+		{
+			ATile* Tile = Tiles->Pop(false);
+			if(!IsValid(Tile))
+				continue;
+
+			Tile->SetActorLocationAndRotation(Location, Rotation, false, nullptr, ETeleportType::TeleportPhysics);
+			Tile->SetActorHiddenInGame(false);
+			Tile->SetActorEnableCollision(true);
+			Tile->SetActorTickEnabled(Tile->PrimaryActorTick.bStartWithTickEnabled);
+			NumReused++;
+			bOutSpawned = false;
+			return Tile;
+		}
+	}
+
+	bOutSpawned = true;
+	NumSpawned++;
+	return World->SpawnActor<ATile>(TileClass, Location, Rotation);
+}
+
+void FTilePool::Release(ATile* Tile)
+{
+	if(!IsValid(Tile))
+		return;
+
+	Tile->SetActorHiddenInGame(true);
+	Tile->SetActorEnableCollision(false);
+	Tile->SetActorTickEnabled(false);
+	FreeTiles.FindOrAdd(Tile->GetClass()).Add(Tile);
+}
+
+void FTilePool::Empty()
+{
+	for(TPair<UClass*, TArray<ATile*>>& Pair : FreeTiles)
+	{
+		for(ATile* Tile : Pair.Value)
+		{
+			if(IsValid(Tile))
+			{
+				Tile->Destroy();
+			}
+		}
+	}
+	FreeTiles.Empty();
+}
+
+int32 FTilePool::Trim(int32 MaxTiles)
+{
+	const int32 NumTiles = Num();
+	if(NumTiles <= MaxTiles)
+		return 0;
+
+	const int32 MaxKept = FMath::Max(MaxTiles, 0);
+	int32 NumDestroyed = 0;
+	for(TPair<UClass*, TArray<ATile*>>& Pair : FreeTiles)
+	{
+		TArray<ATile*>& Tiles = Pair.Value;
+		const int32 NumKept = (int32)((int64)Tiles.Num() * MaxKept / NumTiles);
+		for(int32 i = NumKept; i < Tiles.Num(); i++)
+		{
+			if(IsValid(Tiles[i]))
+			{
+				Tiles[i]->Destroy();
+			}
+		}
+		NumDestroyed += Tiles.Num() - NumKept;
+		Tiles.SetNum(NumKept);
+	}
+	return NumDestroyed;
+}
+
+int32 FTilePool::Num() const
+{
+	int32 NumTiles = 0;
+	for(const TPair<UClass*, TArray<ATile*>>& Pair : FreeTiles)
+	{
+		NumTiles += Pair.Value.Num();
+	}
+	return NumTiles;
+}
+
+void FTilePool::GetAndResetCounters(int32& OutReused, int32& OutSpawned)
+{
+	OutReused = NumReused;
+	OutSpawned = NumSpawned;
+	NumReused = 0;
+	NumSpawned = 0;
+}
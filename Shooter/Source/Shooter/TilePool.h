@@ -0,0 +1,40 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tile.h"
+
+/**
+ * Tile actors of previous generations, hidden and waiting to be placed again
+ * Tiles are kept by class, so a tile of the class is moved instead of spawned, as long as the pool has one
+ * The pool doesn't own the tiles - they live in the level as any spawned actor
+ */
+class SHOOTER_API FTilePool
+{
+public:
+	// Moves a pooled tile of TileClass to the location and shows it, or spawns a new one if there is none
+	// bOutSpawned - the tile is new
+	ATile* Acquire(UWorld* World, TSubclassOf<ATile> TileClass, const FVector& Location, const FRotator& Rotation, bool& bOutSpawned);
+
+	// Hides the tile and keeps it for Acquire()
+	void Release(ATile* Tile);
+
+	// Destroys all the pooled tiles
+	void Empty();
+
+	// Destroys pooled tiles until at most MaxTiles are left. Every class loses the same share of its tiles
+	// Returns the amount of destroyed tiles
+	int32 Trim(int32 MaxTiles);
+
+	int32 Num() const;
+
+	// Tiles taken from the pool and spawned since the last call
+	void GetAndResetCounters(int32& OutReused, int32& OutSpawned);
+
+private:
+	TMap<UClass*, TArray<ATile*>> FreeTiles;
+
+	int32 NumReused = 0;
+	int32 NumSpawned = 0;
+};
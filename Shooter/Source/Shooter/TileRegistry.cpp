@@ -2,9 +2,18 @@
 
 
 #include "TileRegistry.h"
+#include "GenerationMemory.h"
+
+// Rule number Element of the compatibility array of Row in relative Direction. Indexes stay the same while the arrays are reallocated
+static uint64 MakeRuleKey(bool bTagRule, int32 Row, int32 Direction, int32 Element)
+{
+	return ((uint64)bTagRule << 63) | ((uint64)(uint32)Row << 32) | ((uint64)Direction << 24) | (uint64)(uint32)Element;
+}
 
 // Sets default values
 ATileRegistry::ATileRegistry() :
+bHotReloadRules(false),
+RulesPollInterval(1.f),
 RoadTags({
 		ETileType::ETT_Road,
 		ETileType::ETT_Road_Crossroads,
@@ -22,62 +31,54 @@ SidewalkTags({
 	ETileType::ETT_Sidewalks_Corner,
 	ETileType::ETT_Sidewalks_Borderline,
 	ETileType::ETT_Sidewalks_Inner
-})
+}),
+TileListHash(0),
+TimeToRulesPoll(0.f)
 {
  	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
 
 }
 
-void ATileRegistry::GetArrayOfCompatibleTilesByRelativeDeltaPosition(TArray<FTileCompatibilityElement>& OutArray, FTileRegistryEl RegistryRow,
-	ETileCompatibilityDeltaPosition RelativeDeltaPosition)
+const TArray<FTileCompatibilityElement>& ATileRegistry::GetArrayOfCompatibleTilesByRelativeDeltaPosition(const FTileRegistryEl& RegistryRow,
+	ETileCompatibilityDeltaPosition RelativeDeltaPosition) const
 {
 	switch (RelativeDeltaPosition)
 	{
-	case ETileCompatibilityDeltaPosition::ETDP_OnForward:
-		OutArray = RegistryRow.OnForwardCompatible;
-		return;
 	case ETileCompatibilityDeltaPosition::ETDP_OnBackward:
-		OutArray = RegistryRow.OnBackCompatible;
-		return;
+		return RegistryRow.OnBackCompatible;
 	case ETileCompatibilityDeltaPosition::ETDP_OnTop:
-		OutArray = RegistryRow.OnTopCompatible;
-		return;
+		return RegistryRow.OnTopCompatible;
 	case ETileCompatibilityDeltaPosition::ETDP_OnBottom:
-		OutArray = RegistryRow.OnBottomCompatible;
-		return;
+		return RegistryRow.OnBottomCompatible;
 	case ETileCompatibilityDeltaPosition::ETDP_OnLeft:
-		OutArray = RegistryRow.OnLeftCompatible;
-		return;
+		return RegistryRow.OnLeftCompatible;
 	case ETileCompatibilityDeltaPosition::ETDP_OnRight:
-		OutArray = RegistryRow.OnRightCompatible;
-		return;
+		return RegistryRow.OnRightCompatible;
+	case ETileCompatibilityDeltaPosition::ETDP_OnForward:
+	default:
+		return RegistryRow.OnForwardCompatible;
 	}
 }
 
-void ATileRegistry::GetArrayOfCompatibleTagsByRelativeDeltaPosition(TArray<FTagCompatibilityElement>& OutArray,
-	FTagRegistryEl RegistryRow, ETileCompatibilityDeltaPosition RelativeDeltaPosition)
+const TArray<FTagCompatibilityElement>& ATileRegistry::GetArrayOfCompatibleTagsByRelativeDeltaPosition(const FTagRegistryEl& RegistryRow,
+	ETileCompatibilityDeltaPosition RelativeDeltaPosition) const
 {
 	switch (RelativeDeltaPosition)
 	{
-	case ETileCompatibilityDeltaPosition::ETDP_OnForward:
-		OutArray = RegistryRow.OnForwardCompatible;
-		return;
 	case ETileCompatibilityDeltaPosition::ETDP_OnBackward:
-		OutArray = RegistryRow.OnBackCompatible;
-		return;
+		return RegistryRow.OnBackCompatible;
 	case ETileCompatibilityDeltaPosition::ETDP_OnTop:
-		OutArray = RegistryRow.OnTopCompatible;
-		return;
+		return RegistryRow.OnTopCompatible;
 	case ETileCompatibilityDeltaPosition::ETDP_OnBottom:
-		OutArray = RegistryRow.OnBottomCompatible;
-		return;
+		return RegistryRow.OnBottomCompatible;
 	case ETileCompatibilityDeltaPosition::ETDP_OnLeft:
-		OutArray = RegistryRow.OnLeftCompatible;
-		return;
+		return RegistryRow.OnLeftCompatible;
 	case ETileCompatibilityDeltaPosition::ETDP_OnRight:
-		OutArray = RegistryRow.OnRightCompatible;
-		return;
+		return RegistryRow.OnRightCompatible;
+	case ETileCompatibilityDeltaPosition::ETDP_OnForward:
+	default:
+		return RegistryRow.OnForwardCompatible;
 	}
 }
 
@@ -145,13 +146,13 @@ bool ATileRegistry::IsCompatible(int MyRegIndex, ETileRotation MyTileRotation,
 		return true;
 	}
 	
-	FTileRegistryEl MyRegistryRow = RegistryArray[MyRegIndex];
+	const FTileRegistryEl& MyRegistryRow = RegistryArray[MyRegIndex];
 
 	// Get the array of compatible tiles corresponding to the position of ComparableTile,
 	// respecting the turn of MyTile
-	TArray<FTileCompatibilityElement> MyCompatibilityArray;
 	ETileCompatibilityDeltaPosition RelativeDeltaPosition = GetRelativeDeltaPosition(MyTileRotation, DeltaPositionToCompare);
-	GetArrayOfCompatibleTilesByRelativeDeltaPosition(MyCompatibilityArray, MyRegistryRow, RelativeDeltaPosition);
+	const TArray<FTileCompatibilityElement>& MyCompatibilityArray =
+		GetArrayOfCompatibleTilesByRelativeDeltaPosition(MyRegistryRow, RelativeDeltaPosition);
 	
 	ETileRotation RelativeRotation = GetRelativeRotationOfTheirTile(MyTileRotation,
 		ComparableTileRotation, RelativeDeltaPosition);
@@ -175,9 +176,8 @@ bool ATileRegistry::IsCompatible(int MyRegIndex, ETileRotation MyTileRotation,
 		if(MyTagRowIndex != -1)
 		{
 			// Array of compatibility rules for my tag exists. Search it the same way we searched the RegistryArray for it
-			FTagRegistryEl MyTagRow = TagRegistryArray[MyTagRowIndex];
-			TArray<FTagCompatibilityElement> MyTagComp;
-			GetArrayOfCompatibleTagsByRelativeDeltaPosition(MyTagComp, MyTagRow, RelativeDeltaPosition);
+			const TArray<FTagCompatibilityElement>& MyTagComp =
+				GetArrayOfCompatibleTagsByRelativeDeltaPosition(TagRegistryArray[MyTagRowIndex], RelativeDeltaPosition);
 			found = DoesTagCompatibilityArrayContainThisTag(MyTagComp, CompTag, RelativeRotation);
 		}
 	}
@@ -245,7 +245,7 @@ ETileRotation ATileRegistry::GetRelativeRotationOfTheirTile(ETileRotation MyRota
 	return (ETileRotation)theirRotation;
 }
 
-bool ATileRegistry::DoesCompatibilityArrayContainThisTile(TArray<FTileCompatibilityElement> CompatibilityArray, int TileIndexInRegister, ETileRotation RelativeRotation)
+bool ATileRegistry::DoesCompatibilityArrayContainThisTile(const TArray<FTileCompatibilityElement>& CompatibilityArray, int TileIndexInRegister, ETileRotation RelativeRotation)
 {
 	for(int i = 0; i < CompatibilityArray.Num(); i++)
 	{
@@ -259,7 +259,7 @@ bool ATileRegistry::DoesCompatibilityArrayContainThisTile(TArray<FTileCompatibil
 	return false;
 }
 
-bool ATileRegistry::DoesTagCompatibilityArrayContainThisTag(TArray<FTagCompatibilityElement> CompatibilityArray,
+bool ATileRegistry::DoesTagCompatibilityArrayContainThisTag(const TArray<FTagCompatibilityElement>& CompatibilityArray,
 	ETileType Tag, ETileRotation RelativeRotation)
 {
 	for(int i = 0; i < CompatibilityArray.Num(); i++)
@@ -286,7 +286,8 @@ void ATileRegistry::Init()
 
 				for(int regTile = 0; regTile < RegistryArray.Num(); regTile++)
 				{
-					if(RegistryArray[regTile].Tile.GetDefaultObject()->GetName()
+					if(RegistryArray[regTile].Tile != nullptr
+						&& RegistryArray[regTile].Tile.GetDefaultObject()->GetName()
 						== AdditionalTilesList[addTile].GetDefaultObject()->GetName())
 					{
 						alreadyExists = true;
@@ -308,6 +309,7 @@ void ATileRegistry::Init()
 					newRegistryEl.OnBottomCompatible = TArray<FTileCompatibilityElement>();
 
 					RegistryArray.Add(newRegistryEl);
+					MergedAdditionalTiles.Add(AdditionalTilesList[addTile]);
 				}
 			}
 		}
@@ -327,7 +329,15 @@ void ATileRegistry::Init()
 
 			for(int k = 0; k < PossibleRotations.Num(); k++)
 			{
-				FWorldArrayWFCSuperpositionElement El = { i, PossibleRotations[k], Weight };
+				// Rotations which look the same under the symmetry of the tile are one candidate - the first of them.
+				// It takes the weight of all of them, so the tile is chosen as often as before
+				TArray<ETileRotation> EquivalentRotations = RegistryArray[i].TileInstance->GetEquivalentRotations(PossibleRotations[k]);
+				if(EquivalentRotations[0] != PossibleRotations[k])
+				{
+					continue;
+				}
+				
+				FWorldArrayWFCSuperpositionElement El = { i, PossibleRotations[k], Weight * EquivalentRotations.Num() };
 
 				// Fill array of shortened superposition - Roads
 				if(IsTileARoad(RegistryArray[i].TileInstance))
@@ -398,8 +408,516 @@ void ATileRegistry::Init()
 			}
 		}
 	}
+
+	CompileRules();
+
+	TileListHash = GetTileListHash();
+	GetRuleHashes(RowHashes, TagHashes);
 }
 
+void ATileRegistry::CompileRules(const TBitArray<>* ChangedVariants)
+{
+	GENERATION_LLM_SCOPE(Registry);
+	const int32 NumVariants = FullSuperpositionArray.Num();
+	if(!ChangedVariants)
+	{
+		CompiledRules.Reset(NumVariants);
+		CompiledRules.Variants = FullSuperpositionArray;
+		DeclaredRuleMasks.Init(0, CompiledRules.Compatible.Num());
+	}
+
+	// Variant by tile index in register and rotation: [TileIndex * 4 + Rotation]
+	const int32 NumRotations = 4;
+	TArray<int32> VariantIndexes;
+	VariantIndexes.Init(INDEX_NONE, RegistryArray.Num() * NumRotations);
+
+	// Variants of each tag
+	TArray<TArray<int32>> VariantsByTag;
+	VariantsByTag.SetNum((int32)ETileType::ETT_MAX);
+
+	for(int32 v = 0; v < NumVariants; v++)
+	{
+		const FWorldArrayWFCSuperpositionElement& Variant = FullSuperpositionArray[v];
+		const ETileType Tag = RegistryArray[Variant.TileIndexInRegister].TileInstance->GetTileTypeTag();
+		
+		check((int32)Variant.Rotation < NumRotations);
+		VariantsByTag[(int32)Tag].Add(v);
+		if(ChangedVariants)
+			continue;
+
+		CompiledRules.VariantTags.Add(Tag);
+		CompiledRules.VariantNames.Add(FString::Printf(TEXT("%s:%s"),
+			*RegistryArray[Variant.TileIndexInRegister].TileInstance->GetName(),
+			*StaticEnum<ETileRotation>()->GetNameStringByValue((int64)Variant.Rotation)));
+
+		const float Weight = FMath::Max(Variant.Weight, 1);
+		CompiledRules.Weights[v] = Weight;
+		CompiledRules.WeightLogWeights[v] = Weight * FMath::Loge(Weight);
+	}
+
+	// Rule "Their tile can be set in Direction of My tile" is also the rule "My tile can be set in reverse Direction of Their tile".
+	// Compiling both sides here does the same as TileFitsByDirection() did with the reverse IsCompatible() check
+	// DeclaredRuleMasks keeps only the side the user has set - for the report of asymmetric rules
+	auto AddCompatiblePair = [this, ChangedVariants](int32 MyVariant, int32 TheirVariant, int32 Direction)
+	{
+		// Pairs of two unchanged variants are already compiled
+		if(ChangedVariants && !(*ChangedVariants)[MyVariant] && !(*ChangedVariants)[TheirVariant])
+			return;
+
+		WFCBitsetKernels::SetBit(CompiledRules.GetCompatible(MyVariant, Direction), TheirVariant);
+		WFCBitsetKernels::SetBit(CompiledRules.GetCompatible(TheirVariant, FWFCCompiledRules::ReverseDirection(Direction)), MyVariant);
+		WFCBitsetKernels::SetBit(DeclaredRuleMasks.GetData() + (MyVariant * FWFCCompiledRules::NumDirections + Direction) * CompiledRules.NumWords, TheirVariant);
+	};
+
+	// Recompilation clears the masks of changed variants and their bits in the masks of the others - both sides of their pairs
+	if(ChangedVariants)
+	{
+		const int32 NumWords = CompiledRules.NumWords;
+		TArray<uint64> ChangedMask;
+		ChangedMask.Init(0, NumWords);
+		for(TConstSetBitIterator<> It(*ChangedVariants); It; ++It)
+		{
+			WFCBitsetKernels::SetBit(ChangedMask.GetData(), It.GetIndex());
+		}
+
+		for(int32 v = 0; v < NumVariants; v++)
+		{
+			for(int32 Direction = 0; Direction < FWFCCompiledRules::NumDirections; Direction++)
+			{
+				uint64* Compatible = CompiledRules.GetCompatible(v, Direction);
+				uint64* Declared = DeclaredRuleMasks.GetData() + (v * FWFCCompiledRules::NumDirections + Direction) * NumWords;
+				for(int32 Word = 0; Word < NumWords; Word++)
+				{
+					const uint64 Keep = (*ChangedVariants)[v] ? 0 : ~ChangedMask[Word];
+					Compatible[Word] &= Keep;
+					Declared[Word] &= Keep;
+				}
+			}
+		}
+	}
+
+	// Rules which have added at least one pair. The rest are dead - they name a rotation or a tag no variant has
+	TSet<uint64> UsedRules;
+
+	// Every rotation of a tile, merged into the variant of its symmetry class
+	struct FVariantMember
+	{
+		int32 Variant;
+		ETileRotation Rotation;
+	};
+	TArray<FVariantMember> Members;
+	for(int32 v = 0; v < NumVariants; v++)
+	{
+		const FWorldArrayWFCSuperpositionElement& Variant = FullSuperpositionArray[v];
+		for(ETileRotation Rotation : RegistryArray[Variant.TileIndexInRegister].TileInstance->GetEquivalentRotations(Variant.Rotation))
+		{
+			VariantIndexes[Variant.TileIndexInRegister * NumRotations + (int32)Rotation] = v;
+			Members.Add({ v, Rotation });
+		}
+	}
+
+	// Merged variant takes the rules of all its rotations
+	for(const FVariantMember& Member : Members)
+	{
+		const int32 v = Member.Variant;
+		const FWorldArrayWFCSuperpositionElement Variant = { FullSuperpositionArray[v].TileIndexInRegister, Member.Rotation, 0 };
+		const FTileRegistryEl& MyRegistryRow = RegistryArray[Variant.TileIndexInRegister];
+		const ETileType MyTag = CompiledRules.VariantTags[v];
+
+		const int32 MyTagRowIndex = TagRegistryArray.IndexOfByPredicate([MyTag](const FTagRegistryEl& Row)
+		{
+			return Row.TileTag == MyTag;
+		});
+		const FTagRegistryEl* MyTagRow = MyTagRowIndex != INDEX_NONE ? &TagRegistryArray[MyTagRowIndex] : nullptr;
+
+		for(int32 Direction = 0; Direction < FWFCCompiledRules::NumDirections; Direction++)
+		{
+			const ETileCompatibilityDeltaPosition RelativeDeltaPosition =
+				GetRelativeDeltaPosition(Variant.Rotation, (ETileCompatibilityDeltaPosition)Direction);
+
+			// Rotation in compatibility arrays is relative to my rotation - turn it back into world rotation
+			auto GetTheirWorldRotation = [&Variant](ETileRotation RelativeRotation)
+			{
+				return ((int32)RelativeRotation + (int32)Variant.Rotation) % NumRotations;
+			};
+
+			const TArray<FTileCompatibilityElement>& TileRules = GetArrayOfCompatibleTilesByRelativeDeltaPosition(MyRegistryRow, RelativeDeltaPosition);
+			for(int32 Rule = 0; Rule < TileRules.Num(); Rule++)
+			{
+				const FTileCompatibilityElement& El = TileRules[Rule];
+				if((int32)El.Rotation >= NumRotations || El.Tile == nullptr)
+					continue;
+
+				const int32 TheirTile = El.Tile.GetDefaultObject()->GetIndexInRegister();
+				if(!RegistryArray.IsValidIndex(TheirTile))
+					continue;
+
+				const int32 TheirVariant = VariantIndexes[TheirTile * NumRotations + GetTheirWorldRotation(El.Rotation)];
+				if(TheirVariant != INDEX_NONE)
+				{
+					AddCompatiblePair(v, TheirVariant, Direction);
+					UsedRules.Add(MakeRuleKey(false, Variant.TileIndexInRegister, (int32)RelativeDeltaPosition, Rule));
+				}
+			}
+
+			if(MyTagRow)
+			{
+				const TArray<FTagCompatibilityElement>& TagRules = GetArrayOfCompatibleTagsByRelativeDeltaPosition(*MyTagRow, RelativeDeltaPosition);
+				for(int32 Rule = 0; Rule < TagRules.Num(); Rule++)
+				{
+					const FTagCompatibilityElement& El = TagRules[Rule];
+					if((int32)El.Rotation >= NumRotations || El.Tag == ETileType::ETT_MAX)
+						continue;
+
+					const int32 TheirRotation = GetTheirWorldRotation(El.Rotation);
+					for(int32 TheirVariant : VariantsByTag[(int32)El.Tag])
+					{
+						const int32 TheirTile = FullSuperpositionArray[TheirVariant].TileIndexInRegister;
+						if(VariantIndexes[TheirTile * NumRotations + TheirRotation] == TheirVariant)
+						{
+							AddCompatiblePair(v, TheirVariant, Direction);
+							UsedRules.Add(MakeRuleKey(true, MyTagRowIndex, (int32)RelativeDeltaPosition, Rule));
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// Air and NoCity fit each other from any side
+	TArray<int32> EmptyVariants = VariantsByTag[(int32)ETileType::ETT_Air];
+	EmptyVariants.Append(VariantsByTag[(int32)ETileType::ETT_NoCity]);
+	for(int32 My : EmptyVariants)
+	{
+		for(int32 Their : EmptyVariants)
+		{
+			for(int32 Direction = 0; Direction < FWFCCompiledRules::NumDirections; Direction++)
+			{
+				WFCBitsetKernels::SetBit(CompiledRules.GetCompatible(My, Direction), Their);
+			}
+		}
+	}
+
+	// Halves of wide road are compatible only with the same tile
+	const TArray<int32>& HalfRoadVariants = VariantsByTag[(int32)ETileType::ETT_Road_HalfOfWideRoad];
+	for(int32 My : HalfRoadVariants)
+	{
+		for(int32 Their : HalfRoadVariants)
+		{
+			if(FullSuperpositionArray[My].TileIndexInRegister == FullSuperpositionArray[Their].TileIndexInRegister)
+				continue;
+			
+			for(int32 Direction = 0; Direction < FWFCCompiledRules::NumDirections; Direction++)
+			{
+				WFCBitsetKernels::ClearBit(CompiledRules.GetCompatible(My, Direction), Their);
+			}
+		}
+	}
+
+	// Tiles and their tags and colours are the same on recompilation - domains too
+	if(ChangedVariants)
+	{
+		UE_LOG(LogGeneration, Display, TEXT("ATileRegistry::CompileRules - %d of %d variants recompiled"),
+			ChangedVariants->CountSetBits(), NumVariants);
+		ReportRules(DeclaredRuleMasks, UsedRules);
+		return;
+	}
+
+	// Initial domains of elements by their tag
+	for(int32 Tag = 0; Tag < (int32)ETileType::ETT_MAX; Tag++)
+	{
+		uint64* Domain = CompiledRules.GetTagDomain((ETileType)Tag);
+		for(const FWorldArrayWFCSuperpositionElement& El : GetSuperpositionArrayByTag((ETileType)Tag))
+		{
+			const int32 Variant = VariantIndexes[El.TileIndexInRegister * NumRotations + (int32)El.Rotation];
+			if(Variant != INDEX_NONE)
+			{
+				WFCBitsetKernels::SetBit(Domain, Variant);
+			}
+		}
+	}
+
+	// Colour domains: variants of indifferent colour fit any colour
+	for(int32 v = 0; v < NumVariants; v++)
+	{
+		const ETileColorTag Color = RegistryArray[FullSuperpositionArray[v].TileIndexInRegister].TileInstance->GetColorTag();
+		WFCBitsetKernels::SetBit(CompiledRules.GetColorDomain(ETileColorTag::ETCT_Indifferent), v);
+		for(int32 OtherColor = 1; OtherColor < (int32)ETileColorTag::ETCT_MAX; OtherColor++)
+		{
+			if(Color == ETileColorTag::ETCT_Indifferent || (int32)Color == OtherColor)
+			{
+				WFCBitsetKernels::SetBit(CompiledRules.GetColorDomain((ETileColorTag)OtherColor), v);
+			}
+		}
+	}
+
+	UE_LOG(LogGeneration, Display, TEXT("ATileRegistry::CompileRules - %d variants, %d words per mask"),
+		NumVariants, CompiledRules.NumWords);
+
+	ReportRules(DeclaredRuleMasks, UsedRules);
+
+	GenerationMemory::Set(EGenerationMemoryTag::Registry, CompiledRules.GetAllocatedSize() + DeclaredRuleMasks.GetAllocatedSize()
+		+ FullSuperpositionArray.GetAllocatedSize() + RegistryArray.GetAllocatedSize() + TagRegistryArray.GetAllocatedSize());
+}
+
+void ATileRegistry::ReportRules(const TArray<uint64>& DeclaredRules, const TSet<uint64>& UsedRules) const
+{
+	const UEnum* DirectionEnum = StaticEnum<ETileCompatibilityDeltaPosition>();
+	const UEnum* RotationEnum = StaticEnum<ETileRotation>();
+	const int32 NumWords = CompiledRules.NumWords;
+
+	// Dead rules: nothing in the registry matches them
+	int32 NumDeadRules = 0;
+	for(int32 RowIndex = 0; RowIndex < RegistryArray.Num(); RowIndex++)
+	{
+		const FTileRegistryEl& Row = RegistryArray[RowIndex];
+		if(Row.TileInstance == nullptr)
+			continue;
+
+		for(int32 Direction = 0; Direction < FWFCCompiledRules::NumDirections; Direction++)
+		{
+			const TArray<FTileCompatibilityElement>& TileRules = GetArrayOfCompatibleTilesByRelativeDeltaPosition(Row, (ETileCompatibilityDeltaPosition)Direction);
+			for(int32 Rule = 0; Rule < TileRules.Num(); Rule++)
+			{
+				const FTileCompatibilityElement& El = TileRules[Rule];
+				if(!UsedRules.Contains(MakeRuleKey(false, RowIndex, Direction, Rule)))
+				{
+					NumDeadRules++;
+					UE_LOG(LogGeneration, Log, TEXT("ATileRegistry::ReportRules - dead rule of %s %s: %s:%s"),
+						*Row.TileInstance->GetName(), *DirectionEnum->GetNameStringByValue(Direction),
+						El.Tile != nullptr ? *El.Tile.GetDefaultObject()->GetName() : TEXT("None"),
+						*RotationEnum->GetNameStringByValue((int64)El.Rotation));
+				}
+			}
+		}
+	}
+	for(int32 RowIndex = 0; RowIndex < TagRegistryArray.Num(); RowIndex++)
+	{
+		const FTagRegistryEl& Row = TagRegistryArray[RowIndex];
+		for(int32 Direction = 0; Direction < FWFCCompiledRules::NumDirections; Direction++)
+		{
+			const TArray<FTagCompatibilityElement>& TagRules = GetArrayOfCompatibleTagsByRelativeDeltaPosition(Row, (ETileCompatibilityDeltaPosition)Direction);
+			for(int32 Rule = 0; Rule < TagRules.Num(); Rule++)
+			{
+				const FTagCompatibilityElement& El = TagRules[Rule];
+				if(!UsedRules.Contains(MakeRuleKey(true, RowIndex, Direction, Rule)))
+				{
+					NumDeadRules++;
+					UE_LOG(LogGeneration, Log, TEXT("ATileRegistry::ReportRules - dead rule of tag %s %s: %s:%s"),
+						*StaticEnum<ETileType>()->GetNameStringByValue((int64)Row.TileTag), *DirectionEnum->GetNameStringByValue(Direction),
+						*StaticEnum<ETileType>()->GetNameStringByValue((int64)El.Tag),
+						*RotationEnum->GetNameStringByValue((int64)El.Rotation));
+				}
+			}
+		}
+	}
+
+	// Asymmetric rules: "B fits in Direction of A" is set, but "A fits in reverse Direction of B" is not.
+	// CompiledRules has both sides anyway, but the user may not mean it
+	int32 NumAsymmetricRules = 0;
+	auto GetDeclared = [&DeclaredRules, NumWords](int32 Variant, int32 Direction)
+	{
+		return DeclaredRules.GetData() + (Variant * FWFCCompiledRules::NumDirections + Direction) * NumWords;
+	};
+	for(int32 My = 0; My < CompiledRules.NumVariants(); My++)
+	{
+		for(int32 Direction = 0; Direction < FWFCCompiledRules::NumDirections; Direction++)
+		{
+			const int32 ReverseDirection = FWFCCompiledRules::ReverseDirection(Direction);
+			WFCBitsetKernels::ForEachSetBit(GetDeclared(My, Direction), NumWords, [&](int32 Their)
+			{
+				if(!WFCBitsetKernels::TestBit(GetDeclared(Their, ReverseDirection), My))
+				{
+					NumAsymmetricRules++;
+					UE_LOG(LogGeneration, Log, TEXT("ATileRegistry::ReportRules - asymmetric rule: %s fits %s of %s, but not the other way"),
+						*CompiledRules.VariantNames[Their], *DirectionEnum->GetNameStringByValue(Direction),
+						*CompiledRules.VariantNames[My]);
+				}
+			});
+		}
+	}
+
+	// Variants which fit nothing in some side direction can stand only at the border of the city
+	int32 NumBorderOnlyVariants = 0;
+	for(int32 Variant = 0; Variant < CompiledRules.NumVariants(); Variant++)
+	{
+		for(int32 Direction = 0; Direction < 4; Direction++)
+		{
+			if(WFCBitsetKernels::Get().PopCount(CompiledRules.GetCompatible(Variant, Direction), NumWords) == 0)
+			{
+				NumBorderOnlyVariants++;
+				UE_LOG(LogGeneration, Log, TEXT("ATileRegistry::ReportRules - %s fits nothing %s, it can stand only at the border"),
+					*CompiledRules.VariantNames[Variant], *DirectionEnum->GetNameStringByValue(Direction));
+				break;
+			}
+		}
+	}
+
+	UE_LOG(LogGeneration, Display, TEXT("ATileRegistry::ReportRules - %d dead rules, %d asymmetric rules, %d variants only for the border"),
+		NumDeadRules, NumAsymmetricRules, NumBorderOnlyVariants);
+}
+
+bool ATileRegistry::ReloadRules()
+{
+	// Nothing compiled yet - Init() will read the lists
+	if(CompiledRules.NumVariants() == 0)
+		return false;
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	// Other tiles make other variants - the whole registry is compiled again
+	if(GetTileListHash() != TileListHash)
+	{
+		RegistryArray.RemoveAll([this](const FTileRegistryEl& Row)
+		{
+			return MergedAdditionalTiles.Contains(Row.Tile);
+		});
+		MergedAdditionalTiles.Reset();
+		ResetSuperpositionArrays();
+		Init();
+
+		UE_LOG(LogGeneration, Display, TEXT("ATileRegistry::ReloadRules - list of tiles changed, %d variants compiled in %.2f ms"),
+			CompiledRules.NumVariants(), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+		OnRulesChanged.Broadcast(TBitArray<>());
+		return true;
+	}
+
+	TArray<uint32> NewRowHashes;
+	TArray<uint32> NewTagHashes;
+	GetRuleHashes(NewRowHashes, NewTagHashes);
+
+	TBitArray<> ChangedRows(false, RegistryArray.Num());
+	int32 NumChangedRows = 0;
+	for(int32 Row = 0; Row < RegistryArray.Num(); Row++)
+	{
+		if(NewRowHashes[Row] != RowHashes[Row])
+		{
+			ChangedRows[Row] = true;
+			NumChangedRows++;
+			if(RegistryArray[Row].Tile != nullptr)
+			{
+				InitInstancePointersInRegistryRow(RegistryArray[Row]);
+			}
+		}
+	}
+	int32 NumChangedTags = 0;
+	for(int32 Tag = 0; Tag < NewTagHashes.Num(); Tag++)
+	{
+		NumChangedTags += NewTagHashes[Tag] != TagHashes[Tag] ? 1 : 0;
+	}
+	if(NumChangedRows == 0 && NumChangedTags == 0)
+		return false;
+
+	// Variants of changed rows and of changed tags
+	const int32 NumVariants = CompiledRules.NumVariants();
+	TBitArray<> ChangedVariants(false, NumVariants);
+	for(int32 v = 0; v < NumVariants; v++)
+	{
+		const int32 Tag = (int32)CompiledRules.VariantTags[v];
+		ChangedVariants[v] = ChangedRows[CompiledRules.Variants[v].TileIndexInRegister] || NewTagHashes[Tag] != TagHashes[Tag];
+	}
+
+	RowHashes = MoveTemp(NewRowHashes);
+	TagHashes = MoveTemp(NewTagHashes);
+	CompileRules(&ChangedVariants);
+
+	UE_LOG(LogGeneration, Display, TEXT("ATileRegistry::ReloadRules - %d rows and %d tags changed, recompiled in %.2f ms"),
+		NumChangedRows, NumChangedTags, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+	OnRulesChanged.Broadcast(ChangedVariants);
+	return true;
+}
+
+void ATileRegistry::ResetSuperpositionArrays()
+{
+	RoadSuperpositionArray.Reset();
+	RoadCrossroadsSuperpositionArray.Reset();
+	RoadOneLineSuperpositionArray.Reset();
+	RoadDoubleSuperpositionArray.Reset();
+	SidewalkInnerSuperpositionArray.Reset();
+	SidewalkBorderlineSuperpositionArray.Reset();
+	SidewalkCornerSuperpositionArray.Reset();
+	BuildingSuperpositionArray.Reset();
+	BuildingDoorSectionSuperpositionArray.Reset();
+	BuildingDoorCornerSuperpositionArray.Reset();
+	BuildingWindowSectionSuperpositionArray.Reset();
+	BuildingWindowCornerSuperpositionArray.Reset();
+	BuildingGreebleSuperpositionArray.Reset();
+	AirSuperpositionArray.Reset();
+	FullSuperpositionArray.Reset();
+}
+
+uint32 ATileRegistry::GetTileListHash() const
+{
+	uint32 Hash = GetTypeHash(RegistryArray.Num());
+	for(const FTileRegistryEl& Row : RegistryArray)
+	{
+		Hash = HashCombine(Hash, GetTypeHash(Row.Tile.Get()));
+	}
+	for(const TSubclassOf<ATile>& Tile : AdditionalTilesList)
+	{
+		Hash = HashCombine(Hash, GetTypeHash(Tile.Get()));
+	}
+	return Hash;
+}
+
+void ATileRegistry::GetRuleHashes(TArray<uint32>& OutRowHashes, TArray<uint32>& OutTagHashes) const
+{
+	OutRowHashes.Reset(RegistryArray.Num());
+	for(const FTileRegistryEl& Row : RegistryArray)
+	{
+		uint32 Hash = 0;
+		for(int32 Direction = 0; Direction < FWFCCompiledRules::NumDirections; Direction++)
+		{
+			const TArray<FTileCompatibilityElement>& Array = GetArrayOfCompatibleTilesByRelativeDeltaPosition(Row, (ETileCompatibilityDeltaPosition)Direction);
+			Hash = HashCombine(Hash, GetTypeHash(Array.Num()));
+			for(const FTileCompatibilityElement& El : Array)
+			{
+				Hash = HashCombine(Hash, HashCombine(GetTypeHash(El.Tile.Get()), GetTypeHash((uint8)El.Rotation)));
+			}
+		}
+		OutRowHashes.Add(Hash);
+	}
+
+	// Only the first row of a tag is compiled
+	OutTagHashes.Init(0, (int32)ETileType::ETT_MAX);
+	for(int32 Tag = 0; Tag < (int32)ETileType::ETT_MAX; Tag++)
+	{
+		const FTagRegistryEl* TagRow = TagRegistryArray.FindByPredicate([Tag](const FTagRegistryEl& Row)
+		{
+			return (int32)Row.TileTag == Tag;
+		});
+		if(!TagRow)
+			continue;
+
+		uint32 Hash = 1;
+		for(int32 Direction = 0; Direction < FWFCCompiledRules::NumDirections; Direction++)
+		{
+			const TArray<FTagCompatibilityElement>& Array = GetArrayOfCompatibleTagsByRelativeDeltaPosition(*TagRow, (ETileCompatibilityDeltaPosition)Direction);
+			Hash = HashCombine(Hash, GetTypeHash(Array.Num()));
+			for(const FTagCompatibilityElement& El : Array)
+			{
+				Hash = HashCombine(Hash, HashCombine(GetTypeHash((uint8)El.Tag), GetTypeHash((uint8)El.Rotation)));
+			}
+		}
+		OutTagHashes[Tag] = Hash;
+	}
+}
+
+#if WITH_EDITOR
+void ATileRegistry::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	const FName MemberName = PropertyChangedEvent.MemberProperty ? PropertyChangedEvent.MemberProperty->GetFName() : NAME_None;
+	if(MemberName == GET_MEMBER_NAME_CHECKED(ATileRegistry, RegistryArray)
+		|| MemberName == GET_MEMBER_NAME_CHECKED(ATileRegistry, TagRegistryArray)
+		|| MemberName == GET_MEMBER_NAME_CHECKED(ATileRegistry, AdditionalTilesList))
+	{
+		ReloadRules();
+	}
+}
+#endif
+
 // Called when the game starts or when spawned
 void ATileRegistry::BeginPlay()
 {
@@ -412,6 +930,16 @@ void ATileRegistry::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
+	// Lists can be changed without PostEditChangeProperty (Blueprints, console) - compare their hashes from time to time
+	if(bHotReloadRules)
+	{
+		TimeToRulesPoll -= DeltaTime;
+		if(TimeToRulesPoll <= 0.f)
+		{
+			TimeToRulesPoll = RulesPollInterval;
+			ReloadRules();
+		}
+	}
 }
 
 TArray<FWorldArrayWFCSuperpositionElement> ATileRegistry::GetSuperpositionArrayByTag(ETileType Tag) const
@@ -507,9 +1035,8 @@ void ATileRegistry::InitInstancePointersInCompatibilityArray(TArray<FTileCompati
 {
 	for(int k = 0; k < Array.Num(); k++)
 	{
-		check(Array[k].Tile != nullptr);
-		
-		Array[k].TileInstance = Array[k].Tile.GetDefaultObject();
+		// An element which is being edited may have no tile yet - CompileRules() skips it
+		Array[k].TileInstance = Array[k].Tile != nullptr ? Array[k].Tile.GetDefaultObject() : nullptr;
 	}
 }
 
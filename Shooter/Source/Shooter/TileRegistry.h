@@ -5,11 +5,16 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "Tile.h"
-#include "WorldArrayItem.h"
+#include "WorldArrayWFCSuperpositionElement.h"
 #include "TileCompatibilityDeltaPosition.h"
 #include "TagCompatibilityElement.h"
+#include "WFCCompiledRules.h"
 #include "TileRegistry.generated.h"
 
+// ChangedVariants - variants of FWFCCompiledRules whose rules were recompiled
+// Empty - the list of tiles changed and all the variants are new, solved variants can't be kept
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnTileRulesChanged, const TBitArray<>& /* ChangedVariants */);
+
 USTRUCT(BlueprintType)
 struct FTileRegistryEl
 {
@@ -96,11 +101,11 @@ public:
 	// Output: ETileCompatibilityDeltaPosition::ETDP_OnBackward
 	// ETileCompatibilityDeltaPosition GetLocalCompatibilityDeltaPositionByWorldDeltaPosition(ETileRotation CurrentRotation, ETileCompatibilityDeltaPosition WorldDeltaPosition);
 
-	void GetArrayOfCompatibleTilesByRelativeDeltaPosition(TArray<FTileCompatibilityElement>& OutArray, FTileRegistryEl RegistryRow,
-			ETileCompatibilityDeltaPosition RelativeDeltaPosition);
+	const TArray<FTileCompatibilityElement>& GetArrayOfCompatibleTilesByRelativeDeltaPosition(const FTileRegistryEl& RegistryRow,
+			ETileCompatibilityDeltaPosition RelativeDeltaPosition) const;
 	
-	void GetArrayOfCompatibleTagsByRelativeDeltaPosition(TArray<FTagCompatibilityElement>& OutArray, FTagRegistryEl RegistryRow,
-			ETileCompatibilityDeltaPosition RelativeDeltaPosition);
+	const TArray<FTagCompatibilityElement>& GetArrayOfCompatibleTagsByRelativeDeltaPosition(const FTagRegistryEl& RegistryRow,
+			ETileCompatibilityDeltaPosition RelativeDeltaPosition) const;
 	
 	// Gets the delta position corresponding to the OnXCompatible array
 	// Manages the turn of tile
@@ -112,14 +117,28 @@ public:
 
 	ETileRotation GetRelativeRotationOfTheirTile(ETileRotation MyRotation, ETileRotation TheirRotation, ETileCompatibilityDeltaPosition TheirRelativePosition);
 
-	bool DoesCompatibilityArrayContainThisTile(TArray<FTileCompatibilityElement> CompatibilityArray, int TileIndexInRegister, ETileRotation RelativeRotation);
+	bool DoesCompatibilityArrayContainThisTile(const TArray<FTileCompatibilityElement>& CompatibilityArray, int TileIndexInRegister, ETileRotation RelativeRotation);
 
-	bool DoesTagCompatibilityArrayContainThisTag(TArray<FTagCompatibilityElement> CompatibilityArray, ETileType Tag, ETileRotation RelativeRotation);
+	bool DoesTagCompatibilityArrayContainThisTag(const TArray<FTagCompatibilityElement>& CompatibilityArray, ETileType Tag, ETileRotation RelativeRotation);
 
 	ETileCompatibilityDeltaPosition ReverseWorldDirection(ETileCompatibilityDeltaPosition direction) const;
 	
 	void Init();
 
+	// Rules compiled into bitsets by Init(). Used by WFC instead of IsCompatible()
+	FORCEINLINE const FWFCCompiledRules& GetCompiledRules() const { return CompiledRules; }
+
+	// Compiles the rules again if RegistryArray, TagRegistryArray or AdditionalTilesList changed after Init()
+	// Changed rows only recompile the masks of their variants. Other tiles in the lists recompile everything
+	// Returns true and broadcasts OnRulesChanged if anything changed
+	bool ReloadRules();
+
+	FOnTileRulesChanged OnRulesChanged;
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
@@ -127,6 +146,23 @@ protected:
 	void InitInstancePointersInCompatibilityArray(TArray<FTileCompatibilityElement> &Array);
 	void InitInstancePointersInRegistryRow(FTileRegistryEl &Row);
 
+	// Compiles RegistryArray, TagRegistryArray and superposition arrays into CompiledRules
+	// ChangedVariants - only pairs with these variants are compiled again, the rest of CompiledRules stays. nullptr - everything
+	void CompileRules(const TBitArray<>* ChangedVariants = nullptr);
+
+	void ResetSuperpositionArrays();
+
+	// Hash of the classes of RegistryArray and AdditionalTilesList - they make the variants
+	uint32 GetTileListHash() const;
+	// Hashes of the compatibility arrays: [Row of RegistryArray] and [ETileType] of TagRegistryArray
+	void GetRuleHashes(TArray<uint32>& OutRowHashes, TArray<uint32>& OutTagHashes) const;
+
+	// Logs rules which do nothing, rules set only from one side and variants which can't stand inside the city
+	// DeclaredRules - masks in the layout of FWFCCompiledRules::Compatible with only the side set in the registry
+	// UsedRules - keys of the compatibility elements of the registry which matched at least one variant: index of the row,
+	// relative direction and index of the element, see MakeRuleKey() of TileRegistry.cpp
+	void ReportRules(const TArray<uint64>& DeclaredRules, const TSet<uint64>& UsedRules) const;
+
 	bool IsTileARoad(const ATile* Tile);
 	bool IsTileARoadCrossroads(const ATile* Tile);
 	bool IsTileARoadOneLine(const ATile* Tile);
@@ -157,6 +193,14 @@ private:
 	// Add here additional tiles without need of individual rules
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true"), Category = Tiles)
 	TArray<TSubclassOf<ATile>> AdditionalTilesList;
+
+	// Checks the rules for changes every RulesPollInterval seconds while playing and recompiles them
+	// Off by default - turn it on while tuning the rules, changes in the details panel are reloaded without it
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true"), Category = HotReload)
+	bool bHotReloadRules;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true", ClampMin=0.1), Category = HotReload)
+	float RulesPollInterval;
 	
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true"), Category = TileTags)
 	TArray<ETileType> RoadTags;
@@ -185,4 +229,19 @@ private:
 	TArray<FWorldArrayWFCSuperpositionElement> AirSuperpositionArray;
 	// TArray<FWorldArrayWFCSuperpositionElement> CrosswalkSuperpositionArray;
 	TArray<FWorldArrayWFCSuperpositionElement> FullSuperpositionArray;
+
+	FWFCCompiledRules CompiledRules;
+
+	// Rules as the user has set them, in the layout of FWFCCompiledRules::Compatible - for the report of asymmetric rules
+	TArray<uint64> DeclaredRuleMasks;
+
+	// Rows of RegistryArray added by Init() from AdditionalTilesList
+	TArray<TSubclassOf<ATile>> MergedAdditionalTiles;
+
+	// State of the lists on the last compilation
+	uint32 TileListHash;
+	TArray<uint32> RowHashes;
+	TArray<uint32> TagHashes;
+
+	float TimeToRulesPoll;
 };
@@ -0,0 +1,84 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+// Automation tests of the hot reload of ATileRegistry rules
+// Run in the editor: Session Frontend > Automation > Shooter.WFC.Registry, or "Automation RunTests Shooter.WFC.Registry"
+
+
+#include "TileRegistry.h"
+#include "Engine/World.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	int32 CountCompatiblePairs(const FWFCCompiledRules& Rules)
+	{
+		return WFCBitsetKernels::Get().PopCount(Rules.Compatible.GetData(), Rules.Compatible.Num());
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTileRegistryHotReloadTest, "Shooter.WFC.Registry.HotReload",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FTileRegistryHotReloadTest::RunTest(const FString& Parameters)
+{
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false);
+	ATileRegistry* Registry = World->SpawnActor<ATileRegistry>();
+
+	// One plain tile without rules: its rotations are the variants
+	FTileRegistryEl Row;
+	Row.Tile = ATile::StaticClass();
+	Row.TileInstance = nullptr;
+	Registry->RegistryArray.Add(Row);
+	Registry->Init();
+
+	const FWFCCompiledRules& Rules = Registry->GetCompiledRules();
+	const int32 NumVariants = Rules.NumVariants();
+	const TArray<uint64> InitialCompatible = Rules.Compatible;
+	TestTrue(TEXT("Tile has variants"), NumVariants > 0);
+
+	int32 NumBroadcasts = 0;
+	TBitArray<> LastChangedVariants;
+	Registry->OnRulesChanged.AddLambda([&NumBroadcasts, &LastChangedVariants](const TBitArray<>& ChangedVariants)
+	{
+		NumBroadcasts++;
+		LastChangedVariants = ChangedVariants;
+	});
+
+	TestFalse(TEXT("Unchanged rules are reloaded"), Registry->ReloadRules());
+	TestEqual(TEXT("Broadcasts of unchanged rules"), NumBroadcasts, 0);
+
+	// A rule of the row recompiles only the variants of the row - here all of them
+	FTileCompatibilityElement Rule;
+	Rule.Tile = ATile::StaticClass();
+	Rule.Rotation = ETileRotation::ETR_Forward;
+	Registry->RegistryArray[0].OnRightCompatible.Add(Rule);
+	TestTrue(TEXT("Added rule is reloaded"), Registry->ReloadRules());
+	TestEqual(TEXT("Broadcasts of the added rule"), NumBroadcasts, 1);
+	TestEqual(TEXT("Variants in the change"), LastChangedVariants.Num(), NumVariants);
+	TestEqual(TEXT("Changed variants"), LastChangedVariants.CountSetBits(), NumVariants);
+	TestEqual(TEXT("Variants after the reload"), Rules.NumVariants(), NumVariants);
+	TestTrue(TEXT("Added rule makes compatible pairs"), CountCompatiblePairs(Rules) > 0);
+
+	// Removed rule takes its pairs away: the masks are the same as before it
+	Registry->RegistryArray[0].OnRightCompatible.Reset();
+	TestTrue(TEXT("Removed rule is reloaded"), Registry->ReloadRules());
+	TestEqual(TEXT("Broadcasts of the removed rule"), NumBroadcasts, 2);
+	TestTrue(TEXT("Masks after the removed rule"), Rules.Compatible == InitialCompatible);
+
+	// A rule of a tag is a change of the variants of the tag
+	FTagRegistryEl TagRow;
+	TagRow.TileTag = ATile::StaticClass()->GetDefaultObject<ATile>()->GetTileTypeTag();
+	TagRow.OnForwardCompatible.Add({ TagRow.TileTag, ETileRotation::ETR_Forward });
+	Registry->TagRegistryArray.Add(TagRow);
+	TestTrue(TEXT("Added tag rule is reloaded"), Registry->ReloadRules());
+	TestEqual(TEXT("Broadcasts of the added tag rule"), NumBroadcasts, 3);
+	TestEqual(TEXT("Variants changed by the tag rule"), LastChangedVariants.CountSetBits(), NumVariants);
+	TestTrue(TEXT("Tag rule makes compatible pairs"), CountCompatiblePairs(Rules) > 0);
+
+	World->DestroyWorld(false);
+	return true;
+}
+
+#endif
@@ -0,0 +1,340 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WFCBitsetKernels.h"
+#include "GenerationLogs.h"
+#include "HAL/IConsoleManager.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+	#define WFC_KERNELS_X86 1
+#else
+	#define WFC_KERNELS_X86 0
+#endif
+
+#if WFC_KERNELS_X86
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+		// MSVC allows AVX2 intrinsics in any function
+		#define WFC_AVX2_FUNCTION
+	#else
+		#include <cpuid.h>
+		// Clang and GCC compile AVX2 intrinsics only in functions with AVX2 target
+		#define WFC_AVX2_FUNCTION __attribute__((target("avx2")))
+	#endif
+#endif
+
+static TAutoConsoleVariable<int32> CVarWFCBitsetKernels(
+	TEXT("wfc.BitsetKernels"),
+	0,
+	TEXT("Limits the instruction set of WFC bitset kernels. Read once at startup.\n")
+	TEXT("0: best supported (default), 1: scalar, 2: SSE, 3: AVX2"),
+	ECVF_ReadOnly);
+
+// SCALAR ================================
+
+static void OrInto_Scalar(uint64* RESTRICT Out, const uint64* RESTRICT In, int32 NumWords)
+{
+	for(int32 i = 0; i < NumWords; i++)
+	{
+		Out[i] |= In[i];
+	}
+}
+
+static bool AndInto_Scalar(uint64* RESTRICT Out, const uint64* RESTRICT In, int32 NumWords)
+{
+	uint64 Changed = 0;
+	for(int32 i = 0; i < NumWords; i++)
+	{
+		const uint64 New = Out[i] & In[i];
+		Changed |= New ^ Out[i];
+		Out[i] = New;
+	}
+	return Changed != 0;
+}
+
+static int32 PopCount_Scalar(const uint64* Mask, int32 NumWords)
+{
+	int32 Count = 0;
+	for(int32 i = 0; i < NumWords; i++)
+	{
+		Count += (int32)FMath::CountBits(Mask[i]);
+	}
+	return Count;
+}
+
+static void WeightedSums_Scalar(const uint64* Mask, const float* Weights, const float* WeightLogWeights, int32 NumWords,
+	float& OutSumWeights, float& OutSumWeightLogWeights)
+{
+	float SumWeights = 0.f;
+	float SumWeightLogWeights = 0.f;
+	WFCBitsetKernels::ForEachSetBit(Mask, NumWords, [&](int32 Bit)
+	{
+		SumWeights += Weights[Bit];
+		SumWeightLogWeights += WeightLogWeights[Bit];
+	});
+	OutSumWeights = SumWeights;
+	OutSumWeightLogWeights = SumWeightLogWeights;
+}
+
+static const FWFCBitsetKernelTable ScalarKernels = {
+	&OrInto_Scalar, &AndInto_Scalar, &PopCount_Scalar, &WeightedSums_Scalar, TEXT("Scalar") };
+
+#if WFC_KERNELS_X86
+
+// SSE ================================
+// SSE2 is the baseline of x86-64, these kernels need no CPU check
+
+static void OrInto_SSE(uint64* RESTRICT Out, const uint64* RESTRICT In, int32 NumWords)
+{
+	for(int32 i = 0; i < NumWords; i += 2)
+	{
+		const __m128i A = _mm_loadu_si128((const __m128i*)(Out + i));
+		const __m128i B = _mm_loadu_si128((const __m128i*)(In + i));
+		_mm_storeu_si128((__m128i*)(Out + i), _mm_or_si128(A, B));
+	}
+}
+
+static bool AndInto_SSE(uint64* RESTRICT Out, const uint64* RESTRICT In, int32 NumWords)
+{
+	__m128i Changed = _mm_setzero_si128();
+	for(int32 i = 0; i < NumWords; i += 2)
+	{
+		const __m128i A = _mm_loadu_si128((const __m128i*)(Out + i));
+		const __m128i New = _mm_and_si128(A, _mm_loadu_si128((const __m128i*)(In + i)));
+		Changed = _mm_or_si128(Changed, _mm_xor_si128(A, New));
+		_mm_storeu_si128((__m128i*)(Out + i), New);
+	}
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(Changed, _mm_setzero_si128())) != 0xFFFF;
+}
+
+static void WeightedSums_SSE(const uint64* Mask, const float* Weights, const float* WeightLogWeights, int32 NumWords,
+	float& OutSumWeights, float& OutSumWeightLogWeights)
+{
+	// Every nibble of the mask selects 4 lanes of weights
+	const __m128i BitSelect = _mm_setr_epi32(1, 2, 4, 8);
+	__m128 SumWeights = _mm_setzero_ps();
+	__m128 SumWeightLogWeights = _mm_setzero_ps();
+
+	for(int32 Word = 0; Word < NumWords; Word++)
+	{
+		uint64 Bits = Mask[Word];
+		int32 Base = Word * 64;
+		while(Bits)
+		{
+			const int32 Nibble = (int32)(Bits & 0xF);
+			if(Nibble)
+			{
+				const __m128i Lanes = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(Nibble), BitSelect), BitSelect);
+				const __m128 LaneMask = _mm_castsi128_ps(Lanes);
+				SumWeights = _mm_add_ps(SumWeights, _mm_and_ps(LaneMask, _mm_loadu_ps(Weights + Base)));
+				SumWeightLogWeights = _mm_add_ps(SumWeightLogWeights, _mm_and_ps(LaneMask, _mm_loadu_ps(WeightLogWeights + Base)));
+			}
+			Bits >>= 4;
+			Base += 4;
+		}
+	}
+
+	float W[4];
+	float WL[4];
+	_mm_storeu_ps(W, SumWeights);
+	_mm_storeu_ps(WL, SumWeightLogWeights);
+	OutSumWeights = W[0] + W[1] + W[2] + W[3];
+	OutSumWeightLogWeights = WL[0] + WL[1] + WL[2] + WL[3];
+}
+
+// POPCNT is not a part of SSE2 - popcount stays scalar
+static const FWFCBitsetKernelTable SSEKernels = {
+	&OrInto_SSE, &AndInto_SSE, &PopCount_Scalar, &WeightedSums_SSE, TEXT("SSE") };
+
+// AVX2 ================================
+
+WFC_AVX2_FUNCTION static void OrInto_AVX2(uint64* RESTRICT Out, const uint64* RESTRICT In, int32 NumWords)
+{
+	for(int32 i = 0; i < NumWords; i += 4)
+	{
+		const __m256i A = _mm256_loadu_si256((const __m256i*)(Out + i));
+		const __m256i B = _mm256_loadu_si256((const __m256i*)(In + i));
+		_mm256_storeu_si256((__m256i*)(Out + i), _mm256_or_si256(A, B));
+	}
+}
+
+WFC_AVX2_FUNCTION static bool AndInto_AVX2(uint64* RESTRICT Out, const uint64* RESTRICT In, int32 NumWords)
+{
+	__m256i Changed = _mm256_setzero_si256();
+	for(int32 i = 0; i < NumWords; i += 4)
+	{
+		const __m256i A = _mm256_loadu_si256((const __m256i*)(Out + i));
+		const __m256i New = _mm256_and_si256(A, _mm256_loadu_si256((const __m256i*)(In + i)));
+		Changed = _mm256_or_si256(Changed, _mm256_xor_si256(A, New));
+		_mm256_storeu_si256((__m256i*)(Out + i), New);
+	}
+	return !_mm256_testz_si256(Changed, Changed);
+}
+
+WFC_AVX2_FUNCTION static int32 PopCount_AVX2(const uint64* Mask, int32 NumWords)
+{
+	// Nibble lookup popcount (W. Mula): count bits of each byte with pshufb, then sum bytes with psadbw
+	const __m256i Lookup = _mm256_setr_epi8(
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i LowMask = _mm256_set1_epi8(0x0F);
+	__m256i Total = _mm256_setzero_si256();
+
+	for(int32 i = 0; i < NumWords; i += 4)
+	{
+		const __m256i V = _mm256_loadu_si256((const __m256i*)(Mask + i));
+		const __m256i Low = _mm256_and_si256(V, LowMask);
+		const __m256i High = _mm256_and_si256(_mm256_srli_epi16(V, 4), LowMask);
+		const __m256i Count = _mm256_add_epi8(_mm256_shuffle_epi8(Lookup, Low), _mm256_shuffle_epi8(Lookup, High));
+		Total = _mm256_add_epi64(Total, _mm256_sad_epu8(Count, _mm256_setzero_si256()));
+	}
+
+	alignas(32) uint64 Lanes[4];
+	_mm256_store_si256((__m256i*)Lanes, Total);
+	return (int32)(Lanes[0] + Lanes[1] + Lanes[2] + Lanes[3]);
+}
+
+WFC_AVX2_FUNCTION static void WeightedSums_AVX2(const uint64* Mask, const float* Weights, const float* WeightLogWeights, int32 NumWords,
+	float& OutSumWeights, float& OutSumWeightLogWeights)
+{
+	// Every byte of the mask selects 8 lanes of weights
+	const __m256i BitSelect = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+	__m256 SumWeights = _mm256_setzero_ps();
+	__m256 SumWeightLogWeights = _mm256_setzero_ps();
+
+	for(int32 Word = 0; Word < NumWords; Word++)
+	{
+		uint64 Bits = Mask[Word];
+		int32 Base = Word * 64;
+		while(Bits)
+		{
+			const int32 Byte = (int32)(Bits & 0xFF);
+			if(Byte)
+			{
+				const __m256i Lanes = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(Byte), BitSelect), BitSelect);
+				const __m256 LaneMask = _mm256_castsi256_ps(Lanes);
+				SumWeights = _mm256_add_ps(SumWeights, _mm256_and_ps(LaneMask, _mm256_loadu_ps(Weights + Base)));
+				SumWeightLogWeights = _mm256_add_ps(SumWeightLogWeights, _mm256_and_ps(LaneMask, _mm256_loadu_ps(WeightLogWeights + Base)));
+			}
+			Bits >>= 8;
+			Base += 8;
+		}
+	}
+
+	alignas(32) float W[8];
+	alignas(32) float WL[8];
+	_mm256_store_ps(W, SumWeights);
+	_mm256_store_ps(WL, SumWeightLogWeights);
+	OutSumWeights = W[0] + W[1] + W[2] + W[3] + W[4] + W[5] + W[6] + W[7];
+	OutSumWeightLogWeights = WL[0] + WL[1] + WL[2] + WL[3] + WL[4] + WL[5] + WL[6] + WL[7];
+}
+
+static const FWFCBitsetKernelTable AVX2Kernels = {
+	&OrInto_AVX2, &AndInto_AVX2, &PopCount_AVX2, &WeightedSums_AVX2, TEXT("AVX2") };
+
+static void CpuId(int32 Leaf, int32 SubLeaf, int32 OutRegisters[4])
+{
+#if defined(_MSC_VER)
+	__cpuidex(OutRegisters, Leaf, SubLeaf);
+#else
+	uint32 Eax, Ebx, Ecx, Edx;
+	__cpuid_count(Leaf, SubLeaf, Eax, Ebx, Ecx, Edx);
+	OutRegisters[0] = (int32)Eax;
+	OutRegisters[1] = (int32)Ebx;
+	OutRegisters[2] = (int32)Ecx;
+	OutRegisters[3] = (int32)Edx;
+#endif
+}
+
+static uint64 ReadExtendedControlRegister()
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	uint32 Eax, Edx;
+	__asm__ volatile("xgetbv" : "=a"(Eax), "=d"(Edx) : "c"(0));
+	return ((uint64)Edx << 32) | Eax;
+#endif
+}
+
+static bool IsAVX2Supported()
+{
+	int32 Registers[4];
+	CpuId(0, 0, Registers);
+	if(Registers[0] < 7)
+	{
+		return false;
+	}
+
+	// AVX and OSXSAVE
+	CpuId(1, 0, Registers);
+	const bool bHasAVX = (Registers[2] & (1 << 28)) != 0;
+	const bool bHasOSXSAVE = (Registers[2] & (1 << 27)) != 0;
+	if(!bHasAVX || !bHasOSXSAVE)
+	{
+		return false;
+	}
+	
+	// OS saves XMM and YMM registers on context switch
+	if((ReadExtendedControlRegister() & 0x6) != 0x6)
+	{
+		return false;
+	}
+
+	CpuId(7, 0, Registers);
+	return (Registers[1] & (1 << 5)) != 0;
+}
+
+#endif // WFC_KERNELS_X86
+
+namespace WFCBitsetKernels
+{
+	const FWFCBitsetKernelTable& GetScalar()
+	{
+		return ScalarKernels;
+	}
+
+	const FWFCBitsetKernelTable* GetSSE()
+	{
+#if WFC_KERNELS_X86
+		return &SSEKernels;
+#else
+		return nullptr;
+#endif
+	}
+
+	const FWFCBitsetKernelTable* GetAVX2()
+	{
+#if WFC_KERNELS_X86
+		static const bool bIsSupported = IsAVX2Supported();
+		return bIsSupported ? &AVX2Kernels : nullptr;
+#else
+		return nullptr;
+#endif
+	}
+
+	static const FWFCBitsetKernelTable& ChooseKernels()
+	{
+		const int32 Limit = CVarWFCBitsetKernels.GetValueOnAnyThread();
+
+		const FWFCBitsetKernelTable* Chosen = &GetScalar();
+		if((Limit == 0 || Limit >= 2) && GetSSE())
+		{
+			Chosen = GetSSE();
+		}
+		if((Limit == 0 || Limit >= 3) && GetAVX2())
+		{
+			Chosen = GetAVX2();
+		}
+
+		UE_LOG(LogGeneration, Display, TEXT("WFC bitset kernels: %s"), Chosen->Name);
+		return *Chosen;
+	}
+
+	const FWFCBitsetKernelTable& Get()
+	{
+		static const FWFCBitsetKernelTable& Chosen = ChooseKernels();
+		return Chosen;
+	}
+}
@@ -0,0 +1,81 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Candidate masks of WFC are arrays of uint64 words, one bit per tile variant
+// Amount of words in a mask is always a multiple of this value (256 bits), so vectorised kernels never need a tail loop
+#define WFC_MASK_WORD_ALIGNMENT 4
+
+/**
+ * Set of kernels working with WFC candidate masks
+ * NumWords of every mask passed to kernels is a multiple of WFC_MASK_WORD_ALIGNMENT
+ * Weights arrays are padded with zeros up to NumWords * 64 elements
+ */
+struct SHOOTER_API FWFCBitsetKernelTable
+{
+	// Out |= In
+	void (*OrInto)(uint64* RESTRICT Out, const uint64* RESTRICT In, int32 NumWords);
+	
+	// Out &= In
+	// Returns true if Out has changed
+	bool (*AndInto)(uint64* RESTRICT Out, const uint64* RESTRICT In, int32 NumWords);
+	
+	// Returns amount of set bits
+	int32 (*PopCount)(const uint64* Mask, int32 NumWords);
+	
+	// Sums Weights and WeightLogWeights (w * ln(w)) of set bits
+	// Entropy of the mask is ln(SumWeights) - SumWeightLogWeights / SumWeights
+	void (*WeightedSums)(const uint64* Mask, const float* Weights, const float* WeightLogWeights, int32 NumWords,
+		float& OutSumWeights, float& OutSumWeightLogWeights);
+
+	const TCHAR* Name;
+};
+
+namespace WFCBitsetKernels
+{
+	// Kernels chosen at startup: the widest instruction set supported by CPU, unless limited by wfc.BitsetKernels
+	SHOOTER_API const FWFCBitsetKernelTable& Get();
+
+	SHOOTER_API const FWFCBitsetKernelTable& GetScalar();
+	// Returns nullptr if the instruction set is not supported by CPU or by the build
+	SHOOTER_API const FWFCBitsetKernelTable* GetSSE();
+	SHOOTER_API const FWFCBitsetKernelTable* GetAVX2();
+
+	// Amount of words in a mask of NumBits candidates
+	FORCEINLINE int32 GetNumWords(int32 NumBits)
+	{
+		return Align(FMath::DivideAndRoundUp(FMath::Max(NumBits, 1), 64), WFC_MASK_WORD_ALIGNMENT);
+	}
+
+	FORCEINLINE void SetBit(uint64* Mask, int32 Bit)
+	{
+		Mask[Bit >> 6] |= 1ull << (Bit & 63);
+	}
+
+	FORCEINLINE void ClearBit(uint64* Mask, int32 Bit)
+	{
+		Mask[Bit >> 6] &= ~(1ull << (Bit & 63));
+	}
+
+	FORCEINLINE bool TestBit(const uint64* Mask, int32 Bit)
+	{
+		return (Mask[Bit >> 6] & (1ull << (Bit & 63))) != 0;
+	}
+
+	// Calls Func(int32 Bit) for every set bit of the mask in increasing order
+	template<typename FuncType>
+	FORCEINLINE void ForEachSetBit(const uint64* Mask, int32 NumWords, FuncType Func)
+	{
+		for(int32 Word = 0; Word < NumWords; Word++)
+		{
+			uint64 Bits = Mask[Word];
+			while(Bits)
+			{
+				Func(Word * 64 + (int32)FMath::CountTrailingZeros64(Bits));
+				Bits &= Bits - 1;
+			}
+		}
+	}
+}
@@ -0,0 +1,163 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+// Micro-benchmarks of WFC bitset kernels
+// Usage: WFC.BenchmarkBitsetKernels [NumCandidates ...]
+// Without arguments measures the candidate counts of tile registries in the world and a few reference sizes
+
+
+#include "WFCBitsetKernels.h"
+#include "TileRegistry.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+
+namespace
+{
+	// Enough masks to get out of L1 as WFC domain planes do
+	const int32 BenchmarkNumMasks = 4096;
+	const int32 BenchmarkIterations = 64;
+
+	volatile uint64 BenchmarkSink = 0;
+
+	void RunKernelsBenchmark(const FWFCBitsetKernelTable& Kernels, int32 NumCandidates)
+	{
+		const int32 NumWords = WFCBitsetKernels::GetNumWords(NumCandidates);
+		const int32 NumBits = NumWords * 64;
+
+		FRandomStream RandomStream(NumCandidates);
+		TArray<uint64> Masks;
+		Masks.SetNumZeroed(BenchmarkNumMasks * NumWords);
+		for(int32 i = 0; i < BenchmarkNumMasks; i++)
+		{
+			for(int32 Bit = 0; Bit < NumCandidates; Bit++)
+			{
+				if(RandomStream.RandHelper(4) != 0)
+				{
+					WFCBitsetKernels::SetBit(Masks.GetData() + i * NumWords, Bit);
+				}
+			}
+		}
+
+		TArray<float> Weights;
+		TArray<float> WeightLogWeights;
+		Weights.Init(0.f, NumBits);
+		WeightLogWeights.Init(0.f, NumBits);
+		for(int32 Bit = 0; Bit < NumCandidates; Bit++)
+		{
+			Weights[Bit] = RandomStream.RandRange(1, 100);
+			WeightLogWeights[Bit] = Weights[Bit] * FMath::Loge(Weights[Bit]);
+		}
+
+		TArray<uint64> Accumulator;
+		Accumulator.SetNumZeroed(NumWords);
+		const double NumCalls = (double)BenchmarkNumMasks * BenchmarkIterations;
+		uint64 Sink = 0;
+
+		double Start = FPlatformTime::Seconds();
+		for(int32 Iteration = 0; Iteration < BenchmarkIterations; Iteration++)
+		{
+			for(int32 i = 0; i < BenchmarkNumMasks; i++)
+			{
+				Kernels.OrInto(Accumulator.GetData(), Masks.GetData() + i * NumWords, NumWords);
+			}
+			Sink += Accumulator[0];
+		}
+		const double OrTime = FPlatformTime::Seconds() - Start;
+
+		Start = FPlatformTime::Seconds();
+		for(int32 Iteration = 0; Iteration < BenchmarkIterations; Iteration++)
+		{
+			FMemory::Memset(Accumulator.GetData(), 0xFF, NumWords * sizeof(uint64));
+			for(int32 i = 0; i < BenchmarkNumMasks; i++)
+			{
+				Sink += Kernels.AndInto(Accumulator.GetData(), Masks.GetData() + i * NumWords, NumWords) ? 1 : 0;
+			}
+		}
+		const double AndTime = FPlatformTime::Seconds() - Start;
+
+		Start = FPlatformTime::Seconds();
+		for(int32 Iteration = 0; Iteration < BenchmarkIterations; Iteration++)
+		{
+			for(int32 i = 0; i < BenchmarkNumMasks; i++)
+			{
+				Sink += Kernels.PopCount(Masks.GetData() + i * NumWords, NumWords);
+			}
+		}
+		const double PopCountTime = FPlatformTime::Seconds() - Start;
+
+		float SumWeights = 0.f;
+		float SumWeightLogWeights = 0.f;
+		Start = FPlatformTime::Seconds();
+		for(int32 Iteration = 0; Iteration < BenchmarkIterations; Iteration++)
+		{
+			for(int32 i = 0; i < BenchmarkNumMasks; i++)
+			{
+				float W, WL;
+				Kernels.WeightedSums(Masks.GetData() + i * NumWords, Weights.GetData(), WeightLogWeights.GetData(), NumWords, W, WL);
+				SumWeights += W;
+				SumWeightLogWeights += WL;
+			}
+		}
+		const double EntropyTime = FPlatformTime::Seconds() - Start;
+
+		BenchmarkSink = Sink + (uint64)(SumWeights + SumWeightLogWeights);
+
+		UE_LOG(LogGeneration, Display,
+			TEXT("%-6s candidates: %4d (%2d words) | OR: %7.2f ns | AND: %7.2f ns | PopCount: %7.2f ns | Entropy: %7.2f ns"),
+			Kernels.Name, NumCandidates, NumWords,
+			OrTime * 1e9 / NumCalls, AndTime * 1e9 / NumCalls,
+			PopCountTime * 1e9 / NumCalls, EntropyTime * 1e9 / NumCalls);
+	}
+
+	void RunBitsetKernelsBenchmark(const TArray<FString>& Args, UWorld* World)
+	{
+		TArray<int32> CandidateCounts;
+		for(const FString& Arg : Args)
+		{
+			const int32 Count = FCString::Atoi(*Arg);
+			if(Count > 0)
+			{
+				CandidateCounts.AddUnique(Count);
+			}
+		}
+
+		if(CandidateCounts.Num() == 0)
+		{
+			// Real tile counts of the registries, then reference sizes
+			if(World)
+			{
+				for(TActorIterator<ATileRegistry> It(World); It; ++It)
+				{
+					const int32 Count = It->GetCompiledRules().NumVariants();
+					if(Count > 0)
+					{
+						CandidateCounts.AddUnique(Count);
+					}
+				}
+			}
+			CandidateCounts.AddUnique(64);
+			CandidateCounts.AddUnique(256);
+			CandidateCounts.AddUnique(512);
+		}
+
+		TArray<const FWFCBitsetKernelTable*> KernelTables = {
+			&WFCBitsetKernels::GetScalar(), WFCBitsetKernels::GetSSE(), WFCBitsetKernels::GetAVX2() };
+
+		UE_LOG(LogGeneration, Display, TEXT("WFC bitset kernels benchmark. Active kernels: %s. Time per call:"),
+			WFCBitsetKernels::Get().Name);
+		for(int32 Count : CandidateCounts)
+		{
+			for(const FWFCBitsetKernelTable* Kernels : KernelTables)
+			{
+				if(Kernels)
+				{
+					RunKernelsBenchmark(*Kernels, Count);
+				}
+			}
+		}
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs BenchmarkBitsetKernelsCommand(
+	TEXT("WFC.BenchmarkBitsetKernels"),
+	TEXT("Measures WFC bitset kernels of every supported instruction set. Args: [NumCandidates ...]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&RunBitsetKernelsBenchmark));
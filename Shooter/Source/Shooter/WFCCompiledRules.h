@@ -0,0 +1,106 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "TileType.h"
+#include "TileColorTag.h"
+#include "TileCompatibilityDeltaPosition.h"
+#include "WorldArrayWFCSuperpositionElement.h"
+#include "WFCBitsetKernels.h"
+
+// Compatibility rules of ATileRegistry compiled into bitsets
+// Every variant (tile + rotation) is one bit of a candidate mask
+struct FWFCCompiledRules
+{
+	static constexpr int32 NumDirections = 6;
+
+	// All variants, the index of a variant is its bit in masks
+	TArray<FWorldArrayWFCSuperpositionElement> Variants;
+	// Tag of each variant
+	TArray<ETileType> VariantTags;
+	// "TileName:Rotation" of each variant - for reports and traces
+	TArray<FString> VariantNames;
+
+	// Amount of uint64 words in one mask
+	int32 NumWords = 0;
+
+	// [Variant][World direction] - mask of variants which can be set in this direction of the variant
+	// Holds both "A accepts B" and "B accepts A" rules, so the user doesn't have to set both sides
+	TArray<uint64> Compatible;
+
+	// [ETileType] - initial candidates of an element of this type
+	TArray<uint64> TagDomains;
+
+	// [ETileColorTag] - variants of this colour and variants of indifferent colour
+	// Indifferent - all the variants, an element without colour is not restricted
+	TArray<uint64> ColorDomains;
+
+	// Weight and Weight * ln(Weight) of each variant for entropy. Padded with zeros up to NumWords * 64
+	TArray<float> Weights;
+	TArray<float> WeightLogWeights;
+
+	void Reset(int32 NumVariants)
+	{
+		NumWords = WFCBitsetKernels::GetNumWords(NumVariants);
+		const int32 NumBits = NumWords * 64;
+
+		Variants.Reset(NumVariants);
+		VariantTags.Reset(NumVariants);
+		VariantNames.Reset(NumVariants);
+		Compatible.Init(0, NumVariants * NumDirections * NumWords);
+		TagDomains.Init(0, (int32)ETileType::ETT_MAX * NumWords);
+		ColorDomains.Init(0, (int32)ETileColorTag::ETCT_MAX * NumWords);
+		Weights.Init(0.f, NumBits);
+		WeightLogWeights.Init(0.f, NumBits);
+	}
+
+	FORCEINLINE int32 NumVariants() const { return Variants.Num(); }
+
+	FORCEINLINE const uint64* GetCompatible(int32 Variant, int32 Direction) const
+	{
+		return Compatible.GetData() + (Variant * NumDirections + Direction) * NumWords;
+	}
+
+	FORCEINLINE uint64* GetCompatible(int32 Variant, int32 Direction)
+	{
+		return Compatible.GetData() + (Variant * NumDirections + Direction) * NumWords;
+	}
+
+	FORCEINLINE const uint64* GetTagDomain(ETileType Tag) const
+	{
+		return TagDomains.GetData() + (int32)Tag * NumWords;
+	}
+
+	FORCEINLINE uint64* GetTagDomain(ETileType Tag)
+	{
+		return TagDomains.GetData() + (int32)Tag * NumWords;
+	}
+
+	FORCEINLINE const uint64* GetColorDomain(ETileColorTag Color) const
+	{
+		return ColorDomains.GetData() + (int32)Color * NumWords;
+	}
+
+	FORCEINLINE uint64* GetColorDomain(ETileColorTag Color)
+	{
+		return ColorDomains.GetData() + (int32)Color * NumWords;
+	}
+
+	SIZE_T GetAllocatedSize() const
+	{
+		SIZE_T Size = Variants.GetAllocatedSize() + VariantTags.GetAllocatedSize() + VariantNames.GetAllocatedSize()
+			+ Compatible.GetAllocatedSize() + TagDomains.GetAllocatedSize() + ColorDomains.GetAllocatedSize()
+			+ Weights.GetAllocatedSize() + WeightLogWeights.GetAllocatedSize();
+		for(const FString& Name : VariantNames)
+		{
+			Size += Name.GetAllocatedSize();
+		}
+		return Size;
+	}
+
+	// Same as ATileRegistry::ReverseWorldDirection, but on direction indexes
+	static FORCEINLINE int32 ReverseDirection(int32 Direction)
+	{
+		// Forward(0) <-> Backward(2), Right(1) <-> Left(3), Top(4) <-> Bottom(5)
+		return Direction < 4 ? (Direction + 2) % 4 : (Direction ^ 1);
+	}
+};
\ No newline at end of file
@@ -2,11 +2,17 @@
 
 
 #include "WFCGeneratorComponent.h"
+#include "WFCSolver.h"
+#include "WFCValidator.h"
 
 // Sets default values for this component's properties
 UWFCGeneratorComponent::UWFCGeneratorComponent() :
 bDebugWFCOnlyFloor(true),
-MaxAttempts(100)
+MaxAttempts(100),
+PortfolioSize(4),
+ReSolveMargin(1),
+bValidateResult(true),
+LastNumViolations(INDEX_NONE)
 {
 	// Set this component to be initialized when the game starts, and to be ticked every frame.  You can turn these features
 	// off to improve performance if you don't need them.
@@ -15,391 +21,197 @@ MaxAttempts(100)
 	// ...
 }
 
-bool UWFCGeneratorComponent::Generate(UWorldItem3DArray* worldArray, TArray<UWorldArrayItem*>& OutWorldArray)
+bool UWFCGeneratorComponent::Generate(UWorldItem3DArray* worldArray, int32 Seed)
 {
 	if(!TileRegistryActor)
 		return false;
 
-	UWorldItem3DArray* InputWorldArray = NewObject<UWorldItem3DArray>();
-	InputWorldArray->Bounds = worldArray->Bounds;
-	InputWorldArray->Arr = CopyWorldArray(worldArray->Arr, worldArray->Arr.Num());
+	const FIntVector SolvedBounds = GetSolvedBounds(worldArray);
+	// Typed planes are drawn by FWorldGridRasterizer
+	check(SolvedBounds.Z <= worldArray->NumFilledSlabs);
+	LastNumViolations = INDEX_NONE;
 
-	ReservedWorldArray = NewObject<UWorldItem3DArray>();
-	
-	ReservedWorldArray->Bounds = worldArray->Bounds;
-	if(bDebugWFCOnlyFloor)
-	{
-		int floorNum = worldArray->Bounds.X * worldArray->Bounds.Y;
-		ReservedWorldArray->Bounds.Z = 1;
-		ReservedWorldArray->Arr = CopyWorldArray(worldArray->Arr, floorNum);
-	}
-	else
-	{
-		ReservedWorldArray->Arr = CopyWorldArray(worldArray->Arr, worldArray->Arr.Num());
-	}
-	ReservedWorldArray->DefaultValue = worldArray->DefaultValue;
-	SetSuperpositionsOfArrayElementsByType(*ReservedWorldArray);
-
-	bool generatedSuccessfully = StartWFC();
+	TArray<int32> SolvedArea;
+	bool generatedSuccessfully = FWFCSolver::SolvePortfolio(TileRegistryActor->GetCompiledRules(),
+		worldArray->TileTypes, worldArray->ColorTags, SolvedBounds, Seed, MaxAttempts, PortfolioSize, SolvedArea);
 	
 	if(!generatedSuccessfully)
 	{
 		UE_LOG(LogGeneration, Error, TEXT("WFC FAIL! Attempts: %d"), MaxAttempts);
 	}
 
-	int32 inputArrBounds = InputWorldArray->Bounds.Z * InputWorldArray->Bounds.Y * InputWorldArray->Bounds.X;
-	int32 wfcArrBounds = WfcWorldArray->Bounds.Z * WfcWorldArray->Bounds.Y * WfcWorldArray->Bounds.X;
+	// Elements above the solved area keep no tile
+	worldArray->SolvedVariants.Init(INDEX_NONE, worldArray->TileTypes.Num());
+	FMemory::Memcpy(worldArray->SolvedVariants.GetData(), SolvedArea.GetData(), SolvedArea.Num() * sizeof(int32));
 
-	TArray<UWorldArrayItem*> returnArr;
-	for(int i = 0; i < inputArrBounds; i++)
+#if WFC_VALIDATE_ENABLED
+	if(generatedSuccessfully && bValidateResult)
 	{
-		UWorldArrayItem* item = NewObject<UWorldArrayItem>();
-		item->Init(WfcWorldArray->Arr[i]->TileType, WfcWorldArray->Arr[i]->ChosenTileIndex,
-			WfcWorldArray->Arr[i]->PossibleTiles, WfcWorldArray->Arr[i]->TileRotation,
-			WfcWorldArray->Arr[i]->bIsChosen);
-
-		returnArr.Add(item);
+		ValidateResult(worldArray);
 	}
-	
-	// OutWorldArray = CopyWorldArray(WfcWorldArray->Arr, WfcWorldArray->Arr.Num());
-
-	OutWorldArray = returnArr;
+#endif
 
 	return generatedSuccessfully;
 }
 
-TArray<UWorldArrayItem*> UWFCGeneratorComponent::CopyWorldArray(TArray<UWorldArrayItem*> inputArray, int32 Num)
+bool UWFCGeneratorComponent::Resolve(UWorldItem3DArray* worldArray, int32 Seed, const TBitArray<>& ChangedVariants)
 {
-	TArray<UWorldArrayItem*> newArr;
-	for(int i = 0; i < Num; i++)
-	{
-		UWorldArrayItem* item = NewObject<UWorldArrayItem>();
-		
-		item->Init(inputArray[i]->TileType, inputArray[i]->ChosenTileIndex,
-			inputArray[i]->PossibleTiles, inputArray[i]->TileRotation,
-			inputArray[i]->bIsChosen);
-
-		newArr.Add(item);
-	}
-	return newArr;
-}
-
-
-// Called when the game starts
-void UWFCGeneratorComponent::BeginPlay()
-{
-	Super::BeginPlay();
+	if(!TileRegistryActor)
+		return false;
 
-	if(TileRegistryClass)
+	const FWFCCompiledRules& Rules = TileRegistryActor->GetCompiledRules();
+	if(ChangedVariants.Num() != Rules.NumVariants() || worldArray->SolvedVariants.Num() != worldArray->TileTypes.Num())
 	{
-		TileRegistryActor = GetWorld()->SpawnActor<ATileRegistry>(TileRegistryClass);
-		
-		if(TileRegistryActor)
-		{
-			TileRegistryActor->Init();
-		}
+		// Old variants mean nothing for the new rules
+		return Generate(worldArray, Seed);
 	}
-}
-
 
-void UWFCGeneratorComponent::SetSuperpositionsOfArrayElementsByType(UWorldItem3DArray& worldArray)
-{
-	check(TileRegistryActor);
+	const FIntVector SolvedBounds = GetSolvedBounds(worldArray);
+	const int32 SlabSize = SolvedBounds.X * SolvedBounds.Y;
+	const int32 NumCells = SlabSize * SolvedBounds.Z;
 
-	for(int i = 0; i < worldArray.Arr.Num(); i++)
+	// Same directions as FWFCSolver::GetNeighbour
+	auto GetNeighbour = [&SolvedBounds, SlabSize](int32 Cell, int32 Direction)
 	{
-		if(!worldArray.Arr[i]->bIsChosen)
+		const int32 x = Cell % SolvedBounds.X;
+		const int32 y = (Cell / SolvedBounds.X) % SolvedBounds.Y;
+		const int32 z = Cell / SlabSize;
+		switch ((ETileCompatibilityDeltaPosition)Direction)
 		{
-			worldArray.Arr[i]->PossibleTiles =
-				TileRegistryActor->GetSuperpositionArrayByTag(worldArray.Arr[i]->TileType);
+		case ETileCompatibilityDeltaPosition::ETDP_OnForward:
+			return y > 0 ? Cell - SolvedBounds.X : INDEX_NONE;
+		case ETileCompatibilityDeltaPosition::ETDP_OnBackward:
+			return y < SolvedBounds.Y - 1 ? Cell + SolvedBounds.X : INDEX_NONE;
+		case ETileCompatibilityDeltaPosition::ETDP_OnLeft:
+			return x > 0 ? Cell - 1 : INDEX_NONE;
+		case ETileCompatibilityDeltaPosition::ETDP_OnRight:
+			return x < SolvedBounds.X - 1 ? Cell + 1 : INDEX_NONE;
+		case ETileCompatibilityDeltaPosition::ETDP_OnTop:
+			return z < SolvedBounds.Z - 1 ? Cell + SlabSize : INDEX_NONE;
+		case ETileCompatibilityDeltaPosition::ETDP_OnBottom:
+			return z > 0 ? Cell - SlabSize : INDEX_NONE;
+		default:
+			return INDEX_NONE;
 		}
-	}
-}
-
-bool UWFCGeneratorComponent::StartWFC()
-{
-	WfcWorldArray = NewObject<UWorldItem3DArray>();
-	WfcWorldArray->Bounds = ReservedWorldArray->Bounds;
-	WfcWorldArray->DefaultValue = ReservedWorldArray->DefaultValue;
-
-	if(bDebugWFCOnlyFloor)
-	{
-		WfcWorldArray->Bounds.Z = 1;
-		int WfcMapLen = WfcWorldArray->Bounds.X * WfcWorldArray->Bounds.Y;
+	};
 
-		for(int i = 0; i < WfcMapLen; i++)
+	// Free: elements whose own variant has changed or isn't allowed there any more, and elements whose variant doesn't fit a neighbour any more.
+	// Elements which merely could take a changed variant keep theirs - otherwise a change of a common tile frees almost the whole city
+	TBitArray<> FreeCells(false, NumCells);
+	for(int32 Cell = 0; Cell < NumCells; Cell++)
+	{
+		const ETileType Type = worldArray->TileTypes[Cell];
+		const int32 Variant = worldArray->SolvedVariants[Cell];
+		if(Variant == INDEX_NONE || Type == ETileType::ETT_Air || Type == ETileType::ETT_NoCity)
+			continue;
+
+		const uint64* TagDomain = Rules.GetTagDomain(Type);
+		const uint64* ColorDomain = Rules.GetColorDomain(worldArray->ColorTags[Cell]);
+		bool bFree = ChangedVariants[Variant]
+			|| !WFCBitsetKernels::TestBit(TagDomain, Variant) || !WFCBitsetKernels::TestBit(ColorDomain, Variant);
+		for(int32 Direction = 0; Direction < FWFCCompiledRules::NumDirections && !bFree; Direction++)
 		{
-			WfcWorldArray->Arr.Emplace(ReservedWorldArray->Arr[i]);
+			const int32 Neighbour = GetNeighbour(Cell, Direction);
+			const int32 NeighbourVariant = Neighbour != INDEX_NONE ? worldArray->SolvedVariants[Neighbour] : INDEX_NONE;
+			bFree = NeighbourVariant != INDEX_NONE
+				&& !WFCBitsetKernels::TestBit(Rules.GetCompatible(Variant, Direction), NeighbourVariant);
 		}
+		FreeCells[Cell] = bFree;
 	}
 
-	currentMaxSuperposition = 1;
-	int WFC_MaxAttempts = MaxAttempts;
-	int WFC_Attempts = 0;
-
-	bool WFCFinished = false;
-	while(!WFCFinished && WFC_Attempts++ < WFC_MaxAttempts)
+	for(int32 Step = 0; Step < ReSolveMargin; Step++)
 	{
-		if(WFC_Attempts > 0)
-			ResetWFCWorldMap();
-
-		TQueue<int> CoordsToPropagateQueue;
-		int32 slotIndexToCollapse = ChooseSlotToStartWFC();
-
-		while(slotIndexToCollapse >= 0)
+		const TBitArray<> Grown = FreeCells;
+		for(TConstSetBitIterator<> It(Grown); It; ++It)
 		{
-			Collapse(CoordsToPropagateQueue, slotIndexToCollapse);
-			bool metContradiction = false;
-			while(!CoordsToPropagateQueue.IsEmpty() && !metContradiction)
-			{
-				metContradiction = !Propagate(CoordsToPropagateQueue);
-			}
-
-			if(metContradiction)
-			{
-				// Attempt again
-				break;
-			}
-
-			// Observation:
-			slotIndexToCollapse = FindSlotWithLeastChoice(bDebugWFCOnlyFloor);
-			if(slotIndexToCollapse < 0)
+			for(int32 Direction = 0; Direction < FWFCCompiledRules::NumDirections; Direction++)
 			{
-				// haven't found any suitable slot
-				UE_LOG(LogGeneration, Display, TEXT("UWFCGeneratorComponent::StartWFC() - WFC finished!"));
-				WFCFinished = true;
-				break;
-			}
-		}
-	}
-	return WFCFinished;
-}
-
-int32 UWFCGeneratorComponent::ChooseSlotToStartWFC()
-{
-	// Start from the start of first road
-	// return Roads[0].StartPoint.Y * WfcWorldArray->Bounds.X + Roads[0].StartPoint.X;
-	return FindSlotWithLeastChoice(true);
-}
-
-void UWFCGeneratorComponent::ResetWFCWorldMap()
-{
-	WfcWorldArray->Arr.Empty();
-	WfcWorldArray->Bounds = ReservedWorldArray->Bounds;
-	WfcWorldArray->Arr = CopyWorldArray(ReservedWorldArray->Arr, ReservedWorldArray->Arr.Num());
-}
-
-int32 UWFCGeneratorComponent::FindSlotWithLeastChoice(bool bCheckOnlyFloor)
-{
-	int32 ZBound = WfcWorldArray->Bounds.Z;
-	if(bCheckOnlyFloor)
-		ZBound = 1;
-
-	int32 maxSuperposition = -1;
-	int32 minSuperposition = INT_MAX;
-	int32 chosenSlot = -1;
-
-	int z = 0;
-
-	while(z++ < ZBound && chosenSlot == -1)
-	{
-		for(int y = 0; y < WfcWorldArray->Bounds.Y; y++)
-			for(int x = 0; x < WfcWorldArray->Bounds.X; x++)
-			{
-				int32 Index = WfcWorldArray->GetLinearIndex(z, y, x);
-				int32 superpos = WfcWorldArray->Arr[Index]->PossibleTiles.Num();
-				if(superpos < minSuperposition)
-				{
-					minSuperposition = superpos;
-					chosenSlot = Index;
-				}
-				if(superpos > maxSuperposition)
+				const int32 Neighbour = GetNeighbour(It.GetIndex(), Direction);
+				if(Neighbour != INDEX_NONE)
 				{
-					maxSuperposition = superpos;
+					FreeCells[Neighbour] = true;
 				}
 			}
+		}
 	}
 
-	if(maxSuperposition != -1)
-		currentMaxSuperposition = maxSuperposition;
-
-	if(minSuperposition == 0)
+	const int32 NumFree = FreeCells.CountSetBits();
+	if(NumFree == 0)
 	{
-		UE_LOG(LogGeneration, Error, TEXT("MinSuperposition = 0!"));
+		UE_LOG(LogGeneration, Display, TEXT("UWFCGeneratorComponent::Resolve - no element can take the changed tiles"));
+		return true;
 	}
 
-	return chosenSlot;
-}
-
-void UWFCGeneratorComponent::Collapse(TQueue<int>& CoordsQueue, int OutIndex)
-{
-	int32 tile = TileRegistryActor->GetRandomWeightedTileIndex(WfcWorldArray->Arr[OutIndex]->PossibleTiles);
-	bool shouldCheckNeighbours = WfcWorldArray->Arr[OutIndex]->PossibleTiles.Num() > 1;
-
-	FWorldArrayWFCSuperpositionElement Element = WfcWorldArray->Arr[OutIndex]->PossibleTiles[tile];
-	WfcWorldArray->Arr[OutIndex]->ChooseSpecificTile(Element);
-
-	if(shouldCheckNeighbours)
+	TArray<int32> PinnedVariants(worldArray->SolvedVariants.GetData(), NumCells);
+	for(TConstSetBitIterator<> It(FreeCells); It; ++It)
 	{
-		EnqueueNeighbours(CoordsQueue, OutIndex);
+		PinnedVariants[It.GetIndex()] = INDEX_NONE;
 	}
-}
 
-bool UWFCGeneratorComponent::Propagate(TQueue<int>& CoordsQueue)
-{
-	int current;
-	bool currentSlotIsUnchanged = true;
-	bool successDeque = CoordsQueue.Dequeue(current);
-
-	int debug_contradiction = -1;
-	TArray<FString> debug_contr_pos;
-	
-	if(successDeque)
+	TArray<int32> SolvedArea;
+	if(!FWFCSolver::SolvePortfolio(Rules, worldArray->TileTypes, worldArray->ColorTags, SolvedBounds, Seed, MaxAttempts, PortfolioSize,
+		SolvedArea, &PinnedVariants))
 	{
-		// If the tile is already chosen, no need to change
-		if(!WfcWorldArray->Arr[current]->bIsChosen)
-		{
-			// CHECK COMPATIBILITY FOR EACH IN PossibleTiles
-			for(int i = 0; i < WfcWorldArray->Arr[current]->PossibleTiles.Num(); i++)
-			{
-				debug_contr_pos.Empty();
-				FWorldArrayWFCSuperpositionElement currentPossibleTile = WfcWorldArray->Arr[current]->PossibleTiles[i];
-				// CAN THIS TILE BE SET HERE? IF ANY SIDE DOES NOT CONTAIN A COMPATIBLE TILE => DELETE THIS TILE FROM PossibleTiles AND EnqueueNeighbours()
-
-				bool fitsByForw = TileFitsByDirection(current, currentPossibleTile, ETileCompatibilityDeltaPosition::ETDP_OnForward);
-				bool fitsByBack = TileFitsByDirection(current, currentPossibleTile, ETileCompatibilityDeltaPosition::ETDP_OnBackward);
-				bool fitsByLeft = TileFitsByDirection(current, currentPossibleTile, ETileCompatibilityDeltaPosition::ETDP_OnLeft);
-				bool fitsByRight = TileFitsByDirection(current, currentPossibleTile, ETileCompatibilityDeltaPosition::ETDP_OnRight);
-				bool fitsByTop = TileFitsByDirection(current, currentPossibleTile, ETileCompatibilityDeltaPosition::ETDP_OnTop);
-				bool fitsByBot = TileFitsByDirection(current, currentPossibleTile, ETileCompatibilityDeltaPosition::ETDP_OnBottom);
-				
-				if(!fitsByForw
-					|| !fitsByBack
-					|| !fitsByLeft
-					|| !fitsByRight
-					|| !fitsByTop
-					|| !fitsByBot
-					)
-				{
-					
-					// If current tile doesn't fit this slot, remove it
-					currentSlotIsUnchanged = false;
-					debug_contradiction = WfcWorldArray->Arr[current]->PossibleTiles[i].TileIndexInRegister;
-					WfcWorldArray->Arr[current]->PossibleTiles.RemoveAt(i);
-					i--; // we remove an element, next tile gets into the position of current one, which was already processed
-				}
-			}
-
-			if(WfcWorldArray->Arr[current]->PossibleTiles.Num() == 0)
-			{
-				// We met a contradiction! Process it outside of this function
-				UE_LOG(LogGeneration, Error, TEXT("WFC - Met a contradiction"));
-				FString debug_contr_name = TileRegistryActor->RegistryArray[debug_contradiction].TileInstance->GetName();
-				UE_LOG(LogGeneration, Error, TEXT("%s"), *debug_contr_name);
-				for(int p = 0; p < debug_contr_pos.Num(); p++)
-				{
-					UE_LOG(LogGeneration, Error, TEXT("%s"), *debug_contr_pos[p]);
-				}
-				UE_LOG(LogGeneration, Error, TEXT("WFC - Met a contradiction END"));
-				
+		UE_LOG(LogGeneration, Warning, TEXT("UWFCGeneratorComponent::Resolve - %d elements can't be solved around the kept ones, solving everything"), NumFree);
+		return Generate(worldArray, Seed);
+	}
 
-				return false;
-			}
-			
-			if(WfcWorldArray->Arr[current]->PossibleTiles.Num() == 1)
-			{
-				// Мы выбрали единственно возможный тайл для данного слота
-				
-				WfcWorldArray->Arr[current]->ChooseSpecificTile(WfcWorldArray->Arr[current]->PossibleTiles[0]);
-				
-			}
+	UE_LOG(LogGeneration, Display, TEXT("UWFCGeneratorComponent::Resolve - %d of %d elements solved again"), NumFree, NumCells);
+	FMemory::Memcpy(worldArray->SolvedVariants.GetData(), SolvedArea.GetData(), SolvedArea.Num() * sizeof(int32));
 
-			if(!currentSlotIsUnchanged)
-			{
-				EnqueueNeighbours(CoordsQueue, current);
-			}
-		}
-	}
-	else
+#if WFC_VALIDATE_ENABLED
+	if(bValidateResult)
 	{
-		UE_LOG(LogGeneration, Warning, TEXT("UWFCGeneratorComponent::Collapse cant deque!"));
+		ValidateResult(worldArray);
 	}
+#endif
 	return true;
 }
 
-void UWFCGeneratorComponent::EnqueueNeighbours(TQueue<int>& CoordsQueue, int current)
+int32 UWFCGeneratorComponent::ValidateResult(const UWorldItem3DArray* worldArray)
 {
-	TArray<int> IndexesToCheck =
-		{
-		current + (WfcWorldArray->Bounds.Y * WfcWorldArray->Bounds.X), // +Z
-		current - (WfcWorldArray->Bounds.Y * WfcWorldArray->Bounds.X), // -Z
-		current + WfcWorldArray->Bounds.X, // +Y
-		current - WfcWorldArray->Bounds.X, // -Y
-		current + 1, // +X
-		current - 1 // -X	
-	};
-		
-	for(int i = 0; i < IndexesToCheck.Num(); i++)
-	{
-		if(WfcWorldArray->Arr.IsValidIndex(IndexesToCheck[i]))
-		{
-			if(!WfcWorldArray->Arr[IndexesToCheck[i]]->bIsChosen
-				&& WfcWorldArray->Arr[IndexesToCheck[i]]->TileType != ETileType::ETT_Air
-				&& WfcWorldArray->Arr[IndexesToCheck[i]]->TileType != ETileType::ETT_NoCity)
-			{
-				CoordsQueue.Enqueue(IndexesToCheck[i]);
-			}
-		}
-	}
+	if(!TileRegistryActor)
+		return INDEX_NONE;
+
+	const FWFCCompiledRules& Rules = TileRegistryActor->GetCompiledRules();
+	const double StartTime = FPlatformTime::Seconds();
+	TArray<FWFCViolation> Violations;
+	LastNumViolations = WFCValidator::Validate(Rules, worldArray->TileTypes, worldArray->ColorTags, worldArray->SolvedVariants,
+		GetSolvedBounds(worldArray), Violations);
+
+	UE_LOG(LogGeneration, Display, TEXT("UWFCGeneratorComponent::ValidateResult - %d violations, %.2f ms"),
+		LastNumViolations, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+	WFCValidator::LogViolations(Rules, Violations, LastNumViolations);
+	return LastNumViolations;
 }
 
-bool UWFCGeneratorComponent::TileFitsByDirection(int32 currentIndexInWorld, FWorldArrayWFCSuperpositionElement currentPossibleTile, ETileCompatibilityDeltaPosition worldDirection)
+FIntVector UWFCGeneratorComponent::GetSolvedBounds(const UWorldItem3DArray* worldArray) const
 {
-	int32 secondIndex = currentIndexInWorld + WfcWorldArray->GetDeltaIndex(worldDirection);
-
-	if(!WfcWorldArray->Arr.IsValidIndex(secondIndex))
+	FIntVector SolvedBounds = worldArray->Bounds;
+	if(bDebugWFCOnlyFloor)
 	{
-		// If index is not valid, then there's no error in compatibility at the border of the array
-		return true;
+		SolvedBounds.Z = 1;
 	}
+	return SolvedBounds;
+}
 
-	if(WfcWorldArray->Arr[currentIndexInWorld]->TileType == ETileType::ETT_NoCity
-		|| WfcWorldArray->Arr[secondIndex]->TileType == ETileType::ETT_NoCity)
-	{
-		// If there's no city, then it's a border and we don't need to compare it with anything
-		return true;
-	}
-	
-	// Check all the tiles in the direction
-	int32 MyRegisterIndex = currentPossibleTile.TileIndexInRegister;
-	ETileRotation MyWorldRotation = currentPossibleTile.Rotation;
+// Called when the game starts
+void UWFCGeneratorComponent::BeginPlay()
+{
+	Super::BeginPlay();
 
-	int32 max = WfcWorldArray->Arr[secondIndex]->PossibleTiles.Num();
-	for(int i = 0; i < max; i++)
-	{
-		int32 ComparableRegisterIndex = WfcWorldArray->Arr[secondIndex]->PossibleTiles[i].TileIndexInRegister;
-		ETileRotation ComparableWorldRotation = WfcWorldArray->Arr[secondIndex]->PossibleTiles[i].Rotation;
+	InitTileRegistry();
+}
 
-		// check compatibility
-		// with reverse check - by the world direction from 2nd tile to 1st
-		// so we check both tile compatibility arrays
-		// and avoid the human error of setting one tile compatible with another but not vice versa
-		if(TileRegistryActor->IsCompatible(
-			MyRegisterIndex, MyWorldRotation,
-			ComparableRegisterIndex, ComparableWorldRotation,
-			worldDirection
-			)
-			||
-			TileRegistryActor->IsCompatible(
-			ComparableRegisterIndex, ComparableWorldRotation,
-			MyRegisterIndex, MyWorldRotation,
-			TileRegistryActor->ReverseWorldDirection(worldDirection))
-			)
+void UWFCGeneratorComponent::InitTileRegistry()
+{
+	if(TileRegistryClass && !TileRegistryActor)
+	{
+		TileRegistryActor = GetWorld()->SpawnActor<ATileRegistry>(TileRegistryClass);
+		
+		if(TileRegistryActor)
 		{
-			// we need at least one compatible - no need to check the full array
-			return true;
+			TileRegistryActor->Init();
 		}
 	}
-
-	return false;
 }
\ No newline at end of file
@@ -6,8 +6,6 @@
 #include "Components/ActorComponent.h"
 #include "WorldItem3DArray.h"
 #include "TileRegistry.h"
-#include "TileCompatibilityDeltaPosition.h"
-#include "WorldArrayWFCSuperpositionElement.h"
 #include "WFCGeneratorComponent.generated.h"
 
 UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
@@ -19,46 +17,30 @@ public:
 	// Sets default values for this component's properties
 	UWFCGeneratorComponent();
 
-	bool Generate(UWorldItem3DArray* worldArray, TArray<UWorldArrayItem*>& OutWorldArray);
+	// Solves the typed planes of worldArray with FWFCSolver and fills worldArray->SolvedVariants
+	bool Generate(UWorldItem3DArray* worldArray, int32 Seed);
 
-	TArray<UWorldArrayItem*> CopyWorldArray(TArray<UWorldArrayItem*> inputArray, int32 Num);
+	// Solves again only the elements which have one of ChangedVariants or whose variant contradicts the new rules
+	// (and ReSolveMargin elements around them), the other elements keep their variants of worldArray->SolvedVariants.
+	// Empty ChangedVariants - solves everything
+	// worldArray->SolvedVariants are changed only on success
+	bool Resolve(UWorldItem3DArray* worldArray, int32 Seed, const TBitArray<>& ChangedVariants);
+
+	// Checks every pair of neighbours of the solved area of worldArray against the compiled rules and logs violations
+	// Returns the amount of violations. Called after each generation in development builds if bValidateResult
+	int32 ValidateResult(const UWorldItem3DArray* worldArray);
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true"))
 	bool bDebugWFCOnlyFloor;
 
+	// Spawns and initializes TileRegistryActor of TileRegistryClass. Called from BeginPlay,
+	// call it by hand when the world doesn't begin play (commandlets)
+	void InitTileRegistry();
+
 protected:
 	// Called when the game starts
 	virtual void BeginPlay() override;
 	
-	void SetSuperpositionsOfArrayElementsByType(UWorldItem3DArray& worldArray);
-
-	bool StartWFC();
-
-	int32 ChooseSlotToStartWFC();
-
-	void ResetWFCWorldMap();
-
-	// Returns 1D-index in world 3D-array of an element with minimum superposition
-	// If haven't found any suitable element, returns -1
-	// Also fills in value of currentMaxSuperposition
-	int32 FindSlotWithLeastChoice(bool bCheckOnlyFloor);
-
-	void Collapse(TQueue<int>& CoordsQueue, int OutIndex);
-
-	// Propagates the changes of collapse
-	// Checks if a slot from CoordsQueue is compatible with the possible tiles in adjacent slots
-	// Returns false if we met a contradiction, otherwise returns true
-	bool Propagate(TQueue<int>& CoordsQueue);
-
-	// Adds neighbour coordinates of current coordinate to WFC queue. Avoids Air and NoCity tiles
-	void EnqueueNeighbours(TQueue<int>& CoordsQueue, int current);
-	
-	// If any (at least 1) possible tile in the slot by the provided direction is compatible with current possible tile, returns true
-	// If there is no slot in provided direction, returns true
-	// If no possible tile in the slot by the provided direction is compatible with current possible tile, returns false
-	bool TileFitsByDirection(int32 currentIndexInWorld, FWorldArrayWFCSuperpositionElement currentPossibleTile,
-		ETileCompatibilityDeltaPosition direction);
-	
 private:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true"), Category = Tiles)
 	TSubclassOf<ATileRegistry> TileRegistryClass;
@@ -66,17 +48,28 @@ private:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true"), Category = Tiles)
 	ATileRegistry* TileRegistryActor;
 
-	int32 currentMaxSuperposition;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true", ClampMin=1))
+	int32 MaxAttempts;
 
-	UPROPERTY()
-	UWorldItem3DArray* ReservedWorldArray;
+	// Amount of solvers racing on worker threads. The result doesn't depend on it, only the time of generation
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true", ClampMin=1, ClampMax=64))
+	int32 PortfolioSize;
 
-	UPROPERTY()
-	UWorldItem3DArray* WfcWorldArray;
+	// Elements around the re-solved ones which are solved again too, so the changed tiles have room to fit
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true", ClampMin=0, ClampMax=8))
+	int32 ReSolveMargin;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true", ClampMin=1))
-	int32 MaxAttempts;
+	// Validates the result of each generation (not in shipping builds)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true"))
+	bool bValidateResult;
+
+	// Violations found by the last ValidateResult(), INDEX_NONE - not validated
+	int32 LastNumViolations;
 
 public:
+	// Area of worldArray solved by WFC. Only the ground with bDebugWFCOnlyFloor
+	FIntVector GetSolvedBounds(const UWorldItem3DArray* worldArray) const;
+
 	FORCEINLINE ATileRegistry* GetTileRegistryActor() const { return TileRegistryActor; }
+	FORCEINLINE int32 GetLastNumViolations() const { return LastNumViolations; }
 };
@@ -0,0 +1,148 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WFCRuleAnalysis.h"
+#include "GenerationLogs.h"
+#include "WFCBitsetKernels.h"
+
+FWFCTagAdjacency WFCRuleAnalysis::GetTagAdjacency(const TArray<ETileType>& TileTypes, FIntVector Bounds)
+{
+	FWFCTagAdjacency Adjacency;
+	FMemory::Memzero(Adjacency);
+
+	const int32 SlabSize = Bounds.X * Bounds.Y;
+	check(TileTypes.Num() >= SlabSize * Bounds.Z);
+
+	for(int32 z = 0; z < Bounds.Z; z++)
+	{
+		for(int32 y = 0; y < Bounds.Y; y++)
+		{
+			for(int32 x = 0; x < Bounds.X; x++)
+			{
+				const int32 Cell = z * SlabSize + y * Bounds.X + x;
+				const int32 Tag = (int32)TileTypes[Cell];
+				Adjacency.PresentTags |= 1u << Tag;
+
+				// Same neighbours as FWFCSolver::GetNeighbour, indexed by ETileCompatibilityDeltaPosition
+				const int32 Neighbours[FWFCCompiledRules::NumDirections] = {
+					y > 0 ? Cell - Bounds.X : INDEX_NONE,
+					x < Bounds.X - 1 ? Cell + 1 : INDEX_NONE,
+					y < Bounds.Y - 1 ? Cell + Bounds.X : INDEX_NONE,
+					x > 0 ? Cell - 1 : INDEX_NONE,
+					z < Bounds.Z - 1 ? Cell + SlabSize : INDEX_NONE,
+					z > 0 ? Cell - SlabSize : INDEX_NONE
+				};
+
+				for(int32 Direction = 0; Direction < FWFCCompiledRules::NumDirections; Direction++)
+				{
+					const int32 Neighbour = Neighbours[Direction];
+					if(Neighbour == INDEX_NONE || TileTypes[Neighbour] == ETileType::ETT_NoCity)
+					{
+						Adjacency.FreeDirections[Tag] |= 1 << Direction;
+					}
+					else
+					{
+						Adjacency.NeighbourTags[Tag][Direction] |= 1u << (int32)TileTypes[Neighbour];
+					}
+				}
+			}
+		}
+	}
+
+	return Adjacency;
+}
+
+int32 WFCRuleAnalysis::PruneTagDomains(const FWFCCompiledRules& Rules, const FWFCTagAdjacency& Adjacency, TArray<uint64>& OutTagDomains)
+{
+	const FWFCBitsetKernelTable& Kernels = WFCBitsetKernels::Get();
+	const int32 NumWords = Rules.NumWords;
+	const int32 NumTags = (int32)ETileType::ETT_MAX;
+
+	OutTagDomains = Rules.TagDomains;
+	auto GetDomain = [&OutTagDomains, NumWords](int32 Tag)
+	{
+		return OutTagDomains.GetData() + Tag * NumWords;
+	};
+
+	// Tags whose elements are skipped by FWFCSolver - they fit anything, like the border.
+	// Air keeps all its candidates, it only restricts the neighbours
+	const uint32 AirMask = 1u << (int32)ETileType::ETT_Air;
+	const uint32 NoCityMask = 1u << (int32)ETileType::ETT_NoCity;
+	const uint32 FreeTags = NoCityMask
+		| (Kernels.PopCount(Rules.GetTagDomain(ETileType::ETT_Air), NumWords) == 0 ? AirMask : 0);
+	const uint32 PrunedTags = Adjacency.PresentTags & ~AirMask & ~NoCityMask;
+
+	TArray<uint64> Allowed;
+	Allowed.Init(0, NumWords);
+
+	bool bChanged = true;
+	while(bChanged)
+	{
+		bChanged = false;
+		for(int32 Tag = 0; Tag < NumTags; Tag++)
+		{
+			if(!(PrunedTags & (1u << Tag)))
+				continue;
+
+			uint64* Domain = GetDomain(Tag);
+			for(int32 Direction = 0; Direction < FWFCCompiledRules::NumDirections; Direction++)
+			{
+				const uint32 NeighbourTags = Adjacency.NeighbourTags[Tag][Direction];
+				if((Adjacency.FreeDirections[Tag] & (1 << Direction)) || (NeighbourTags & FreeTags))
+				{
+					// Some element of the tag has nothing to fit in this direction - any candidate may stand there
+					continue;
+				}
+
+				// Candidates which fit at least one candidate of at least one neighbour tag
+				FMemory::Memzero(Allowed.GetData(), NumWords * sizeof(uint64));
+				const int32 ReverseDirection = FWFCCompiledRules::ReverseDirection(Direction);
+				for(int32 NeighbourTag = 0; NeighbourTag < NumTags; NeighbourTag++)
+				{
+					if(!(NeighbourTags & (1u << NeighbourTag)))
+						continue;
+
+					WFCBitsetKernels::ForEachSetBit(GetDomain(NeighbourTag), NumWords, [&](int32 Variant)
+					{
+						Kernels.OrInto(Allowed.GetData(), Rules.GetCompatible(Variant, ReverseDirection), NumWords);
+					});
+				}
+
+				bChanged |= Kernels.AndInto(Domain, Allowed.GetData(), NumWords);
+			}
+		}
+	}
+
+	// Report what was removed
+	int32 NumRemoved = 0;
+	for(int32 Tag = 0; Tag < NumTags; Tag++)
+	{
+		if(!(PrunedTags & (1u << Tag)))
+			continue;
+
+		const uint64* Initial = Rules.GetTagDomain((ETileType)Tag);
+		const uint64* Pruned = GetDomain(Tag);
+		for(int32 Word = 0; Word < NumWords; Word++)
+		{
+			const uint64 Removed = Initial[Word] & ~Pruned[Word];
+			NumRemoved += FMath::CountBits(Removed);
+		}
+
+		WFCBitsetKernels::ForEachSetBit(Initial, NumWords, [&](int32 Variant)
+		{
+			if(!WFCBitsetKernels::TestBit(Pruned, Variant))
+			{
+				UE_LOG(LogGeneration, Verbose, TEXT("WFCRuleAnalysis::PruneTagDomains - %s can't fit the neighbours of %s"),
+					*Rules.VariantNames[Variant], *StaticEnum<ETileType>()->GetNameStringByValue(Tag));
+			}
+		});
+
+		if(Kernels.PopCount(Initial, NumWords) > 0 && Kernels.PopCount(Pruned, NumWords) == 0)
+		{
+			UE_LOG(LogGeneration, Warning, TEXT("WFCRuleAnalysis::PruneTagDomains - no tile of %s fits the neighbours the layout puts around it!"),
+				*StaticEnum<ETileType>()->GetNameStringByValue(Tag));
+		}
+	}
+
+	return NumRemoved;
+}
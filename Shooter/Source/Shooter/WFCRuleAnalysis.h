@@ -0,0 +1,37 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TileType.h"
+#include "WFCCompiledRules.h"
+
+static_assert((int32)ETileType::ETT_MAX <= 32, "FWFCTagAdjacency keeps tags in uint32 masks");
+
+// Which tags the layout puts next to which - gathered from the typed grid before WFC
+struct FWFCTagAdjacency
+{
+	// [ETileType][World direction] - mask of tags (1 << ETileType) met in this direction of an element of the tag
+	uint32 NeighbourTags[(int32)ETileType::ETT_MAX][FWFCCompiledRules::NumDirections];
+	// [ETileType] - mask of directions (1 << Direction) in which some element of the tag has nothing to fit:
+	// the border of the grid or a NoCity element
+	uint8 FreeDirections[(int32)ETileType::ETT_MAX];
+	// Mask of tags present in the grid
+	uint32 PresentTags;
+};
+
+/**
+ * Static analysis of compiled rules
+ * Arc consistency on tag level: a candidate of a tag stays only if in every direction it fits some candidate
+ * of some tag the layout puts there. Repeated to a fixed point, because removed candidates stop supporting others
+ * Elements of the grid start WFC with these candidates - everything removed here would fail propagation anyway
+ */
+namespace WFCRuleAnalysis
+{
+	// TileTypes are indexed as UWorldItem3DArray: z * Y * X + y * X + x. Only the first Bounds.Z slabs are used
+	SHOOTER_API FWFCTagAdjacency GetTagAdjacency(const TArray<ETileType>& TileTypes, FIntVector Bounds);
+
+	// Outputs TagDomains of Rules without candidates which can't fit the neighbours of the layout
+	// Returns the amount of removed candidates of the tags present in the layout
+	SHOOTER_API int32 PruneTagDomains(const FWFCCompiledRules& Rules, const FWFCTagAdjacency& Adjacency, TArray<uint64>& OutTagDomains);
+}
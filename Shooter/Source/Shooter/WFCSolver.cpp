@@ -0,0 +1,551 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WFCSolver.h"
+#include "GenerationLogs.h"
+#include "WFCRuleAnalysis.h"
+#include "Async/ParallelFor.h"
+#include "Misc/Paths.h"
+
+FWFCSolver::FWFCSolver(const FWFCCompiledRules& InRules) :
+Rules(InRules),
+Kernels(WFCBitsetKernels::Get()),
+Bounds(FIntVector::ZeroValue),
+NumCells(0),
+NumWords(InRules.NumWords),
+NumSlots(0),
+PropagationQueueHead(0),
+PropagationQueueNum(0),
+CurrentAttempt(0),
+WinningAttempt(nullptr),
+DomainsMemory(EGenerationMemoryTag::Domains),
+QueueMemory(EGenerationMemoryTag::PropagationQueue)
+{
+#if WFC_TRACE_ENABLED
+	const int32 TraceCapacity = WFCTrace::GetBufferCapacity();
+	if(TraceCapacity > 0)
+	{
+		Trace = MakeUnique<FWFCTraceBuffer>(TraceCapacity);
+		DomainBeforePropagation.Init(0, NumWords);
+	}
+#endif
+}
+
+bool FWFCSolver::Init(const TArray<ETileType>& TileTypes, const TArray<ETileColorTag>& ColorTags, FIntVector InBounds, const TArray<uint64>& TagDomains)
+{
+	GENERATION_LLM_SCOPE(Domains);
+	Bounds = InBounds;
+	NumCells = Bounds.X * Bounds.Y * Bounds.Z;
+	check(TileTypes.Num() >= NumCells);
+	check(ColorTags.Num() >= NumCells);
+
+	// Without Air tiles in the registry Air has nothing to restrict
+	const ECellState AirState = Kernels.PopCount(TagDomains.GetData() + (int32)ETileType::ETT_Air * NumWords, NumWords) > 0
+		? ECellState::Passive
+		: ECellState::Inactive;
+
+	// Empty bricks take no slots of their own: empty Air bricks all point at one shared brick of passive slots after the stored ones,
+	// NoCity bricks and Air which restricts nothing are no neighbours at all
+	Bricks.Build(TileTypes, Bounds);
+	NumSlots = (Bricks.GetNumBricks() - Bricks.GetNumEmptyBricks()) * FWorldBrickMap::BrickSize;
+	const int32 AirBrickSlot = AirState == ECellState::Passive ? NumSlots : INDEX_NONE;
+	TArray<int32> BrickSlots;
+	BrickSlots.SetNumUninitialized(Bricks.GetNumBricks());
+	StoredBricks.Reset(Bricks.GetNumBricks() - Bricks.GetNumEmptyBricks());
+	for(int32 Brick = 0; Brick < Bricks.GetNumBricks(); Brick++)
+	{
+		if(!Bricks.IsEmpty(Brick))
+		{
+			BrickSlots[Brick] = StoredBricks.Num() * FWorldBrickMap::BrickSize;
+			StoredBricks.Add(Brick);
+		}
+		else
+		{
+			BrickSlots[Brick] = Bricks.GetUniformType(Brick) == ETileType::ETT_Air ? AirBrickSlot : INDEX_NONE;
+		}
+	}
+
+	// Neighbour bricks of the stored bricks, walked in the order of the grid so nothing is divided
+	// Same directions as UWorldItem3DArray::GetDeltaIndex
+	const FIntVector NumBricks = Bricks.GetNumBricksAlongAxes();
+	const int32 BricksInSlab = NumBricks.X * NumBricks.Y;
+	BrickNeighbourSlots.SetNumUninitialized(StoredBricks.Num() * FWFCCompiledRules::NumDirections);
+	for(int32 z = 0, Brick = 0, StoredBrick = 0; z < NumBricks.Z; z++)
+	{
+		for(int32 by = 0; by < NumBricks.Y; by++)
+		{
+			for(int32 bx = 0; bx < NumBricks.X; bx++, Brick++)
+			{
+				if(Bricks.IsEmpty(Brick))
+					continue;
+
+				int32* Neighbours = BrickNeighbourSlots.GetData() + StoredBrick++ * FWFCCompiledRules::NumDirections;
+				Neighbours[(int32)ETileCompatibilityDeltaPosition::ETDP_OnForward] = by > 0 ? BrickSlots[Brick - NumBricks.X] : INDEX_NONE;
+				Neighbours[(int32)ETileCompatibilityDeltaPosition::ETDP_OnRight] = bx < NumBricks.X - 1 ? BrickSlots[Brick + 1] : INDEX_NONE;
+				Neighbours[(int32)ETileCompatibilityDeltaPosition::ETDP_OnBackward] = by < NumBricks.Y - 1 ? BrickSlots[Brick + NumBricks.X] : INDEX_NONE;
+				Neighbours[(int32)ETileCompatibilityDeltaPosition::ETDP_OnLeft] = bx > 0 ? BrickSlots[Brick - 1] : INDEX_NONE;
+				Neighbours[(int32)ETileCompatibilityDeltaPosition::ETDP_OnTop] = z < NumBricks.Z - 1 ? BrickSlots[Brick + BricksInSlab] : INDEX_NONE;
+				Neighbours[(int32)ETileCompatibilityDeltaPosition::ETDP_OnBottom] = z > 0 ? BrickSlots[Brick - BricksInSlab] : INDEX_NONE;
+			}
+		}
+	}
+
+	// Neighbours inside of a brick are the same for every brick
+	const int32 LastInRow = FWorldBrickMap::BrickSide - 1;
+	for(int32 IndexInBrick = 0; IndexInBrick < FWorldBrickMap::BrickSize; IndexInBrick++)
+	{
+		const int32 x = IndexInBrick & LastInRow;
+		const int32 y = IndexInBrick >> FWorldBrickMap::BrickShift;
+		InBrickNeighbours[(int32)ETileCompatibilityDeltaPosition::ETDP_OnForward][IndexInBrick] = (uint8)(y > 0
+			? IndexInBrick - FWorldBrickMap::BrickSide
+			: CrossesBrick | (IndexInBrick + LastInRow * FWorldBrickMap::BrickSide));
+		InBrickNeighbours[(int32)ETileCompatibilityDeltaPosition::ETDP_OnRight][IndexInBrick] = (uint8)(x < LastInRow
+			? IndexInBrick + 1
+			: CrossesBrick | (IndexInBrick - LastInRow));
+		InBrickNeighbours[(int32)ETileCompatibilityDeltaPosition::ETDP_OnBackward][IndexInBrick] = (uint8)(y < LastInRow
+			? IndexInBrick + FWorldBrickMap::BrickSide
+			: CrossesBrick | (IndexInBrick - LastInRow * FWorldBrickMap::BrickSide));
+		InBrickNeighbours[(int32)ETileCompatibilityDeltaPosition::ETDP_OnLeft][IndexInBrick] = (uint8)(x > 0
+			? IndexInBrick - 1
+			: CrossesBrick | (IndexInBrick + LastInRow));
+		InBrickNeighbours[(int32)ETileCompatibilityDeltaPosition::ETDP_OnTop][IndexInBrick] = (uint8)(CrossesBrick | IndexInBrick);
+		InBrickNeighbours[(int32)ETileCompatibilityDeltaPosition::ETDP_OnBottom][IndexInBrick] = (uint8)(CrossesBrick | IndexInBrick);
+	}
+
+	// Slots outside of the grid stay inactive
+	CellStates.Init(ECellState::Inactive, NumSlots + FWorldBrickMap::BrickSize);
+	InitialDomains.Init(0, CellStates.Num() * NumWords);
+	Domains.Init(0, InitialDomains.Num());
+	Support.Init(0, NumWords);
+	DomainsMemory.Set(CellStates.GetAllocatedSize() + StoredBricks.GetAllocatedSize() + BrickNeighbourSlots.GetAllocatedSize()
+		+ InitialDomains.GetAllocatedSize() + Domains.GetAllocatedSize() + Support.GetAllocatedSize());
+	{
+		GENERATION_LLM_SCOPE(PropagationQueue);
+		IsInQueue.Init(false, NumSlots);
+		// An element is re-queued many times during a solve, but IsInQueue keeps it in the ring at most once at a time,
+		// so NumSlots entries always fit. The ring is allocated here, on the calling thread, and propagation only wraps around it
+		PropagationQueue.SetNumUninitialized(NumSlots);
+		QueueMemory.Set(IsInQueue.GetAllocatedSize() + PropagationQueue.GetAllocatedSize());
+	}
+
+	// The shared brick of empty Air
+	for(int32 Slot = NumSlots; Slot < CellStates.Num(); Slot++)
+	{
+		CellStates[Slot] = AirState;
+		FMemory::Memcpy(InitialDomains.GetData() + Slot * NumWords, TagDomains.GetData() + (int32)ETileType::ETT_Air * NumWords, NumWords * sizeof(uint64));
+	}
+
+	int32 EmptyCells = 0;
+	for(int32 StoredBrick = 0; StoredBrick < StoredBricks.Num(); StoredBrick++)
+	{
+		const int32 FirstSlot = StoredBrick * FWorldBrickMap::BrickSize;
+		Bricks.ForEachCellWithIndex(StoredBricks[StoredBrick], [&](int32 Cell, int32 IndexInBrick)
+		{
+			const int32 Slot = FirstSlot + IndexInBrick;
+			const ETileType Type = TileTypes[Cell];
+			if(Type == ETileType::ETT_NoCity)
+				return;
+
+			uint64* InitialDomain = InitialDomains.GetData() + Slot * NumWords;
+			FMemory::Memcpy(InitialDomain, TagDomains.GetData() + (int32)Type * NumWords, NumWords * sizeof(uint64));
+			if(ColorTags[Cell] != ETileColorTag::ETCT_Indifferent)
+			{
+				Kernels.AndInto(InitialDomain, Rules.GetColorDomain(ColorTags[Cell]), NumWords);
+			}
+
+			if(Type == ETileType::ETT_Air)
+			{
+				CellStates[Slot] = AirState;
+			}
+			else
+			{
+				CellStates[Slot] = ECellState::Active;
+				if(Kernels.PopCount(InitialDomain, NumWords) == 0)
+				{
+					EmptyCells++;
+				}
+			}
+		});
+	}
+
+	UE_LOG(LogGeneration, Verbose, TEXT("FWFCSolver::Init - %d of %d bricks are empty, %d KB of masks"),
+		Bricks.GetNumEmptyBricks(), Bricks.GetNumBricks(), Domains.Num() * (int32)sizeof(uint64) * 2 / 1024);
+
+	if(EmptyCells > 0)
+	{
+		UE_LOG(LogGeneration, Error, TEXT("FWFCSolver::Init - %d elements have no tiles for their type and colour!"), EmptyCells);
+		return false;
+	}
+	return true;
+}
+
+bool FWFCSolver::PinCells(const TArray<int32>& PinnedVariants)
+{
+	check(PinnedVariants.Num() >= NumCells);
+
+	int32 NumPinned = 0;
+	for(int32 StoredBrick = 0; StoredBrick < StoredBricks.Num(); StoredBrick++)
+	{
+		const int32 FirstSlot = StoredBrick * FWorldBrickMap::BrickSize;
+		Bricks.ForEachCellWithIndex(StoredBricks[StoredBrick], [this, &PinnedVariants, &NumPinned, FirstSlot](int32 Cell, int32 IndexInBrick)
+		{
+			const int32 Slot = FirstSlot + IndexInBrick;
+			if(CellStates[Slot] != ECellState::Active || PinnedVariants[Cell] == INDEX_NONE)
+				return;
+
+			uint64* InitialDomain = InitialDomains.GetData() + Slot * NumWords;
+			FMemory::Memzero(InitialDomain, NumWords * sizeof(uint64));
+			WFCBitsetKernels::SetBit(InitialDomain, PinnedVariants[Cell]);
+			NumPinned++;
+		});
+	}
+
+	// Free elements next to the pins are the same in every attempt - propagate them once
+	ResetDomains();
+	for(int32 StoredBrick = 0; StoredBrick < StoredBricks.Num(); StoredBrick++)
+	{
+		const int32 FirstSlot = StoredBrick * FWorldBrickMap::BrickSize;
+		Bricks.ForEachCellWithIndex(StoredBricks[StoredBrick], [this, &PinnedVariants, FirstSlot](int32 Cell, int32 IndexInBrick)
+		{
+			const int32 Slot = FirstSlot + IndexInBrick;
+			if(CellStates[Slot] == ECellState::Active && PinnedVariants[Cell] != INDEX_NONE)
+			{
+				EnqueueNeighbours(Slot);
+			}
+		});
+	}
+	if(!PropagateQueue())
+	{
+		UE_LOG(LogGeneration, Warning, TEXT("FWFCSolver::PinCells - %d pinned elements contradict each other"), NumPinned);
+		return false;
+	}
+	FMemory::Memcpy(InitialDomains.GetData(), Domains.GetData(), Domains.Num() * sizeof(uint64));
+
+	UE_LOG(LogGeneration, Verbose, TEXT("FWFCSolver::PinCells - %d elements pinned"), NumPinned);
+	return true;
+}
+
+bool FWFCSolver::Solve(int32 Seed, int32 MaxAttempts)
+{
+	for(int32 Attempt = 0; Attempt < MaxAttempts; Attempt++)
+	{
+		if(RunAttempt(Seed, Attempt))
+		{
+			UE_LOG(LogGeneration, Display, TEXT("FWFCSolver::Solve - WFC finished! Attempts: %d"), Attempt + 1);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FWFCSolver::SolvePortfolio(const FWFCCompiledRules& Rules, const TArray<ETileType>& TileTypes, const TArray<ETileColorTag>& ColorTags, FIntVector Bounds,
+	int32 Seed, int32 MaxAttempts, int32 NumWorkers, TArray<int32>& OutVariants, const TArray<int32>* PinnedVariants)
+{
+	FGenerationArenaScope ArenaScope(TEXT("WFC"));
+	NumWorkers = FMath::Clamp(NumWorkers, 1, MaxAttempts);
+
+	// Candidates which can't fit the neighbours of the layout would only be removed by propagation of every attempt
+	TArray<uint64> TagDomains;
+	const int32 NumRemoved = WFCRuleAnalysis::PruneTagDomains(Rules, WFCRuleAnalysis::GetTagAdjacency(TileTypes, Bounds), TagDomains);
+	UE_LOG(LogGeneration, Display, TEXT("FWFCSolver::SolvePortfolio - %d candidates removed from tags before WFC"), NumRemoved);
+
+	TArray<TUniquePtr<FWFCSolver>> Solvers;
+	for(int32 Worker = 0; Worker < NumWorkers; Worker++)
+	{
+		Solvers.Add(MakeUnique<FWFCSolver>(Rules));
+		if(!Solvers[Worker]->Init(TileTypes, ColorTags, Bounds, TagDomains))
+		{
+			return false;
+		}
+		if(PinnedVariants && !Solvers[Worker]->PinCells(*PinnedVariants))
+		{
+			return false;
+		}
+	}
+
+	if(NumWorkers == 1)
+	{
+		const bool bSolved = Solvers[0]->Solve(Seed, MaxAttempts);
+		Solvers[0]->GetResult(OutVariants);
+		Solvers[0]->SaveTrace(FString::Printf(TEXT("Seed%d"), Seed));
+		return bSolved;
+	}
+
+	// MaxAttempts - no attempt has succeeded yet
+	TAtomic<int32> WinningAttempt(MaxAttempts);
+
+	ParallelFor(NumWorkers, [&Solvers, &WinningAttempt, Seed, NumWorkers](int32 Worker)
+	{
+		FWFCSolver& Solver = *Solvers[Worker];
+		Solver.WinningAttempt = &WinningAttempt;
+
+		// Attempts after the winning one can't win - stop taking them
+		for(int32 Attempt = Worker; Attempt < WinningAttempt.Load(); Attempt += NumWorkers)
+		{
+			if(Solver.RunAttempt(Seed, Attempt))
+			{
+				int32 Current = WinningAttempt.Load();
+				while(Attempt < Current && !WinningAttempt.CompareExchange(Current, Attempt))
+				{
+				}
+				// Keep the result in this solver - no later attempt of this worker can win
+				break;
+			}
+		}
+	});
+
+	const int32 Winner = WinningAttempt.Load();
+	for(int32 Worker = 0; Worker < NumWorkers; Worker++)
+	{
+		Solvers[Worker]->SaveTrace(FString::Printf(TEXT("Seed%d_Worker%d%s"), Seed, Worker,
+			Winner < MaxAttempts && Winner % NumWorkers == Worker ? TEXT("_Winner") : TEXT("")));
+	}
+	
+	if(Winner >= MaxAttempts)
+	{
+		return false;
+	}
+
+	UE_LOG(LogGeneration, Display, TEXT("FWFCSolver::SolvePortfolio - WFC finished! Attempts: %d, workers: %d"),
+		Winner + 1, NumWorkers);
+	Solvers[Winner % NumWorkers]->GetResult(OutVariants);
+	return true;
+}
+
+void FWFCSolver::GetResult(TArray<int32>& OutVariants) const
+{
+	// Empty bricks have no variants, only the stored bricks are walked
+	OutVariants.Init(INDEX_NONE, NumCells);
+	for(int32 StoredBrick = 0; StoredBrick < StoredBricks.Num(); StoredBrick++)
+	{
+		const int32 FirstSlot = StoredBrick * FWorldBrickMap::BrickSize;
+		Bricks.ForEachCellWithIndex(StoredBricks[StoredBrick], [this, &OutVariants, FirstSlot](int32 Cell, int32 IndexInBrick)
+		{
+			const int32 Slot = FirstSlot + IndexInBrick;
+			if(CellStates[Slot] == ECellState::Inactive)
+				return;
+
+			const uint64* Domain = GetDomain(Slot);
+			if(Kernels.PopCount(Domain, NumWords) == 1)
+			{
+				WFCBitsetKernels::ForEachSetBit(Domain, NumWords, [&OutVariants, Cell](int32 Variant)
+				{
+					OutVariants[Cell] = Variant;
+				});
+			}
+		});
+	}
+}
+
+bool FWFCSolver::RunAttempt(int32 Seed, int32 Attempt)
+{
+	CurrentAttempt = Attempt;
+	const int32 AttemptSeed = (int32)HashCombine(GetTypeHash(Seed), GetTypeHash(Attempt));
+	RandomStream.Initialize(AttemptSeed);
+	ResetDomains();
+	WFC_TRACE(Trace, Restart, Attempt, INDEX_NONE, AttemptSeed);
+
+	int32 SlotToCollapse = FindSlotWithLeastChoice();
+	while(SlotToCollapse != INDEX_NONE)
+	{
+		if(IsAttemptCancelled())
+		{
+			return false;
+		}
+		
+		Collapse(SlotToCollapse);
+
+		if(!PropagateQueue())
+		{
+			// Attempt again
+			return false;
+		}
+
+		// Observation:
+		SlotToCollapse = FindSlotWithLeastChoice();
+	}
+	WFC_TRACE(Trace, Finish, Attempt, INDEX_NONE, INDEX_NONE);
+	return true;
+}
+
+void FWFCSolver::ResetDomains()
+{
+	FMemory::Memcpy(Domains.GetData(), InitialDomains.GetData(), Domains.Num() * sizeof(uint64));
+	PropagationQueueHead = 0;
+	PropagationQueueNum = 0;
+	IsInQueue.SetRange(0, NumSlots, false);
+}
+
+int32 FWFCSolver::FindSlotWithLeastChoice()
+{
+	int32 ChosenSlot = INDEX_NONE;
+	float MinEntropy = MAX_flt;
+
+	// Empty bricks have no slots, and slots outside of the grid are inactive
+	for(int32 Slot = 0; Slot < NumSlots; Slot++)
+	{
+		if(CellStates[Slot] != ECellState::Active)
+			continue;
+
+		const uint64* Domain = GetDomain(Slot);
+		if(Kernels.PopCount(Domain, NumWords) <= 1)
+			continue;
+
+		float SumWeights;
+		float SumWeightLogWeights;
+		Kernels.WeightedSums(Domain, Rules.Weights.GetData(), Rules.WeightLogWeights.GetData(), NumWords,
+			SumWeights, SumWeightLogWeights);
+
+		// Small noise breaks ties between equal elements, so WFC doesn't always go in the order of the array
+		const float Entropy = FMath::Loge(SumWeights) - SumWeightLogWeights / SumWeights
+			+ RandomStream.FRand() * 1e-4f;
+		if(Entropy < MinEntropy)
+		{
+			MinEntropy = Entropy;
+			ChosenSlot = Slot;
+		}
+	}
+	return ChosenSlot;
+}
+
+void FWFCSolver::Collapse(int32 Slot)
+{
+	uint64* Domain = GetDomain(Slot);
+
+	float SumWeights;
+	float SumWeightLogWeights;
+	Kernels.WeightedSums(Domain, Rules.Weights.GetData(), Rules.WeightLogWeights.GetData(), NumWords,
+		SumWeights, SumWeightLogWeights);
+
+	float RandValue = RandomStream.FRand() * SumWeights;
+	int32 ChosenVariant = INDEX_NONE;
+	WFCBitsetKernels::ForEachSetBit(Domain, NumWords, [this, &RandValue, &ChosenVariant](int32 Variant)
+	{
+		if(ChosenVariant == INDEX_NONE || RandValue > 0.f)
+		{
+			ChosenVariant = Variant;
+		}
+		RandValue -= Rules.Weights[Variant];
+	});
+	check(ChosenVariant != INDEX_NONE);
+
+	FMemory::Memzero(Domain, NumWords * sizeof(uint64));
+	WFCBitsetKernels::SetBit(Domain, ChosenVariant);
+	WFC_TRACE(Trace, Collapse, CurrentAttempt, GetCellOfSlot(Slot), ChosenVariant);
+
+	EnqueueNeighbours(Slot);
+}
+
+bool FWFCSolver::Propagate(int32 Slot)
+{
+	uint64* Domain = GetDomain(Slot);
+	bool bChanged = false;
+
+#if WFC_TRACE_ENABLED
+	if(Trace)
+	{
+		FMemory::Memcpy(DomainBeforePropagation.GetData(), Domain, NumWords * sizeof(uint64));
+	}
+#endif
+
+	for(int32 Direction = 0; Direction < FWFCCompiledRules::NumDirections; Direction++)
+	{
+		const int32 Neighbour = GetNeighbour(Slot, Direction);
+		if(Neighbour == INDEX_NONE || CellStates[Neighbour] == ECellState::Inactive)
+		{
+			// No error in compatibility at the border of the array or of the city
+			continue;
+		}
+
+		// Candidates of this element which fit at least one candidate of the neighbour
+		BuildSupport(Neighbour, FWFCCompiledRules::ReverseDirection(Direction), Support.GetData());
+		bChanged |= Kernels.AndInto(Domain, Support.GetData(), NumWords);
+	}
+
+	if(bChanged)
+	{
+#if WFC_TRACE_ENABLED
+		if(Trace)
+		{
+			for(int32 Word = 0; Word < NumWords; Word++)
+			{
+				DomainBeforePropagation[Word] &= ~Domain[Word];
+			}
+			const int32 Cell = GetCellOfSlot(Slot);
+			WFCBitsetKernels::ForEachSetBit(DomainBeforePropagation.GetData(), NumWords, [this, Cell](int32 Variant)
+			{
+				Trace->Record(EWFCTraceEventType::Ban, CurrentAttempt, Cell, Variant);
+			});
+		}
+#endif
+		
+		if(Kernels.PopCount(Domain, NumWords) == 0)
+		{
+			// We met a contradiction! Process it outside of this function
+			WFC_TRACE(Trace, Contradiction, CurrentAttempt, GetCellOfSlot(Slot), INDEX_NONE);
+			return false;
+		}
+		EnqueueNeighbours(Slot);
+	}
+	return true;
+}
+
+bool FWFCSolver::PropagateQueue()
+{
+	while(PropagationQueueNum > 0)
+	{
+		const int32 Slot = PropagationQueue[PropagationQueueHead];
+		PropagationQueueHead = PropagationQueueHead + 1 < NumSlots ? PropagationQueueHead + 1 : 0;
+		PropagationQueueNum--;
+		IsInQueue[Slot] = false;
+
+		if(!Propagate(Slot))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void FWFCSolver::EnqueueNeighbours(int32 Slot)
+{
+	for(int32 Direction = 0; Direction < FWFCCompiledRules::NumDirections; Direction++)
+	{
+		const int32 Neighbour = GetNeighbour(Slot, Direction);
+		if(Neighbour != INDEX_NONE && CellStates[Neighbour] == ECellState::Active && !IsInQueue[Neighbour])
+		{
+			// IsInQueue keeps every element in the queue at most once, so it never holds more than NumSlots elements
+			IsInQueue[Neighbour] = true;
+			const int32 Tail = PropagationQueueHead + PropagationQueueNum;
+			PropagationQueue[Tail < NumSlots ? Tail : Tail - NumSlots] = Neighbour;
+			PropagationQueueNum++;
+		}
+	}
+}
+
+void FWFCSolver::BuildSupport(int32 Slot, int32 Direction, uint64* OutSupport) const
+{
+	FMemory::Memzero(OutSupport, NumWords * sizeof(uint64));
+	WFCBitsetKernels::ForEachSetBit(GetDomain(Slot), NumWords, [this, Direction, OutSupport](int32 Variant)
+	{
+		Kernels.OrInto(OutSupport, Rules.GetCompatible(Variant, Direction), NumWords);
+	});
+}
+
+void FWFCSolver::SaveTrace(const FString& Name) const
+{
+#if WFC_TRACE_ENABLED
+	if(!Trace)
+		return;
+
+	const FString Path = FPaths::Combine(WFCTrace::GetTraceDirectory(), Name + TEXT(".wfctrace"));
+	if(Trace->SaveToFile(Path, Bounds, Rules.VariantNames))
+	{
+		UE_LOG(LogGeneration, Display, TEXT("WFC trace saved: %s (%llu events)"), *Path, Trace->GetNumRecorded());
+	}
+	else
+	{
+		UE_LOG(LogGeneration, Error, TEXT("WFC trace can't be saved: %s"), *Path);
+	}
+#endif
+}
@@ -0,0 +1,175 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "WFCCompiledRules.h"
+#include "WFCBitsetKernels.h"
+#include "WFCTrace.h"
+#include "GenerationArena.h"
+#include "WorldBrickMap.h"
+#include "GenerationMemory.h"
+
+/**
+ * Wave function collapse over candidate bitsets
+ * Each element of the grid holds a mask of variants of FWFCCompiledRules which still can be set there
+ * Elements are stored by bricks of FWorldBrickMap: empty bricks (Air or NoCity only) have no state and no masks of their own
+ * Internally an element is a slot - BrickSize slots of each stored brick in a row. Only the input planes and the result are dense
+ * All the buffers of the solver live in the generation arena: create and destroy it inside one FGenerationArenaScope
+ */
+class SHOOTER_API FWFCSolver
+{
+public:
+	FWFCSolver(const FWFCCompiledRules& InRules);
+
+	// Sets up initial candidates of the elements by their types: TagDomains in the layout of FWFCCompiledRules::TagDomains,
+	// usually pruned by WFCRuleAnalysis::PruneTagDomains. Candidates are restricted by the colours of the elements
+	// TileTypes and ColorTags are indexed as UWorldItem3DArray: z * Y * X + y * X + x. Only the first InBounds.Z slabs are used
+	// Returns false if any element has no candidates at all
+	bool Init(const TArray<ETileType>& TileTypes, const TArray<ETileColorTag>& ColorTags, FIntVector InBounds, const TArray<uint64>& TagDomains);
+
+	// Keeps the variants of a previous solution: element i with PinnedVariants[i] != INDEX_NONE can take only this variant
+	// Pins are propagated into the initial candidates once, so every attempt solves only the free elements
+	// Returns false if the pins contradict each other
+	bool PinCells(const TArray<int32>& PinnedVariants);
+
+	// Makes up to MaxAttempts attempts, each starts from the initial candidates with its own random stream
+	bool Solve(int32 Seed, int32 MaxAttempts);
+
+	// Races NumWorkers solvers on worker threads. Worker W makes attempts W, W + NumWorkers, W + 2 * NumWorkers...
+	// The successful attempt with the smallest index wins and cancels all the attempts after it,
+	// so the result is the same as of Solve() with the same seed - only faster when early attempts fail
+	// PinnedVariants - optional variants to keep, see PinCells()
+	static bool SolvePortfolio(const FWFCCompiledRules& Rules, const TArray<ETileType>& TileTypes, const TArray<ETileColorTag>& ColorTags, FIntVector Bounds,
+		int32 Seed, int32 MaxAttempts, int32 NumWorkers, TArray<int32>& OutVariants, const TArray<int32>* PinnedVariants = nullptr);
+
+	// Outputs the chosen variant of each element of the solved area
+	// INDEX_NONE for elements which don't take part in WFC (NoCity) or are not chosen
+	void GetResult(TArray<int32>& OutVariants) const;
+
+	FORCEINLINE int32 GetNumCells() const { return NumCells; }
+
+	// Saves recorded events into Saved/WFCTraces/<Name>.wfctrace if tracing is on
+	void SaveTrace(const FString& Name) const;
+
+protected:
+	// NoCity elements are skipped - there's nothing to compare with at the border of the city
+	// Air elements keep their candidates and only restrict their neighbours
+	enum class ECellState : uint8
+	{
+		Inactive,
+		Passive,
+		Active
+	};
+
+	// Runs attempt number Attempt of the seed. Returns false on contradiction or if cancelled
+	bool RunAttempt(int32 Seed, int32 Attempt);
+
+	// Portfolio solving: an attempt is cancelled when an attempt with a smaller index has already succeeded
+	FORCEINLINE bool IsAttemptCancelled() const
+	{
+		return WinningAttempt && WinningAttempt->Load(EMemoryOrder::Relaxed) < CurrentAttempt;
+	}
+
+	void ResetDomains();
+
+	// Returns the slot of an undecided element with the least entropy, or INDEX_NONE if every element is decided
+	int32 FindSlotWithLeastChoice();
+
+	// Chooses one of the candidates of the element by weight
+	void Collapse(int32 Slot);
+
+	// Removes candidates of the element which have no compatible candidate in any of neighbours
+	// Returns false if we met a contradiction, otherwise returns true
+	bool Propagate(int32 Slot);
+
+	// Propagates the elements of PropagationQueue until it's empty. Returns false on contradiction
+	bool PropagateQueue();
+
+	// Adds active neighbours of the element to the propagation queue
+	void EnqueueNeighbours(int32 Slot);
+
+	// Returns the slot of a neighbour in a world direction, or INDEX_NONE at the border of the grid
+	// and in empty bricks which take no part in WFC
+	FORCEINLINE int32 GetNeighbour(int32 Slot, int32 Direction) const
+	{
+		const int32 IndexInBrick = Slot & (FWorldBrickMap::BrickSize - 1);
+		const uint8 Next = InBrickNeighbours[Direction][IndexInBrick];
+		if((Next & CrossesBrick) == 0)
+		{
+			return Slot - IndexInBrick + Next;
+		}
+		const int32 BrickSlot = BrickNeighbourSlots[(Slot >> FWorldBrickMap::BrickSizeShift) * FWFCCompiledRules::NumDirections + Direction];
+		return BrickSlot != INDEX_NONE ? BrickSlot + (Next & ~CrossesBrick) : INDEX_NONE;
+	}
+
+	// Linear index of the element of a slot - for the trace only, it divides
+	FORCEINLINE int32 GetCellOfSlot(int32 Slot) const
+	{
+		return Bricks.GetCell(StoredBricks[Slot >> FWorldBrickMap::BrickSizeShift], Slot & (FWorldBrickMap::BrickSize - 1));
+	}
+
+	// Makes the mask of variants which fit in Direction of any candidate of the element
+	void BuildSupport(int32 Slot, int32 Direction, uint64* OutSupport) const;
+
+	FORCEINLINE uint64* GetDomain(int32 Slot)
+	{
+		return Domains.GetData() + Slot * NumWords;
+	}
+
+	FORCEINLINE const uint64* GetDomain(int32 Slot) const
+	{
+		return Domains.GetData() + Slot * NumWords;
+	}
+
+	const FWFCCompiledRules& Rules;
+	const FWFCBitsetKernelTable& Kernels;
+
+	FIntVector Bounds;
+	int32 NumCells;
+	int32 NumWords;
+	// Slots of StoredBricks. Only they can be active
+	int32 NumSlots;
+
+	FWorldBrickMap Bricks;
+	// Bricks which have state of their own, in the order of the grid
+	TGenerationArenaArray<int32> StoredBricks;
+	// [Slot] - slots of StoredBricks, then one brick of passive Air slots which all empty Air bricks share
+	// Slots of a stored brick outside of the grid are inactive
+	TGenerationArenaArray<ECellState> CellStates;
+	// [Slot * NumWords] - masks in the same layout as CellStates
+	TGenerationArenaArray<uint64> InitialDomains;
+	TGenerationArenaArray<uint64> Domains;
+
+	// Bit of InBrickNeighbours when the neighbour is in the next brick
+	static constexpr uint8 CrossesBrick = 0x80;
+	// [Direction][IndexInBrick] - index of the neighbour in the same brick, or CrossesBrick | its index in the next brick
+	uint8 InBrickNeighbours[FWFCCompiledRules::NumDirections][FWorldBrickMap::BrickSize];
+	// [StoredBrick * NumDirections + Direction] - first slot of the neighbour brick, INDEX_NONE if it takes no part in WFC
+	TGenerationArenaArray<int32> BrickNeighbourSlots;
+
+	// Ring of NumSlots elements: PropagationQueueNum elements from PropagationQueueHead, wrapped at the end
+	TGenerationArenaArray<int32> PropagationQueue;
+	int32 PropagationQueueHead;
+	int32 PropagationQueueNum;
+	TBitArray<> IsInQueue;
+
+	TGenerationArenaArray<uint64> Support;
+
+	FRandomStream RandomStream;
+
+	int32 CurrentAttempt;
+	// Smallest successful attempt of the portfolio, shared between workers. nullptr when solving alone
+	const TAtomic<int32>* WinningAttempt;
+
+	// Bytes of the buffers above while the solver lives
+	FGenerationMemoryCounter DomainsMemory;
+	FGenerationMemoryCounter QueueMemory;
+
+#if WFC_TRACE_ENABLED
+	// Events of this solver, nullptr when tracing is off
+	TUniquePtr<FWFCTraceBuffer> Trace;
+	// Candidates of the element before propagation - to record bans
+	TGenerationArenaArray<uint64> DomainBeforePropagation;
+#endif
+};
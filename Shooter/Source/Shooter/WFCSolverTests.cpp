@@ -0,0 +1,273 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+// Automation tests of FWFCSolver and WFCValidator on small hand-made rules, without a tile registry
+// Run in the editor: Session Frontend > Automation > Shooter.WFC, or "Automation RunTests Shooter.WFC"
+
+
+#include "WFCSolver.h"
+#include "WFCValidator.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	const int32 SolverTestNumVariants = 4;
+	const FIntVector SolverTestBounds(16, 16, 2);
+	const int32 SolverTestMaxAttempts = 16;
+
+	// Road variants which can't stand next to themselves on the ground plane, anything goes along Z
+	// Colours other than Indifferent have no variants at all
+	void MakeSolverTestRules(FWFCCompiledRules& Rules)
+	{
+		Rules.Reset(SolverTestNumVariants);
+		for(int32 Variant = 0; Variant < SolverTestNumVariants; Variant++)
+		{
+			Rules.Variants.Add({ 0, ETileRotation::ETR_Forward, 1 });
+			Rules.VariantTags.Add(ETileType::ETT_Road);
+			Rules.VariantNames.Add(FString::Printf(TEXT("TestTile_%d:ETR_Forward"), Variant));
+			Rules.Weights[Variant] = 1.f;
+			Rules.WeightLogWeights[Variant] = 0.f;
+			WFCBitsetKernels::SetBit(Rules.GetTagDomain(ETileType::ETT_Road), Variant);
+			WFCBitsetKernels::SetBit(Rules.GetColorDomain(ETileColorTag::ETCT_Indifferent), Variant);
+
+			for(int32 Direction = 0; Direction < FWFCCompiledRules::NumDirections; Direction++)
+			{
+				for(int32 Neighbour = 0; Neighbour < SolverTestNumVariants; Neighbour++)
+				{
+					if(Direction >= (int32)ETileCompatibilityDeltaPosition::ETDP_OnTop || Neighbour != Variant)
+					{
+						WFCBitsetKernels::SetBit(Rules.GetCompatible(Variant, Direction), Neighbour);
+					}
+				}
+			}
+		}
+	}
+
+	// Roads with a NoCity column along x = 0, so inactive elements are in the grid too
+	void MakeSolverTestLayout(TArray<ETileType>& TileTypes, TArray<ETileColorTag>& ColorTags)
+	{
+		const int32 NumCells = SolverTestBounds.X * SolverTestBounds.Y * SolverTestBounds.Z;
+		TileTypes.Init(ETileType::ETT_Road, NumCells);
+		ColorTags.Init(ETileColorTag::ETCT_Indifferent, NumCells);
+		for(int32 Cell = 0; Cell < NumCells; Cell += SolverTestBounds.X)
+		{
+			TileTypes[Cell] = ETileType::ETT_NoCity;
+		}
+	}
+
+	int32 GetSolverTestCell(int32 x, int32 y, int32 z)
+	{
+		return (z * SolverTestBounds.Y + y) * SolverTestBounds.X + x;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FWFCSolverDeterminismTest, "Shooter.WFC.Solver.Determinism",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FWFCSolverDeterminismTest::RunTest(const FString& Parameters)
+{
+	FWFCCompiledRules Rules;
+	MakeSolverTestRules(Rules);
+	TArray<ETileType> TileTypes;
+	TArray<ETileColorTag> ColorTags;
+	MakeSolverTestLayout(TileTypes, ColorTags);
+
+	const int32 Seed = 1234;
+	TArray<int32> First;
+	TArray<int32> Second;
+	TArray<int32> Portfolio;
+	TArray<int32> OtherSeed;
+	if(!TestTrue(TEXT("Solved alone"), FWFCSolver::SolvePortfolio(Rules, TileTypes, ColorTags, SolverTestBounds, Seed, SolverTestMaxAttempts, 1, First))
+		|| !TestTrue(TEXT("Solved alone again"), FWFCSolver::SolvePortfolio(Rules, TileTypes, ColorTags, SolverTestBounds, Seed, SolverTestMaxAttempts, 1, Second))
+		|| !TestTrue(TEXT("Solved by 4 workers"), FWFCSolver::SolvePortfolio(Rules, TileTypes, ColorTags, SolverTestBounds, Seed, SolverTestMaxAttempts, 4, Portfolio))
+		|| !TestTrue(TEXT("Solved with another seed"), FWFCSolver::SolvePortfolio(Rules, TileTypes, ColorTags, SolverTestBounds, Seed + 1, SolverTestMaxAttempts, 1, OtherSeed)))
+	{
+		return false;
+	}
+
+	// The portfolio keeps the first successful attempt, so it has to match solving alone
+	TestTrue(TEXT("Same seed gives the same city"), First == Second);
+	TestTrue(TEXT("Portfolio gives the same city as solving alone"), First == Portfolio);
+	TestFalse(TEXT("Another seed gives another city"), First == OtherSeed);
+
+	TestEqual(TEXT("NoCity element has no variant"), First[GetSolverTestCell(0, 3, 1)], (int32)INDEX_NONE);
+	TArray<FWFCViolation> Violations;
+	TestEqual(TEXT("Violations of the solved city"),
+		WFCValidator::Validate(Rules, TileTypes, ColorTags, First, SolverTestBounds, Violations), 0);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FWFCSolverPinnedCellsTest, "Shooter.WFC.Solver.KeepsPinnedCells",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FWFCSolverPinnedCellsTest::RunTest(const FString& Parameters)
+{
+	FWFCCompiledRules Rules;
+	MakeSolverTestRules(Rules);
+	TArray<ETileType> TileTypes;
+	TArray<ETileColorTag> ColorTags;
+	MakeSolverTestLayout(TileTypes, ColorTags);
+
+	TArray<int32> Solved;
+	if(!TestTrue(TEXT("Solved"), FWFCSolver::SolvePortfolio(Rules, TileTypes, ColorTags, SolverTestBounds, 1, SolverTestMaxAttempts, 1, Solved)))
+	{
+		return false;
+	}
+
+	// Re-solve after a hot reload keeps the variants which didn't change: here the left half of the city
+	TArray<int32> Pinned;
+	Pinned.Init(INDEX_NONE, Solved.Num());
+	for(int32 Cell = 0; Cell < Solved.Num(); Cell++)
+	{
+		if(Cell % SolverTestBounds.X < SolverTestBounds.X / 2)
+		{
+			Pinned[Cell] = Solved[Cell];
+		}
+	}
+
+	TArray<int32> Resolved;
+	if(!TestTrue(TEXT("Solved again with pins"), FWFCSolver::SolvePortfolio(Rules, TileTypes, ColorTags, SolverTestBounds, 2, SolverTestMaxAttempts, 4, Resolved, &Pinned)))
+	{
+		return false;
+	}
+
+	int32 NumMoved = 0;
+	for(int32 Cell = 0; Cell < Pinned.Num(); Cell++)
+	{
+		NumMoved += Pinned[Cell] != INDEX_NONE && Resolved[Cell] != Pinned[Cell] ? 1 : 0;
+	}
+	TestEqual(TEXT("Pinned elements which changed their variant"), NumMoved, 0);
+
+	TArray<FWFCViolation> Violations;
+	TestEqual(TEXT("Violations of the re-solved city"),
+		WFCValidator::Validate(Rules, TileTypes, ColorTags, Resolved, SolverTestBounds, Violations), 0);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FWFCSolverEmptyBricksTest, "Shooter.WFC.Solver.EmptyBricks",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FWFCSolverEmptyBricksTest::RunTest(const FString& Parameters)
+{
+	FWFCCompiledRules Rules;
+	MakeSolverTestRules(Rules);
+
+	// Roads in the corner of the ground cut across bricks, NoCity around them and Air above - the rules have no Air,
+	// so the whole upper slab and the NoCity bricks take no part in WFC
+	const FIntVector Bounds(20, 12, 2);
+	const FIntPoint RoadEnd(11, 10);
+	TArray<ETileType> TileTypes;
+	TArray<ETileColorTag> ColorTags;
+	TileTypes.Init(ETileType::ETT_Air, Bounds.X * Bounds.Y * Bounds.Z);
+	ColorTags.Init(ETileColorTag::ETCT_Indifferent, TileTypes.Num());
+	for(int32 y = 0; y < Bounds.Y; y++)
+	{
+		for(int32 x = 0; x < Bounds.X; x++)
+		{
+			TileTypes[y * Bounds.X + x] = x < RoadEnd.X && y < RoadEnd.Y ? ETileType::ETT_Road : ETileType::ETT_NoCity;
+		}
+	}
+
+	TArray<int32> Solved;
+	if(!TestTrue(TEXT("Solved"), FWFCSolver::SolvePortfolio(Rules, TileTypes, ColorTags, Bounds, 7, SolverTestMaxAttempts, 1, Solved)))
+	{
+		return false;
+	}
+	if(!TestEqual(TEXT("Elements of the result"), Solved.Num(), TileTypes.Num()))
+	{
+		return false;
+	}
+
+	int32 NumUnsolvedRoads = 0;
+	int32 NumSameNeighbours = 0;
+	int32 NumOtherVariants = 0;
+	for(int32 Cell = 0; Cell < Solved.Num(); Cell++)
+	{
+		const int32 x = Cell % Bounds.X;
+		const int32 y = (Cell / Bounds.X) % Bounds.Y;
+		if(TileTypes[Cell] != ETileType::ETT_Road)
+		{
+			NumOtherVariants += Solved[Cell] != INDEX_NONE ? 1 : 0;
+			continue;
+		}
+		NumUnsolvedRoads += Solved[Cell] == INDEX_NONE ? 1 : 0;
+		NumSameNeighbours += x + 1 < RoadEnd.X && Solved[Cell + 1] == Solved[Cell] ? 1 : 0;
+		NumSameNeighbours += y + 1 < RoadEnd.Y && Solved[Cell + Bounds.X] == Solved[Cell] ? 1 : 0;
+	}
+	TestEqual(TEXT("Roads without a variant"), NumUnsolvedRoads, 0);
+	TestEqual(TEXT("Roads with the same variant as a neighbour"), NumSameNeighbours, 0);
+	TestEqual(TEXT("NoCity and Air elements with a variant"), NumOtherVariants, 0);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FWFCValidatorFindsViolationsTest, "Shooter.WFC.Validator.FindsViolations",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FWFCValidatorFindsViolationsTest::RunTest(const FString& Parameters)
+{
+	FWFCCompiledRules Rules;
+	MakeSolverTestRules(Rules);
+	TArray<ETileType> TileTypes;
+	TArray<ETileColorTag> ColorTags;
+	MakeSolverTestLayout(TileTypes, ColorTags);
+
+	TArray<int32> Solved;
+	if(!TestTrue(TEXT("Solved"), FWFCSolver::SolvePortfolio(Rules, TileTypes, ColorTags, SolverTestBounds, 1, SolverTestMaxAttempts, 1, Solved)))
+	{
+		return false;
+	}
+
+	const int32 Cell = GetSolverTestCell(5, 5, 1);
+	const FIntVector CellCoords(5, 5, 1);
+	TArray<FWFCViolation> Violations;
+
+	auto HasViolation = [&Violations, &CellCoords](EWFCViolationType Type, int32 Direction)
+	{
+		return Violations.ContainsByPredicate([&CellCoords, Type, Direction](const FWFCViolation& Violation)
+		{
+			return Violation.Type == Type && Violation.Cell == CellCoords && Violation.Direction == Direction;
+		});
+	};
+
+	{
+		TArray<int32> Variants = Solved;
+		Variants[Cell] = INDEX_NONE;
+		TestEqual(TEXT("Violations of an unsolved element"), WFCValidator::Validate(Rules, TileTypes, ColorTags, Variants, SolverTestBounds, Violations), 1);
+		TestTrue(TEXT("Unsolved element is reported"), HasViolation(EWFCViolationType::Unsolved, INDEX_NONE));
+	}
+	{
+		// The same variant as the right neighbour
+		TArray<int32> Variants = Solved;
+		Variants[Cell] = Variants[Cell + 1];
+		TestTrue(TEXT("Incompatible neighbours make violations"), WFCValidator::Validate(Rules, TileTypes, ColorTags, Variants, SolverTestBounds, Violations) >= 1);
+		TestTrue(TEXT("Incompatible right neighbour is reported"), HasViolation(EWFCViolationType::Incompatible, (int32)ETileCompatibilityDeltaPosition::ETDP_OnRight));
+	}
+	{
+		TArray<ETileType> WrongTypes = TileTypes;
+		WrongTypes[Cell] = ETileType::ETT_Building_Door_Section;
+		TestEqual(TEXT("Violations of a variant of another type"), WFCValidator::Validate(Rules, WrongTypes, ColorTags, Solved, SolverTestBounds, Violations), 1);
+		TestTrue(TEXT("Variant of another type is reported"), HasViolation(EWFCViolationType::WrongType, INDEX_NONE));
+	}
+	{
+		TArray<ETileColorTag> WrongColors = ColorTags;
+		WrongColors[Cell] = ETileColorTag::ETCT_01_A;
+		TestEqual(TEXT("Violations of a variant of another colour"), WFCValidator::Validate(Rules, TileTypes, WrongColors, Solved, SolverTestBounds, Violations), 1);
+		TestTrue(TEXT("Variant of another colour is reported"), HasViolation(EWFCViolationType::WrongColor, INDEX_NONE));
+	}
+	{
+		// Whole row without variants: every element is counted, only MaxReported are listed
+		TArray<int32> Variants = Solved;
+		for(int32 x = 0; x < SolverTestBounds.X; x++)
+		{
+			Variants[GetSolverTestCell(x, 2, 0)] = INDEX_NONE;
+		}
+		const int32 MaxReported = 4;
+		TestEqual(TEXT("Violations of an unsolved row"),
+			WFCValidator::Validate(Rules, TileTypes, ColorTags, Variants, SolverTestBounds, Violations, MaxReported), SolverTestBounds.X - 1);
+		TestEqual(TEXT("Reported violations"), Violations.Num(), MaxReported);
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,236 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WFCTrace.h"
+#include "GenerationLogs.h"
+#include "WorldImageExport.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/BufferArchive.h"
+#include "Serialization/MemoryReader.h"
+
+static TAutoConsoleVariable<int32> CVarWFCTrace(
+	TEXT("wfc.Trace"),
+	0,
+	TEXT("Records WFC solver events and saves them to Saved/WFCTraces after each generation.\n")
+	TEXT("Decode the files with WFC.DecodeTrace <File>"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarWFCTraceCapacity(
+	TEXT("wfc.TraceCapacity"),
+	1 << 18,
+	TEXT("Amount of last events kept by each WFC solver when wfc.Trace is on"),
+	ECVF_Default);
+
+// 'WFCT'
+static const uint32 TraceFileMagic = 0x54434657;
+static const uint32 TraceFileVersion = 1;
+
+FWFCTraceBuffer::FWFCTraceBuffer(int32 Capacity) :
+Mask(0),
+Head(0)
+{
+	const uint32 RoundedCapacity = FMath::RoundUpToPowerOfTwo((uint32)FMath::Max(Capacity, 1));
+	Events.SetNumZeroed(RoundedCapacity);
+	Mask = RoundedCapacity - 1;
+}
+
+bool FWFCTraceBuffer::SaveToFile(const FString& Path, FIntVector Bounds, const TArray<FString>& VariantNames) const
+{
+	const uint64 NumKept = FMath::Min<uint64>(Head, (uint64)Events.Num());
+	const uint64 First = Head - NumKept;
+	
+	FBufferArchive Ar;
+	uint32 Magic = TraceFileMagic;
+	uint32 Version = TraceFileVersion;
+	uint64 NumDropped = First;
+	uint64 NumEvents = NumKept;
+	TArray<FString> Names = VariantNames;
+	Ar << Magic << Version << Bounds << Names << NumDropped << NumEvents;
+
+	for(uint64 i = First; i < Head; i++)
+	{
+		FWFCTraceEvent Event = Events[(int32)(i & Mask)];
+		Ar.Serialize(&Event, sizeof(FWFCTraceEvent));
+	}
+
+	return FFileHelper::SaveArrayToFile(Ar, *Path);
+}
+
+namespace WFCTrace
+{
+	int32 GetBufferCapacity()
+	{
+#if WFC_TRACE_ENABLED
+		return CVarWFCTrace.GetValueOnAnyThread() != 0 ? FMath::Max(CVarWFCTraceCapacity.GetValueOnAnyThread(), 1) : 0;
+#else
+		return 0;
+#endif
+	}
+
+	FString GetTraceDirectory()
+	{
+		return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("WFCTraces"));
+	}
+
+	static const TCHAR* GetEventName(EWFCTraceEventType Type)
+	{
+		switch (Type)
+		{
+		case EWFCTraceEventType::Restart:
+			return TEXT("Restart");
+		case EWFCTraceEventType::Collapse:
+			return TEXT("Collapse");
+		case EWFCTraceEventType::Ban:
+			return TEXT("Ban");
+		case EWFCTraceEventType::Contradiction:
+			return TEXT("Contradiction");
+		case EWFCTraceEventType::Finish:
+			return TEXT("Finish");
+		default:
+			return TEXT("Unknown");
+		}
+	}
+
+	bool DecodeFile(const FString& Path)
+	{
+		TArray<uint8> Data;
+		if(!FFileHelper::LoadFileToArray(Data, *Path))
+		{
+			UE_LOG(LogGeneration, Error, TEXT("WFCTrace::DecodeFile - can't read %s"), *Path);
+			return false;
+		}
+
+		FMemoryReader Ar(Data);
+		uint32 Magic = 0;
+		uint32 Version = 0;
+		FIntVector Bounds;
+		TArray<FString> VariantNames;
+		uint64 NumDropped = 0;
+		uint64 NumEvents = 0;
+		Ar << Magic << Version;
+		if(Magic != TraceFileMagic || Version != TraceFileVersion)
+		{
+			UE_LOG(LogGeneration, Error, TEXT("WFCTrace::DecodeFile - %s is not a WFC trace of version %d"), *Path, TraceFileVersion);
+			return false;
+		}
+		Ar << Bounds << VariantNames << NumDropped << NumEvents;
+
+		const int32 NumCells = Bounds.X * Bounds.Y * Bounds.Z;
+		TArray<int32> Bans;
+		TArray<float> Contradictions;
+		Bans.Init(0, NumCells);
+		Contradictions.Init(0.f, NumCells);
+		// Order of collapse and attempt of the collapse of each element - only collapses of the last attempt are shown
+		TArray<float> CollapseOrder;
+		TArray<int32> CollapseAttempts;
+		CollapseOrder.Init(-1.f, NumCells);
+		CollapseAttempts.Init(INDEX_NONE, NumCells);
+		int32 LastAttempt = INDEX_NONE;
+		int32 NumCollapses = 0;
+
+		auto GetVariantName = [&VariantNames](int32 Variant)
+		{
+			return VariantNames.IsValidIndex(Variant) ? VariantNames[Variant] : FString::Printf(TEXT("#%d"), Variant);
+		};
+
+		TArray<FString> Lines;
+		Lines.Add(FString::Printf(TEXT("Bounds: X %d, Y %d, Z %d. Events: %llu, dropped by ring buffer: %llu"),
+			Bounds.X, Bounds.Y, Bounds.Z, NumEvents, NumDropped));
+
+		for(uint64 i = 0; i < NumEvents && !Ar.IsError() && !Ar.AtEnd(); i++)
+		{
+			FWFCTraceEvent Event;
+			Ar.Serialize(&Event, sizeof(FWFCTraceEvent));
+
+			FString Line = FString::Printf(TEXT("[%d] %s"), Event.Attempt, GetEventName(Event.Type));
+			if(Event.Cell >= 0 && Event.Cell < NumCells)
+			{
+				Line += FString::Printf(TEXT(" X: %d, Y: %d, Z: %d"),
+					Event.Cell % Bounds.X, (Event.Cell / Bounds.X) % Bounds.Y, Event.Cell / (Bounds.X * Bounds.Y));
+
+				if(Event.Type == EWFCTraceEventType::Ban)
+				{
+					Bans[Event.Cell]++;
+				}
+				if(Event.Type == EWFCTraceEventType::Contradiction)
+				{
+					Contradictions[Event.Cell]++;
+				}
+				if(Event.Type == EWFCTraceEventType::Collapse)
+				{
+					CollapseOrder[Event.Cell] = NumCollapses++;
+					CollapseAttempts[Event.Cell] = Event.Attempt;
+				}
+			}
+			if(Event.Type == EWFCTraceEventType::Restart)
+			{
+				LastAttempt = Event.Attempt;
+				NumCollapses = 0;
+			}
+
+			if(Event.Type == EWFCTraceEventType::Collapse || Event.Type == EWFCTraceEventType::Ban)
+			{
+				Line += TEXT(" - ") + GetVariantName(Event.Value);
+			}
+			else if(Event.Type == EWFCTraceEventType::Restart)
+			{
+				Line += FString::Printf(TEXT(" - seed %d"), Event.Value);
+			}
+			Lines.Add(Line);
+		}
+
+		// Heatmap: "Bans/Contradictions" per element, rows along X as in LogDrawArray2DSlice
+		TArray<FString> Heatmap;
+		for(int32 z = 0; z < Bounds.Z; z++)
+		{
+			Heatmap.Add(FString::Printf(TEXT("Z = %d"), z));
+			for(int32 y = 0; y < Bounds.Y; y++)
+			{
+				FString Row;
+				for(int32 x = 0; x < Bounds.X; x++)
+				{
+					const int32 Cell = z * Bounds.Y * Bounds.X + y * Bounds.X + x;
+					Row += FString::Printf(TEXT("%s%d/%d"), x > 0 ? TEXT(",") : TEXT(""), Bans[Cell], (int32)Contradictions[Cell]);
+				}
+				Heatmap.Add(Row);
+			}
+		}
+
+		bool bSaved = FFileHelper::SaveStringArrayToFile(Lines, *(Path + TEXT(".txt")))
+			&& FFileHelper::SaveStringArrayToFile(Heatmap, *(Path + TEXT(".heatmap.csv")));
+
+		for(int32 Cell = 0; Cell < NumCells; Cell++)
+		{
+			if(CollapseAttempts[Cell] != LastAttempt)
+			{
+				CollapseOrder[Cell] = -1.f;
+			}
+		}
+
+		const int32 SlabSize = Bounds.X * Bounds.Y;
+		FWorldImage Image;
+		for(int32 z = 0; z < Bounds.Z; z++)
+		{
+			WorldImageExport::DrawHeatmap(TArrayView<const float>(CollapseOrder.GetData() + z * SlabSize, SlabSize), Bounds.X, Bounds.Y, Image);
+			bSaved &= WorldImageExport::SaveImage(Image, FString::Printf(TEXT("%s.collapse.z%d.png"), *Path, z));
+			WorldImageExport::DrawHeatmap(TArrayView<const float>(Contradictions.GetData() + z * SlabSize, SlabSize), Bounds.X, Bounds.Y, Image);
+			bSaved &= WorldImageExport::SaveImage(Image, FString::Printf(TEXT("%s.contradictions.z%d.png"), *Path, z));
+		}
+		UE_LOG(LogGeneration, Display, TEXT("WFCTrace::DecodeFile - %s: %llu events decoded"), *Path, NumEvents);
+		return bSaved;
+	}
+}
+
+static FAutoConsoleCommand DecodeTraceCommand(
+	TEXT("WFC.DecodeTrace"),
+	TEXT("Decodes a WFC trace file (absolute or relative to Saved/WFCTraces) into a readable .txt, a .heatmap.csv and heatmap images per Z-slab"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		for(const FString& Arg : Args)
+		{
+			const FString Path = FPaths::IsRelative(Arg) ? FPaths::Combine(WFCTrace::GetTraceDirectory(), Arg) : Arg;
+			WFCTrace::DecodeFile(Path);
+		}
+	}));
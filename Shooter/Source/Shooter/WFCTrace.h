@@ -0,0 +1,91 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Tracing of WFC solver events. Compiled out in shipping builds; in other builds turned on by wfc.Trace
+#ifndef WFC_TRACE_ENABLED
+	#define WFC_TRACE_ENABLED !UE_BUILD_SHIPPING
+#endif
+
+enum class EWFCTraceEventType : uint8
+{
+	// Attempt started from the initial candidates. Value - seed of the attempt
+	Restart,
+	// Element got one candidate chosen by weight. Value - chosen variant
+	Collapse,
+	// Candidate removed from the element by propagation. Value - removed variant
+	Ban,
+	// Element has no candidates left. Value - INDEX_NONE
+	Contradiction,
+	// Attempt finished successfully. Value - INDEX_NONE
+	Finish
+};
+
+struct FWFCTraceEvent
+{
+	// Linear index of the element in the solved area, INDEX_NONE for Restart and Finish
+	int32 Cell;
+	int32 Value;
+	uint16 Attempt;
+	EWFCTraceEventType Type;
+	uint8 Padding;
+};
+static_assert(sizeof(FWFCTraceEvent) == 12, "FWFCTraceEvent is written to trace files as is");
+
+/**
+ * Ring buffer of solver events. Keeps the last Capacity events: when full, the oldest ones are overwritten
+ * Written by one solver only - every worker of the portfolio has its own buffer
+ */
+class SHOOTER_API FWFCTraceBuffer
+{
+public:
+	// Capacity is rounded up to a power of two
+	FWFCTraceBuffer(int32 Capacity);
+
+	FORCEINLINE void Record(EWFCTraceEventType Type, int32 Attempt, int32 Cell, int32 Value)
+	{
+		FWFCTraceEvent& Event = Events[(int32)(Head & Mask)];
+		Event.Cell = Cell;
+		Event.Value = Value;
+		Event.Attempt = (uint16)Attempt;
+		Event.Type = Type;
+		Event.Padding = 0;
+		Head++;
+	}
+
+	// Writes events in chronological order with bounds of the solved area and names of variants,
+	// so the file can be decoded without the registry
+	bool SaveToFile(const FString& Path, FIntVector Bounds, const TArray<FString>& VariantNames) const;
+
+	FORCEINLINE uint64 GetNumRecorded() const { return Head; }
+
+private:
+	TArray<FWFCTraceEvent> Events;
+	uint64 Mask;
+	uint64 Head;
+};
+
+namespace WFCTrace
+{
+	// Capacity of a new buffer per solver, or 0 if tracing is off
+	SHOOTER_API int32 GetBufferCapacity();
+
+	// Directory for trace files: Saved/WFCTraces
+	SHOOTER_API FString GetTraceDirectory();
+
+	// Decodes a trace file into:
+	// - <Path>.txt - readable list of events
+	// - <Path>.heatmap.csv - bans and contradictions per element, one table per Z-slab
+	// - <Path>.collapse.z<Z>.png - order of collapses of the last attempt, <Path>.contradictions.z<Z>.png - contradictions of all attempts
+	SHOOTER_API bool DecodeFile(const FString& Path);
+}
+
+// One statement in both builds, so it's safe in an if/else without braces
+#if WFC_TRACE_ENABLED
+	#define WFC_TRACE(Buffer, Type, Attempt, Cell, Value) \
+		do { if(Buffer) { (Buffer)->Record(EWFCTraceEventType::Type, Attempt, Cell, Value); } } while(0)
+#else
+	#define WFC_TRACE(Buffer, Type, Attempt, Cell, Value) do { } while(0)
+#endif
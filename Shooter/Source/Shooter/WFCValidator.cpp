@@ -0,0 +1,144 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WFCValidator.h"
+#include "GenerationLogs.h"
+#include "TileCompatibilityDeltaPosition.h"
+#include "Async/ParallelFor.h"
+
+int32 WFCValidator::Validate(const FWFCCompiledRules& Rules, const TArray<ETileType>& TileTypes, const TArray<ETileColorTag>& ColorTags,
+	const TArray<int32>& Variants, FIntVector Bounds, TArray<FWFCViolation>& OutViolations, int32 MaxReported)
+{
+	const int32 SlabSize = Bounds.X * Bounds.Y;
+	const int32 NumRows = Bounds.Y * Bounds.Z;
+	check(TileTypes.Num() >= SlabSize * Bounds.Z);
+	check(ColorTags.Num() >= SlabSize * Bounds.Z);
+	check(Variants.Num() >= SlabSize * Bounds.Z);
+
+	// Each pair once: from the element to its right, backward and top neighbour
+	const int32 Right = (int32)ETileCompatibilityDeltaPosition::ETDP_OnRight;
+	const int32 Backward = (int32)ETileCompatibilityDeltaPosition::ETDP_OnBackward;
+	const int32 Top = (int32)ETileCompatibilityDeltaPosition::ETDP_OnTop;
+
+	// Every row keeps its own violations, so workers never share anything
+	TArray<TArray<FWFCViolation>> RowViolations;
+	RowViolations.SetNum(NumRows);
+	TArray<int32> RowNumViolations;
+	RowNumViolations.Init(0, NumRows);
+
+	ParallelFor(NumRows, [&](int32 Row)
+	{
+		const int32 y = Row % Bounds.Y;
+		const int32 z = Row / Bounds.Y;
+		TArray<FWFCViolation>& Violations = RowViolations[Row];
+		int32& NumViolations = RowNumViolations[Row];
+
+		auto Report = [&Violations, &NumViolations, MaxReported](EWFCViolationType Type, FIntVector Cell, int32 Direction, int32 Variant, int32 NeighbourVariant)
+		{
+			if(Violations.Num() < MaxReported)
+			{
+				Violations.Add({ Type, Cell, Direction, Variant, NeighbourVariant });
+			}
+			NumViolations++;
+		};
+
+		auto CheckPair = [&](int32 x, int32 Variant, int32 Direction, int32 Neighbour)
+		{
+			const int32 NeighbourVariant = Variants[Neighbour];
+			if(NeighbourVariant != INDEX_NONE && !WFCBitsetKernels::TestBit(Rules.GetCompatible(Variant, Direction), NeighbourVariant))
+			{
+				Report(EWFCViolationType::Incompatible, FIntVector(x, y, z), Direction, Variant, NeighbourVariant);
+			}
+		};
+
+		for(int32 x = 0; x < Bounds.X; x++)
+		{
+			const int32 Cell = z * SlabSize + y * Bounds.X + x;
+			const ETileType Type = TileTypes[Cell];
+			const int32 Variant = Variants[Cell];
+
+			if(Variant == INDEX_NONE)
+			{
+				if(Type != ETileType::ETT_Air && Type != ETileType::ETT_NoCity)
+				{
+					Report(EWFCViolationType::Unsolved, FIntVector(x, y, z), INDEX_NONE, INDEX_NONE, INDEX_NONE);
+				}
+				continue;
+			}
+			if(!WFCBitsetKernels::TestBit(Rules.GetTagDomain(Type), Variant))
+			{
+				Report(EWFCViolationType::WrongType, FIntVector(x, y, z), INDEX_NONE, Variant, INDEX_NONE);
+			}
+			if(ColorTags[Cell] != ETileColorTag::ETCT_Indifferent && !WFCBitsetKernels::TestBit(Rules.GetColorDomain(ColorTags[Cell]), Variant))
+			{
+				Report(EWFCViolationType::WrongColor, FIntVector(x, y, z), INDEX_NONE, Variant, INDEX_NONE);
+			}
+
+			if(x < Bounds.X - 1)
+			{
+				CheckPair(x, Variant, Right, Cell + 1);
+			}
+			if(y < Bounds.Y - 1)
+			{
+				CheckPair(x, Variant, Backward, Cell + Bounds.X);
+			}
+			if(z < Bounds.Z - 1)
+			{
+				CheckPair(x, Variant, Top, Cell + SlabSize);
+			}
+		}
+	});
+
+	int32 NumViolations = 0;
+	OutViolations.Reset();
+	for(int32 Row = 0; Row < NumRows; Row++)
+	{
+		NumViolations += RowNumViolations[Row];
+		for(const FWFCViolation& Violation : RowViolations[Row])
+		{
+			if(OutViolations.Num() < MaxReported)
+			{
+				OutViolations.Add(Violation);
+			}
+		}
+	}
+	return NumViolations;
+}
+
+void WFCValidator::LogViolations(const FWFCCompiledRules& Rules, const TArray<FWFCViolation>& Violations, int32 NumViolations)
+{
+	const UEnum* DirectionEnum = StaticEnum<ETileCompatibilityDeltaPosition>();
+	auto GetVariantName = [&Rules](int32 Variant)
+	{
+		return Rules.VariantNames.IsValidIndex(Variant) ? Rules.VariantNames[Variant] : FString(TEXT("None"));
+	};
+
+	for(const FWFCViolation& Violation : Violations)
+	{
+		switch (Violation.Type)
+		{
+		case EWFCViolationType::Unsolved:
+			UE_LOG(LogGeneration, Error, TEXT("WFCValidator - [%d, %d, %d] has no tile"),
+				Violation.Cell.X, Violation.Cell.Y, Violation.Cell.Z);
+			break;
+		case EWFCViolationType::WrongType:
+			UE_LOG(LogGeneration, Error, TEXT("WFCValidator - [%d, %d, %d] %s is not a tile of its type"),
+				Violation.Cell.X, Violation.Cell.Y, Violation.Cell.Z, *GetVariantName(Violation.Variant));
+			break;
+		case EWFCViolationType::WrongColor:
+			UE_LOG(LogGeneration, Error, TEXT("WFCValidator - [%d, %d, %d] %s is not a tile of its colour"),
+				Violation.Cell.X, Violation.Cell.Y, Violation.Cell.Z, *GetVariantName(Violation.Variant));
+			break;
+		case EWFCViolationType::Incompatible:
+			UE_LOG(LogGeneration, Error, TEXT("WFCValidator - [%d, %d, %d] %s doesn't fit %s %s"),
+				Violation.Cell.X, Violation.Cell.Y, Violation.Cell.Z, *GetVariantName(Violation.Variant),
+				*DirectionEnum->GetNameStringByValue(Violation.Direction), *GetVariantName(Violation.NeighbourVariant));
+			break;
+		}
+	}
+
+	if(NumViolations > Violations.Num())
+	{
+		UE_LOG(LogGeneration, Error, TEXT("WFCValidator - %d more violations"), NumViolations - Violations.Num());
+	}
+}
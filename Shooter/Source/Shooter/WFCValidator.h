@@ -0,0 +1,52 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TileType.h"
+#include "TileColorTag.h"
+#include "WFCCompiledRules.h"
+
+// Validation of WFC results after every generation. Compiled out in shipping builds
+#ifndef WFC_VALIDATE_ENABLED
+	#define WFC_VALIDATE_ENABLED !UE_BUILD_SHIPPING
+#endif
+
+enum class EWFCViolationType : uint8
+{
+	// Element which takes part in WFC has no variant
+	Unsolved,
+	// Variant is not a candidate of the type of the element
+	WrongType,
+	// Variant is not a tile of the colour chosen for the element before WFC (AGenerator::AssignBuildingColours)
+	WrongColor,
+	// Variant doesn't fit the variant of the neighbour in Direction
+	Incompatible
+};
+
+struct FWFCViolation
+{
+	EWFCViolationType Type;
+	FIntVector Cell;
+	// World direction of the neighbour, INDEX_NONE if the violation is of one element
+	int32 Direction;
+	int32 Variant;
+	int32 NeighbourVariant;
+};
+
+/**
+ * Checks a solved grid against compiled rules in one pass: each pair of neighbours is tested once
+ * (right, backward and top neighbour of every element) with one bit of FWFCCompiledRules::Compatible
+ * Rows of the grid are checked in parallel
+ */
+namespace WFCValidator
+{
+	// TileTypes, ColorTags and Variants are indexed as UWorldItem3DArray: z * Y * X + y * X + x. Only the first Bounds.Z slabs are checked
+	// Elements without a variant (NoCity, undecided Air) are skipped as neighbours
+	// Returns the amount of violations, the first MaxReported of them (in the order of the grid) are put into OutViolations
+	SHOOTER_API int32 Validate(const FWFCCompiledRules& Rules, const TArray<ETileType>& TileTypes, const TArray<ETileColorTag>& ColorTags,
+		const TArray<int32>& Variants, FIntVector Bounds, TArray<FWFCViolation>& OutViolations, int32 MaxReported = 32);
+
+	// Logs violations with coordinates and names of variants
+	SHOOTER_API void LogViolations(const FWFCCompiledRules& Rules, const TArray<FWFCViolation>& Violations, int32 NumViolations);
+}
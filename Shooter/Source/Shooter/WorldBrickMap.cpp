@@ -0,0 +1,48 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WorldBrickMap.h"
+
+FWorldBrickMap::FWorldBrickMap() :
+Bounds(FIntVector::ZeroValue),
+NumBricks(FIntVector::ZeroValue),
+NumEmptyBricks(0)
+{
+}
+
+void FWorldBrickMap::Build(const TArray<ETileType>& TileTypes, FIntVector InBounds)
+{
+	Bounds = InBounds;
+	NumBricks = FIntVector(
+		(Bounds.X + BrickSide - 1) >> BrickShift,
+		(Bounds.Y + BrickSide - 1) >> BrickShift,
+		Bounds.Z);
+	check(TileTypes.Num() >= Bounds.X * Bounds.Y * Bounds.Z);
+
+	UniformTypes.SetNumUninitialized(NumBricks.X * NumBricks.Y * NumBricks.Z);
+	NumEmptyBricks = 0;
+
+	for(int32 Brick = 0; Brick < UniformTypes.Num(); Brick++)
+	{
+		ETileType UniformType = ETileType::ETT_Undefined;
+		bool bFirst = true;
+		ForEachCell(Brick, [&TileTypes, &UniformType, &bFirst](int32 Cell)
+		{
+			if(bFirst)
+			{
+				UniformType = TileTypes[Cell];
+				bFirst = false;
+			}
+			else if(TileTypes[Cell] != UniformType)
+			{
+				UniformType = ETileType::ETT_MAX;
+			}
+		});
+
+		UniformTypes[Brick] = UniformType;
+		if(IsEmpty(Brick))
+		{
+			NumEmptyBricks++;
+		}
+	}
+}
@@ -0,0 +1,99 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TileType.h"
+
+/**
+ * Splits each Z-slab of the grid into 8x8 bricks and remembers which bricks are of one type only
+ * Bricks of Air or NoCity only are empty: they don't need storage of their own, every element there is the same
+ * Used by FWFCSolver, which keeps its per-element state only for the bricks which aren't empty.
+ * The typed planes of UWorldItem3DArray it's built from stay dense
+ */
+class SHOOTER_API FWorldBrickMap
+{
+public:
+	static constexpr int32 BrickShift = 3;
+	static constexpr int32 BrickSide = 1 << BrickShift;
+	static constexpr int32 BrickSize = BrickSide * BrickSide;
+	static constexpr int32 BrickSizeShift = 2 * BrickShift;
+
+	FWorldBrickMap();
+
+	// Classifies bricks of the first InBounds.Z slabs of TileTypes (indexed as UWorldItem3DArray)
+	void Build(const TArray<ETileType>& TileTypes, FIntVector InBounds);
+
+	FORCEINLINE int32 GetNumBricks() const { return UniformTypes.Num(); }
+
+	// Amount of bricks along each axis, bricks are indexed in z/y/x order. Z - one brick per slab
+	FORCEINLINE FIntVector GetNumBricksAlongAxes() const { return NumBricks; }
+
+	FORCEINLINE int32 GetBrick(int32 x, int32 y, int32 z) const
+	{
+		return (z * NumBricks.Y + (y >> BrickShift)) * NumBricks.X + (x >> BrickShift);
+	}
+
+	// Index of the element inside of its brick, [0; BrickSize)
+	static FORCEINLINE int32 GetIndexInBrick(int32 x, int32 y)
+	{
+		return ((y & (BrickSide - 1)) << BrickShift) + (x & (BrickSide - 1));
+	}
+
+	// Linear index of the element IndexInBrick of the brick. Divides - keep it out of hot loops
+	FORCEINLINE int32 GetCell(int32 Brick, int32 IndexInBrick) const
+	{
+		const int32 x = ((Brick % NumBricks.X) << BrickShift) + (IndexInBrick & (BrickSide - 1));
+		const int32 y = (((Brick / NumBricks.X) % NumBricks.Y) << BrickShift) + (IndexInBrick >> BrickShift);
+		const int32 z = Brick / (NumBricks.X * NumBricks.Y);
+		return (z * Bounds.Y + y) * Bounds.X + x;
+	}
+
+	// Type of all elements of the brick, ETT_MAX if the brick has different types
+	FORCEINLINE ETileType GetUniformType(int32 Brick) const { return UniformTypes[Brick]; }
+
+	FORCEINLINE bool IsEmpty(int32 Brick) const
+	{
+		return UniformTypes[Brick] == ETileType::ETT_Air || UniformTypes[Brick] == ETileType::ETT_NoCity;
+	}
+
+	FORCEINLINE int32 GetNumEmptyBricks() const { return NumEmptyBricks; }
+
+	// Calls Func(Cell) with the linear index of each element of the brick inside of the bounds
+	template<typename FuncType>
+	void ForEachCell(int32 Brick, FuncType Func) const
+	{
+		ForEachCellWithIndex(Brick, [&Func](int32 Cell, int32 IndexInBrick)
+		{
+			Func(Cell);
+		});
+	}
+
+	// Calls Func(Cell, IndexInBrick) for each element of the brick inside of the bounds
+	template<typename FuncType>
+	void ForEachCellWithIndex(int32 Brick, FuncType Func) const
+	{
+		const int32 bx = Brick % NumBricks.X;
+		const int32 by = (Brick / NumBricks.X) % NumBricks.Y;
+		const int32 z = Brick / (NumBricks.X * NumBricks.Y);
+
+		const int32 x0 = bx << BrickShift;
+		const int32 y0 = by << BrickShift;
+		const int32 x1 = FMath::Min(x0 + BrickSide, Bounds.X);
+		const int32 y1 = FMath::Min(y0 + BrickSide, Bounds.Y);
+		for(int32 y = y0; y < y1; y++)
+		{
+			const int32 RowStart = (z * Bounds.Y + y) * Bounds.X;
+			for(int32 x = x0; x < x1; x++)
+			{
+				Func(RowStart + x, GetIndexInBrick(x, y));
+			}
+		}
+	}
+
+private:
+	FIntVector Bounds;
+	FIntVector NumBricks;
+	TArray<ETileType> UniformTypes;
+	int32 NumEmptyBricks;
+};
@@ -0,0 +1,66 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+// Automation tests of FWorldBrickMap
+// Run in the editor: Session Frontend > Automation > Shooter.World.BrickMap, or "Automation RunTests Shooter.World.BrickMap"
+
+
+#include "WorldBrickMap.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FWorldBrickMapTest, "Shooter.World.BrickMap",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FWorldBrickMapTest::RunTest(const FString& Parameters)
+{
+	// Not a multiple of the brick side, so the last bricks are cut by the bounds
+	const FIntVector Bounds(20, 10, 2);
+	TArray<ETileType> TileTypes;
+	TileTypes.Init(ETileType::ETT_Air, Bounds.X * Bounds.Y * Bounds.Z);
+	// The ground is NoCity with one road in the middle, the slab above is Air
+	for(int32 Cell = 0; Cell < Bounds.X * Bounds.Y; Cell++)
+	{
+		TileTypes[Cell] = ETileType::ETT_NoCity;
+	}
+	TileTypes[3 * Bounds.X + 9] = ETileType::ETT_Road;
+
+	FWorldBrickMap Bricks;
+	Bricks.Build(TileTypes, Bounds);
+
+	TestEqual(TEXT("Bricks"), Bricks.GetNumBricks(), 3 * 2 * 2);
+	TestEqual(TEXT("Empty bricks"), Bricks.GetNumEmptyBricks(), 3 * 2 * 2 - 1);
+
+	const int32 RoadBrick = Bricks.GetBrick(9, 3, 0);
+	TestFalse(TEXT("Brick of the road is empty"), Bricks.IsEmpty(RoadBrick));
+	TestEqual(TEXT("Type of the brick of the road"), Bricks.GetUniformType(RoadBrick), ETileType::ETT_MAX);
+	TestEqual(TEXT("Type of a brick of the ground"), Bricks.GetUniformType(Bricks.GetBrick(0, 0, 0)), ETileType::ETT_NoCity);
+	TestEqual(TEXT("Type of a brick above the ground"), Bricks.GetUniformType(Bricks.GetBrick(9, 3, 1)), ETileType::ETT_Air);
+	TestEqual(TEXT("Index of the road in its brick"), FWorldBrickMap::GetIndexInBrick(9, 3), 3 * FWorldBrickMap::BrickSide + 1);
+
+	// The corner brick is cut to 4 x 2 elements, and they are the elements of its corner of the grid
+	int32 NumCornerCells = 0;
+	bool bCornerCellsInside = true;
+	Bricks.ForEachCell(Bricks.GetBrick(19, 9, 1), [&NumCornerCells, &bCornerCellsInside, &Bounds](int32 Cell)
+	{
+		NumCornerCells++;
+		const int32 x = Cell % Bounds.X;
+		const int32 y = (Cell / Bounds.X) % Bounds.Y;
+		const int32 z = Cell / (Bounds.X * Bounds.Y);
+		bCornerCellsInside &= x >= 16 && y >= 8 && z == 1;
+	});
+	TestEqual(TEXT("Elements of the corner brick"), NumCornerCells, 4 * 2);
+	TestTrue(TEXT("Elements of the corner brick are in its corner"), bCornerCellsInside);
+
+	// Index in the brick goes back to the same element
+	bool bCellsMatch = true;
+	Bricks.ForEachCellWithIndex(RoadBrick, [&Bricks, &bCellsMatch, RoadBrick](int32 Cell, int32 IndexInBrick)
+	{
+		bCellsMatch &= Bricks.GetCell(RoadBrick, IndexInBrick) == Cell;
+	});
+	TestTrue(TEXT("Elements of the brick of the road from their index in the brick"), bCellsMatch);
+	TestEqual(TEXT("Bricks along the axes"), Bricks.GetNumBricksAlongAxes(), FIntVector(3, 2, 2));
+	return true;
+}
+
+#endif
@@ -0,0 +1,154 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WorldColumnRuns.h"
+#include "GenerationLogs.h"
+
+FWorldColumnRuns::FWorldColumnRuns() :
+Footprint(FIntPoint::ZeroValue),
+LastColumn(INDEX_NONE),
+LastColumnHeight(0),
+MaxHeight(0)
+{
+}
+
+void FWorldColumnRuns::Reset(FIntPoint InFootprint)
+{
+	Footprint = InFootprint;
+	Runs.Reset();
+	ColumnStarts.Init(0, Footprint.X * Footprint.Y + 1);
+	LastColumn = INDEX_NONE;
+	LastColumnHeight = 0;
+	MaxHeight = 0;
+}
+
+void FWorldColumnRuns::Append(int32 x, int32 y, ETileType Type, int32 Variant, int32 Count)
+{
+	const int32 Column = y * Footprint.X + x;
+	check(Column >= LastColumn && Column < Footprint.X * Footprint.Y);
+	if(Count <= 0)
+	{
+		return;
+	}
+
+	// Start the column and close the skipped ones - they are empty
+	if(Column != LastColumn)
+	{
+		for(int32 Skipped = LastColumn + 1; Skipped <= Column; Skipped++)
+		{
+			ColumnStarts[Skipped] = Runs.Num();
+		}
+		LastColumn = Column;
+		LastColumnHeight = 0;
+	}
+
+	LastColumnHeight += Count;
+	MaxHeight = FMath::Max(MaxHeight, LastColumnHeight);
+
+	if(Runs.Num() > ColumnStarts[Column])
+	{
+		FWorldColumnRun& Top = Runs.Last();
+		if(Top.Type == Type && Top.Variant == Variant && Top.Count + Count <= MAX_uint16)
+		{
+			Top.Count += Count;
+			return;
+		}
+	}
+
+	while(Count > 0)
+	{
+		const int32 RunCount = FMath::Min(Count, (int32)MAX_uint16);
+		Runs.Add({ Variant, Type, (uint16)RunCount });
+		Count -= RunCount;
+	}
+}
+
+void FWorldColumnRuns::Finish()
+{
+	for(int32 Column = LastColumn + 1; Column <= Footprint.X * Footprint.Y; Column++)
+	{
+		ColumnStarts[Column] = Runs.Num();
+	}
+	LastColumn = Footprint.X * Footprint.Y;
+}
+
+int32 FWorldColumnRuns::GetHeight(int32 x, int32 y) const
+{
+	int32 Height = 0;
+	for(const FWorldColumnRun& Run : GetColumn(x, y))
+	{
+		Height += Run.Count;
+	}
+	return Height;
+}
+
+int32 FWorldColumnRuns::GetBuildingHeight(int32 x, int32 y) const
+{
+	int32 Height = 0;
+	int32 z = 0;
+	for(const FWorldColumnRun& Run : GetColumn(x, y))
+	{
+		z += Run.Count;
+		if(Run.Type >= ETileType::ETT_Building && Run.Type <= ETileType::ETT_Building_Greeble_Cube)
+		{
+			Height = z;
+		}
+	}
+	return Height;
+}
+
+bool FWorldColumnRuns::IsStreet(int32 x, int32 y) const
+{
+	const TArrayView<const FWorldColumnRun> Column = GetColumn(x, y);
+	return Column.Num() > 0
+		&& Column[0].Type >= ETileType::ETT_Road && Column[0].Type <= ETileType::ETT_Sidewalks_Corner
+		&& GetBuildingHeight(x, y) == 0;
+}
+
+const FWorldColumnRun* FWorldColumnRuns::FindRun(int32 z, int32 y, int32 x) const
+{
+	if(x < 0 || y < 0 || x >= Footprint.X || y >= Footprint.Y || z < 0)
+	{
+		UE_LOG(LogGeneration, Error, TEXT("FWorldColumnRuns::FindRun - INVALID INPUT! X: %d, Y: %d, Z: %d"), x, y, z);
+		return nullptr;
+	}
+
+	int32 RunBottom = 0;
+	for(const FWorldColumnRun& Run : GetColumn(x, y))
+	{
+		RunBottom += Run.Count;
+		if(z < RunBottom)
+		{
+			return &Run;
+		}
+	}
+	return nullptr;
+}
+
+ETileType FWorldColumnRuns::GetTileType(int32 z, int32 y, int32 x) const
+{
+	const FWorldColumnRun* Run = FindRun(z, y, x);
+	return Run ? Run->Type : ETileType::ETT_Air;
+}
+
+int32 FWorldColumnRuns::GetVariant(int32 z, int32 y, int32 x) const
+{
+	const FWorldColumnRun* Run = FindRun(z, y, x);
+	return Run ? Run->Variant : INDEX_NONE;
+}
+
+SIZE_T FWorldColumnRuns::GetAllocatedSize() const
+{
+	return Runs.GetAllocatedSize() + ColumnStarts.GetAllocatedSize();
+}
+
+FArchive& operator<<(FArchive& Ar, FWorldColumnRuns& Columns)
+{
+	Ar << Columns.Footprint << Columns.Runs << Columns.ColumnStarts << Columns.MaxHeight;
+	if(Ar.IsLoading())
+	{
+		Columns.LastColumn = Columns.Footprint.X * Columns.Footprint.Y;
+		Columns.LastColumnHeight = 0;
+	}
+	return Ar;
+}
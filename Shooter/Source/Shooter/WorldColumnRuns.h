@@ -0,0 +1,81 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TileType.h"
+
+// Count equal elements of a column, one on top of another
+struct FWorldColumnRun
+{
+	// Variant of FWFCCompiledRules, INDEX_NONE - no tile
+	int32 Variant;
+	ETileType Type;
+	uint16 Count;
+
+	friend FArchive& operator<<(FArchive& Ar, FWorldColumnRun& Run)
+	{
+		return Ar << Run.Variant << Run.Type << Run.Count;
+	}
+};
+
+/**
+ * Vertical run-length storage of the world: each (x, y) column is a short list of runs from the ground up,
+ * so a tall building takes as much memory as a low one. Everything above the top of a column is Air
+ * Columns are appended in linear order (y * X + x), like UWorldItem3DArray rows
+ */
+class SHOOTER_API FWorldColumnRuns
+{
+public:
+	FWorldColumnRuns();
+
+	void Reset(FIntPoint InFootprint);
+
+	// Puts Count elements on top of column (x, y). Merges them into the top run if it's the same
+	// Columns must be filled in linear order, a column can't be appended after the next one is started
+	void Append(int32 x, int32 y, ETileType Type, int32 Variant, int32 Count);
+
+	// Closes the columns which got no runs. Call after the last Append()
+	void Finish();
+
+	FORCEINLINE TArrayView<const FWorldColumnRun> GetColumn(int32 x, int32 y) const
+	{
+		const int32 Column = y * Footprint.X + x;
+		return TArrayView<const FWorldColumnRun>(Runs.GetData() + ColumnStarts[Column], ColumnStarts[Column + 1] - ColumnStarts[Column]);
+	}
+
+	int32 GetHeight(int32 x, int32 y) const;
+
+	// Top of the last building run of the column, 0 if there is no building
+	int32 GetBuildingHeight(int32 x, int32 y) const;
+
+	// Road or sidewalk on the ground and no building above
+	bool IsStreet(int32 x, int32 y) const;
+
+	// Walks the runs of the column. Air above the top of the column
+	ETileType GetTileType(int32 z, int32 y, int32 x) const;
+	int32 GetVariant(int32 z, int32 y, int32 x) const;
+
+	FORCEINLINE FIntPoint GetFootprint() const { return Footprint; }
+	FORCEINLINE int32 GetMaxHeight() const { return MaxHeight; }
+	FORCEINLINE int32 GetNumRuns() const { return Runs.Num(); }
+
+	SIZE_T GetAllocatedSize() const;
+
+	friend FArchive& operator<<(FArchive& Ar, FWorldColumnRuns& Columns);
+
+private:
+	// Returns the run which holds element z of the column, nullptr above the top of the column
+	const FWorldColumnRun* FindRun(int32 z, int32 y, int32 x) const;
+
+	FIntPoint Footprint;
+
+	TArray<FWorldColumnRun> Runs;
+	// [y * X + x] - first run of the column, [X * Y] - end of the last column
+	TArray<int32> ColumnStarts;
+
+	// Column which is being filled now
+	int32 LastColumn;
+	int32 LastColumnHeight;
+	int32 MaxHeight;
+};
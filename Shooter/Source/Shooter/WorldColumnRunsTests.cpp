@@ -0,0 +1,71 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+// Automation tests of FWorldColumnRuns
+// Run in the editor: Session Frontend > Automation > Shooter.World.ColumnRuns, or "Automation RunTests Shooter.World.ColumnRuns"
+
+
+#include "WorldColumnRuns.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FWorldColumnRunsTest, "Shooter.World.ColumnRuns",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FWorldColumnRunsTest::RunTest(const FString& Parameters)
+{
+	// 3 x 1 columns: a building, an empty column and a street
+	FWorldColumnRuns Columns;
+	Columns.Reset(FIntPoint(3, 1));
+	Columns.Append(0, 0, ETileType::ETT_Sidewalks_Inner, 1, 1);
+	Columns.Append(0, 0, ETileType::ETT_Building_Window_Section, 7, 3);
+	// Same as the top run - merged into it
+	Columns.Append(0, 0, ETileType::ETT_Building_Window_Section, 7, 2);
+	Columns.Append(2, 0, ETileType::ETT_Road, 3, 1);
+	Columns.Finish();
+
+	TestEqual(TEXT("Runs"), Columns.GetNumRuns(), 3);
+	TestEqual(TEXT("Runs of the building"), Columns.GetColumn(0, 0).Num(), 2);
+	TestEqual(TEXT("Runs of the skipped column"), Columns.GetColumn(1, 0).Num(), 0);
+	TestEqual(TEXT("Height of the building"), Columns.GetHeight(0, 0), 6);
+	TestEqual(TEXT("Building height of the building"), Columns.GetBuildingHeight(0, 0), 6);
+	TestEqual(TEXT("Max height"), Columns.GetMaxHeight(), 6);
+	TestEqual(TEXT("Type of the ground of the building"), Columns.GetTileType(0, 0, 0), ETileType::ETT_Sidewalks_Inner);
+	TestEqual(TEXT("Type in the merged run"), Columns.GetTileType(5, 0, 0), ETileType::ETT_Building_Window_Section);
+	TestEqual(TEXT("Variant in the merged run"), Columns.GetVariant(5, 0, 0), 7);
+	TestEqual(TEXT("Type above the top"), Columns.GetTileType(6, 0, 0), ETileType::ETT_Air);
+	TestEqual(TEXT("Variant above the top"), Columns.GetVariant(6, 0, 0), (int32)INDEX_NONE);
+	TestFalse(TEXT("Building is a street"), Columns.IsStreet(0, 0));
+	TestFalse(TEXT("Empty column is a street"), Columns.IsStreet(1, 0));
+	TestTrue(TEXT("Road is a street"), Columns.IsStreet(2, 0));
+
+	// A run holds at most MAX_uint16 elements
+	FWorldColumnRuns Tall;
+	Tall.Reset(FIntPoint(1, 1));
+	Tall.Append(0, 0, ETileType::ETT_Building_Greeble_Cube, 0, MAX_uint16 + 10);
+	Tall.Finish();
+	TestEqual(TEXT("Runs of a very tall column"), Tall.GetNumRuns(), 2);
+	TestEqual(TEXT("Height of a very tall column"), Tall.GetHeight(0, 0), MAX_uint16 + 10);
+
+	// Serialized columns read back the same
+	TArray<uint8> Data;
+	FMemoryWriter Writer(Data);
+	Writer << Columns;
+	FWorldColumnRuns Loaded;
+	FMemoryReader Reader(Data);
+	Reader << Loaded;
+	TestEqual(TEXT("Footprint of loaded columns"), Loaded.GetFootprint(), Columns.GetFootprint());
+	TestEqual(TEXT("Runs of loaded columns"), Loaded.GetNumRuns(), Columns.GetNumRuns());
+	for(int32 x = 0; x < 3; x++)
+	{
+		for(int32 z = 0; z < 7; z++)
+		{
+			TestEqual(*FString::Printf(TEXT("Variant of loaded element (%d, 0, %d)"), x, z), Loaded.GetVariant(z, 0, x), Columns.GetVariant(z, 0, x));
+		}
+	}
+	return true;
+}
+
+#endif
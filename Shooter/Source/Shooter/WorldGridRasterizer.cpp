@@ -0,0 +1,161 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WorldGridRasterizer.h"
+
+FWorldGridRasterizer::FWorldGridRasterizer(UWorldItem3DArray& InGrid) :
+Grid(InGrid),
+CityStart(FIntPoint::ZeroValue),
+CityEnd(FIntPoint::ZeroValue)
+{
+}
+
+void FWorldGridRasterizer::Rasterize(FIntPoint InCityStart, FIntPoint InCityEnd,
+	const TArray<FRoadBaseCoord>& XRoadPoints, const TArray<FRoadBaseCoord>& YRoadPoints,
+	const TArray<FRoad>& Roads, const TArray<FBlock>& Blocks, int32 NumSlabs)
+{
+	CityStart = InCityStart;
+	CityEnd = InCityEnd;
+
+	const int32 FirstSlab = Grid.NumFilledSlabs;
+	NumSlabs = FMath::Min(NumSlabs, Grid.Bounds.Z);
+	if(FirstSlab >= NumSlabs)
+		return;
+
+	// Ground slab
+	if(FirstSlab == 0)
+	{
+		DrawCityArea(0, ETileType::ETT_Undefined);
+
+		for(int i = 0; i < Roads.Num(); i++)
+		{
+			DrawRoad(Roads[i]);
+		}
+		// Crossroads are drawn over roads - roads never replace crossroads
+		DrawCrossroads(XRoadPoints, YRoadPoints);
+
+		for(int i = 0; i < Blocks.Num(); i++)
+		{
+			DrawBlockSidewalks(Blocks[i]);
+		}
+	}
+
+	// Door floor of buildings
+	if(FirstSlab <= 1 && NumSlabs > 1)
+	{
+		DrawCityArea(1, ETileType::ETT_Air);
+		for(int i = 0; i < Blocks.Num(); i++)
+		{
+			DrawBuildingFloor(1, Blocks[i], ETileType::ETT_Building_Door_Corner, ETileType::ETT_Building_Door_Section);
+		}
+	}
+
+	// Window floors of buildings are all the same - draw the first one and copy it upwards
+	if(FirstSlab <= 2 && NumSlabs > 2)
+	{
+		DrawCityArea(2, ETileType::ETT_Air);
+		for(int i = 0; i < Blocks.Num(); i++)
+		{
+			DrawBuildingFloor(2, Blocks[i], ETileType::ETT_Building_Window_Corner, ETileType::ETT_Building_Window_Section);
+		}
+	}
+	for(int z = FMath::Max(FirstSlab, 3); z < NumSlabs; z++)
+	{
+		Grid.CopySlab(2, z);
+	}
+
+	Grid.NumFilledSlabs = NumSlabs;
+}
+
+void FWorldGridRasterizer::DrawCityArea(int32 z, ETileType InnerType)
+{
+	// NoCity elements are final - they never take part in WFC
+	for(int32 y = 0; y < Grid.Bounds.Y; y++)
+	{
+		if(y < CityStart.Y || y > CityEnd.Y)
+		{
+			Grid.FillSpan(z, y, 0, Grid.Bounds.X - 1, ETileType::ETT_NoCity, true);
+			continue;
+		}
+
+		Grid.FillSpan(z, y, 0, CityStart.X - 1, ETileType::ETT_NoCity, true);
+		Grid.FillSpan(z, y, CityStart.X, CityEnd.X, InnerType, false);
+		Grid.FillSpan(z, y, CityEnd.X + 1, Grid.Bounds.X - 1, ETileType::ETT_NoCity, true);
+	}
+}
+
+void FWorldGridRasterizer::DrawRoad(const FRoad& Road)
+{
+	FIntPoint Min(Road.StartPoint.X, Road.StartPoint.Y);
+	FIntPoint Max;
+	
+	if(Road.bDirectedAlongX)
+	{
+		Max = FIntPoint(Road.StartPoint.X + Road.RoadWidth - 1, Road.EndPoint.Y);
+	}
+	else
+	{
+		// Road directed along Y
+		Max = FIntPoint(Road.EndPoint.X, Road.StartPoint.Y + Road.RoadWidth - 1);
+	}
+
+	if(Min.X < 0 || Min.Y < 0 || Max.X >= Grid.Bounds.X || Max.Y >= Grid.Bounds.Y)
+	{
+		UE_LOG(LogRoadGeneration, Error, TEXT("FWorldGridRasterizer::DrawRoad ERROR: Road is out of the array bounds! Min: X:%d, Y:%d; Max: X:%d, Y:%d; World: X:%d, Y:%d."),
+			Min.X, Min.Y, Max.X, Max.Y, Grid.Bounds.X, Grid.Bounds.Y);
+	}
+
+	Grid.FillRect(0, Min, Max, ETileType::ETT_Road, false);
+}
+
+void FWorldGridRasterizer::DrawCrossroads(const TArray<FRoadBaseCoord>& XRoadPoints, const TArray<FRoadBaseCoord>& YRoadPoints)
+{
+	for(int x = 0; x < XRoadPoints.Num(); x++)
+	{
+		for(int y = 0; y < YRoadPoints.Num(); y++)
+		{
+			const FIntPoint Min(XRoadPoints[x].coord, YRoadPoints[y].coord);
+			const FIntPoint Max = Min + FIntPoint(XRoadPoints[x].RoadWidth - 1, YRoadPoints[y].RoadWidth - 1);
+			
+			Grid.FillRect(0, Min, Max, ETileType::ETT_Road_Crossroads, false);
+		}
+	}
+}
+
+void FWorldGridRasterizer::DrawFramedRect(int32 z, FIntPoint Min, FIntPoint Max,
+	ETileType CornerType, ETileType BorderType, ETileType InnerType)
+{
+	if(Min.X > Max.X || Min.Y > Max.Y)
+	{
+		return;
+	}
+	
+	for(int32 y = Min.Y; y <= Max.Y; y++)
+	{
+		const bool bIsEdgeRow = y == Min.Y || y == Max.Y;
+		const ETileType SideType = bIsEdgeRow ? CornerType : BorderType;
+		const ETileType MiddleType = bIsEdgeRow ? BorderType : InnerType;
+
+		Grid.FillSpan(z, y, Min.X + 1, Max.X - 1, MiddleType, false);
+		Grid.FillSpan(z, y, Min.X, Min.X, SideType, false);
+		Grid.FillSpan(z, y, Max.X, Max.X, SideType, false);
+	}
+}
+
+void FWorldGridRasterizer::DrawBlockSidewalks(const FBlock& Block)
+{
+	// Superposition array is set after the full map generation
+	DrawFramedRect(0,
+		FIntPoint(Block.StartCorner.X, Block.StartCorner.Y),
+		FIntPoint(Block.EndCorner.X, Block.EndCorner.Y),
+		ETileType::ETT_Sidewalks_Corner, ETileType::ETT_Sidewalks_Borderline, ETileType::ETT_Sidewalks_Inner);
+}
+
+void FWorldGridRasterizer::DrawBuildingFloor(int32 z, const FBlock& Block, ETileType CornerType, ETileType SectionType)
+{
+	// not corner, not border => inside of block
+	DrawFramedRect(z,
+		FIntPoint(Block.StartCorner.X + 1, Block.StartCorner.Y + 1),
+		FIntPoint(Block.EndCorner.X - 1, Block.EndCorner.Y - 1),
+		CornerType, SectionType, ETileType::ETT_Building_Greeble_Cube);
+}
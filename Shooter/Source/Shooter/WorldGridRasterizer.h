@@ -0,0 +1,50 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "WorldItem3DArray.h"
+#include "Road.h"
+#include "RoadBaseCoord.h"
+#include "Block.h"
+
+/**
+ * Draws the road map, blocks and buildings into the typed planes of UWorldItem3DArray
+ * Everything is drawn as axis-aligned rectangles, each row of a rectangle is one contiguous span write
+ */
+class SHOOTER_API FWorldGridRasterizer
+{
+public:
+	FWorldGridRasterizer(UWorldItem3DArray& InGrid);
+
+	// Draws the city slab by slab, from the first unfilled slab of the grid up to NumSlabs (exclusive):
+	// - ground slab (Z = 0): NoCity borders, roads, crossroads and sidewalks of blocks
+	// - Z = 1: Air, NoCity borders and door floor of buildings
+	// - Z >= 2: window floors of buildings - drawn once and copied to all the upper slabs
+	// Only WFC reads the typed planes, so only the slabs it solves are drawn. CityStart and CityEnd are inclusive XY bounds of the city
+	void Rasterize(FIntPoint CityStart, FIntPoint CityEnd,
+		const TArray<FRoadBaseCoord>& XRoadPoints, const TArray<FRoadBaseCoord>& YRoadPoints,
+		const TArray<FRoad>& Roads, const TArray<FBlock>& Blocks, int32 NumSlabs);
+
+private:
+	// Fills the slab with NoCity outside of the city area and with InnerType inside of it
+	void DrawCityArea(int32 z, ETileType InnerType);
+
+	void DrawRoad(const FRoad& Road);
+
+	void DrawCrossroads(const TArray<FRoadBaseCoord>& XRoadPoints, const TArray<FRoadBaseCoord>& YRoadPoints);
+
+	// Draws a rectangle which has different types for its corners, borders and inner area
+	void DrawFramedRect(int32 z, FIntPoint Min, FIntPoint Max,
+		ETileType CornerType, ETileType BorderType, ETileType InnerType);
+
+	void DrawBlockSidewalks(const FBlock& Block);
+
+	// Draws one floor of a building which takes inner area of the block (sidewalks are the border of the block)
+	void DrawBuildingFloor(int32 z, const FBlock& Block, ETileType CornerType, ETileType SectionType);
+
+	UWorldItem3DArray& Grid;
+
+	FIntPoint CityStart;
+	FIntPoint CityEnd;
+};
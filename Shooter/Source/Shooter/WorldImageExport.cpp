@@ -0,0 +1,223 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WorldImageExport.h"
+#include "GenerationLogs.h"
+#include "WorldItem3DArray.h"
+#include "WorldLayoutIndex.h"
+#include "Async/ParallelFor.h"
+#include "IImageWrapper.h"
+#include "IImageWrapperModule.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Modules/ModuleManager.h"
+
+// [ETileType]
+static const FColor TileTypeColors[] =
+{
+	FColor(255, 0, 255),	// Undefined
+	FColor(24, 24, 32),		// Air
+	FColor(96, 96, 96),		// Road
+	FColor(160, 160, 160),	// Road Crossroads
+	FColor(112, 112, 96),	// Road OneLine
+	FColor(128, 112, 96),	// Road HalfOfWideRoad
+	FColor(160, 144, 48),	// Road Blank_Yellow_Side
+	FColor(200, 190, 150),	// Sidewalks Borderline
+	FColor(170, 160, 130),	// Sidewalks Inner
+	FColor(230, 220, 180),	// Sidewalks Corner
+	FColor(120, 60, 40),	// Building
+	FColor(200, 80, 40),	// Building Door Section
+	FColor(240, 120, 40),	// Building Door Corner
+	FColor(60, 110, 200),	// Building Window Section
+	FColor(90, 160, 240),	// Building Window Corner
+	FColor(70, 150, 70),	// Building Greeble Cube
+	FColor(0, 0, 0)			// NoCity
+};
+static_assert(UE_ARRAY_COUNT(TileTypeColors) == (int32)ETileType::ETT_MAX, "Every tile type needs a colour");
+
+namespace WorldImageExport
+{
+	FColor GetTileTypeColor(ETileType Type)
+	{
+		return Type < ETileType::ETT_MAX ? TileTypeColors[(int32)Type] : TileTypeColors[(int32)ETileType::ETT_Undefined];
+	}
+
+	void DrawSlice(const FWorldLayoutIndex& Layout, int32 Z, FWorldImage& OutImage)
+	{
+		const FIntPoint Footprint = Layout.GetFootprint();
+		OutImage.Init(Footprint.X, Footprint.Y);
+
+		ParallelFor(OutImage.Height, [&OutImage, &Layout, Z](int32 y)
+		{
+			const int32 Start = y * OutImage.Width;
+			for(int32 x = 0; x < OutImage.Width; x++)
+			{
+				OutImage.Pixels[Start + x] = GetTileTypeColor(Layout.GetTileType(x, y, Z));
+			}
+		});
+	}
+
+	void DrawLayout(const FWorldLayoutIndex& Layout, FWorldImage& OutImage)
+	{
+		const FIntPoint Footprint = Layout.GetFootprint();
+		OutImage.Init(Footprint.X, Footprint.Y);
+
+		ParallelFor(OutImage.Height, [&OutImage, &Layout](int32 y)
+		{
+			for(int32 x = 0; x < OutImage.Width; x++)
+			{
+				const int32 Block = Layout.GetBlock(x, y);
+				FColor Color;
+				if(Block != INDEX_NONE)
+				{
+					// Neighbouring blocks get far colours
+					const uint32 Hash = GetTypeHash(Block) * 2654435761u;
+					Color = FColor(64 + (Hash & 0x7F), 64 + ((Hash >> 8) & 0x7F), 64 + ((Hash >> 16) & 0x7F));
+				}
+				else
+				{
+					Color = GetTileTypeColor(Layout.GetTileType(x, y, 0));
+				}
+				OutImage.Pixels[y * OutImage.Width + x] = Color;
+			}
+		});
+	}
+
+	void DrawHeatmap(TArrayView<const float> Values, int32 Width, int32 Height, FWorldImage& OutImage)
+	{
+		check(Values.Num() >= Width * Height);
+		OutImage.Init(Width, Height);
+
+		float MinValue = MAX_flt;
+		float MaxValue = 0.f;
+		for(int32 i = 0; i < Width * Height; i++)
+		{
+			if(Values[i] >= 0.f)
+			{
+				MinValue = FMath::Min(MinValue, Values[i]);
+				MaxValue = FMath::Max(MaxValue, Values[i]);
+			}
+		}
+		const float Scale = MaxValue > MinValue ? 255.f / (MaxValue - MinValue) : 0.f;
+
+		// Hue from blue to red
+		FColor Gradient[256];
+		for(int32 i = 0; i < 256; i++)
+		{
+			Gradient[i] = FLinearColor::MakeFromHSV8((uint8)((255 - i) * 170 / 255), 255, 255).ToFColor(true);
+		}
+
+		ParallelFor(Height, [&OutImage, &Gradient, Values, Width, MinValue, Scale](int32 y)
+		{
+			for(int32 x = 0; x < Width; x++)
+			{
+				const float Value = Values[y * Width + x];
+				OutImage.Pixels[y * Width + x] = Value >= 0.f
+					? Gradient[FMath::Clamp((int32)((Value - MinValue) * Scale), 0, 255)]
+					: FColor::Black;
+			}
+		});
+	}
+
+	void GetInitialEntropy(const FWFCCompiledRules& Rules, const TArray<uint64>& TagDomains, const UWorldItem3DArray& Array,
+		int32 Z, TArray<float>& OutEntropy)
+	{
+		check(Z >= 0 && Z < Array.Bounds.Z);
+		const int32 Width = Array.Bounds.X;
+		const int32 SlabStart = Z * Array.Bounds.Y * Width;
+		const int32 NumWords = Rules.NumWords;
+		const FWFCBitsetKernelTable& Kernels = WFCBitsetKernels::Get();
+		OutEntropy.SetNumUninitialized(Array.Bounds.Y * Width, false);
+
+		ParallelFor(Array.Bounds.Y, [&](int32 y)
+		{
+			TArray<uint64, TInlineAllocator<8>> Domain;
+			Domain.SetNumUninitialized(NumWords);
+			for(int32 x = 0; x < Width; x++)
+			{
+				const int32 Cell = SlabStart + y * Width + x;
+				float& Entropy = OutEntropy[y * Width + x];
+				if(Array.TileTypes[Cell] == ETileType::ETT_NoCity)
+				{
+					Entropy = -1.f;
+					continue;
+				}
+
+				FMemory::Memcpy(Domain.GetData(), TagDomains.GetData() + (int32)Array.TileTypes[Cell] * NumWords, NumWords * sizeof(uint64));
+				if(Array.ColorTags.IsValidIndex(Cell))
+				{
+					Kernels.AndInto(Domain.GetData(), Rules.GetColorDomain(Array.ColorTags[Cell]), NumWords);
+				}
+
+				float SumWeights;
+				float SumWeightLogWeights;
+				Kernels.WeightedSums(Domain.GetData(), Rules.Weights.GetData(), Rules.WeightLogWeights.GetData(), NumWords,
+					SumWeights, SumWeightLogWeights);
+				Entropy = SumWeights > 0.f ? FMath::Max(FMath::Loge(SumWeights) - SumWeightLogWeights / SumWeights, 0.f) : 0.f;
+			}
+		});
+	}
+
+	static bool SavePPM(const FWorldImage& Image, const FString& Path)
+	{
+		const FTCHARToUTF8 Header(*FString::Printf(TEXT("P6\n%d %d\n255\n"), Image.Width, Image.Height));
+		const int32 RowSize = Image.Width * 3;
+
+		TArray<uint8> Data;
+		Data.SetNumUninitialized(Header.Length() + RowSize * Image.Height);
+		FMemory::Memcpy(Data.GetData(), Header.Get(), Header.Length());
+		uint8* Pixels = Data.GetData() + Header.Length();
+
+		ParallelFor(Image.Height, [&Image, Pixels, RowSize](int32 y)
+		{
+			uint8* Out = Pixels + y * RowSize;
+			const FColor* In = Image.Pixels.GetData() + y * Image.Width;
+			for(int32 x = 0; x < Image.Width; x++)
+			{
+				Out[x * 3] = In[x].R;
+				Out[x * 3 + 1] = In[x].G;
+				Out[x * 3 + 2] = In[x].B;
+			}
+		});
+		return FFileHelper::SaveArrayToFile(Data, *Path);
+	}
+
+	static bool SavePNG(const FWorldImage& Image, const FString& Path)
+	{
+		IImageWrapperModule& ImageWrapperModule = FModuleManager::LoadModuleChecked<IImageWrapperModule>(TEXT("ImageWrapper"));
+		const TSharedPtr<IImageWrapper> ImageWrapper = ImageWrapperModule.CreateImageWrapper(EImageFormat::PNG);
+		if(!ImageWrapper.IsValid()
+			|| !ImageWrapper->SetRaw(Image.Pixels.GetData(), Image.Pixels.Num() * sizeof(FColor), Image.Width, Image.Height, ERGBFormat::BGRA, 8))
+		{
+			return false;
+		}
+		return FFileHelper::SaveArrayToFile(ImageWrapper->GetCompressed(), *Path);
+	}
+
+	bool SaveImage(const FWorldImage& Image, const FString& Path)
+	{
+		if(Image.Width <= 0 || Image.Height <= 0)
+		{
+			UE_LOG(LogGeneration, Error, TEXT("WorldImageExport::SaveImage - %s: the image is empty"), *Path);
+			return false;
+		}
+
+		const double StartTime = FPlatformTime::Seconds();
+		const bool bSaved = FPaths::GetExtension(Path).Equals(TEXT("ppm"), ESearchCase::IgnoreCase)
+			? SavePPM(Image, Path)
+			: SavePNG(Image, Path);
+		if(!bSaved)
+		{
+			UE_LOG(LogGeneration, Error, TEXT("WorldImageExport::SaveImage - can't write %s"), *Path);
+			return false;
+		}
+		UE_LOG(LogGeneration, Display, TEXT("WorldImageExport::SaveImage - %s (%dx%d) in %.1f ms"),
+			*Path, Image.Width, Image.Height, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+		return true;
+	}
+
+	FString GetExportDirectory()
+	{
+		return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("CityImages"));
+	}
+}
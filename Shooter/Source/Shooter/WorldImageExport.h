@@ -0,0 +1,57 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TileType.h"
+#include "WFCCompiledRules.h"
+
+class UWorldItem3DArray;
+class FWorldLayoutIndex;
+
+// Image of one Z-slab: pixel (x, y) is the element (x, y), rows along X as in AGenerator::LogDrawArray2DSlice
+struct FWorldImage
+{
+	int32 Width = 0;
+	int32 Height = 0;
+	TArray<FColor> Pixels;
+
+	// Keeps the allocation if the image is not getting bigger, so one image can be reused for every slab
+	void Init(int32 InWidth, int32 InHeight)
+	{
+		Width = InWidth;
+		Height = InHeight;
+		Pixels.SetNumUninitialized(Width * Height, false);
+	}
+};
+
+/**
+ * Writes slices of the world and statistics of the solver as images
+ * Pixels are drawn row by row in parallel straight into one buffer, and the file is written from one buffer too
+ * Works without a viewport, so cities of UCityFarmCommandlet can be exported as well
+ */
+namespace WorldImageExport
+{
+	SHOOTER_API FColor GetTileTypeColor(ETileType Type);
+
+	// Types of Z-slab of the layout, straight from the index - slabs which WFC doesn't solve have no dense grid
+	SHOOTER_API void DrawSlice(const FWorldLayoutIndex& Layout, int32 Z, FWorldImage& OutImage);
+
+	// Ground of the whole footprint of the layout: roads and crossroads in grey, every block in its own colour
+	SHOOTER_API void DrawLayout(const FWorldLayoutIndex& Layout, FWorldImage& OutImage);
+
+	// Values of one Z-slab ([y * Width + x]) from blue (the smallest) to red (the largest)
+	// Negative values mean "no value" and are black
+	SHOOTER_API void DrawHeatmap(TArrayView<const float> Values, int32 Width, int32 Height, FWorldImage& OutImage);
+
+	// Entropy of the initial candidates of each element of Z-slab, as FWFCSolver chooses the element to collapse
+	// TagDomains - in the layout of FWFCCompiledRules::TagDomains. -1 for elements which don't take part in WFC (NoCity)
+	SHOOTER_API void GetInitialEntropy(const FWFCCompiledRules& Rules, const TArray<uint64>& TagDomains, const UWorldItem3DArray& Array,
+		int32 Z, TArray<float>& OutEntropy);
+
+	// Format by the extension of Path: .ppm - binary PPM without compression (the fastest), otherwise PNG
+	SHOOTER_API bool SaveImage(const FWorldImage& Image, const FString& Path);
+
+	// Directory for images: Saved/CityImages
+	SHOOTER_API FString GetExportDirectory();
+}
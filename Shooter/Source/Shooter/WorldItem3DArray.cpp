@@ -5,64 +5,91 @@
 
 #include <string>
 
-UWorldItem3DArray::UWorldItem3DArray()
+UWorldItem3DArray::UWorldItem3DArray() :
+NumFilledSlabs(0)
 {
-	DefaultValue = NewObject<UWorldArrayItem>();
-	DefaultValue->TileType = ETileType::ETT_Undefined;
 }
 
-UWorldArrayItem* UWorldItem3DArray::GetElement(int32 z, int32 y, int32 x)
+void UWorldItem3DArray::Init(int32 boundZ, int32 boundY, int32 boundX)
 {
-	const int32 Index = z * Bounds.Y * Bounds.X
-				+ y * Bounds.X + x;
+	Bounds = FIntVector(boundX, boundY, boundZ);
 	
-	if(Arr.IsValidIndex(Index))
+	// Init() keeps the allocation when the size is the same, so a grid can be used for many cities
+	int32 arrLen = boundZ * boundY * boundX;
+	TileTypes.Init(ETileType::ETT_Undefined, arrLen);
+	ChosenFlags.Init(false, arrLen);
+	ColorTags.Init(ETileColorTag::ETCT_Indifferent, arrLen);
+	SolvedVariants.Reset();
+	NumFilledSlabs = 0;
+}
+
+void UWorldItem3DArray::FillSpan(int32 z, int32 y, int32 x0, int32 x1, ETileType Type, bool bChosen)
+{
+	if(z < 0 || z >= Bounds.Z || y < 0 || y >= Bounds.Y)
 	{
-		return Arr[Index];
+		return;
 	}
-	else
+	x0 = FMath::Max(x0, 0);
+	x1 = FMath::Min(x1, Bounds.X - 1);
+	if(x0 > x1)
 	{
-		UE_LOG(LogRoadGeneration, Error,
-		TEXT("UWorldItem3DArray::GetElement - INVALID INDEX! %d\n Index: iX: %d, iY: %d, iZ: %d\nBounds: bX: %d, bY: %d, bZ: %d"),
-		Index, x, y, z,
-		Bounds.X, Bounds.Y, Bounds.Z);
-		return nullptr;
+		return;
 	}
+
+	const int32 Start = z * Bounds.Y * Bounds.X + y * Bounds.X + x0;
+	const int32 Count = x1 - x0 + 1;
+	static_assert(sizeof(ETileType) == 1, "ETileType is written with memset");
+	FMemory::Memset(TileTypes.GetData() + Start, (uint8)Type, Count);
+	FMemory::Memset(ChosenFlags.GetData() + Start, bChosen ? 1 : 0, Count);
 }
 
-bool UWorldItem3DArray::SetElement(int32 z, int32 y, int32 x, UWorldArrayItem* Value)
+void UWorldItem3DArray::FillRect(int32 z, FIntPoint Min, FIntPoint Max, ETileType Type, bool bChosen)
 {
-	const int32 Index = z * Bounds.Y * Bounds.X
-				+ y * Bounds.X + x;
-	
-	if(Arr.IsValidIndex(Index))
+	const int32 y0 = FMath::Max(Min.Y, 0);
+	const int32 y1 = FMath::Min(Max.Y, Bounds.Y - 1);
+	for(int32 y = y0; y <= y1; y++)
 	{
-		UWorldArrayItem* Item = NewObject<UWorldArrayItem>();
-		Item->Init(Value->TileType, Value->ChosenTileIndex,
-			Value->PossibleTiles, Value->TileRotation, Value->bIsChosen);
-		Arr[Index] = Item;
-		return true;
+		FillSpan(z, y, Min.X, Max.X, Type, bChosen);
 	}
-	else
+}
+
+void UWorldItem3DArray::FillColorRect(int32 z, FIntPoint Min, FIntPoint Max, ETileColorTag Color)
+{
+	if(z < 0 || z >= Bounds.Z)
 	{
-		UE_LOG(LogRoadGeneration, Error,
-		TEXT("UWorldItem3DArray::SetElement - INVALID INDEX! %d\n Index: iX: %d, iY: %d, iZ: %d\nBounds: bX: %d, bY: %d, bZ: %d"),
-		Index, x, y, z,
-		Bounds.X, Bounds.Y, Bounds.Z);
+		return;
 	}
+	const int32 x0 = FMath::Max(Min.X, 0);
+	const int32 x1 = FMath::Min(Max.X, Bounds.X - 1);
+	const int32 y0 = FMath::Max(Min.Y, 0);
+	const int32 y1 = FMath::Min(Max.Y, Bounds.Y - 1);
+	if(x0 > x1)
+	{
+		return;
+	}
+	
+	static_assert(sizeof(ETileColorTag) == 1, "ETileColorTag is written with memset");
+	for(int32 y = y0; y <= y1; y++)
+	{
+		FMemory::Memset(ColorTags.GetData() + z * Bounds.Y * Bounds.X + y * Bounds.X + x0, (uint8)Color, x1 - x0 + 1);
+	}
+}
 
-	return false;
+void UWorldItem3DArray::CopySlab(int32 SrcZ, int32 DstZ)
+{
+	check(SrcZ >= 0 && SrcZ < Bounds.Z);
+	check(DstZ >= 0 && DstZ < Bounds.Z);
+	
+	const int32 SlabSize = Bounds.Y * Bounds.X;
+	FMemory::Memcpy(TileTypes.GetData() + DstZ * SlabSize, TileTypes.GetData() + SrcZ * SlabSize, SlabSize * sizeof(ETileType));
+	FMemory::Memcpy(ChosenFlags.GetData() + DstZ * SlabSize, ChosenFlags.GetData() + SrcZ * SlabSize, SlabSize * sizeof(bool));
+	FMemory::Memcpy(ColorTags.GetData() + DstZ * SlabSize, ColorTags.GetData() + SrcZ * SlabSize, SlabSize * sizeof(ETileColorTag));
 }
 
-void UWorldItem3DArray::Init(int32 boundZ, int32 boundY, int32 boundX)
+SIZE_T UWorldItem3DArray::GetAllocatedSize() const
 {
-	if(Arr.Num() == 0)
-	{
-		Bounds = FIntVector(boundX, boundY, boundZ);
-	 	
-		int32 arrLen = boundZ * boundY * boundX;
-		Arr.Init(DefaultValue, arrLen);
-	}
+	return TileTypes.GetAllocatedSize() + ChosenFlags.GetAllocatedSize() + ColorTags.GetAllocatedSize()
+		+ SolvedVariants.GetAllocatedSize() + Columns.GetAllocatedSize();
 }
 
 int32 UWorldItem3DArray::GetLinearIndex(int32 z, int32 y, int32 x)
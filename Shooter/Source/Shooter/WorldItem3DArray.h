@@ -3,10 +3,12 @@
 #pragma once
 
 #include "CoreMinimal.h"
-#include "TileRegistry.h"
 #include "UObject/NoExportTypes.h"
-#include "WorldArrayItem.h"
-#include "TileRegistry.h"
+#include "TileType.h"
+#include "TileColorTag.h"
+#include "TileCompatibilityDeltaPosition.h"
+#include "WorldColumnRuns.h"
+#include "GenerationLogs.h"
 #include "WorldItem3DArray.generated.h"
 
 /**
@@ -18,25 +20,48 @@ class SHOOTER_API UWorldItem3DArray : public UObject
 	GENERATED_BODY()
 public:
 	UWorldItem3DArray();
-	
-	UPROPERTY()	
-	TArray<UWorldArrayItem*> Arr;
-
-	UPROPERTY()
-	UWorldArrayItem* DefaultValue;
 
-	// TODO: Substitute all DoSmth(z, y, x) operations with:
-	// DoSmth(GetLinearIndex(z, y, x))
-	// and set Arr as public for direct operations 
-	
 	FIntVector Bounds;
 
-	UWorldArrayItem* GetElement(int32 z, int32 y, int32 x);
+	// Typed planes of the grid, indexed by GetLinearIndex(z, y, x), so rows along X are contiguous in memory
+	// Drawn by FWorldGridRasterizer only up to NumFilledSlabs, slabs above it are Undefined
+	TArray<ETileType> TileTypes;
+	TArray<bool> ChosenFlags;
+	// Colour of the building the element belongs to, chosen before WFC. Indifferent - any colour
+	TArray<ETileColorTag> ColorTags;
 
-	bool SetElement(int32 z, int32 y, int32 x, UWorldArrayItem* Value);
+	// Variant of FWFCCompiledRules chosen by WFC for each element. INDEX_NONE - no tile
+	TArray<int32> SolvedVariants;
+
+	// Z-slabs of typed planes [0; NumFilledSlabs) hold the layout
+	int32 NumFilledSlabs;
+
+	// The whole city by columns: the solved planes plus building floors above them, built after WFC
+	// The planes are only as high as the template of a building, real heights live here
+	FWorldColumnRuns Columns;
 	
 	void Init(int32 boundZ, int32 boundY, int32 boundX);
 
+	// Fills [x0; x1] of row (z, y) of typed planes. The span is clipped by the array bounds
+	void FillSpan(int32 z, int32 y, int32 x0, int32 x1, ETileType Type, bool bChosen);
+
+	// Fills [Min; Max] rectangle of Z-slab of typed planes. The rectangle is clipped by the array bounds
+	void FillRect(int32 z, FIntPoint Min, FIntPoint Max, ETileType Type, bool bChosen);
+
+	// Sets the colour of [Min; Max] rectangle of Z-slab. The rectangle is clipped by the array bounds
+	void FillColorRect(int32 z, FIntPoint Min, FIntPoint Max, ETileColorTag Color);
+
+	// Copies the whole Z-slab SrcZ into DstZ
+	void CopySlab(int32 SrcZ, int32 DstZ);
+
+	// Typed planes, variants and columns
+	SIZE_T GetAllocatedSize() const;
+
+	FORCEINLINE ETileType GetTileType(int32 z, int32 y, int32 x) const
+	{
+		return TileTypes[z * Bounds.Y * Bounds.X + y * Bounds.X + x];
+	}
+
 	int32 GetLinearIndex(int32 z, int32 y, int32 x);
 
 	int32 GetDeltaIndex(ETileCompatibilityDeltaPosition delta);
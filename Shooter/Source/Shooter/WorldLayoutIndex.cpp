@@ -0,0 +1,229 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WorldLayoutIndex.h"
+#include "GenerationLogs.h"
+
+// Rectangle which has different types for its corners, borders and inner area
+static ETileType GetFramedType(FIntPoint Min, FIntPoint Max, int32 x, int32 y,
+	ETileType CornerType, ETileType BorderType, ETileType InnerType)
+{
+	const bool bEdgeX = x == Min.X || x == Max.X;
+	const bool bEdgeY = y == Min.Y || y == Max.Y;
+	if(bEdgeX && bEdgeY)
+	{
+		return CornerType;
+	}
+	return bEdgeX || bEdgeY ? BorderType : InnerType;
+}
+
+FWorldLayoutIndex::FWorldLayoutIndex() :
+Footprint(FIntPoint::ZeroValue),
+CityStart(FIntPoint::ZeroValue),
+CityEnd(FIntPoint::ZeroValue)
+{
+}
+
+void FWorldLayoutIndex::Build(FIntPoint InFootprint, FIntPoint InCityStart, FIntPoint InCityEnd,
+	const TArray<FRoadBaseCoord>& XRoadPoints, const TArray<FRoadBaseCoord>& YRoadPoints,
+	const TArray<FRoad>& Roads, const TArray<FBlock>& Blocks)
+{
+	Footprint = InFootprint;
+	CityStart = InCityStart;
+	CityEnd = InCityEnd;
+
+	TArray<FLayoutRect> RoadRects;
+	RoadRects.Reserve(Roads.Num() + XRoadPoints.Num() * YRoadPoints.Num());
+	for(const FRoad& Road : Roads)
+	{
+		const FIntPoint Min(Road.StartPoint.X, Road.StartPoint.Y);
+		const FIntPoint Max = Road.bDirectedAlongX
+			? FIntPoint(Road.StartPoint.X + Road.RoadWidth - 1, Road.EndPoint.Y)
+			: FIntPoint(Road.EndPoint.X, Road.StartPoint.Y + Road.RoadWidth - 1);
+		RoadRects.Add({ Min, Max, (int32)ETileType::ETT_Road, RoadRects.Num() });
+	}
+
+	// Crossroads cover roads - roads never replace crossroads
+	for(const FRoadBaseCoord& XPoint : XRoadPoints)
+	{
+		for(const FRoadBaseCoord& YPoint : YRoadPoints)
+		{
+			const FIntPoint Min(XPoint.coord, YPoint.coord);
+			const FIntPoint Max = Min + FIntPoint(XPoint.RoadWidth - 1, YPoint.RoadWidth - 1);
+			RoadRects.Add({ Min, Max, (int32)ETileType::ETT_Road_Crossroads, RoadRects.Num() });
+		}
+	}
+
+	TArray<FLayoutRect> BlockRects;
+	BlockRects.Reserve(Blocks.Num());
+	for(int32 Block = 0; Block < Blocks.Num(); Block++)
+	{
+		BlockRects.Add({
+			FIntPoint(Blocks[Block].StartCorner.X, Blocks[Block].StartCorner.Y),
+			FIntPoint(Blocks[Block].EndCorner.X, Blocks[Block].EndCorner.Y),
+			Block, Block });
+	}
+
+	RoadTree.Build(MoveTemp(RoadRects));
+	BlockTree.Build(MoveTemp(BlockRects));
+
+	UE_LOG(LogGeneration, Display, TEXT("FWorldLayoutIndex::Build - %d roads, %d crossroads, %d blocks, %llu KB"),
+		Roads.Num(), XRoadPoints.Num() * YRoadPoints.Num(), Blocks.Num(), (uint64)GetAllocatedSize() / 1024);
+}
+
+void FWorldLayoutIndex::Reset()
+{
+	Footprint = FIntPoint::ZeroValue;
+	RoadTree.Reset();
+	BlockTree.Reset();
+}
+
+ETileType FWorldLayoutIndex::GetTileType(int32 x, int32 y, int32 z) const
+{
+	if(x < 0 || y < 0 || z < 0 || x >= Footprint.X || y >= Footprint.Y)
+	{
+		return ETileType::ETT_NoCity;
+	}
+
+	const bool bInCity = x >= CityStart.X && x <= CityEnd.X && y >= CityStart.Y && y <= CityEnd.Y;
+	const FLayoutRect* Block = BlockTree.Find(x, y);
+
+	if(z == 0)
+	{
+		if(Block)
+		{
+			return GetFramedType(Block->Min, Block->Max, x, y,
+				ETileType::ETT_Sidewalks_Corner, ETileType::ETT_Sidewalks_Borderline, ETileType::ETT_Sidewalks_Inner);
+		}
+		if(const FLayoutRect* Road = RoadTree.Find(x, y))
+		{
+			return (ETileType)Road->Value;
+		}
+		return bInCity ? ETileType::ETT_Undefined : ETileType::ETT_NoCity;
+	}
+
+	// Building takes inner area of the block (sidewalks are the border of the block)
+	if(Block && x > Block->Min.X && x < Block->Max.X && y > Block->Min.Y && y < Block->Max.Y)
+	{
+		const FIntPoint Min = Block->Min + FIntPoint(1, 1);
+		const FIntPoint Max = Block->Max - FIntPoint(1, 1);
+		return z == 1
+			? GetFramedType(Min, Max, x, y, ETileType::ETT_Building_Door_Corner, ETileType::ETT_Building_Door_Section, ETileType::ETT_Building_Greeble_Cube)
+			: GetFramedType(Min, Max, x, y, ETileType::ETT_Building_Window_Corner, ETileType::ETT_Building_Window_Section, ETileType::ETT_Building_Greeble_Cube);
+	}
+	return bInCity ? ETileType::ETT_Air : ETileType::ETT_NoCity;
+}
+
+int32 FWorldLayoutIndex::GetBlock(int32 x, int32 y) const
+{
+	const FLayoutRect* Block = BlockTree.Find(x, y);
+	return Block ? Block->Value : INDEX_NONE;
+}
+
+SIZE_T FWorldLayoutIndex::GetAllocatedSize() const
+{
+	return RoadTree.GetAllocatedSize() + BlockTree.GetAllocatedSize();
+}
+
+void FWorldLayoutIndex::FRectTree::Build(TArray<FLayoutRect>&& InRects)
+{
+	Rects = MoveTemp(InRects);
+	Nodes.Reset();
+	if(Rects.Num() > 0)
+	{
+		Nodes.Reserve(2 * FMath::DivideAndRoundUp(Rects.Num(), LeafSize));
+		BuildNode(0, Rects.Num());
+	}
+}
+
+void FWorldLayoutIndex::FRectTree::Reset()
+{
+	Rects.Reset();
+	Nodes.Reset();
+}
+
+int32 FWorldLayoutIndex::FRectTree::BuildNode(int32 Begin, int32 End)
+{
+	FNode Node;
+	Node.Min = Rects[Begin].Min;
+	Node.Max = Rects[Begin].Max;
+	// Doubled centres, so they stay integer
+	FIntPoint CenterMin(MAX_int32, MAX_int32);
+	FIntPoint CenterMax(MIN_int32, MIN_int32);
+	for(int32 i = Begin; i < End; i++)
+	{
+		Node.Min = Node.Min.ComponentMin(Rects[i].Min);
+		Node.Max = Node.Max.ComponentMax(Rects[i].Max);
+		const FIntPoint Center = Rects[i].Min + Rects[i].Max;
+		CenterMin = CenterMin.ComponentMin(Center);
+		CenterMax = CenterMax.ComponentMax(Center);
+	}
+
+	const int32 NodeIndex = Nodes.Add(Node);
+	if(End - Begin <= LeafSize)
+	{
+		Nodes[NodeIndex].First = Begin;
+		Nodes[NodeIndex].Num = End - Begin;
+		return NodeIndex;
+	}
+
+	const bool bSplitX = CenterMax.X - CenterMin.X >= CenterMax.Y - CenterMin.Y;
+	Sort(Rects.GetData() + Begin, End - Begin, [bSplitX](const FLayoutRect& A, const FLayoutRect& B)
+	{
+		return bSplitX
+			? A.Min.X + A.Max.X < B.Min.X + B.Max.X
+			: A.Min.Y + A.Max.Y < B.Min.Y + B.Max.Y;
+	});
+
+	const int32 Middle = (Begin + End) / 2;
+	BuildNode(Begin, Middle);
+	const int32 SecondChild = BuildNode(Middle, End);
+	// Children may have reallocated Nodes
+	Nodes[NodeIndex].First = SecondChild;
+	Nodes[NodeIndex].Num = 0;
+	return NodeIndex;
+}
+
+const FWorldLayoutIndex::FLayoutRect* FWorldLayoutIndex::FRectTree::Find(int32 x, int32 y) const
+{
+	const FLayoutRect* Found = nullptr;
+	if(Nodes.Num() == 0)
+	{
+		return Found;
+	}
+
+	// Depth of a median tree is log2 of the amount of leaves
+	int32 Stack[64];
+	int32 StackSize = 0;
+	Stack[StackSize++] = 0;
+	while(StackSize > 0)
+	{
+		const int32 NodeIndex = Stack[--StackSize];
+		const FNode& Node = Nodes[NodeIndex];
+		if(x < Node.Min.X || x > Node.Max.X || y < Node.Min.Y || y > Node.Max.Y)
+		{
+			continue;
+		}
+
+		if(Node.Num > 0)
+		{
+			for(int32 i = Node.First; i < Node.First + Node.Num; i++)
+			{
+				if(Rects[i].Contains(x, y) && (!Found || Rects[i].Order > Found->Order))
+				{
+					Found = &Rects[i];
+				}
+			}
+			continue;
+		}
+
+		Stack[StackSize++] = Node.First;
+		Stack[StackSize++] = NodeIndex + 1;
+	}
+	return Found;
+}
+
+SIZE_T FWorldLayoutIndex::FRectTree::GetAllocatedSize() const
+{
+	return Rects.GetAllocatedSize() + Nodes.GetAllocatedSize();
+}
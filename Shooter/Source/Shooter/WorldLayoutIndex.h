@@ -0,0 +1,113 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TileType.h"
+#include "WorldItem3DArray.h"
+#include "Road.h"
+#include "RoadBaseCoord.h"
+#include "Block.h"
+
+/**
+ * Type of any single element of the city straight from the road map, without a grid: roads, crossroads and blocks
+ * are kept as rectangles in trees of bounding rectangles, a query visits only the nodes whose bounds contain the element.
+ * For point queries - slice images, logs, traffic. Whole slabs for WFC are drawn span by span by FWorldGridRasterizer
+ * Types are the same as if the rectangles were drawn into a grid in order - later ones cover earlier ones:
+ * - ground (Z = 0): NoCity out of the city area, roads, crossroads over them and sidewalks of blocks over everything
+ * - Z = 1: Air, NoCity out of the city area and door floor of buildings
+ * - Z >= 2: the same with window floors of buildings. There is no top, the floors repeat
+ * Blocks don't overlap, so an element belongs to one block at most
+ */
+class SHOOTER_API FWorldLayoutIndex
+{
+public:
+	FWorldLayoutIndex();
+
+	// Footprint - XY size of the world, everything out of it is NoCity. CityStart and CityEnd are inclusive XY bounds of the city
+	void Build(FIntPoint InFootprint, FIntPoint InCityStart, FIntPoint InCityEnd,
+		const TArray<FRoadBaseCoord>& XRoadPoints, const TArray<FRoadBaseCoord>& YRoadPoints,
+		const TArray<FRoad>& Roads, const TArray<FBlock>& Blocks);
+
+	void Reset();
+
+	ETileType GetTileType(int32 x, int32 y, int32 z) const;
+
+	// Index of the block of (x, y) in Blocks of Build(), INDEX_NONE out of blocks
+	int32 GetBlock(int32 x, int32 y) const;
+
+	FORCEINLINE FIntPoint GetFootprint() const { return Footprint; }
+
+	// Calls Func(Min, Max, Type) with the inclusive rectangle of each road (ETT_Road) and crossroads (ETT_Road_Crossroads)
+	template<typename FuncType>
+	void ForEachRoadRect(FuncType Func) const
+	{
+		for(const FLayoutRect& Rect : RoadTree.GetRects())
+		{
+			Func(Rect.Min, Rect.Max, (ETileType)Rect.Value);
+		}
+	}
+
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	struct FLayoutRect
+	{
+		// Inclusive
+		FIntPoint Min;
+		FIntPoint Max;
+		// ETileType of a road, index of a block
+		int32 Value;
+		// Order of drawing, the latest rectangle wins
+		int32 Order;
+
+		FORCEINLINE bool Contains(int32 x, int32 y) const
+		{
+			return x >= Min.X && x <= Max.X && y >= Min.Y && y <= Max.Y;
+		}
+	};
+
+	// Static tree of bounding rectangles, split by the median of the centres along the longer side
+	class FRectTree
+	{
+	public:
+		void Build(TArray<FLayoutRect>&& InRects);
+
+		void Reset();
+
+		// The latest rectangle which contains (x, y), nullptr if there is none
+		const FLayoutRect* Find(int32 x, int32 y) const;
+
+		// In the order of the tree, not of drawing
+		FORCEINLINE const TArray<FLayoutRect>& GetRects() const { return Rects; }
+
+		SIZE_T GetAllocatedSize() const;
+
+	private:
+		struct FNode
+		{
+			FIntPoint Min;
+			FIntPoint Max;
+			// Leaf: first rectangle and amount. Inner node: the first child is the next node, First - index of the second one, Num = 0
+			int32 First;
+			int32 Num;
+		};
+
+		static constexpr int32 LeafSize = 4;
+
+		// Builds the node of Rects[Begin; End) and its children, returns its index
+		int32 BuildNode(int32 Begin, int32 End);
+
+		TArray<FLayoutRect> Rects;
+		TArray<FNode> Nodes;
+	};
+
+	FIntPoint Footprint;
+	FIntPoint CityStart;
+	FIntPoint CityEnd;
+
+	// Roads, then crossroads
+	FRectTree RoadTree;
+	// Whole rectangles of blocks, sidewalks included
+	FRectTree BlockTree;
+};